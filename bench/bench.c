@@ -0,0 +1,1392 @@
+/*
+ * bench.c
+ * Copyright (C) 2009-2020 Joachim de Groot <jdegroot@web.de>
+ *
+ * NLarn is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * NLarn is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Microbenchmarks of the engine on games started from a fixed seed. The
+ * results are printed as JSON, one report per subsystem; each report is
+ * described where it is made. Times are in microseconds. Some reports
+ * check that an optimisation does not change the outcome of the game;
+ * the program fails if such a check fails. Usage:
+ *
+ *   nlarn-bench [samples]
+ */
+
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cJSON.h"
+#include "codec.h"
+#include "config.h"
+#include "counters.h"
+#include "display.h"
+#include "fov.h"
+#include "game.h"
+#include "maze.h"
+#include "nlarn.h"
+#include "pathfinding.h"
+#include "timewheel.h"
+
+#define STR_HELPER(x) #x
+#define STR(x) STR_HELPER(x)
+
+/* the globals usually provided by nlarn.c */
+const char *nlarn_version = STR(VERSION_MAJOR) "." STR(VERSION_MINOR) "." STR(VERSION_PATCH) GITREV;
+const char *nlarn_libdir = "";
+const char *nlarn_mesgfile = "";
+const char *nlarn_helpfile = "";
+const char *nlarn_mazefile = "";
+const char *nlarn_fortunes = "";
+const char *nlarn_highscores = "";
+const char *nlarn_inifile = "";
+const char *nlarn_savefile = "";
+
+jmp_buf nlarn_death_jump;
+
+#define BENCH_SEED     4711
+#define BENCH_MONSTERS 200  /* spread over all levels */
+#define BENCH_LEVEL    3    /* the level most kernels work on */
+#define BENCH_CROWDED  4    /* the level crowded with monsters */
+#define BENCH_INPUTS   64   /* inputs prepared for each kernel */
+#define SAMPLE_TIME    2000 /* minimal duration of a sample in microseconds */
+#define CHECK_GAMES    2    /* games played side by side */
+#define CHECK_TURNS    500  /* turns played in each of them */
+#define PLANNERS       4    /* threads planning the monsters' moves */
+#define SIZE_SCALES    3    /* map sizes compared: 1x, 4x and 16x the area */
+#define RESIDENT       3    /* levels kept in memory by the paged games */
+#define DEEP_DEPTH     100  /* the deepest level of the caverns of the deep game */
+#define DEEP_LAYOUTS   8    /* levels laid out ahead at most in the deep game */
+#define BURST_KEYS     50   /* keys typed ahead at once */
+#define TRAVELS        10   /* travel commands given on a known level */
+#define REST_TURNS     2000 /* turns the wounded player rests */
+
+/* run a kernel once; the argument allows choosing the input */
+typedef void (*bench_run)(guint idx);
+
+/* prepare the inputs for the following runs, not measured */
+typedef void (*bench_prepare)(guint count);
+
+typedef struct bench
+{
+    const char *name;
+    bench_prepare prepare;
+    bench_run run;
+    guint batch;        /* runs per sample, 0 to determine automatically */
+} bench;
+
+static struct game_config config = { 0 };
+
+static position pairs_near[BENCH_INPUTS][2];
+static position pairs_mid[BENCH_INPUTS][2];
+static position pairs_far[BENCH_INPUTS][2];
+static position pairs_crowded[BENCH_INPUTS][2];
+
+static fov *bench_fov;
+static cJSON *level_json;
+static item *items[BENCH_INPUTS];
+static inventory *stack;
+static GPtrArray *waters;
+static gchar *tmpdir;
+static guint saves = 0;
+static game *paging_game;
+
+/* the codecs compared on the text of the saved game */
+static const char *codecs[] = { "gzip-1", "gzip", "gzip-9", "lz4" };
+static gchar *save_text;
+static gsize save_len;
+static GBytes *save_member;
+
+/* Start a game of its own from the given configuration with the player on
+   the given level. If prev is not NULL, the game in use before is stored
+   there to be restored by fixture_end(). */
+static game *fixture_start(struct game_config cfg, guint nmap, game **prev)
+{
+    game *before = game_use(NULL);
+
+    if (prev != NULL)
+        *prev = before;
+
+    game *g = game_create(&cfg);
+    player_map_enter(g->p, game_map_generate(g, nmap), FALSE);
+
+    return g;
+}
+
+static void fixture_end(game *g, game *prev)
+{
+    game_destroy(g);
+    game_use(prev);
+}
+
+static guint count_monsters(guint nmap)
+{
+    GHashTableIter iter;
+    gpointer oid, m;
+    guint count = 0;
+
+    g_hash_table_iter_init(&iter, nlarn->monsters);
+    while (g_hash_table_iter_next(&iter, &oid, &m))
+    {
+        if (nmap == MAP_MAX || Z(monster_pos(m)) == nmap)
+            count++;
+    }
+
+    return count;
+}
+
+/* spread BENCH_MONSTERS monsters evenly over all levels but the town */
+static void bench_monsters_spread()
+{
+    const guint quota = (BENCH_MONSTERS - count_monsters(0)) / (MAP_MAX - 1);
+    GList *monsters = g_hash_table_get_values(nlarn->monsters);
+
+    for (GList *iter = monsters; iter != NULL; iter = iter->next)
+    {
+        monster *m = iter->data;
+        guint nmap = Z(monster_pos(m));
+
+        if (nmap > 0 && count_monsters(nmap) > quota)
+        {
+            map_set_monster_at(game_map(nlarn, nmap), monster_pos(m), NULL);
+            monster_destroy(m);
+        }
+    }
+
+    g_list_free(monsters);
+
+    for (guint nmap = 1; count_monsters(MAP_MAX) < BENCH_MONSTERS; nmap++)
+    {
+        if (nmap == MAP_MAX)
+            nmap = 1;
+
+        position pos = map_find_space(game_map(nlarn, nmap), LE_MONSTER, FALSE);
+
+        if (pos_valid(pos))
+            monster_new_by_level(pos);
+    }
+
+    game_actors_wake(nlarn);
+}
+
+/* find pairs of positions whose distance is within the given limits */
+static void bench_pairs(guint nmap, position pairs[][2], int dmin, int dmax)
+{
+    map *m = game_map(nlarn, nmap);
+    guint found = 0;
+
+    for (guint attempt = 0; found < BENCH_INPUTS && attempt < 100000; attempt++)
+    {
+        position a = map_find_space(m, LE_GROUND, FALSE);
+        position b = map_find_space(m, LE_GROUND, FALSE);
+        int dist = pos_distance(a, b);
+
+        if (dist >= dmin && dist <= dmax)
+        {
+            pairs[found][0] = a;
+            pairs[found][1] = b;
+            found++;
+        }
+    }
+
+    /* reuse what has been found if the level is too small */
+    for (guint idx = found; found > 0 && idx < BENCH_INPUTS; idx++)
+    {
+        pairs[idx][0] = pairs[idx % found][0];
+        pairs[idx][1] = pairs[idx % found][1];
+    }
+
+    g_assert(found > 0);
+}
+
+static void path_find_pair(position pair[2])
+{
+    path *p = path_find(game_map(nlarn, Z(pair[0])), pair[0], pair[1], LE_GROUND);
+    if (p != NULL) path_destroy(p);
+}
+
+static void run_path_near(guint idx)
+{
+    path_find_pair(pairs_near[idx % BENCH_INPUTS]);
+}
+
+static void run_path_mid(guint idx)
+{
+    path_find_pair(pairs_mid[idx % BENCH_INPUTS]);
+}
+
+static void run_path_far(guint idx)
+{
+    path_find_pair(pairs_far[idx % BENCH_INPUTS]);
+}
+
+static void run_path_crowded(guint idx)
+{
+    path_find_pair(pairs_crowded[idx % BENCH_INPUTS]);
+}
+
+static void run_fov_6(guint idx)
+{
+    fov_calculate(bench_fov, game_map(nlarn, BENCH_LEVEL),
+                  pairs_mid[idx % BENCH_INPUTS][0], 6, FALSE);
+}
+
+static void run_fov_15(guint idx)
+{
+    fov_calculate(bench_fov, game_map(nlarn, BENCH_LEVEL),
+                  pairs_mid[idx % BENCH_INPUTS][0], 15, FALSE);
+}
+
+static void run_pos_is_visible(guint idx)
+{
+    position *pair = pairs_mid[idx % BENCH_INPUTS];
+    map_pos_is_visible(game_map(nlarn, BENCH_LEVEL), pair[0], pair[1]);
+}
+
+static void run_ray(guint idx)
+{
+    position *pair = pairs_mid[idx % BENCH_INPUTS];
+    g_list_free(map_ray(game_map(nlarn, BENCH_LEVEL), pair[0], pair[1]));
+}
+
+static void run_circle_flooded(guint idx)
+{
+    position center = pairs_mid[idx % BENCH_INPUTS][0];
+    area *obstacles = map_get_obstacles(game_map(nlarn, BENCH_LEVEL),
+                                        center, 5, TRUE);
+
+    area_destroy(area_new_circle_flooded(center, 5, obstacles));
+}
+
+/* area_blast() without drawing and pausing: find the positions hit */
+static void run_blast_hits(guint idx)
+{
+    map *m = game_map(nlarn, BENCH_LEVEL);
+    position cursor = pairs_mid[idx % BENCH_INPUTS][0];
+    area *ball = area_new_circle_flooded(cursor, 3,
+            map_get_obstacles(m, cursor, 3, TRUE));
+    guint hits = 0;
+
+    for (Y(cursor) = ball->start_y; Y(cursor) < ball->start_y + ball->size_y; Y(cursor)++)
+        for (X(cursor) = ball->start_x; X(cursor) < ball->start_x + ball->size_x; X(cursor)++)
+            if (area_pos_get(ball, cursor) && map_get_monster_at(m, cursor))
+                hits++;
+
+    area_destroy(ball);
+}
+
+static void run_validate(guint idx __attribute__((unused)))
+{
+    map_validate(game_map(nlarn, BENCH_LEVEL));
+}
+
+static void run_serialize(guint idx __attribute__((unused)))
+{
+    cJSON_Delete(map_serialize(game_map(nlarn, BENCH_LEVEL)));
+}
+
+static void run_deserialize(guint idx __attribute__((unused)))
+{
+    map *m = map_deserialize(level_json);
+
+    /* the items and monsters belong to the original level */
+    for (int y = 0; y < m->height; y++)
+        for (int x = 0; x < m->width; x++)
+            if (map_grid(m, x, y).ilist != NULL)
+            {
+                g_ptr_array_free(map_grid(m, x, y).ilist->content, TRUE);
+                g_free(map_grid(m, x, y).ilist);
+            }
+
+    g_free(m->grid);
+    g_free(m);
+}
+
+static void prepare_inv_add(guint count)
+{
+    for (guint idx = 0; idx < count; idx++)
+        g_ptr_array_add(waters, item_new(IT_POTION, PO_WATER));
+}
+
+static void run_inv_add(guint idx __attribute__((unused)))
+{
+    inv_add(&stack, g_ptr_array_remove_index_fast(waters, waters->len - 1));
+}
+
+static void run_describe(guint idx)
+{
+    g_free(item_describe(items[idx % BENCH_INPUTS], TRUE, FALSE, FALSE));
+}
+
+static void run_describe_uncached(guint idx)
+{
+    item_desc_invalidate();
+    g_free(item_describe(items[idx % BENCH_INPUTS], TRUE, FALSE, FALSE));
+}
+
+static void prepare_serial(guint count __attribute__((unused)))
+{
+    nlarn->planners = 1;
+}
+
+static void prepare_planned(guint count __attribute__((unused)))
+{
+    nlarn->planners = PLANNERS;
+}
+
+static void run_turn(guint idx __attribute__((unused)))
+{
+    game_spin_the_wheel(nlarn);
+}
+
+static void run_save(guint idx __attribute__((unused)))
+{
+    game_save(nlarn);
+}
+
+/* all levels changed since the last save */
+static void prepare_save_all(guint count __attribute__((unused)))
+{
+    g_assert(count == 1);
+
+    for (guint nmap = 0; nmap < MAP_MAX; nmap++)
+        game_map(nlarn, nmap)->modified = TRUE;
+}
+
+/* a piece of the work done while waiting for a key, which holds up
+   the key pressed meanwhile: the next save of a changed level */
+static void prepare_idle(guint count __attribute__((unused)))
+{
+    game_autosave(nlarn) = TRUE;
+    prepare_save_all(count);
+}
+
+static void run_idle(guint idx __attribute__((unused)))
+{
+    game_idle(nlarn, 1);
+}
+
+/* the save file is locked while the game is running,
+   hence every restored game needs its own copy */
+static void prepare_load(guint count __attribute__((unused)))
+{
+    gchar *content;
+    gsize length;
+
+    g_assert(count == 1);
+
+    g_file_get_contents(nlarn_savefile, &content, &length, NULL);
+    nlarn_savefile = g_strdup_printf("%s/nlarn-%u.sav", tmpdir, ++saves);
+    g_file_set_contents(nlarn_savefile, content, length, NULL);
+    g_free(content);
+
+    nlarn = game_destroy(nlarn);
+}
+
+static void run_load(guint idx __attribute__((unused)))
+{
+    game_init(&config);
+}
+
+static void run_compress(guint idx __attribute__((unused)))
+{
+    g_bytes_unref(codec_compress(save_text, save_len));
+}
+
+static void run_decompress(guint idx __attribute__((unused)))
+{
+    gsize len;
+    gconstpointer data = g_bytes_get_data(save_member, &len);
+
+    g_free(codec_decompress(data, len, NULL));
+}
+
+static void prepare_page_in(guint count __attribute__((unused)))
+{
+    game_levels_page(paging_game);
+}
+
+static void run_page_in(guint idx __attribute__((unused)))
+{
+    game_map(paging_game, MAP_MAX - 1);
+}
+
+static void prepare_page_out(guint count __attribute__((unused)))
+{
+    game_map(paging_game, MAP_MAX - 1);
+}
+
+static void run_page_out(guint idx __attribute__((unused)))
+{
+    game_levels_page(paging_game);
+}
+
+static int compare_doubles(const void *a, const void *b)
+{
+    const double da = *(const double *)a, db = *(const double *)b;
+    return (da > db) - (da < db);
+}
+
+static double bench_sample(const bench *b, guint batch, guint first)
+{
+    if (b->prepare != NULL)
+        b->prepare(batch);
+
+    gint64 start = g_get_monotonic_time();
+
+    for (guint idx = 0; idx < batch; idx++)
+        b->run(first + idx);
+
+    return (double)(g_get_monotonic_time() - start);
+}
+
+static cJSON *bench_measure(const bench *b, guint samples)
+{
+    guint batch = b->batch;
+    double times[samples];
+
+    /* choose a batch that takes long enough to be measured reliably */
+    if (batch == 0)
+    {
+        for (batch = 1; batch < (1 << 20); batch <<= 1)
+        {
+            if (bench_sample(b, batch, 0) >= SAMPLE_TIME)
+                break;
+        }
+    }
+
+    for (guint s = 0; s < samples; s++)
+        times[s] = bench_sample(b, batch, s * batch) / batch;
+
+    qsort(times, samples, sizeof(double), compare_doubles);
+
+    cJSON *res = cJSON_CreateObject();
+    cJSON_AddStringToObject(res, "name", b->name);
+    cJSON_AddNumberToObject(res, "samples", samples);
+    cJSON_AddNumberToObject(res, "batch", batch);
+    cJSON_AddNumberToObject(res, "median", times[samples / 2]);
+    cJSON_AddNumberToObject(res, "p95", times[(samples * 95 + 99) / 100 - 1]);
+
+    return res;
+}
+
+/* compress the last saved game with every codec */
+static cJSON *bench_codecs(guint samples, gboolean *ok __attribute__((unused)))
+{
+    const bench compress = { "compress", NULL, run_compress, 0 };
+    const bench decompress = { "decompress", NULL, run_decompress, 0 };
+    cJSON *table = cJSON_CreateArray();
+    gchar *raw;
+    gsize len;
+
+    g_file_get_contents(nlarn_savefile, &raw, &len, NULL);
+    save_text = codec_decompress(raw, len, &save_len);
+    g_free(raw);
+
+    for (guint idx = 0; idx < G_N_ELEMENTS(codecs); idx++)
+    {
+        codec_select(codecs[idx]);
+        save_member = codec_compress(save_text, save_len);
+
+        cJSON *c = bench_measure(&compress, samples);
+        cJSON *d = bench_measure(&decompress, samples);
+        const gsize size = g_bytes_get_size(save_member);
+
+        cJSON *row = cJSON_CreateObject();
+        cJSON_AddStringToObject(row, "name", codecs[idx]);
+        cJSON_AddNumberToObject(row, "bytes", save_len);
+        cJSON_AddNumberToObject(row, "compressed", size);
+        cJSON_AddNumberToObject(row, "ratio", (double)save_len / size);
+        cJSON_AddNumberToObject(row, "compress",
+                cJSON_GetObjectItem(c, "median")->valuedouble);
+        cJSON_AddNumberToObject(row, "decompress",
+                cJSON_GetObjectItem(d, "median")->valuedouble);
+        cJSON_AddItemToArray(table, row);
+
+        cJSON_Delete(c);
+        cJSON_Delete(d);
+        g_bytes_unref(save_member);
+    }
+
+    codec_select("gzip");
+    g_free(save_text);
+
+    return table;
+}
+
+/* Play a level of the classic size and levels of four and sixteen times its
+   area: the time of a turn should grow with the number of monsters rather
+   than with the size of the level. */
+static cJSON *bench_sizes(guint samples, gboolean *ok __attribute__((unused)))
+{
+    const bench turn = { "turn", NULL, run_turn, 0 };
+    cJSON *table = cJSON_CreateArray();
+
+    for (guint scale = 1; scale < (1 << SIZE_SCALES); scale <<= 1)
+    {
+        struct game_config cfg = config;
+        game *prev;
+
+        cfg.map_width = MAP_MAX_X * scale;
+        cfg.map_height = MAP_MAX_Y * scale;
+
+        game *g = fixture_start(cfg, BENCH_LEVEL, &prev);
+
+        cJSON *res = bench_measure(&turn, samples);
+        cJSON_DeleteItemFromObject(res, "name");
+        cJSON_AddNumberToObject(res, "width", cfg.map_width);
+        cJSON_AddNumberToObject(res, "height", cfg.map_height);
+        cJSON_AddNumberToObject(res, "monsters", count_monsters(BENCH_LEVEL));
+        cJSON_AddItemToArray(table, res);
+
+        fixture_end(g, prev);
+    }
+
+    return table;
+}
+
+/* Page out the levels of a game and read them back: the state of the game
+   must not change. Reports the time of moving the deepest level in and
+   out and the memory kept by the levels. */
+static cJSON *bench_paging(guint samples, gboolean *same)
+{
+    const bench page_in = { "page_in", prepare_page_in, run_page_in, 1 };
+    const bench page_out = { "page_out", prepare_page_out, run_page_out, 1 };
+    struct game_config cfg = config;
+    game *prev;
+
+    cfg.resident_levels = RESIDENT;
+    paging_game = fixture_start(cfg, 1, &prev);
+
+    for (guint nmap = 0; nmap < MAP_MAX; nmap++)
+        game_map_generate(paging_game, nmap);
+
+    gchar *before = game_state_hash(paging_game);
+    game_levels_page(paging_game);
+    gchar *paged = game_state_hash(paging_game);
+
+    guint resident = 0;
+    for (guint nmap = 0; nmap < MAP_MAX; nmap++)
+        resident += !paging_game->maps[nmap]->paged;
+
+    const guint64 stored = (paging_game->level_store != NULL)
+        ? level_store_used(paging_game->level_store) : 0;
+
+    for (guint nmap = 0; nmap < MAP_MAX; nmap++)
+        game_map(paging_game, nmap);
+
+    gchar *after = game_state_hash(paging_game);
+
+    cJSON *res = cJSON_CreateObject();
+    cJSON_AddNumberToObject(res, "levels", MAP_MAX);
+    cJSON_AddNumberToObject(res, "resident", resident);
+    cJSON_AddNumberToObject(res, "stored", stored);
+    cJSON_AddItemToObject(res, "page_in", bench_measure(&page_in, samples));
+    cJSON_AddItemToObject(res, "page_out", bench_measure(&page_out, samples));
+
+    *same = (resident == RESIDENT) && g_strcmp0(before, paged) == 0
+        && g_strcmp0(before, after) == 0;
+    cJSON_AddBoolToObject(res, "same", *same);
+
+    g_free(before);
+    g_free(paged);
+    g_free(after);
+    fixture_end(paging_game, prev);
+    paging_game = NULL;
+
+    return res;
+}
+
+/* the amulet of larn lies on the floor of a level */
+static gboolean bench_amulet_found(map *m)
+{
+    position pos = pos_invalid;
+    Z(pos) = m->nlevel;
+
+    for (Y(pos) = 0; Y(pos) < m->height; Y(pos)++)
+        for (X(pos) = 0; X(pos) < m->width; X(pos)++)
+        {
+            inventory *inv = map_tile_get(m, pos)->ilist;
+
+            for (guint idx = 0; idx < inv_length(inv); idx++)
+            {
+                item *it = inv_get(inv, idx);
+
+                if (it->type == IT_AMULET && it->id == AM_LARN)
+                    return TRUE;
+            }
+        }
+
+    return FALSE;
+}
+
+/* Walk down the caverns of a deep dungeon paged like the paged game: the
+   levels in memory and the levels laid out ahead must not grow with the
+   depth, and the amulet of larn has to lie on the deepest level of the
+   caverns. Reports the time of the descent by a level. */
+static cJSON *bench_deep(guint samples __attribute__((unused)), gboolean *ok)
+{
+    struct game_config cfg = config;
+    game *prev;
+
+    cfg.depth = DEEP_DEPTH;
+    cfg.resident_levels = RESIDENT;
+    game *g = fixture_start(cfg, 1, &prev);
+
+    guint resident_max = 0, layouts_max = 0;
+    const gint64 start = g_get_monotonic_time();
+
+    for (guint nmap = 2; nmap + MAP_VMAX < g->levels; nmap++)
+    {
+        player_map_enter(g->p, game_map_generate(g, nmap), FALSE);
+        game_levels_page(g);
+
+        guint resident = 0, layouts = 0;
+
+        for (guint idx = 0; idx < g->levels; idx++)
+        {
+            resident += map_generated(g->maps[idx]) && !g->maps[idx]->paged;
+            layouts += (g->level_jobs[idx] != NULL);
+        }
+
+        resident_max = MAX(resident_max, resident);
+        layouts_max = MAX(layouts_max, layouts);
+    }
+
+    const gint64 descent = (g_get_monotonic_time() - start) / (DEEP_DEPTH - 1);
+    map *bottom = game_map(g, Z(g->p->pos));
+    const gboolean amulet = bench_amulet_found(bottom);
+
+    cJSON *res = cJSON_CreateObject();
+    cJSON_AddNumberToObject(res, "levels", g->levels);
+    cJSON_AddStringToObject(res, "bottom", map_name(bottom));
+    cJSON_AddNumberToObject(res, "resident", resident_max);
+    cJSON_AddNumberToObject(res, "laid_out", layouts_max);
+    cJSON_AddNumberToObject(res, "descent", descent);
+
+    *ok = (g->level_store == NULL || resident_max <= RESIDENT)
+        && layouts_max <= DEEP_LAYOUTS && amulet
+        && bottom->nlevel == DEEP_DEPTH;
+    cJSON_AddBoolToObject(res, "ok", *ok);
+
+    fixture_end(g, prev);
+
+    return res;
+}
+
+/* a game played to compare its outcome */
+typedef struct check_game
+{
+    guint32 seed;
+    guint planners;
+    game *g;
+    gchar *hash;
+    guint64 fovs;   /* fields of vision calculated */
+} check_game;
+
+/* start a game with the player waiting on the first level */
+static void check_game_start(check_game *cg)
+{
+    struct game_config cfg = config;
+
+    cfg.seed = cg->seed;
+    cg->g = fixture_start(cfg, 1, NULL);
+    cg->g->planners = cg->planners;
+}
+
+static void check_game_end(check_game *cg)
+{
+    game_use(cg->g);
+    cg->hash = game_state_hash(cg->g);
+    cg->fovs = cg->g->counts.sum[CNT_FOV_CALC];
+    fixture_end(cg->g, NULL);
+    cg->g = NULL;
+}
+
+static gpointer check_game_play(gpointer data)
+{
+    check_game *cg = (check_game *)data;
+
+    check_game_start(cg);
+
+    for (guint turn = 0; turn < CHECK_TURNS; turn++)
+        game_spin_the_wheel(cg->g);
+
+    check_game_end(cg);
+
+    return NULL;
+}
+
+/* Play games one after the other, side by side taking turns in one thread
+   and in threads of their own: the outcome of a game must not depend on
+   other games played in the same process. Nor must it depend on the
+   threads planning the monsters' moves. Each game counts its own work. */
+static cJSON *bench_games(guint samples __attribute__((unused)), gboolean *same)
+{
+    check_game alone[CHECK_GAMES], turns[CHECK_GAMES], threads[CHECK_GAMES];
+    check_game planned[CHECK_GAMES];
+    GThread *thread[CHECK_GAMES];
+    game *prev = game_use(NULL);
+
+    for (guint idx = 0; idx < CHECK_GAMES; idx++)
+    {
+        alone[idx].seed = turns[idx].seed = threads[idx].seed
+            = planned[idx].seed = BENCH_SEED + idx + 1;
+        alone[idx].planners = turns[idx].planners = threads[idx].planners = 1;
+        planned[idx].planners = PLANNERS;
+
+        check_game_play(&alone[idx]);
+        check_game_play(&planned[idx]);
+    }
+
+    for (guint idx = 0; idx < CHECK_GAMES; idx++)
+        check_game_start(&turns[idx]);
+
+    for (guint turn = 0; turn < CHECK_TURNS; turn++)
+    {
+        for (guint idx = 0; idx < CHECK_GAMES; idx++)
+        {
+            game_use(turns[idx].g);
+            game_spin_the_wheel(turns[idx].g);
+        }
+    }
+
+    for (guint idx = 0; idx < CHECK_GAMES; idx++)
+        check_game_end(&turns[idx]);
+
+    for (guint idx = 0; idx < CHECK_GAMES; idx++)
+        thread[idx] = g_thread_new("game", check_game_play, &threads[idx]);
+
+    for (guint idx = 0; idx < CHECK_GAMES; idx++)
+        g_thread_join(thread[idx]);
+
+    game_use(prev);
+
+    gboolean same_turns = TRUE, same_threads = TRUE, same_planned = TRUE;
+    gboolean same_counts = TRUE;
+    for (guint idx = 0; idx < CHECK_GAMES; idx++)
+    {
+        same_turns &= (g_strcmp0(alone[idx].hash, turns[idx].hash) == 0);
+        same_threads &= (g_strcmp0(alone[idx].hash, threads[idx].hash) == 0);
+        same_planned &= (g_strcmp0(alone[idx].hash, planned[idx].hash) == 0);
+        same_counts &= alone[idx].fovs > 0 && alone[idx].fovs == turns[idx].fovs
+            && alone[idx].fovs == threads[idx].fovs
+            && alone[idx].fovs == planned[idx].fovs;
+        g_free(alone[idx].hash);
+        g_free(turns[idx].hash);
+        g_free(threads[idx].hash);
+        g_free(planned[idx].hash);
+    }
+
+    cJSON *res = cJSON_CreateObject();
+    cJSON_AddNumberToObject(res, "games", CHECK_GAMES);
+    cJSON_AddNumberToObject(res, "turns", CHECK_TURNS);
+    cJSON_AddBoolToObject(res, "side_by_side", same_turns);
+    cJSON_AddBoolToObject(res, "threads", same_threads);
+    cJSON_AddBoolToObject(res, "planned", same_planned);
+    cJSON_AddBoolToObject(res, "counts", same_counts);
+
+    *same = same_turns && same_threads && same_planned && same_counts;
+
+    return res;
+}
+
+/* the player walks to and fro */
+static int burst_key(guint idx)
+{
+    static const char keys[] = "llllljjjhhhhhkkk";
+
+    return keys[idx % (sizeof(keys) - 1)];
+}
+
+static direction burst_dir(int key)
+{
+    switch (key)
+    {
+    case 'h': return GD_WEST;
+    case 'j': return GD_SOUTH;
+    case 'k': return GD_NORTH;
+    default:  return GD_EAST;
+    }
+}
+
+/* Type a burst of keys ahead and handle them as the main loop does,
+   painting the screen for every key or only when all have been handled.
+   Returns the time until the game waits for a key again. */
+static gint64 burst_play(gboolean coalesce, FILE *out, long *bytes,
+                         gchar **hash)
+{
+    game *prev;
+    game *g = fixture_start(config, 1, &prev);
+
+    display_paint_screen(g->p);
+    fflush(out);
+    const long before = ftell(out);
+
+    /* the key put back last is read first */
+    for (guint idx = BURST_KEYS; idx > 0; idx--)
+        ungetch(burst_key(idx - 1));
+
+    const gint64 start = g_get_monotonic_time();
+
+    for (guint idx = 0; idx < BURST_KEYS; idx++)
+    {
+        if (coalesce)
+            display_repaint(g->p);
+        else
+            display_paint_screen(g->p);
+
+        const int moves = player_move(g->p, burst_dir(display_getch(NULL)), TRUE);
+
+        if (moves)
+            player_make_move(g->p, moves, FALSE, NULL);
+
+        player_update_fov(g->p);
+    }
+
+    /* no key is left: the screen is painted in either case */
+    display_repaint(g->p);
+
+    const gint64 elapsed = g_get_monotonic_time() - start;
+
+    fflush(out);
+    *bytes = ftell(out) - before;
+    *hash = game_state_hash(g);
+
+    fixture_end(g, prev);
+
+    return elapsed;
+}
+
+/* Handle a burst of keys typed ahead painting the screen for every key
+   and once at the end; the outcome must be the same. Reports the time
+   until the game waits for a key again and the bytes sent to the
+   terminal. */
+static cJSON *bench_typeahead(guint samples, gboolean *same)
+{
+    const char *names[] = { "every_key", "coalesced" };
+    double times[2][samples];
+    long bytes[2] = { 0 };
+    gchar *hashes[2] = { NULL };
+    FILE *out = tmpfile();
+
+    display_init_file(out);
+    *same = TRUE;
+
+    for (guint sample = 0; sample < samples; sample++)
+    {
+        for (guint mode = 0; mode < 2; mode++)
+        {
+            g_free(hashes[mode]);
+            times[mode][sample] = burst_play(mode, out, &bytes[mode], &hashes[mode]);
+        }
+
+        *same &= (g_strcmp0(hashes[0], hashes[1]) == 0);
+    }
+
+    display_shutdown();
+    fclose(out);
+
+    cJSON *res = cJSON_CreateObject();
+    cJSON_AddNumberToObject(res, "keys", BURST_KEYS);
+
+    for (guint mode = 0; mode < 2; mode++)
+    {
+        cJSON *m = cJSON_CreateObject();
+
+        qsort(times[mode], samples, sizeof(double), compare_doubles);
+        cJSON_AddNumberToObject(m, "median", times[mode][samples / 2]);
+        cJSON_AddNumberToObject(m, "bytes", bytes[mode]);
+        cJSON_AddItemToObject(res, names[mode], m);
+        g_free(hashes[mode]);
+    }
+
+    cJSON_AddBoolToObject(res, "same", *same);
+
+    return res;
+}
+
+/* the outcome of travelling on a level known to the player */
+typedef struct travel_run
+{
+    guint steps;
+    guint searches;
+    gint64 time;
+} travel_run;
+
+/* monsters next to the player would end the travels */
+static void travel_monsters_clear(game *g, map *m)
+{
+    GList *monsters = g_hash_table_get_values(g->monsters);
+
+    for (GList *iter = monsters; iter != NULL; iter = iter->next)
+    {
+        monster *mon = iter->data;
+
+        if (Z(monster_pos(mon)) == m->nlevel)
+        {
+            map_set_monster_at(m, monster_pos(mon), NULL);
+            monster_destroy(mon);
+        }
+    }
+
+    g_list_free(monsters);
+}
+
+/* Give travel commands to places all over the first level, finding a new
+   path for every step or following the path found before. The player
+   travels as in the main loop. */
+static void travel_play(gboolean cached, travel_run *tr)
+{
+    game *prev;
+    game *g = fixture_start(config, 1, &prev);
+    player *p = g->p;
+    map *m = game_map(g, Z(p->pos));
+    position pos = pos_invalid, dest[TRAVELS];
+
+    /* the player knows the level */
+    Z(pos) = Z(p->pos);
+    for (Y(pos) = 0; Y(pos) < m->height; Y(pos)++)
+        for (X(pos) = 0; X(pos) < m->width; X(pos)++)
+            player_memory_of(p, pos).type = map_tiletype_at(m, pos);
+
+    for (guint cmd = 0; cmd < TRAVELS; cmd++)
+        dest[cmd] = map_find_space(m, LE_GROUND, FALSE);
+
+    memset(tr, 0, sizeof(travel_run));
+    const gint64 start = g_get_monotonic_time();
+
+    for (guint cmd = 0; cmd < TRAVELS; cmd++)
+    {
+        path *route = NULL;
+
+        travel_monsters_clear(g, m);
+        player_update_fov(p);
+
+        while (!player_adjacent_monster(p, FALSE) && Z(p->pos) == Z(dest[cmd])
+                && !pos_adjacent(p->pos, dest[cmd]))
+        {
+            const guint64 searches = counters[CNT_TRAVEL_PATHS];
+            const int moves = player_travel_step(p, dest[cmd], &route);
+
+            tr->searches += counters[CNT_TRAVEL_PATHS] - searches;
+
+            if (!cached && route != NULL)
+            {
+                path_destroy(route);
+                route = NULL;
+            }
+
+            if (moves == 0)
+                break;
+
+            player_make_move(p, moves, FALSE, NULL);
+            p->attacked = FALSE;
+            player_update_fov(p);
+            tr->steps++;
+        }
+
+        if (route != NULL)
+            path_destroy(route);
+    }
+
+    tr->time = g_get_monotonic_time() - start;
+
+    fixture_end(g, prev);
+}
+
+/* Travel with and without keeping the path between the steps. Reports
+   the path searches per travel command and the time per step. */
+static cJSON *bench_travel(guint samples, gboolean *ok __attribute__((unused)))
+{
+    const char *names[] = { "every_step", "cached" };
+    cJSON *res = cJSON_CreateObject();
+
+    cJSON_AddNumberToObject(res, "commands", TRAVELS);
+
+    for (guint mode = 0; mode < 2; mode++)
+    {
+        double times[samples];
+        travel_run tr;
+
+        for (guint sample = 0; sample < samples; sample++)
+        {
+            travel_play(mode, &tr);
+            times[sample] = (double)tr.time / max(tr.steps, 1);
+        }
+
+        qsort(times, samples, sizeof(double), compare_doubles);
+
+        cJSON *m = cJSON_CreateObject();
+        cJSON_AddNumberToObject(m, "steps", tr.steps);
+        cJSON_AddNumberToObject(m, "searches_per_command",
+                                (double)tr.searches / TRAVELS);
+        cJSON_AddNumberToObject(m, "step_median", times[samples / 2]);
+        cJSON_AddItemToObject(res, names[mode], m);
+    }
+
+    return res;
+}
+
+/* The wounded player rests on a level cleared of monsters, turn by turn
+   or skipping ahead as the main loop does, until the time is up or a
+   monster turns up. Returns the time per turn rested. */
+static double rest_play(gboolean skip, gchar **hash)
+{
+    game *prev;
+    game *g = fixture_start(config, BENCH_LEVEL, &prev);
+    player *p = g->p;
+    map *m = game_map(g, Z(p->pos));
+
+    travel_monsters_clear(g, m);
+    player_update_fov(p);
+
+    p->hp = max(1, player_get_hp_max(p) / 2);
+    p->mp = 0;
+
+    const guint32 start = game_turn(g), end = start + REST_TURNS;
+    const gint64 started = g_get_monotonic_time();
+
+    while (game_turn(g) < end && !p->attacked
+            && !player_adjacent_monster(p, FALSE))
+    {
+        if (skip)
+            player_rest(p, end);
+        else
+            player_make_move(p, 1, FALSE, NULL);
+
+        player_update_fov(p);
+    }
+
+    const double elapsed = (double)(g_get_monotonic_time() - started)
+        / max(game_turn(g) - start, 1);
+
+    *hash = game_state_hash(g);
+
+    fixture_end(g, prev);
+
+    return elapsed;
+}
+
+/* Rest turn by turn and skipping ahead; the outcome must be the same.
+   Reports the time per turn rested. */
+static cJSON *bench_rest(guint samples, gboolean *same)
+{
+    const char *names[] = { "turn_by_turn", "skipping" };
+    double times[2][samples];
+    gchar *hashes[2] = { NULL };
+
+    *same = TRUE;
+
+    for (guint sample = 0; sample < samples; sample++)
+    {
+        for (guint mode = 0; mode < 2; mode++)
+        {
+            g_free(hashes[mode]);
+            times[mode][sample] = rest_play(mode, &hashes[mode]);
+        }
+
+        *same &= (g_strcmp0(hashes[0], hashes[1]) == 0);
+    }
+
+    cJSON *res = cJSON_CreateObject();
+    cJSON_AddNumberToObject(res, "turns", REST_TURNS);
+
+    for (guint mode = 0; mode < 2; mode++)
+    {
+        qsort(times[mode], samples, sizeof(double), compare_doubles);
+        cJSON_AddNumberToObject(res, names[mode], times[mode][samples / 2]);
+        g_free(hashes[mode]);
+    }
+
+    cJSON_AddBoolToObject(res, "same", *same);
+
+    return res;
+}
+
+/* Register timers due around the boundaries of the levels of the timer
+   wheel, from a turn at the start of a slot and from one in between, and
+   check that each of them fires at its due turn. */
+static cJSON *bench_timewheel(guint samples __attribute__((unused)), gboolean *in_time)
+{
+    const guint32 starts[] = { 0, 4000 };
+    const guint32 boundaries[] = { 1, 64, 4096, 262144, 16777216 };
+    guint timers = 0, mismatches = 0;
+
+    for (guint s = 0; s < G_N_ELEMENTS(starts); s++)
+    {
+        timewheel *tw = timewheel_new(starts[s]);
+        GArray *fired = g_array_new(FALSE, FALSE, sizeof(wheel_timer));
+        guint32 last = starts[s];
+
+        for (guint b = 0; b < G_N_ELEMENTS(boundaries); b++)
+        {
+            for (gint offset = -2; offset <= 2; offset++)
+            {
+                const guint32 delta = boundaries[b] + offset;
+
+                if ((gint32)delta < 1)
+                    continue;
+
+                timewheel_add(tw, starts[s] + delta, 0, NULL);
+                last = max(last, starts[s] + delta);
+                timers++;
+            }
+        }
+
+        for (guint32 turn = starts[s] + 1; turn <= last; turn++)
+        {
+            g_array_set_size(fired, 0);
+            timewheel_advance(tw, fired);
+
+            for (guint idx = 0; idx < fired->len; idx++)
+            {
+                if (g_array_index(fired, wheel_timer, idx).due != turn)
+                    mismatches++;
+            }
+
+            timers -= fired->len;
+        }
+
+        g_array_free(fired, TRUE);
+        timewheel_destroy(tw);
+    }
+
+    /* timers not fired at all count as well */
+    mismatches += timers;
+    *in_time = (mismatches == 0);
+
+    cJSON *res = cJSON_CreateObject();
+    cJSON_AddNumberToObject(res, "mismatches", mismatches);
+    cJSON_AddBoolToObject(res, "in_time", *in_time);
+
+    return res;
+}
+
+static void bench_setup()
+{
+    config.name = "Bench";
+    config.seed = BENCH_SEED;
+    config.wizard = TRUE;
+    config.no_autosave = TRUE;
+
+    game_init(&config);
+
+    for (guint nmap = 1; nmap < MAP_MAX; nmap++)
+        game_map_generate(nlarn, nmap);
+
+    bench_monsters_spread();
+
+    bench_pairs(BENCH_LEVEL, pairs_near, 2, 8);
+    bench_pairs(BENCH_LEVEL, pairs_mid, 10, 25);
+    bench_pairs(BENCH_LEVEL, pairs_far, 30, MAP_MAX_X);
+
+    bench_fov = fov_new();
+    level_json = map_serialize(game_map(nlarn, BENCH_LEVEL));
+
+    /* items of all kinds for item_describe */
+    const item_t types[] = { IT_AMULET, IT_ARMOUR, IT_BOOK, IT_GEM,
+                             IT_POTION, IT_RING, IT_SCROLL, IT_WEAPON };
+
+    stack = inv_new(NULL);
+    waters = g_ptr_array_new();
+
+    for (guint idx = 0; idx < BENCH_INPUTS; idx++)
+    {
+        items[idx] = item_new_random(types[idx % G_N_ELEMENTS(types)], FALSE);
+        inv_add(&stack, item_new_random(types[idx % G_N_ELEMENTS(types)], FALSE));
+    }
+
+    inv_add(&stack, item_new(IT_POTION, PO_WATER));
+}
+
+/* fill the crowded level up to a third of its free space */
+static void bench_crowd()
+{
+    map *m = game_map(nlarn, BENCH_CROWDED);
+
+    for (guint added = 0; added < 120; added++)
+    {
+        position pos = map_find_space(m, LE_MONSTER, FALSE);
+
+        if (pos_valid(pos))
+            monster_new_by_level(pos);
+    }
+
+    bench_pairs(BENCH_CROWDED, pairs_crowded, 10, 25);
+}
+
+/* The hot kernels on the levels of the shared game: for each kernel the
+   median and the 95th percentile of the time per call. */
+static cJSON *bench_kernels(guint samples, gboolean *ok __attribute__((unused)))
+{
+    const bench benches[] =
+    {
+        { "monster_turns_200", prepare_serial, run_turn, 0 },
+        { "monster_turns_200_planned", prepare_planned, run_turn, 0 },
+        { "path_find_near", NULL, run_path_near, 0 },
+        { "path_find_mid", NULL, run_path_mid, 0 },
+        { "path_find_far", NULL, run_path_far, 0 },
+        { "fov_calculate_6", NULL, run_fov_6, 0 },
+        { "fov_calculate_15", NULL, run_fov_15, 0 },
+        { "map_pos_is_visible", NULL, run_pos_is_visible, 0 },
+        { "map_ray", NULL, run_ray, 0 },
+        { "area_new_circle_flooded", NULL, run_circle_flooded, 0 },
+        { "area_blast_hits", NULL, run_blast_hits, 0 },
+        { "map_validate", NULL, run_validate, 0 },
+        { "map_serialize", NULL, run_serialize, 0 },
+        { "map_deserialize", NULL, run_deserialize, 0 },
+        { "inv_add_stack", prepare_inv_add, run_inv_add, 0 },
+        { "item_describe", NULL, run_describe, 0 },
+        { "item_describe_uncached", NULL, run_describe_uncached, 0 },
+        { "path_find_crowded", NULL, run_path_crowded, 0 },
+        { "game_save", NULL, run_save, 1 },
+        { "game_save_all_levels", prepare_save_all, run_save, 1 },
+        { "game_idle_step", prepare_idle, run_idle, 1 },
+        { "game_load", prepare_load, run_load, 1 },
+    };
+
+    cJSON *results = cJSON_CreateArray();
+
+    for (guint idx = 0; idx < G_N_ELEMENTS(benches); idx++)
+    {
+        if (benches[idx].run == run_path_crowded)
+            bench_crowd();
+
+        cJSON_AddItemToArray(results, bench_measure(&benches[idx], samples));
+    }
+
+    return results;
+}
+
+int main(int argc, char *argv[])
+{
+    const guint samples = (argc > 1) ? (guint)atoi(argv[1]) : 31;
+
+    if (samples < 1)
+    {
+        g_printerr("Usage: %s [samples]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    /* the game's library is expected next to the directory of the program */
+    gchar *basedir = g_path_get_dirname(argv[0]);
+    nlarn_libdir = g_build_filename(basedir, "..", "lib", NULL);
+    nlarn_mazefile = g_build_filename(nlarn_libdir, "maze", NULL);
+    nlarn_fortunes = g_build_filename(nlarn_libdir, "fortune", NULL);
+    g_free(basedir);
+
+    char *problems = maze_library_load(nlarn_mazefile);
+    if (problems != NULL)
+    {
+        g_printerr("Cannot read the maze file \"%s\":\n%s", nlarn_mazefile, problems);
+        return EXIT_FAILURE;
+    }
+
+    if ((tmpdir = g_dir_make_tmp("nlarn-bench-XXXXXX", NULL)) == NULL)
+    {
+        g_printerr("Cannot create a temporary directory.\n");
+        return EXIT_FAILURE;
+    }
+
+    nlarn_savefile = g_strdup_printf("%s/nlarn-%u.sav", tmpdir, saves);
+
+    /* the player must not die during the benchmark */
+    if (setjmp(nlarn_death_jump))
+    {
+        g_printerr("The player has died.\n");
+        return EXIT_FAILURE;
+    }
+
+    bench_setup();
+
+    /* the reports in the order they are made; the saved game compressed
+       by the codecs is the one saved by the kernels */
+    const struct
+    {
+        const char *name;
+        cJSON *(*make)(guint samples, gboolean *ok);
+        const char *failure;    /* explanation of a failed check */
+    } reports[] =
+    {
+        { "results", bench_kernels, NULL },
+        { "codecs", bench_codecs, NULL },
+        { "map_sizes", bench_sizes, NULL },
+        { "games", bench_games, "Games played side by side or with threads "
+            "planning the monsters' moves have a different outcome." },
+        { "paging", bench_paging, "Levels paged out and read back differ "
+            "from before." },
+        { "deep", bench_deep, "The levels of a deep dungeon kept in memory "
+            "grow with its depth, or the amulet is not at its bottom." },
+        { "typeahead", bench_typeahead, "Painting the screen for keys typed "
+            "ahead changes the outcome." },
+        { "travel", bench_travel, NULL },
+        { "rest", bench_rest, "Resting skipping ahead has a different "
+            "outcome than resting turn by turn." },
+        { "timewheel", bench_timewheel, "Timers of the timer wheel do not "
+            "fire at their due turn." },
+    };
+
+    cJSON *report = cJSON_CreateObject();
+    const char *failure = NULL;
+
+    cJSON_AddStringToObject(report, "version", nlarn_version);
+    cJSON_AddNumberToObject(report, "seed", BENCH_SEED);
+    cJSON_AddStringToObject(report, "unit", "us");
+
+    for (guint idx = 0; idx < G_N_ELEMENTS(reports); idx++)
+    {
+        gboolean ok = TRUE;
+
+        cJSON_AddItemToObject(report, reports[idx].name,
+                              reports[idx].make(samples, &ok));
+
+        if (!ok && failure == NULL)
+            failure = reports[idx].failure;
+    }
+
+    char *out = cJSON_Print(report);
+    g_print("%s\n", out);
+    free(out);
+    cJSON_Delete(report);
+
+    /* tidy up */
+    cJSON_Delete(level_json);
+    fov_free(bench_fov);
+    g_ptr_array_free(waters, TRUE);
+    nlarn = game_destroy(nlarn);
+    maze_library_destroy();
+
+    for (guint idx = 0; idx <= saves; idx++)
+    {
+        gchar *name = g_strdup_printf("%s/nlarn-%u.sav", tmpdir, idx);
+        g_unlink(name);
+        g_free(name);
+    }
+
+    g_rmdir(tmpdir);
+
+    if (failure != NULL)
+    {
+        g_printerr("%s\n", failure);
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,70 @@
+/*
+ * codec.h
+ * Copyright (C) 2009-2020 Joachim de Groot <jdegroot@web.de>
+ *
+ * NLarn is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * NLarn is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __CODEC_H_
+#define __CODEC_H_
+
+#include <glib.h>
+
+/* Compression of saved games. Compressed data is a series of members,
+   each of them identified by the magic number of its format, which are
+   decompressed as one. Thus files written with different codecs can
+   always be read. */
+
+typedef enum codec_type
+{
+    CODEC_GZIP,     /* gzip members, readable by zlib and gzip */
+    CODEC_LZ4,      /* LZ4 frames: much faster, somewhat larger */
+    CODEC_MAX
+} codec_t;
+
+/**
+ * @brief Choose the codec used for compressing data.
+ *
+ * @param "gzip" (at level 6), "gzip-1" to "gzip-9" or "lz4"
+ * @return FALSE if the codec is unknown; the codec is not changed
+ */
+gboolean codec_select(const char *name);
+
+/**
+ * @return the name of the codec chosen, as accepted by codec_select()
+ */
+const char *codec_name();
+
+/**
+ * @brief Compress data into a member of its own with the chosen codec.
+ *
+ * @param the data
+ * @param the length of the data
+ * @return the compressed member
+ */
+GBytes *codec_compress(gconstpointer data, gsize len);
+
+/**
+ * @brief Decompress a series of members. Data without a known magic
+ *        number is taken as it is, like zlib does.
+ *
+ * @param the compressed data
+ * @param the length of the compressed data
+ * @param a pointer to the variable receiving the length of the result
+ * @return the decompressed data, terminated with a NUL character to be
+ *         read as text, or NULL if the data is corrupt; free with g_free()
+ */
+gchar *codec_decompress(gconstpointer data, gsize len, gsize *result_len);
+
+#endif
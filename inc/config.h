@@ -23,7 +23,14 @@
 struct game_config {
     gint difficulty;
     gboolean wizard;
+    gint64 seed;
+    char *map_size;     /* WIDTHxHEIGHT as given on the command line */
+    gint map_width;     /* the dimensions of the levels, 0 for the classic */
+    gint map_height;
+    gint depth;         /* the deepest level of the caverns, 0 for the classic */
     gboolean no_autosave;
+    char *compression;
+    gint resident_levels; /* levels kept in memory, 0 for all */
     char *name;
     char *gender;
     char *auto_pickup;
@@ -32,6 +39,13 @@ struct game_config {
     int font_size;
 #endif
     char *userdir;
+    char *trace;
+    char *record;
+    char *replay;
+#ifdef __unix
+    char *zygote;
+    char *connect;
+#endif
     gboolean show_scores;
     gboolean show_version;
 };
@@ -0,0 +1,131 @@
+/*
+ * counters.h
+ * Copyright (C) 2009-2020 Joachim de Groot <jdegroot@web.de>
+ *
+ * NLarn is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * NLarn is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __COUNTERS_H_
+#define __COUNTERS_H_
+
+#include <glib.h>
+
+#include "utils.h"
+
+/* things counted on the hot paths of the game; times are in microseconds */
+typedef enum counter_type
+{
+    CNT_PATH_FIND,      /* calls of path_find() */
+    CNT_PATH_NODES,     /* nodes expanded by path_find() */
+    CNT_FOV_CALC,       /* calls of fov_calculate() */
+    CNT_FOV_CELLS,      /* cells lit by fov_calculate() */
+    CNT_POS_VISIBLE,    /* calls of map_pos_is_visible() */
+    CNT_EFFECT_QUERY,   /* calls of effect_query() */
+    CNT_ITEM_GET,       /* lookups by game_item_get() */
+    CNT_MONSTER_GET,    /* lookups by game_monster_get() */
+    CNT_PAINT_TIME,     /* time spent in display_paint_screen() */
+    CNT_SAVE_BYTES,     /* uncompressed size of saved games */
+    CNT_SAVE_TIME,
+    CNT_LOAD_BYTES,     /* uncompressed size of loaded games */
+    CNT_LOAD_TIME,
+    CNT_PAGE_IN,        /* levels read back from the level store */
+    CNT_PAGE_OUT,       /* levels moved to the level store */
+    CNT_PAGE_TIME,
+    CNT_TRAVEL,         /* travel commands given */
+    CNT_TRAVEL_PATHS,   /* paths found for travelling */
+    CNT_MAX
+} counter_t;
+
+/* bucket 0 counts turns with no events, bucket n turns with
+   2^(n-1) to 2^n - 1 events; the last bucket takes everything above */
+#define COUNTER_BUCKETS 24
+
+/* the counts of a game, see counters_use() */
+typedef struct counter_set
+{
+    gint pending[CNT_MAX];      /* counted by other threads this turn */
+    guint64 last[CNT_MAX];      /* counts of the last turn finished */
+
+    /* distribution of the per-turn counts since the last dump */
+    guint32 turns;
+    guint64 sum[CNT_MAX];
+    guint64 max[CNT_MAX];
+    guint32 buckets[CNT_MAX][COUNTER_BUCKETS];
+} counter_set;
+
+/* the counts of the running turn made by the current thread; they are
+   added to the selected set when the turn ends or another set is selected,
+   hence counting needs neither locks nor atomic operations */
+#ifdef _MSC_VER
+extern __declspec(thread) guint64 counters[CNT_MAX];
+#else
+extern __thread guint64 counters[CNT_MAX];
+#endif
+
+/* Building with NO_COUNTERS defined removes counting entirely. */
+#ifndef NO_COUNTERS
+# define counter_add(C, N) (counters[(C)] += (N))
+# define counter_clock_start(V) const gint64 V = g_get_monotonic_time()
+# define counter_clock_stop(C, V) counter_add((C), g_get_monotonic_time() - (V))
+#else
+# define counter_add(C, N)
+# define counter_clock_start(V)
+# define counter_clock_stop(C, V)
+#endif
+
+#define counter_inc(C) counter_add((C), 1)
+
+/**
+ * @brief Select the set the counts of the current thread are added to,
+ *        usually that of the game played in it. The counts made so far
+ *        are added to the set selected before.
+ *
+ * @param the set to count in, NULL to drop the counts
+ * @return the previously selected set
+ */
+counter_set *counters_use(counter_set *set);
+
+/**
+ * @brief Finish counting for the running turn of the selected set. The
+ *        counts of all threads are added to the histograms and kept for
+ *        counters_last().
+ */
+void counters_turn_end();
+
+/**
+ * @brief Get the count of the last turn of the selected set that has been
+ *        finished.
+ *
+ * @param the counter
+ * @return the count
+ */
+guint64 counters_last(counter_t c);
+
+/**
+ * @brief Get a short description of a counter.
+ *
+ * @param the counter
+ * @return a static string
+ */
+const char *counter_desc(counter_t c);
+
+/**
+ * @brief Describe the distribution of the per-turn counts since the last
+ *        call in the message log and start over.
+ *
+ * @param the message log
+ */
+void counters_dump(message_log *log);
+
+#endif
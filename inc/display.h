@@ -128,6 +128,15 @@ typedef struct display_window
 /* function declarations */
 
 void display_init();
+
+/**
+ * @brief Initialise the display to draw to a file instead of the terminal
+ *        and to read no keys, like the display of a replay.
+ *
+ * @param the file receiving the output
+ */
+void display_init_file(FILE *out);
+
 void display_shutdown();
 
 /**
@@ -143,6 +152,23 @@ void display_draw();
 
 void display_paint_screen(player *p);
 
+/**
+ * @brief Paint the screen, unless keys have been typed ahead: then the
+ *        screen is painted once they have all been handled, before
+ *        display_getch() waits for the next key.
+ *
+ * @param the player
+ */
+void display_repaint(player *p);
+
+/**
+ * @brief Move the cursor to a position on the level shown.
+ *
+ * @param a position on the level the player is on
+ * @return FALSE if the position is out of view; the cursor is not moved
+ */
+gboolean display_map_move(position pos);
+
 /**
  * Generic inventory display function
  *
@@ -236,11 +262,19 @@ void display_windows_show();
 
 
 /**
- * @brief Wrap curses wgetch() with added functionality
+ * @brief Wrap curses wgetch() with added functionality. Keys are written
+ *        to the journals, or taken from them when recovering or replaying.
  * @param A pointer to a window structure. May be NULL.
           In this case stdscr is used.
  */
 int display_getch(WINDOW *win);
 
+/**
+ * @brief Pause to let the player follow an animation. Replays and
+ *        recoveries do not pause.
+ * @param The duration in milliseconds
+ */
+void display_sleep(int ms);
+
 
 #endif
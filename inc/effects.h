@@ -135,6 +135,8 @@ typedef struct effect
     guint32 turns;      /* number of turns this effect remains */
     gint32 amount;      /* power of effect, if applicable */
     gpointer item;      /* oid of item which causes the effect (if caused by item) */
+    guint32 expires;    /* game turn the effect ends at, 0 if not scheduled */
+    gpointer owner;     /* oid of the affected monster, NULL for the player */
 } effect;
 
 struct game;
@@ -171,11 +173,49 @@ effect *effect_get(GPtrArray *ea, effect_t type);
 int effect_query(GPtrArray *ea, effect_t type);
 
 /**
- * Count down the number of turns remaining for an effect.
+ * Count down the number of turns remaining for an effect. Only used for
+ * effects which are not scheduled with the game's timers, i.e. time stop
+ * and being trapped, which count the affected one's turns.
  *
  * @param an effect
  * @return turns remaining. Expired effects return -1, permantent effects 0
  */
 int effect_expire(effect *e);
 
+/**
+ * Schedule the end of a temporary effect which has been added to a player
+ * or a monster with the game's timers. Does nothing for permanent effects,
+ * effects which are already scheduled and those counting turns by
+ * themselves, see effect_expire().
+ *
+ * @param an effect
+ * @param the oid of the affected monster, NULL for the player
+ */
+void effect_schedule(effect *e, gpointer owner);
+
+/**
+ * Register the timers of a scheduled effect again, as the timers of effects
+ * restored with a level that has been paged out have become void. Effects
+ * which should have ended already end in the next turn.
+ *
+ * @param an effect
+ * @param the number of turns the end of the effect is moved by
+ */
+void effect_timers_restore(effect *e, gint32 turns);
+
+/**
+ * @param an effect
+ * @return the number of turns the effect remains, 0 for permanent effects
+ */
+guint effect_turns(effect *e);
+
+/**
+ * Change the number of turns an effect remains. Scheduled effects are
+ * rescheduled.
+ *
+ * @param an effect
+ * @param the new number of turns, 0 for a permanent effect
+ */
+void effect_turns_set(effect *e, guint turns);
+
 #endif
@@ -56,6 +56,14 @@ void fov_calculate(fov *fv, map *m, position pos, int radius, gboolean infravisi
   */
 gboolean fov_get(fov *fv, position pos);
 
+/** @brief get the part of the map containing every visible position.
+  *
+  * @param pointer to a fov structure.
+  *
+  * @return a rectangle which is empty (x1 > x2) if nothing is visible
+  */
+rectangle fov_get_bounds(fov *fv);
+
 /** @brief set visibility for a certain position.
   *
   * @param pointer to a fov structure.
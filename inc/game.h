@@ -19,27 +19,60 @@
 #ifndef __GAME_H_
 #define __GAME_H_
 
+#include "counters.h"
 #include "inventory.h"
 #include "items.h"
+#include "levelstore.h"
 #include "map.h"
 #include "player.h"
+#include "random.h"
+#include "scheduler.h"
 #include "spheres.h"
+#include "timewheel.h"
 
 #define TIMELIMIT 30000 /* maximum number of moves before the game is called */
 
 /* internal counter for save file compatibility */
-#define SAVEFILE_VERSION    26
+#define SAVEFILE_VERSION    31
+
+/* things happening at a given turn, see game_spin_the_wheel() */
+typedef enum game_timer_type
+{
+    GT_EFFECT_END,      /* a temporary effect ends */
+    GT_EFFECT_WARNING,  /* a critical effect of the player is about to end */
+    GT_SPAWN,           /* monsters are spawned on a map */
+    GT_BANK_INTEREST,   /* the bank pays interest */
+} game_timer_t;
+
+/* The save file is a series of compressed members, each holding a chunk
+   of the JSON text, which are decompressed as one, see codec.h. Every
+   level is stored in two chunks, the map and the player's memory of it. */
+typedef enum save_chunk_type
+{
+    SAVE_MAP,
+    SAVE_MEMORY,
+    SAVE_CHUNKS
+} save_chunk_t;
+
+/* a level laid out by a worker thread, see game_map_generate() */
+struct level_job;
 
 /* the world as we know it */
 typedef struct game
 {
     player *p;                  /* the player */
-    map *maps[MAP_MAX];         /* the dungeon */
+    map **maps;                 /* the dungeon */
+    guint16 levels;             /* the number of levels, see map_volcano() */
     guint8 version;             /* save compatibility value */
     guint64 time_start;         /* start time */
+    guint32 seed;               /* seed levels are generated from */
+    rand_state rng;             /* the random number streams */
     guint32 gtime;              /* turn count */
     guint8 difficulty;          /* game difficulty */
+    guint16 map_width;          /* dimensions of the levels */
+    guint16 map_height;
     message_log *log;           /* game message log */
+    counter_set counts;         /* counts of frequently used functions */
 
     /* stock of the dnd store */
     inventory *store_stock;
@@ -68,6 +101,10 @@ typedef struct game
     guint effect_max_id;
     guint monster_max_id;
 
+    /* the number of registered effects of each type: the effects of the
+       types no one has are not looked for */
+    guint effect_types[ET_MAX];
+
     /* every object of the types item, effect and monster will be registered
        in these hashed when created and unregistered when destroyed. */
 
@@ -75,6 +112,12 @@ typedef struct game
     GHashTable *effects;
     GHashTable *monsters;
 
+    /* cached item descriptions, keyed by item id (see item_describe).
+       The version is increased whenever something changes that affects
+       the description of items, rendering all cached entries stale. */
+    GHashTable *item_descs;
+    guint32 item_desc_version;
+
     /* Monsters that died during a turn have to be added to this array
        to allow destroying them after all monsters have been moved.
        The functions used to iterate over the GHashTable *monsters above
@@ -86,13 +129,50 @@ typedef struct game
     /* spheres do not need to be referenced, thus a pointer array is sufficient */
     GPtrArray *spheres;
 
+    /* effects ending and periodic events, keyed by game turn */
+    timewheel *timers;
+
+    /* monsters that have something to do, keyed by the turn they move next */
+    scheduler *actors;
+
+    /* the mazes used for the levels of the game */
+    gboolean maze_used[MAP_MAZE_NUM];
+
+    /* levels laid out by worker threads while the game is running */
+    GThreadPool *level_pool;
+    struct level_job **level_jobs;
+
+    /* threads finding the paths of the monsters due in a turn before they
+       move, see monster_plan_step(); their number does not change the
+       outcome of the game. There are no more planners than processors,
+       and nothing is planned on a single processor. */
+    guint planners;
+    GThreadPool *plan_pool;
+    GMutex plan_mutex;
+    GCond plan_done;
+    guint plans_pending;
+
+    /* the compressed chunks of the levels, written again to the save
+       file as long as the level has not been modified */
+    GBytes **save_chunks[SAVE_CHUNKS];
+
+    /* levels away from the player are paged out to a file when more than
+       this number of levels are in memory, see game_levels_page(); all
+       levels are kept in memory if 0 */
+    guint resident_levels;
+    level_store *level_store;
+    gint32 *level_warp;         /* time warps missed by paged levels */
+
     /* flags */
     guint32
         player_stats_set: 1, /* the player's stats have been assigned */
         cure_dianthr_created: 1, /* the potion of cure dianthroritis is a unique item */
         wizard: 1, /* wizard mode */
         fullvis: 1, /* show entire map in wizard mode */
-        autosave: 1; /* save the game when entering a new map */
+        profiler: 1, /* show the counters of the last turn in wizard mode */
+        autosave: 1, /* save the game regularly, journal the keys between */
+        journaled: 1; /* the game started by game_init(), which the key
+                         journal and the write-ahead log belong to */
 } game;
 
 
@@ -105,12 +185,44 @@ struct game_config;
 
 /**
  * @brief Initialise the game. This function will try to restore a saved game;
- *        if it fails it will start a new game.
+ *        if it fails it will start a new game. The game is selected for the
+ *        current thread, see game_use().
  *
  * @param pointer to a parsed command line configuration
  */
 void game_init(struct game_config *config);
 
+/**
+ * @brief Start a new game without reading the saved game or the journal,
+ *        e.g. to run several games in one process. The game is selected
+ *        for the current thread, see game_use().
+ *
+ * @param pointer to the settings of the game; a seed of 0 chooses a new one
+ * @return the new game
+ */
+game *game_create(struct game_config *config);
+
+/**
+ * @brief Select the game played in the current thread. Everything in the
+ *        game, e.g. the player, the maps and the random numbers, refers to
+ *        the game selected, the global variable nlarn. Several games can be
+ *        played in one process by selecting them in turn or in different
+ *        threads.
+ *
+ *        The engine's functions do not take the game as a parameter;
+ *        the state they share is selected along with the game instead:
+ *        the random number streams, the dimensions of the levels and the
+ *        counters of the game. The trace of a thread's spans is kept per
+ *        thread. Shared by all games are only the front end, e.g. the
+ *        display and the last spell cast, the codec selected for saved
+ *        games and the data read once at start-up, i.e. the mazes and the
+ *        fortunes.
+ *
+ * @param the game, or NULL
+ * @return the previously selected game, to be restored afterwards
+ */
+game *game_use(game *g);
+
 game *game_destroy(game *g);
 
 /**
@@ -121,8 +233,97 @@ game *game_destroy(game *g);
  */
 int game_save(game *g);
 
+/**
+ * @brief Calculate a hash of everything that would be saved, to compare
+ *        the outcome of two runs of a game.
+ * @param The game
+ * @return the SHA-256 of the game's state as hex string; free with g_free()
+ */
+gchar *game_state_hash(game *g);
+
+/**
+ * @brief Get a level of the dungeon. Levels the player has not entered yet
+ *        may be placeholders, see map_generated(). Levels which have been
+ *        paged out are read back.
+ */
 map *game_map(game *g, guint nmap);
+
+/**
+ * @brief Page out the levels the player has left the longest ago until no
+ *        more levels than chosen are in memory, and read ahead the levels
+ *        likely to be needed soon. Levels around the player, levels with
+ *        spheres and levels with tiles changing over time stay in memory.
+ *        Called after each turn.
+ *
+ * @param the game
+ */
+void game_levels_page(game *g);
+
+/**
+ * @brief Do a piece of the work which can be done ahead while the game waits
+ *        for the player to press a key: the descriptions of the player's
+ *        items and, if the game is saved automatically, the chunks of the
+ *        levels of the classic size that have changed since the last save.
+ *        Each piece takes a millisecond or two at most.
+ *
+ * @param the game
+ * @param the number of pieces done since the last key has been pressed
+ * @return FALSE if there is nothing left to do
+ */
+gboolean game_idle(game *g, guint step);
+
+/**
+ * @brief Ensure a level has been generated. Each level is generated from
+ *        its own seed derived from the game's seed, thus the result does
+ *        not depend on the time the level is generated. The levels next
+ *        to it are laid out ahead by worker threads, those further away
+ *        are dropped again.
+ *
+ * @param the game
+ * @param the level number
+ * @return the generated level
+ */
+map *game_map_generate(game *g, guint nmap);
 void game_spin_the_wheel(game *g);
+
+/**
+ * @brief Count up the game time by a turn and handle what is due then:
+ *        effects end and monsters spawn. The monsters do not move.
+ *
+ * @param the game
+ */
+void game_timers_advance(game *g);
+
+/**
+ * @brief Let turns pass in one step as long as nothing would happen in
+ *        them: no monster is due, no timer fires, no tile changes and
+ *        the player's tile is harmless. The player's movement points and
+ *        regeneration are left to the caller.
+ *
+ * @param the game
+ * @param the maximum number of turns to pass
+ * @return the number of turns that have passed
+ */
+guint32 game_fast_forward(game *g, guint32 turns);
+
+/**
+ * @brief Move the game time forward or backward. Timers of effects on
+ *        monsters are moved along, those of the player's effects keep
+ *        their turn.
+ *
+ * @param the game
+ * @param the number of turns to move, negative to go back in time
+ */
+void game_time_warp(game *g, gint32 turns);
+
+/**
+ * @brief Queue the monsters on the maps around the player after the player
+ *        has entered another map. Monsters on maps far from the player
+ *        do not move and are dropped from the scheduler when they are due.
+ *
+ * @param the game
+ */
+void game_actors_wake(game *g);
 void game_remove_dead_monsters(game *g);
 
 /* functions to store game data */
@@ -149,6 +350,7 @@ void game_delete_savefile();
 #define game_difficulty(g) ((g)->difficulty)
 #define game_wizardmode(g) ((g)->wizard)
 #define game_fullvis(g)    ((g)->fullvis)
+#define game_profiler(g)   ((g)->profiler)
 #define game_autosave(g)   ((g)->autosave)
 
 #define game_turn(g)            ((g)->gtime)
@@ -47,6 +47,16 @@ void inv_destroy(inventory *inv, gboolean special);
 cJSON *inv_serialize(inventory *inv);
 inventory *inv_deserialize(cJSON *iser);
 
+/**
+ * @brief Serialize the items of an inventory, the content of containers
+ *        included, and the effects of the items.
+ *
+ * @param the inventory, may be NULL
+ * @param the array the effects are added to
+ * @param the array the items are added to
+ */
+void inv_objects_serialize(inventory *inv, cJSON *effects, cJSON *items);
+
 void inv_callbacks_set(inventory *inv, inv_callback_bool pre_add,
                        inv_callback_void post_add, inv_callback_bool pre_del,
                        inv_callback_void post_del);
@@ -149,6 +159,20 @@ guint inv_length(inventory *inv);
  */
 void inv_sort(inventory *inv, GCompareDataFunc compare_func, gpointer user_data);
 
+/**
+ * Function to sort the items in an inventory by precomputed keys.
+ * The key function is called once per item, the keys are compared
+ * with strcmp().
+ *
+ * @param the inventory to be sorted
+ * @param the function used to build the sort key of an item
+ * @param additional data for the key function
+ *
+ */
+void inv_sort_by_key(inventory *inv,
+                     gchar *(*key_func)(item *it, gpointer data),
+                     gpointer user_data);
+
 /**
  * Function to determine the weight of all items in an inventory.
  *
@@ -87,6 +87,7 @@ typedef enum item_erosion_t {
 
 struct game;
 struct _inventory;
+struct player;
 
 typedef struct _item {
     gpointer oid;           /* item's game object id */
@@ -146,7 +147,16 @@ item *item_deserialize(cJSON *iser, struct game *g);
  */
 int item_compare(item *a, item *b);
 
-int item_sort(gconstpointer a, gconstpointer b, gpointer data, gboolean force_id);
+/**
+ * Build the collation key used to sort items in inventory listings.
+ * Items are sorted by type first and by their case-insensitive name second.
+ *
+ * @param the item
+ * @param the player whose knowledge determines the item name
+ * @param TRUE if the item shall be treated as identified
+ * @return a newly allocated string that should be disposed with g_free().
+ */
+gchar *item_sort_key(item *it, struct player *p, gboolean force_id);
 
 /**
  * Describe an item.
@@ -160,6 +170,17 @@ int item_sort(gconstpointer a, gconstpointer b, gpointer data, gboolean force_id
  */
 gchar *item_describe(item *it, gboolean known, gboolean singular, gboolean definite);
 
+/**
+ * Mark all cached item descriptions as stale. Has to be called whenever
+ * the player's knowledge about items changes.
+ */
+void item_desc_invalidate();
+
+/**
+ * Drop the cached item descriptions which have become stale.
+ */
+void item_desc_compact();
+
 item_material_t item_material(item *it);
 guint item_base_price(item *it);
 guint item_price(item *it);
@@ -0,0 +1,146 @@
+/*
+ * journal.h
+ * Copyright (C) 2009-2020 Joachim de Groot <jdegroot@web.de>
+ *
+ * NLarn is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * NLarn is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __JOURNAL_H_
+#define __JOURNAL_H_
+
+#include <glib.h>
+
+#include "game.h"
+
+struct game_config;
+
+/* A journal holds the settings, the seeds and every key pressed during a
+   session. As everything random in the game is derived from the seed,
+   replaying the keys reproduces the session exactly. */
+
+/**
+ * @brief Start recording a journal. Must be called before the display
+ *        has been initialised.
+ *
+ * @param the name of the journal file
+ * @param the game settings, stored in the journal
+ * @return FALSE if the file could not be opened
+ */
+gboolean journal_record(const char *filename, struct game_config *config);
+
+/**
+ * @brief Start replaying a journal. The settings are replaced by those
+ *        stored in the journal. Files written by the game are kept in a
+ *        temporary directory while replaying.
+ *
+ * @param the name of the journal file
+ * @param the game settings to be replaced
+ * @return FALSE if the file could not be read or is not a journal
+ */
+gboolean journal_replay(const char *filename, struct game_config *config);
+
+/**
+ * @brief Finish recording or replaying. A recording stores the hash of the
+ *        final state, a replay reports whether its final state matches.
+ *        Called automatically when the game terminates.
+ *
+ * @return FALSE if the final state of a replay differs from the recording
+ */
+gboolean journal_close();
+
+/* TRUE while a journal is recorded or replayed */
+gboolean journal_active();
+
+/* TRUE while a journal is replayed */
+gboolean journal_replaying();
+
+/**
+ * @brief The directory used for the game's files while replaying.
+ *
+ * @return the directory or NULL if no journal is replayed
+ */
+const char *journal_replay_dir();
+
+/**
+ * @brief Record the seed of a new game, or replace it by the recorded one.
+ *
+ * @param the seed chosen for the game
+ * @return the seed to be used
+ */
+guint32 journal_seed(guint32 seed);
+
+/**
+ * @brief Record a key pressed by the player in the journal and the
+ *        write-ahead journal.
+ *
+ * @param the key as returned by curses
+ */
+void journal_key_add(int key);
+
+/**
+ * @brief Get the next key to be recovered or replayed. When all keys of a
+ *        replay have been used, the replay is finished and the game
+ *        terminates.
+ *
+ * @param a pointer to the variable receiving the key
+ * @return FALSE if the key has to be read from the keyboard
+ */
+gboolean journal_key_next(int *key);
+
+/* TRUE if journal_key_next() has a key to return */
+gboolean journal_key_pending();
+
+/**
+ * @brief Remember the state of a game that is about to end.
+ *
+ * @param the game
+ */
+void journal_game_end(game *g);
+
+/* The write-ahead journal holds the keys pressed since the game has last
+   been saved. After a crash, the keys are replayed on the saved game. */
+
+/* number of keys after which the game is saved again */
+#define JOURNAL_SNAPSHOT_KEYS 1000
+
+/**
+ * @brief Start writing the write-ahead journal next to the saved game.
+ *        Keys left from an interrupted run of the same saved game are
+ *        recovered first.
+ */
+void journal_wal_open();
+
+/**
+ * @brief Start over after the game has been saved or loaded.
+ *
+ * @param the hash of the saved game
+ */
+void journal_wal_snapshot(const char *hash);
+
+/**
+ * @brief Stop writing the write-ahead journal.
+ *
+ * @param TRUE to delete the file as well
+ */
+void journal_wal_close(gboolean remove);
+
+/**
+ * @return the number of keys pressed since the game has last been saved
+ */
+guint journal_wal_length();
+
+/* TRUE while the keys of an interrupted game are recovered */
+gboolean journal_recovering();
+
+#endif
@@ -0,0 +1,96 @@
+/*
+ * levelstore.h
+ * Copyright (C) 2009-2020 Joachim de Groot <jdegroot@web.de>
+ *
+ * NLarn is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * NLarn is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __LEVELSTORE_H_
+#define __LEVELSTORE_H_
+
+#include <glib.h>
+
+/* Pages kept in a temporary file to bound the memory used by the game.
+   A page consists of several parts compressed with codec_compress(), see
+   codec.h. Pages can be read ahead by a worker thread, which decompresses
+   them as well, thus taking a page that has been read ahead is cheap. */
+typedef struct level_store level_store;
+
+/**
+ * @brief Create a store backed by a new temporary file, which is removed
+ *        when the store is destroyed.
+ *
+ * @param the number of pages, numbered from 0
+ * @return a new store or NULL if no temporary file could be created
+ */
+level_store *level_store_new(guint npages);
+
+void level_store_destroy(level_store *ls);
+
+/**
+ * @brief Write a page to the file. Space of pages taken before is reused.
+ *
+ * @param the store
+ * @param the number of the page, which must not be stored already
+ * @param the compressed parts of the page
+ * @param the number of parts
+ * @return FALSE if the page could not be written; it is not stored then
+ */
+gboolean level_store_put(level_store *ls, guint page, GBytes **parts,
+                         guint nparts);
+
+/**
+ * @param the store
+ * @param the number of the page
+ * @return TRUE if the page is stored
+ */
+gboolean level_store_contains(level_store *ls, guint page);
+
+/**
+ * @brief Let the worker thread read and decompress a page which is likely
+ *        to be taken soon. Pages not stored or read already are ignored.
+ *
+ * @param the store
+ * @param the number of the page
+ */
+void level_store_prefetch(level_store *ls, guint page);
+
+/**
+ * @brief Get the compressed parts of a page, which stays in the store.
+ *
+ * @param the store
+ * @param the number of a stored page
+ * @return an array of GBytes, or NULL if the file could not be read;
+ *         free with g_ptr_array_free()
+ */
+GPtrArray *level_store_read(level_store *ls, guint page);
+
+/**
+ * @brief Take a page out of the store, waiting for the worker thread if it
+ *        is reading the page.
+ *
+ * @param the store
+ * @param the number of a stored page
+ * @return the decompressed parts of the page, or NULL if the file could not
+ *         be read; free with g_strfreev()
+ */
+gchar **level_store_take(level_store *ls, guint page);
+
+/**
+ * @param the store
+ * @return the number of bytes of the file holding pages
+ */
+guint64 level_store_used(level_store *ls);
+
+#endif
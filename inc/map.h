@@ -27,16 +27,25 @@
 #include "traps.h"
 #include "utils.h"
 
-/* map dimensions */
+/* map dimensions of the classic game, which are those of the mazes in
+   the maze file and of the part of the map shown on the screen */
 #define MAP_MAX_X 67
 #define MAP_MAX_Y 17
 #define MAP_SIZE MAP_MAX_X*MAP_MAX_Y
 
-/* number of levels */
+/* the largest map dimensions which can be chosen */
+#define MAP_LIMIT_X 512
+#define MAP_LIMIT_Y 256
+
+/* number of levels of the classic game; a deeper dungeon has more levels
+   in the caverns, see map_volcano() */
 #define MAP_CMAX 11                   /* max # levels in the caverns */
 #define MAP_VMAX  3                   /* max # of levels in the temple of the luran */
 #define MAP_MAX (MAP_CMAX + MAP_VMAX) /* total number of levels */
 
+/* the deepest level of the caverns which can be chosen */
+#define MAP_DEPTH_LIMIT 250
+
 /* number of the last custom maze map (including town) */
 #define MAP_MAX_MAZE_NUM 24
 #define MAP_MAZE_NUM     (MAP_MAX_MAZE_NUM + 1)
@@ -99,9 +108,28 @@ typedef struct map
     guint32 nlevel;                       /* map number */
     guint32 visited;                      /* last time player has been on this map */
     guint32 mcount;                       /* monster count */
-    map_tile grid[MAP_MAX_Y][MAP_MAX_X];  /* the map */
+    gboolean generated;                   /* FALSE for placeholders of levels
+                                             that have not been entered yet */
+    gint maze;                            /* maze from the maze file the level
+                                             is based on, -1 if it is dug */
+    GArray *spawns;                       /* monsters and items waiting to be
+                                             created by map_populate() */
+    gboolean modified;                    /* changed since the game has been
+                                             saved, see game_save() */
+    GArray *changes;                      /* positions changed while watched,
+                                             see map_changes_watch() */
+    gboolean paged;                       /* the content has been moved to the
+                                             level store, see game_map() */
+    gboolean timed;                       /* tiles with a running timer may
+                                             exist, see map_timer() */
+    guint16 width;                        /* map dimensions */
+    guint16 height;
+    map_tile *grid;                       /* the map, row by row */
 } map;
 
+/* the tile at the given coordinates, without any checks */
+#define map_grid(m, x, y) ((m)->grid[(y) * (m)->width + (x)])
+
 /* callback function for trajectories */
 typedef gboolean (*trajectory_hit_sth)(const GList *trajectory,
         const damage_originator *damo,
@@ -109,9 +137,130 @@ typedef gboolean (*trajectory_hit_sth)(const GList *trajectory,
 
 /* function declarations */
 
-map *map_new(int num, const char *mazefile);
+/**
+ * @brief Create a level of the game with the dimensions of the game's levels
+ *        and populate it.
+ *
+ * @param the level number
+ * @return the new map, which has been stored in the game
+ */
+map *map_new(int num);
+
+/**
+ * @brief The first level of the volcano of the game played by the calling
+ *        thread, which is MAP_CMAX in the classic dungeon. The levels above
+ *        are the town and the caverns, see pos_bounds_use().
+ */
+int map_volcano();
+
+/**
+ * @brief The level of the classic dungeon whose monsters and items are
+ *        found on a level. The caverns of a deeper dungeon are spread over
+ *        those of the classic one.
+ *
+ * @param the level number
+ * @return the level number in the classic dungeon
+ */
+int map_level_classic(int nlevel);
+
+/**
+ * @brief The name of a level, e.g. "D4" or "V1".
+ *
+ * @param the level number
+ * @param the number of levels of the game
+ * @return a string which must not be freed
+ */
+const char *map_level_name(int nlevel, int levels);
+
+/**
+ * @brief Choose the maze a level will be based on. Each maze from the
+ *        maze library is used only once per game, thus levels have to be
+ *        planned in order, starting with the town.
+ *
+ * @param the level number
+ * @return the number of the maze in the maze file, -1 for a dug level
+ */
+gint map_maze_choose(int num);
+
+/**
+ * @brief Choose another maze for a level when the maze chosen before
+ *        cannot be laid out. Like map_maze_choose(), this has to be
+ *        called on the game's main thread.
+ *
+ * @param the level number
+ * @param the maze map_layout_new() failed with
+ * @return the number of a maze not used yet, -1 for a dug level
+ */
+gint map_maze_replace(int num, gint failed);
+
+/**
+ * @brief Lay out a level: tiles, stationary objects and traps. Monsters
+ *        and items are only recorded. This touches nothing but the new
+ *        map, the thread's random context and the thread's bounds, see
+ *        pos_bounds_use(), and can hence run on any thread.
+ *
+ * @param the level number
+ * @param the maze returned by map_maze_choose()
+ * @param the width of the level
+ * @param the height of the level
+ * @return a map which has to be passed to map_populate(), or NULL if
+ *         the maze keeps failing, see map_maze_replace()
+ */
+map *map_layout_new(int num, gint maze, int width, int height);
+
+/**
+ * @brief Create the recorded monsters and items of a level which has been
+ *        laid out and add random objects and monsters to it.
+ *
+ * @param a map returned by map_layout_new()
+ */
+void map_populate(map *m);
+
+/**
+ * @brief Check if every passable tile of a level can be reached from
+ *        its entrance.
+ *
+ * @param a map
+ * @return TRUE if the level is connected
+ */
+int map_validate(map *m);
+
+/**
+ * @brief Create an empty stand-in for a level that has not been generated.
+ *
+ * @param the level number
+ * @param the maze returned by map_maze_choose()
+ * @param the width of the level
+ * @param the height of the level
+ * @return a map without tiles, monsters or items
+ */
+map *map_placeholder_new(int num, gint maze, int width, int height);
 void map_destroy(map *m);
 
+/**
+ * @brief Serialize the monsters on a level and the items and effects
+ *        found there, which are kept with the other objects of the game.
+ * @param a generated map
+ * @return an object holding the arrays "items", "effects" and "monsters"
+ */
+cJSON *map_objects_serialize(map *m);
+
+/**
+ * @brief Destroy the tiles, items and monsters of a level which has been
+ *        stored elsewhere, keeping the map itself. Unlike map_destroy(),
+ *        unique items on the level are not marked as never created.
+ * @param a generated map
+ */
+void map_unload(map *m);
+
+/**
+ * @brief Restore the tiles of a level unloaded before. The items on the
+ *        level have to be restored first, the monsters afterwards.
+ * @param a map emptied with map_unload()
+ * @param the level as returned by map_serialize()
+ */
+void map_reload(map *m, cJSON *mser);
+
 cJSON *map_serialize(map *m);
 map *map_deserialize(cJSON *mser);
 char *map_dump(map *m, position ppos);
@@ -190,6 +339,15 @@ area *map_get_obstacles(map *m, position center, int radius, gboolean doors);
 
 void map_set_tiletype(map *m, area *area, map_tile_t type, guint8 duration);
 
+/**
+ * @brief Check if a tile may cause damage to those standing on it.
+ *
+ * @param a map
+ * @param a position on the map
+ * @return TRUE if map_tile_damage() might return damage for the position
+ */
+gboolean map_tile_harmful(map *m, position pos);
+
 damage *map_tile_damage(map *m, position pos, gboolean flying);
 
 /**
@@ -232,83 +390,135 @@ void map_timer(map *m);
  */
 char map_get_door_glyph(map *m, position pos);
 
+/**
+ * @brief Start noting the positions at which the tile types, stationary
+ *        objects or monsters are changed.
+ *
+ * @param The map.
+ */
+void map_changes_watch(map *m);
+
+/**
+ * @brief Stop noting changes and forget the changes noted.
+ *
+ * @param The map.
+ */
+void map_changes_forget(map *m);
+
+/**
+ * @brief Check if a change has been noted in an area.
+ *
+ * @param The map.
+ * @param An area covering the map.
+ *
+ * @return TRUE if a position in the area has been changed since the map
+ *         is being watched.
+ */
+gboolean map_changes_touch(map *m, area *a);
+
 /* external vars */
 
 extern const map_tile_data map_tiles[LT_MAX];
-extern const char *map_names[MAP_MAX];
 
 /* inline accessor functions */
 
+/* The accessors returning a pointer to a tile or its items, except
+   map_tile_get(), and all setters mark the map as modified, as the tile
+   may be changed. Changes to what path finding depends on are noted while
+   the map is watched. */
+
+static inline void map_pos_changed(map *m, position pos)
+{
+    m->modified = TRUE;
+
+    if (m->changes != NULL)
+        g_array_append_val(m->changes, pos);
+}
+
 static inline map_tile *map_tile_at(map *m, position pos)
 {
     g_assert(m != NULL && pos_valid(pos));
-    return &m->grid[Y(pos)][X(pos)];
+    map_pos_changed(m, pos);
+    return &map_grid(m, X(pos), Y(pos));
+}
+
+/* the tile for reading only, the map is not marked as modified */
+static inline const map_tile *map_tile_get(map *m, position pos)
+{
+    g_assert(m != NULL && pos_valid(pos));
+    return &map_grid(m, X(pos), Y(pos));
 }
 
 static inline inventory **map_ilist_at(map *m, position pos)
 {
     g_assert(m != NULL && pos_valid(pos));
-    return &m->grid[Y(pos)][X(pos)].ilist;
+    m->modified = TRUE;
+    return &map_grid(m, X(pos), Y(pos)).ilist;
 }
 
 static inline map_tile_t map_tiletype_at(map *m, position pos)
 {
     g_assert(m != NULL && pos_valid(pos));
-    return m->grid[Y(pos)][X(pos)].type;
+    return map_grid(m, X(pos), Y(pos)).type;
 }
 
 static inline void map_tiletype_set(map *m, position pos, map_tile_t type)
 {
     g_assert(m != NULL && pos_valid(pos));
-    m->grid[Y(pos)][X(pos)].type = type;
+    map_pos_changed(m, pos);
+    map_grid(m, X(pos), Y(pos)).type = type;
 }
 
 static inline map_tile_t map_basetype_at(map *m, position pos)
 {
     g_assert(m != NULL && pos_valid(pos));
-    return m->grid[Y(pos)][X(pos)].base_type;
+    return map_grid(m, X(pos), Y(pos)).base_type;
 }
 
 static inline void map_basetype_set(map *m, position pos, map_tile_t type)
 {
     g_assert(m != NULL && pos_valid(pos));
-    m->grid[Y(pos)][X(pos)].base_type = type;
+    m->modified = TRUE;
+    map_grid(m, X(pos), Y(pos)).base_type = type;
 }
 
 static inline guint8 map_timer_at(map *m, position pos)
 {
     g_assert(m != NULL && pos_valid(pos));
-    return m->grid[Y(pos)][X(pos)].timer;
+    return map_grid(m, X(pos), Y(pos)).timer;
 }
 
 static inline trap_t map_trap_at(map *m, position pos)
 {
     g_assert(m != NULL && pos_valid(pos));
-    return m->grid[Y(pos)][X(pos)].trap;
+    return map_grid(m, X(pos), Y(pos)).trap;
 }
 
 static inline void map_trap_set(map *m, position pos, trap_t type)
 {
     g_assert(m != NULL && pos_valid(pos));
-    m->grid[Y(pos)][X(pos)].trap = type;
+    m->modified = TRUE;
+    map_grid(m, X(pos), Y(pos)).trap = type;
 }
 
 static inline sobject_t map_sobject_at(map *m, position pos)
 {
     g_assert(m != NULL && pos_valid(pos));
-    return m->grid[Y(pos)][X(pos)].sobject;
+    return map_grid(m, X(pos), Y(pos)).sobject;
 }
 
 static inline void map_sobject_set(map *m, position pos, sobject_t type)
 {
     g_assert(m != NULL && pos_valid(pos));
-    m->grid[Y(pos)][X(pos)].sobject = type;
+    map_pos_changed(m, pos);
+    map_grid(m, X(pos), Y(pos)).sobject = type;
 }
 
 static inline void map_set_monster_at(map *m, position pos, monster *monst)
 {
     g_assert(m != NULL && m->nlevel == Z(pos) && pos_valid(pos));
-    m->grid[Y(pos)][X(pos)].m_oid = (monst != NULL) ? monster_oid(monst) : NULL;
+    map_pos_changed(m, pos);
+    map_grid(m, X(pos), Y(pos)).m_oid = (monst != NULL) ? monster_oid(monst) : NULL;
 }
 
 static inline gboolean map_is_monster_at(map *m, position pos)
@@ -342,21 +552,26 @@ static inline gboolean mt_is_transparent(map_tile_t t)
     return map_tiles[t].transparent;
 }
 
+static inline gboolean map_generated(map *m)
+{
+    return m->generated;
+}
+
 static inline const char *map_name(map *m)
 {
-    return map_names[m->nlevel];
+    return map_level_name(m->nlevel, pos_levels());
 }
 
 static inline gboolean map_pos_transparent(map *m, position pos)
 {
-    return mt_is_transparent(m->grid[Y(pos)][X(pos)].type)
-        && so_is_transparent(m->grid[Y(pos)][X(pos)].sobject);
+    return mt_is_transparent(map_grid(m, X(pos), Y(pos)).type)
+        && so_is_transparent(map_grid(m, X(pos), Y(pos)).sobject);
 }
 
 static inline gboolean map_pos_passable(map *m, position pos)
 {
-    return mt_is_passable(m->grid[Y(pos)][X(pos)].type)
-        && so_is_passable(m->grid[Y(pos)][X(pos)].sobject);
+    return mt_is_passable(map_grid(m, X(pos), Y(pos)).type)
+        && so_is_passable(map_grid(m, X(pos), Y(pos)).sobject);
 }
 
 #endif
@@ -0,0 +1,66 @@
+/*
+ * maze.h
+ * Copyright (C) 2009-2020 Joachim de Groot <jdegroot@web.de>
+ *
+ * NLarn is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * NLarn is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __MAZE_H_
+#define __MAZE_H_
+
+#include <glib.h>
+
+#include "map.h"
+
+/* a random monster or item marked in a maze */
+typedef struct maze_object
+{
+    guint8 x;
+    guint8 y;
+    char what;      /* '!', 'm' or 'o', see lib/maze_doc.txt */
+} maze_object;
+
+/* a maze from the maze file, decoded when the game starts */
+typedef struct maze
+{
+    map_tile grid[MAP_MAX_Y][MAP_MAX_X]; /* tile types and stationary objects */
+    GArray *objects;                     /* maze_object, in reading order */
+    guint dead_ends;                     /* places fit for staircases */
+} maze;
+
+/**
+ * @brief Read and validate the maze file. All mazes up to MAP_MAX_MAZE_NUM
+ *        are decoded once; afterwards the library is only read, thus it
+ *        can be used by any thread.
+ *
+ * @param the name of the maze file
+ * @return NULL on success, otherwise a description of all problems found
+ *         which has to be freed by the caller
+ */
+char *maze_library_load(const char *filename);
+
+/**
+ * @brief Free the memory used by the maze library.
+ */
+void maze_library_destroy();
+
+/**
+ * @brief Get a maze from the library.
+ *
+ * @param the number of the maze, 0 being the town
+ * @return the maze or NULL if it is not available
+ */
+const maze *maze_get(guint num);
+
+#endif
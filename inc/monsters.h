@@ -172,6 +172,16 @@ void monster_destroy(monster *m);
 void monster_serialize(gpointer oid, monster *m, cJSON *root);
 void monster_deserialize(cJSON *mser, struct game *g);
 
+/**
+ * @brief Serialize the effects and the items of a monster, which are kept
+ *        with the other effects and items of the game.
+ *
+ * @param the monster
+ * @param the array the effects are added to
+ * @param the array the items are added to
+ */
+void monster_objects_serialize(monster *m, cJSON *effects, cJSON *items);
+
 /* getters / setters */
 
 int monster_hp_max(monster *m);
@@ -208,7 +218,55 @@ const char* monster_type_plural_name(monster_t mt, const int count);
 void monster_die(monster *m, struct player *p);
 
 void monster_level_enter(monster *m, struct map *l);
-void monster_move(gpointer *oid, monster *m, struct game *g);
+
+/**
+ * @brief Move a monster that is due according to the game's scheduler and
+ *        queue it again for its next move.
+ *
+ * @param the monster
+ * @param the game
+ */
+void monster_move(monster *m, struct game *g);
+
+/**
+ * @brief Find the monster's next step towards the place it is likely to
+ *        head for before the monster moves. This only reads the game, thus
+ *        the monsters due in a turn can be planned by several threads at
+ *        once. When the monster moves, the planned step is taken if the
+ *        path found would be the same, otherwise the path is found again.
+ *        The map of the monster has to be watched for changes, see
+ *        map_changes_watch().
+ *
+ * @param the monster
+ */
+void monster_plan_step(monster *m);
+
+/**
+ * @brief Forget the planned step if the monster has not needed it.
+ *
+ * @param the monster
+ */
+void monster_plan_drop(monster *m);
+
+/**
+ * @brief Determine the turn the monster needs to be moved next and queue it
+ *        in the game's scheduler. Monsters which have nothing to do, e.g.
+ *        as they are asleep or far from the player, are removed from the
+ *        scheduler. This has to be called whenever something happens to a
+ *        monster that might change this.
+ *
+ * @param the monster
+ */
+void monster_schedule(monster *m);
+
+/**
+ * @brief Shift the turn the monster has been moved at last after the game
+ *        time has been changed.
+ *
+ * @param the monster
+ * @param the number of turns the game time has been changed by
+ */
+void monster_time_warp(monster *m, gint32 turns);
 
 void monster_polymorph(monster *m);
 
@@ -298,4 +356,11 @@ int monster_type_reroll_chance(monster_t type);
 void monster_genocide(monster_t monster_id);
 int monster_is_genocided(monster_t monster_id);
 
+/**
+ * @brief Read the fortunes told by monsters unless they have been read.
+ *
+ * @param the name of the fortune file
+ */
+void monster_fortunes_load(const char *fortune_file);
+
 #endif
@@ -35,8 +35,12 @@
 /* game version string */
 extern const char *nlarn_version;
 
-/* the entire game */
-extern game *nlarn;
+/* the entire game: the game selected for the current thread, see game_use() */
+#ifdef _MSC_VER
+extern __declspec(thread) game *nlarn;
+#else
+extern __thread game *nlarn;
+#endif
 
 /* death jump buffer - used to return to the main loop when the player has died */
 extern jmp_buf nlarn_death_jump;
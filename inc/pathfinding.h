@@ -27,6 +27,9 @@ typedef struct path_element
     guint32 g_score;
     guint32 h_score;
     struct path_element* parent;
+    guint open_idx;     /* index in the open list */
+    guint heap_idx;     /* index in the heap ordering the open list */
+    gboolean closed;
 } path_element;
 
 typedef struct path
@@ -34,6 +37,8 @@ typedef struct path
     GQueue *path;
     GPtrArray *closed;
     GPtrArray *open;
+    GPtrArray *heap;    /* the open list, the best element first */
+    GHashTable *known;  /* the elements of both lists by position */
     position start;
     position goal;
 } path;
@@ -50,6 +55,37 @@ typedef struct path
 path *path_find(map *m, position start, position goal,
                 map_element_t element);
 
+/**
+ * @brief Find a path between two positions like path_find() and note the
+ *        positions of the map the result depends on. The path is the same
+ *        as long as none of these positions and the player's position
+ *        have changed.
+ *
+ * @param the map to work on
+ * @param the starting position
+ * @param the destination
+ * @param the map_element_t that can be travelled
+ * @param an area covering the map, receiving the positions examined
+ * @return a path or NULL if none could be found
+ */
+path *path_find_watched(map *m, position start, position goal,
+                        map_element_t element, area *seen);
+
+/**
+ * @brief Check if a path found before can still be followed from a
+ *        position next to the first position left in it. None of the
+ *        positions left may have become impassable or more costly, e.g.
+ *        by a trap found or a monster come into view.
+ *
+ * @param the map the path has been found on
+ * @param the path
+ * @param the position to follow the path from
+ * @param the map_element_t that can be travelled
+ * @return TRUE if the rest of the path is still good
+ */
+gboolean path_valid(map *m, path *pt, position start,
+                    map_element_t element);
+
 /**
  * @brief Free memory allocated for a given path.
  *
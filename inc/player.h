@@ -33,8 +33,9 @@
 #include "utils.h"
 #include "weapons.h"
 
-/* forward declaration */
+/* forward declarations */
 struct game;
+struct path;
 
 typedef struct _player_stats
 {
@@ -170,8 +171,12 @@ typedef struct player
     /* player's field of vision */
     fov *fv;
 
-    /* player's memory of the map */
-    player_tile_memory memory[MAP_MAX][MAP_MAX_Y][MAP_MAX_X];
+    /* player's memory of the map, allocated for a level when needed;
+       the levels have the dimensions and the number of the game's levels */
+    player_tile_memory **memory;
+    guint16 memory_width;
+    guint16 memory_height;
+    guint16 memory_levels;
 
     /* remembered positions of stationary objects */
     GArray *sobjmem;
@@ -231,6 +236,17 @@ void player_destroy(player *p);
 cJSON *player_serialize(player *p);
 player *player_deserialize(cJSON *pser);
 
+/**
+ * @brief Serialize the player's memory of a level. It is stored apart from
+ *        the player as it only changes while the player is on the level.
+ *
+ * @param the player
+ * @param the level number
+ * @return the memory of the level
+ */
+cJSON *player_level_memory_serialize(player *p, guint nlevel);
+void player_level_memory_deserialize(player *p, guint nlevel, cJSON *mser);
+
 /**
  * @brief consume time for an action by the player
  *
@@ -243,6 +259,16 @@ player *player_deserialize(cJSON *pser);
  */
 gboolean player_make_move(player *p, int turns, gboolean interruptible, const char *desc, ...);
 
+/**
+ * @brief Rest for one turn or, if nothing can happen to the player, for as
+ *        many turns as are certain to be uneventful.
+ *
+ * @param the player
+ * @param the game turn at which resting ends
+ * @return the number of game turns passed
+ */
+int player_rest(player *p, guint until);
+
 /**
  * Kill the player
  *
@@ -256,6 +282,17 @@ void player_die(player *p, player_cod cause_type, int cause);
 guint64 player_calc_score(player *p, int won);
 gboolean player_movement_possible(player *p);
 int player_move(player *p, direction dir, gboolean open_door);
+
+/**
+ * @brief Take a step towards a destination further away, following the
+ *        path found for an earlier step as long as it is valid.
+ *
+ * @param the player
+ * @param the destination
+ * @param the path kept between the steps, NULL to find a new one
+ * @return the number of turns the step took; 0 if no step was possible
+ */
+int player_travel_step(player *p, position dest, struct path **route);
 int player_attack(player *p, monster *m);
 void player_update_fov(player *p);
 
@@ -311,6 +348,7 @@ int player_mp_max_lose(player *p, int count);
 effect *player_effect_add(player *p, effect *e);
 void player_effects_add(player *p, GPtrArray *effects);
 int player_effect_del(player *p, effect *e);
+void player_effect_fading(player *p, effect *e); /* warn before critical effects end */
 void player_effects_del(player *p, GPtrArray *effects);
 effect *player_effect_get(player *p, effect_t et);
 int player_effect(player *p, effect_t et); /* check if a effect is set */
@@ -472,8 +510,34 @@ gboolean player_adjacent_monster(player *p, gboolean ignore_harmless);
 /* fighting simulation */
 void calc_fighting_stats(player *p);
 
+/**
+ * @brief Get the player's memory of a position.
+ *
+ * @param the player
+ * @param a position
+ * @return the memory of the position
+ */
+static inline player_tile_memory *player_memory_at(player *p, position pos)
+{
+    if (p->memory[Z(pos)] == NULL)
+    {
+        p->memory[Z(pos)] = g_new0(player_tile_memory,
+                                   p->memory_width * p->memory_height);
+    }
+
+    return &p->memory[Z(pos)][Y(pos) * p->memory_width + X(pos)];
+}
+
+/**
+ * @brief Forget a level entirely.
+ *
+ * @param the player
+ * @param the level number
+ */
+void player_level_memory_forget(player *p, guint nlevel);
+
 /* macros */
 
-#define player_memory_of(p,pos) ((p)->memory[Z(pos)][Y(pos)][X(pos)])
+#define player_memory_of(p,pos) (*player_memory_at((p), (pos)))
 
 #endif
@@ -76,6 +76,23 @@ typedef struct _area
 #define Z(pos) ((pos).bf.z)
 #define pos_val(pos) ((pos).val)
 
+/**
+ * @brief Set the dimensions of the levels and the number of levels for the
+ *        positions handled by the calling thread, which are MAP_MAX_X,
+ *        MAP_MAX_Y and MAP_MAX by default. pos_move(), pos_valid() and
+ *        rect_new() stay within them.
+ *
+ * @param the width of a level
+ * @param the height of a level
+ * @param the number of levels
+ */
+void pos_bounds_use(int width, int height, int levels);
+
+/**
+ * @brief The number of levels set for the calling thread by pos_bounds_use().
+ */
+int pos_levels();
+
 position pos_move(position pos, direction dir);
 int pos_distance(position first, position second);
 int pos_identical(position pos1, position pos2);
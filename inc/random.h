@@ -23,13 +23,114 @@
 
 #include "cJSON.h"
 
+/* state of a xoshiro128** generator */
+typedef struct rand_ctx
+{
+    guint32 s[4];
+} rand_ctx;
+
+/* the independent streams of a game; each one starts 2^64 values
+ * behind the previous one and hence they never overlap. */
+typedef enum rand_stream
+{
+    RS_MAIN,        /* everything not listed below */
+    RS_MONSTERS,    /* monster movement and actions */
+    RS_SPAWN,       /* periodic generation of new monsters */
+    RS_MAX
+} rand_stream_t;
+
+/* the streams of a game */
+typedef struct rand_state
+{
+    guint32 seed;               /* the seed all streams are derived from */
+    gboolean seeded;
+    rand_ctx streams[RS_MAX];
+} rand_state;
+
 /* function definitions */
 
-cJSON* rand_serialize();
-void rand_deserialize(cJSON *r);
+/**
+ * Generate a new, hopefully unpredictable seed. Never returns zero.
+ */
+guint32 rand_seed_new();
+
+/**
+ * Select the streams used in the current thread, usually those of the
+ * game played in it. The context used by rand_0n() is reset to the main
+ * stream of the selected streams.
+ *
+ * @param the streams to use, NULL for those shared by all threads
+ * @return the previously used streams, to be restored afterwards
+ */
+rand_state *rand_state_use(rand_state *state);
+
+/**
+ * Seed all streams selected in the current thread from a single value.
+ *
+ * @param the seed
+ */
+void rand_init(guint32 seed);
+
+/**
+ * @return the seed the streams selected in the current thread have been
+ *         derived from
+ */
+guint32 rand_seed();
+
+/**
+ * Get one of the streams selected in the current thread. The streams are
+ * seeded automatically if rand_init() has not been called before.
+ *
+ * @param the stream
+ * @return the stream's context
+ */
+rand_ctx *rand_stream(rand_stream_t st);
+
+/**
+ * Select the context used by rand_0n() and friends in the current thread.
+ *
+ * @param the context to use
+ * @return the previously used context, to be restored afterwards
+ */
+rand_ctx *rand_use(rand_ctx *ctx);
+
+/* Seed a context from a single value. */
+void rand_ctx_seed(rand_ctx *ctx, guint32 seed);
+
+/* Advance a context by 2^64 values. */
+void rand_ctx_jump(rand_ctx *ctx);
+
+/* Advance a context by 2^96 values. */
+void rand_ctx_long_jump(rand_ctx *ctx);
+
+/**
+ * Split a context: the child gets the current sequence and
+ * the parent moves on to the next non-overlapping one.
+ *
+ * @param the context to split
+ * @param the context which receives the split off sequence
+ */
+void rand_ctx_split(rand_ctx *ctx, rand_ctx *child);
+
+/**
+ * Initialise the context used to generate a dungeon level. Levels are
+ * separated by long jumps, thus each level has 2^32 non-overlapping
+ * subsequences available for rand_ctx_split().
+ *
+ * @param the context to initialise
+ * @param the game seed
+ * @param the level number
+ */
+void rand_ctx_level(rand_ctx *ctx, guint32 seed, guint nlevel);
+
+cJSON* rand_serialize(rand_state *state);
+void rand_deserialize(rand_state *state, cJSON *r);
+
+/* returns a value x with 0 <= x < n, drawn from the given context. */
+guint32 rand_ctx_0n(rand_ctx *ctx, guint32 n);
 
-/* The following function use a global state
- * which is automatically seeded on first usage. */
+/* The following functions use the context selected by rand_use(),
+ * the main stream by default. */
 
 guint32 rand_0n(guint32 n);
 
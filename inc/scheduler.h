@@ -0,0 +1,95 @@
+/*
+ * scheduler.h
+ * Copyright (C) 2009-2020 Joachim de Groot <jdegroot@web.de>
+ *
+ * NLarn is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * NLarn is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __SCHEDULER_H_
+#define __SCHEDULER_H_
+
+#include <glib.h>
+
+#include "cJSON.h"
+
+/* priority queue of actors keyed by the game turn they act next */
+typedef struct scheduler scheduler;
+
+scheduler *scheduler_new();
+void scheduler_destroy(scheduler *s);
+
+/**
+ * @brief Queue an actor. If the actor is queued already, its turn is
+ *        replaced. Actors due at the same turn are returned in the order
+ *        they have been queued.
+ *
+ * @param the scheduler
+ * @param the id of the actor
+ * @param the game turn the actor is due
+ */
+void scheduler_add(scheduler *s, gpointer id, guint32 due);
+
+/**
+ * @brief Remove an actor from the queue, e.g. as it has nothing to do
+ *        until something wakes it up.
+ *
+ * @param the scheduler
+ * @param the id of the actor; unknown ids are ignored
+ */
+void scheduler_remove(scheduler *s, gpointer id);
+
+/**
+ * @brief Take the next actor that is due.
+ *
+ * @param the scheduler
+ * @param the current game turn
+ * @return the id of an actor due at or before the given turn or NULL
+ */
+gpointer scheduler_pop(scheduler *s, guint32 now);
+
+/**
+ * @brief Get the actors that are due without taking them.
+ *
+ * @param the scheduler
+ * @param the current game turn
+ * @return the ids of the actors due at or before the given turn, in no
+ *         particular order; free with g_ptr_array_free()
+ */
+GPtrArray *scheduler_due(scheduler *s, guint32 now);
+
+/**
+ * @brief Count the turns in which no actor is due.
+ *
+ * @param the scheduler
+ * @param the current game turn
+ * @param the maximum number of turns to count
+ * @return the number of turns starting with the current turn in which
+ *         no actor is due, at most the given maximum
+ */
+guint32 scheduler_idle(scheduler *s, guint32 now, guint32 limit);
+
+/**
+ * @brief Get the number of queued actors.
+ *
+ * @param the scheduler
+ * @return the number of actors in the queue
+ */
+guint scheduler_length(scheduler *s);
+
+/* the actors are stored in the order they are due, thus actors due at the
+   same turn keep their order when the game is restored */
+cJSON *scheduler_serialize(scheduler *s);
+scheduler *scheduler_deserialize(cJSON *sser);
+
+#endif
@@ -39,15 +39,30 @@ typedef struct _score_t
     gint32 level_max;
     gint32 dlevel;
     gint32 dlevel_max;
+    gint32 levels;      /* the number of levels of the game's dungeon */
     gint32 difficulty;
     gint64 time_start;
     gint64 time_end;
+    guint32 rank;       /* place on the scoreboard, 0 if not among the best */
 } score_t;
 
+/**
+ * @brief Read the best scores of all difficulties from the scoreboard.
+ *
+ * @return a list of up to 100 scores, sorted by score
+ */
 GList *scores_load();
 
 score_t *score_new(game *g, player_cod cod, int cause);
 
+/**
+ * @brief Add a score to the scoreboard.
+ *
+ * @param the game
+ * @param the new score, owned by the returned list afterwards
+ * @return the best scores like scores_load(), followed by the new score
+ *         if it is not among them
+ */
 GList *score_add(game *g, score_t *score);
 
 char *score_death_description(score_t *score, int verbose);
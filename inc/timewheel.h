@@ -0,0 +1,97 @@
+/*
+ * timewheel.h
+ * Copyright (C) 2009-2020 Joachim de Groot <jdegroot@web.de>
+ *
+ * NLarn is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * NLarn is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __TIMEWHEEL_H_
+#define __TIMEWHEEL_H_
+
+#include <glib.h>
+
+#include "cJSON.h"
+
+/* a timer waiting in the wheel */
+typedef struct wheel_timer
+{
+    guint32 due;    /* game turn the timer fires at */
+    guint32 kind;   /* what is due, interpreted by the owner of the wheel */
+    gpointer id;    /* the object or number the timer refers to */
+} wheel_timer;
+
+/* hierarchical timer wheel keyed by game turn */
+typedef struct timewheel timewheel;
+
+/**
+ * @brief Create a new, empty timer wheel.
+ *
+ * @param the current game turn
+ * @return a new timer wheel
+ */
+timewheel *timewheel_new(guint32 now);
+
+void timewheel_destroy(timewheel *tw);
+
+/**
+ * @brief Register a timer. Timers can not be cancelled; the owner of the
+ *        wheel has to check if a timer is still valid when it fires.
+ *
+ * @param the timer wheel
+ * @param the game turn the timer is due; timers due already fire next turn
+ * @param the kind of the timer
+ * @param the object or number the timer refers to
+ */
+void timewheel_add(timewheel *tw, guint32 due, guint32 kind, gpointer id);
+
+/**
+ * @brief Advance the wheel by one turn.
+ *
+ * @param the timer wheel
+ * @param an array of wheel_timer the timers due in the new turn are appended to
+ */
+void timewheel_advance(timewheel *tw, GArray *fired);
+
+/**
+ * @brief Count the turns the wheel can be advanced without a timer firing.
+ *
+ * @param the timer wheel
+ * @param the maximum number of turns to count
+ * @return the number of turns, at most the given maximum
+ */
+guint32 timewheel_idle(timewheel *tw, guint32 limit);
+
+/**
+ * @brief Advance the wheel by a number of turns in which no timer is due,
+ *        see timewheel_idle().
+ *
+ * @param the timer wheel
+ * @param the number of turns
+ */
+void timewheel_skip(timewheel *tw, guint32 turns);
+
+/**
+ * @brief Remove all timers, e.g. to register them again after the game
+ *        time has been changed.
+ *
+ * @param the timer wheel
+ * @param the new current game turn
+ * @return an array of wheel_timer which has to be freed by the caller
+ */
+GArray *timewheel_drain(timewheel *tw, guint32 now);
+
+cJSON *timewheel_serialize(timewheel *tw);
+timewheel *timewheel_deserialize(cJSON *tser, guint32 now);
+
+#endif
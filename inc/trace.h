@@ -0,0 +1,66 @@
+/*
+ * trace.h
+ * Copyright (C) 2009-2020 Joachim de Groot <jdegroot@web.de>
+ *
+ * NLarn is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * NLarn is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __TRACE_H_
+#define __TRACE_H_
+
+#include <glib.h>
+
+/* Timelines of what happens during a turn, written in the Chrome trace
+   event format. Open the file in chrome://tracing or ui.perfetto.dev. */
+
+/* TRUE while a trace file is being written */
+extern gboolean trace_active;
+
+/**
+ * @brief Start writing a trace file. Events are collected in a ring
+ *        buffer and written by a background thread. The file is closed
+ *        when the game terminates.
+ *
+ * @param the name of the trace file
+ * @return FALSE if the file could not be opened
+ */
+gboolean trace_open(const char *filename);
+
+/**
+ * @brief Write the pending events and close the trace file.
+ */
+void trace_close();
+
+/**
+ * @brief Record a span that has ended now. Spans that do not fit into
+ *        the ring buffer are dropped and counted.
+ *
+ * @param the name of the span; must be a static string
+ * @param the time the span has begun at, as returned by trace_begin()
+ * @param a number describing the span, e.g. a level; ignored when negative
+ */
+void trace_span(const char *name, gint64 start, gint64 arg);
+
+/* the time a span begins at, or 0 if no trace is written */
+static inline gint64 trace_begin()
+{
+    return trace_active ? g_get_monotonic_time() : 0;
+}
+
+static inline void trace_end(const char *name, gint64 start, gint64 arg)
+{
+    if (start) trace_span(name, start, arg);
+}
+
+#endif
@@ -28,6 +28,7 @@ typedef struct _message_log_entry
 {
     guint32 gtime;      /* game time of log entry */
     char *message;
+    GPtrArray *wrapped; /* the lines shown in the message history */
 } message_log_entry;
 
 typedef struct _message_log
@@ -37,6 +38,8 @@ typedef struct _message_log
     GString *buffer;    /* space to assemble a turn's messages */
     char *lastmsg;      /* copy of last message */
     GPtrArray *entries;
+    int wrap_width;     /* the dimensions of the wrapped entries */
+    int wrap_twidth;
 } message_log;
 
 /* windef.h defines these */
@@ -66,18 +69,51 @@ int log_add_entry(message_log *log, const char *fmt, ...);
 void log_set_time(message_log *log, int gtime);
 
 message_log_entry *log_get_entry(message_log *log, guint id);
+
+/**
+ * Wrap the entries of the log for the message history, each preceded by
+ * its game time. The lines are kept with the entries, thus only entries
+ * which have not been wrapped to the same dimensions before are wrapped.
+ *
+ * @param the log
+ * @param the width of the lines
+ * @param the width of the game time
+ * @param the maximal number of entries to wrap, 0 for all
+ * @return TRUE if entries are left to be wrapped
+ */
+gboolean log_wrap(message_log *log, int width, int twidth, guint count);
+
 cJSON *log_serialize(message_log *log);
 message_log *log_deserialize(cJSON *lser);
 
 static inline guint log_length(message_log *log) { return log->entries->len; }
 static inline void log_enable(message_log *log)  { log->active = TRUE; }
-static inline void log_disable(message_log *log) { log->active = FALSE; }
+
+/* returns if the log has been active before, thus callers muting it for a
+   moment do not enable a log muted by someone else */
+static inline gboolean log_disable(message_log *log)
+{
+    gboolean active = log->active;
+    log->active = FALSE;
+    return active;
+}
 
 static inline char *log_buffer(message_log *log)
 {
     return log->buffer->len ? log->buffer->str : NULL;
 }
 
+/**
+ * Append an item to a JSON array without looking for the end of the array,
+ * which makes filling large arrays much faster than cJSON_AddItemToArray().
+ *
+ * @param the array
+ * @param the last item of the array or NULL if it is empty
+ * @param the item to append
+ * @return the item, which is the last one now
+ */
+cJSON *json_array_append(cJSON *array, cJSON *last, cJSON *item);
+
 /* text array handling */
 GPtrArray *text_wrap(const char *str, int width, int indent);
 
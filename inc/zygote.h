@@ -0,0 +1,55 @@
+/*
+ * zygote.h
+ * Copyright (C) 2009-2020 Joachim de Groot <jdegroot@web.de>
+ *
+ * NLarn is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * NLarn is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __ZYGOTE_H_
+#define __ZYGOTE_H_
+
+#include <glib.h>
+
+/* A zygote reads the data shared by all games once and starts every game
+   in a copy of itself, so the game starts right away and the data is
+   shared between the games. A session connects to the zygote over a local
+   socket and hands over its terminal, its command line and environment:
+
+     nlarn --zygote=/run/nlarn.sock        (started once)
+     nlarn --connect=/run/nlarn.sock ...   (for every session)
+
+   Only available on unix systems. */
+
+/**
+ * @brief Serve sessions connecting to a local socket. Every session is
+ *        played in a child process of the zygote which has taken over the
+ *        terminal and the environment of the session.
+ *
+ * @param the name of the socket
+ * @return in the child process: the command line of the session, free
+ *         with g_strfreev(). The zygote does not return.
+ */
+gchar **zygote_serve(const char *socket_name);
+
+/**
+ * @brief Play a game served by a zygote on the terminal of this process
+ *        and wait until it has ended.
+ *
+ * @param the name of the socket
+ * @param the command line of the session
+ * @return the exit code for this process
+ */
+int zygote_connect(const char *socket_name, char **args);
+
+#endif
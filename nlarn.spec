@@ -7,7 +7,7 @@ License: GPL v3
 URL:     https://nlarn.github.io/
 Source:  http://downloads.sourceforge.net/project/nlarn/nlarn/%{version}/nlarn-%{version}.tar.gz
 
-BuildRequires: gcc glib2-devel ncurses-devel zlib-devel
+BuildRequires: gcc glib2-devel lz4-devel ncurses-devel zlib-devel
 
 %description
 
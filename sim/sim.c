@@ -0,0 +1,671 @@
+/*
+ * sim.c
+ * Copyright (C) 2009-2020 Joachim de Groot <jdegroot@web.de>
+ *
+ * NLarn is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * NLarn is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Monte Carlo simulation of duels between the player and monsters, to
+ * learn about the balance of the game without waiting for players to die.
+ * The player, of the given level and equipment, and a monster stand next
+ * to each other and attack until one of them dies; both attack as often
+ * as their speed allows. Only the attacks are simulated: neither of them
+ * moves. The game's time passes with each round, thus effects wear off,
+ * and monsters spawned on the level meanwhile are removed after the fight.
+ *
+ * Each worker thread plays a game of its own, started from the seed plus
+ * the number of the worker, thus the results only depend on the seed and
+ * the number of workers. They are printed as JSON: for each monster the
+ * share of fights won by the player, the distribution of the turns the
+ * player needed to win, and of the damage dealt and taken per attack.
+ * Usage:
+ *
+ *   nlarn-sim [--monster=name] [--level=n] [--weapon=name] [--armour=name]
+ *             [--difficulty=n] [--fights=n] [--threads=n] [--seed=n]
+ */
+
+#include <glib.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cJSON.h"
+#include "config.h"
+#include "game.h"
+#include "maze.h"
+#include "nlarn.h"
+
+#define STR_HELPER(x) #x
+#define STR(x) STR_HELPER(x)
+
+/* the globals usually provided by nlarn.c */
+const char *nlarn_version = STR(VERSION_MAJOR) "." STR(VERSION_MINOR) "." STR(VERSION_PATCH) GITREV;
+const char *nlarn_libdir = "";
+const char *nlarn_mesgfile = "";
+const char *nlarn_helpfile = "";
+const char *nlarn_mazefile = "";
+const char *nlarn_fortunes = "";
+const char *nlarn_highscores = "";
+const char *nlarn_inifile = "";
+const char *nlarn_savefile = "";
+
+jmp_buf nlarn_death_jump;
+
+#define SIM_LEVEL      5    /* the level the fights take place on */
+#define SIM_TURNS_MAX  100  /* fights lasting longer are undecided */
+#define SIM_DAMAGE_MAX 100  /* larger damage is counted as this */
+
+/* the outcome of the fights against one kind of monster */
+typedef struct sim_result
+{
+    guint64 won;
+    guint64 lost;
+    guint64 undecided;      /* too long or the monster has fled */
+    guint64 turns[SIM_TURNS_MAX + 1];   /* turns needed to win */
+    guint64 dealt[SIM_DAMAGE_MAX + 1];  /* damage per attack of the player */
+    guint64 taken[SIM_DAMAGE_MAX + 1];  /* damage per attack of the monster */
+} sim_result;
+
+/* the player as prepared for the fights, restored before each of them */
+typedef struct sim_player
+{
+    guint strength, intelligence, wisdom, constitution, dexterity;
+    guint hp_max, mp_max;
+    guint experience, level;
+    speed speed;
+    item weapon;
+    item suit;
+} sim_player;
+
+typedef struct sim_worker
+{
+    guint32 seed;
+    guint fights;           /* fights against each monster */
+    sim_result *results;    /* one for each monster */
+    position ppos;
+    position mpos;
+    sim_player orig;
+    effect *protection;     /* tells when the player has died */
+} sim_worker;
+
+static struct game_config config = { 0 };
+
+/* the command line */
+static gchar *opt_monster = NULL;
+static gint opt_level = 1;
+static gchar *opt_weapon = NULL;
+static gchar *opt_armour = NULL;
+static gint opt_difficulty = 0;
+static gint opt_fights = 10000;
+static gint opt_threads = 0;
+static gint64 opt_seed = 4711;
+
+static monster_t monsters[MT_MAX];
+static guint monster_count = 0;
+static gint weapon_type = WT_DAGGER;
+static gint armour_type = AT_LEATHER;
+
+static gint sim_lookup(const char *name, const char *(*name_of)(gint), gint max)
+{
+    if (g_ascii_strcasecmp(name, "none") == 0)
+        return -1;
+
+    for (gint idx = 0; idx < max; idx++)
+    {
+        if (g_ascii_strcasecmp(name, name_of(idx)) == 0)
+            return idx;
+    }
+
+    return max;
+}
+
+static const char *sim_weapon_name(gint idx) { return weapons[idx].name; }
+static const char *sim_armour_name(gint idx) { return armours[idx].name; }
+static const char *sim_monster_name(gint idx) { return monster_type_name(idx); }
+
+/* replace an item of the player's equipment with a fresh one */
+static item *sim_item_replace(player *p, item *old, item_t type, gint id)
+{
+    if (old != NULL)
+    {
+        player_item_unequip(p, NULL, old, TRUE);
+        inv_del_element(&p->inventory, old);
+        item_destroy(old);
+    }
+
+    if (id < 0)
+        return NULL;
+
+    item *it = item_new(type, id);
+    it->bonus = 0;
+    it->cursed = it->blessed = FALSE;
+    inv_add(&p->inventory, it);
+
+    return it;
+}
+
+static void sim_player_prepare(sim_worker *w, player *p)
+{
+    if (opt_level > 1)
+        player_level_gain(p, opt_level - 1);
+
+    /* equip the player without spending time */
+    p->eq_weapon = sim_item_replace(p, p->eq_weapon, IT_WEAPON, weapon_type);
+    p->eq_suit = sim_item_replace(p, p->eq_suit, IT_ARMOUR, armour_type);
+
+    w->orig.strength = p->strength;
+    w->orig.intelligence = p->intelligence;
+    w->orig.wisdom = p->wisdom;
+    w->orig.constitution = p->constitution;
+    w->orig.dexterity = p->dexterity;
+    w->orig.hp_max = p->hp_max;
+    w->orig.mp_max = p->mp_max;
+    w->orig.experience = p->experience;
+    w->orig.level = p->level;
+    w->orig.speed = p->speed;
+
+    if (p->eq_weapon) w->orig.weapon = *p->eq_weapon;
+    if (p->eq_suit) w->orig.suit = *p->eq_suit;
+
+    /* life protection keeps the player alive and counts the deaths: it
+       saves from everything a monster can do to the player */
+    w->protection = effect_new(ET_LIFE_PROTECTION);
+    w->protection->turns = 0;
+    player_effect_add(p, w->protection);
+}
+
+/* an item of the equipment which is not as it has been before the fight */
+static gboolean sim_item_changed(item *it, item *orig, gint id)
+{
+    if (id < 0)
+        return FALSE;
+
+    return it == NULL || it->bonus != orig->bonus || it->corroded
+        || it->burnt || it->rusty;
+}
+
+static void sim_player_restore(sim_worker *w, player *p)
+{
+    /* effects of the last fight, except those caused by the equipment */
+    for (guint idx = p->effects->len; idx > 0; idx--)
+    {
+        effect *e = game_effect_get(nlarn, g_ptr_array_index(p->effects, idx - 1));
+
+        if (e != w->protection && e->item == NULL)
+            player_effect_del(p, e);
+    }
+
+    p->strength = w->orig.strength;
+    p->intelligence = w->orig.intelligence;
+    p->wisdom = w->orig.wisdom;
+    p->constitution = w->orig.constitution;
+    p->dexterity = w->orig.dexterity;
+    p->hp = p->hp_max = w->orig.hp_max;
+    p->mp = p->mp_max = w->orig.mp_max;
+    p->experience = w->orig.experience;
+    p->level = w->orig.level;
+    p->speed = w->orig.speed;
+    p->pos = w->ppos;
+    w->protection->amount = G_MAXINT;
+
+    /* stolen, rusted or broken equipment */
+    if (sim_item_changed(p->eq_weapon, &w->orig.weapon, weapon_type))
+    {
+        p->eq_weapon = sim_item_replace(p, p->eq_weapon, IT_WEAPON, weapon_type);
+        p->eq_weapon->bonus = w->orig.weapon.bonus;
+    }
+
+    if (sim_item_changed(p->eq_suit, &w->orig.suit, armour_type))
+    {
+        p->eq_suit = sim_item_replace(p, p->eq_suit, IT_ARMOUR, armour_type);
+        p->eq_suit->bonus = w->orig.suit.bonus;
+    }
+}
+
+/* remove the items dropped during a fight */
+static void sim_floor_clear(map *m, position pos)
+{
+    inventory **floor = map_ilist_at(m, pos);
+
+    if (*floor != NULL)
+    {
+        inv_destroy(*floor, TRUE);
+        *floor = NULL;
+    }
+}
+
+/* remove all monsters from the level */
+static void sim_arena_clear(map *arena)
+{
+    position pos = pos_invalid;
+    Z(pos) = SIM_LEVEL;
+
+    for (Y(pos) = 0; Y(pos) < arena->height; Y(pos)++)
+    {
+        for (X(pos) = 0; X(pos) < arena->width; X(pos)++)
+        {
+            monster *m = map_get_monster_at(arena, pos);
+
+            if (m == NULL)
+                continue;
+
+            map_set_monster_at(arena, pos, NULL);
+            monster_destroy(m);
+        }
+    }
+}
+
+static inline void sim_count(guint64 *table, gint amount, gint max)
+{
+    table[CLAMP(amount, 0, max)]++;
+}
+
+static void sim_fight(sim_worker *w, game *g, monster_t type, sim_result *r)
+{
+    player *p = g->p;
+    map *arena = game_map(g, SIM_LEVEL);
+
+    sim_player_restore(w, p);
+
+    monster *m = monster_new(type, w->mpos, NULL);
+
+    /* genocided monsters */
+    if (m == NULL)
+        return;
+
+    const guint deaths = p->stats.life_protected;
+    const guint monster_id = g->monster_max_id;
+    gint pmoves = 0, mmoves = 0;
+    guint turn = 0;
+    gboolean won = FALSE, lost = FALSE, fled = FALSE;
+    position mpos = monster_pos(m);
+
+    while (!won && !lost && !fled && turn < SIM_TURNS_MAX)
+    {
+        turn++;
+        pmoves += player_get_speed(p);
+        mmoves += monster_speed(m);
+
+        while (pmoves >= NORMAL && !won)
+        {
+            const gint hp = monster_hp(m);
+
+            pmoves -= NORMAL;
+            mpos = monster_pos(m);
+            player_attack(p, m);
+
+            sim_count(r->dealt, hp - max(monster_hp(m), 0), SIM_DAMAGE_MAX);
+            won = (monster_hp(m) < 1);
+        }
+
+        while (mmoves >= NORMAL && !won && !lost && !fled)
+        {
+            const gint hp = p->hp;
+
+            mmoves -= NORMAL;
+            monster_update_player_pos(m, p->pos);
+            monster_player_attack(m, p);
+
+            lost = (p->stats.life_protected != deaths);
+            sim_count(r->taken, lost ? hp : hp - p->hp, SIM_DAMAGE_MAX);
+
+            /* some attacks hurt the attacker, thieves teleport away */
+            won = (monster_hp(m) < 1);
+            fled = !pos_adjacent(monster_pos(m), p->pos);
+        }
+
+        if (!won && !lost && !fled)
+            game_timers_advance(g);
+    }
+
+    if (won)
+    {
+        r->won++;
+        r->turns[turn]++;
+        game_remove_dead_monsters(g);
+    }
+    else
+    {
+        if (lost) r->lost++;
+        else r->undecided++;
+
+        mpos = monster_pos(m);
+        map_set_monster_at(monster_map(m), mpos, NULL);
+        monster_destroy(m);
+    }
+
+    sim_floor_clear(arena, w->mpos);
+    sim_floor_clear(arena, w->ppos);
+    if (Z(mpos) == SIM_LEVEL) sim_floor_clear(arena, mpos);
+
+    /* monsters have been spawned or summoned */
+    if (g->monster_max_id != monster_id)
+        sim_arena_clear(arena);
+}
+
+/* the player fights on a level without other monsters */
+static gboolean sim_arena_prepare(sim_worker *w, game *g)
+{
+    map *arena = game_map_generate(g, SIM_LEVEL);
+
+    player_map_enter(g->p, arena, FALSE);
+    sim_arena_clear(arena);
+
+    w->ppos = g->p->pos;
+
+    for (direction dir = GD_NONE + 1; dir < GD_MAX; dir++)
+    {
+        if (dir == GD_CURR)
+            continue;
+
+        w->mpos = pos_move(w->ppos, dir);
+
+        if (pos_valid(w->mpos)
+                && map_pos_validate(arena, w->mpos, LE_MONSTER, FALSE))
+            return TRUE;
+    }
+
+    return FALSE;
+}
+
+static gpointer sim_work(gpointer data)
+{
+    sim_worker *w = (sim_worker *)data;
+    struct game_config cfg = config;
+
+    cfg.seed = w->seed;
+    game *g = game_create(&cfg);
+
+    /* the fights are not worth mentioning */
+    log_disable(g->log);
+
+    if (!sim_arena_prepare(w, g))
+    {
+        g_printerr("No room for the fight next to the player.\n");
+        exit(EXIT_FAILURE);
+    }
+
+    sim_player_prepare(w, g->p);
+
+    for (guint idx = 0; idx < monster_count; idx++)
+    {
+        for (guint fight = 0; fight < w->fights; fight++)
+            sim_fight(w, g, monsters[idx], &w->results[idx]);
+    }
+
+    game_destroy(g);
+
+    return NULL;
+}
+
+/* the value below which a share of the counts lies */
+static guint sim_percentile(const guint64 *table, guint max, guint64 total,
+                            double share)
+{
+    guint64 sum = 0;
+
+    if (total == 0)
+        return 0;
+
+    for (guint idx = 0; idx <= max; idx++)
+    {
+        sum += table[idx];
+
+        if (sum > 0 && sum >= share * total)
+            return idx;
+    }
+
+    return max;
+}
+
+/* the distribution of the counts as a table of value and count */
+static cJSON *sim_table(const guint64 *table, guint max)
+{
+    guint64 total = 0, sum = 0;
+
+    for (guint idx = 0; idx <= max; idx++)
+    {
+        total += table[idx];
+        sum += idx * table[idx];
+    }
+
+    cJSON *res = cJSON_CreateObject();
+    cJSON *rows = cJSON_CreateArray();
+
+    cJSON_AddNumberToObject(res, "count", total);
+    cJSON_AddNumberToObject(res, "mean", total ? (double)sum / total : 0);
+    cJSON_AddNumberToObject(res, "median", sim_percentile(table, max, total, 0.5));
+    cJSON_AddNumberToObject(res, "p90", sim_percentile(table, max, total, 0.9));
+
+    for (guint idx = 0; idx <= max; idx++)
+    {
+        if (table[idx] == 0)
+            continue;
+
+        cJSON *row = cJSON_CreateArray();
+        cJSON_AddItemToArray(row, cJSON_CreateNumber(idx));
+        cJSON_AddItemToArray(row, cJSON_CreateNumber(table[idx]));
+        cJSON_AddItemToArray(rows, row);
+    }
+
+    cJSON_AddItemToObject(res, "table", rows);
+
+    return res;
+}
+
+static cJSON *sim_report(sim_result *r, monster_t type)
+{
+    const guint64 fights = r->won + r->lost + r->undecided;
+    cJSON *res = cJSON_CreateObject();
+
+    cJSON_AddStringToObject(res, "monster", monster_type_name(type));
+    cJSON_AddNumberToObject(res, "fights", fights);
+    cJSON_AddNumberToObject(res, "won", r->won);
+    cJSON_AddNumberToObject(res, "lost", r->lost);
+    cJSON_AddNumberToObject(res, "undecided", r->undecided);
+    cJSON_AddNumberToObject(res, "win_rate", fights ? (double)r->won / fights : 0);
+    cJSON_AddItemToObject(res, "turns_to_kill", sim_table(r->turns, SIM_TURNS_MAX));
+    cJSON_AddItemToObject(res, "damage_dealt", sim_table(r->dealt, SIM_DAMAGE_MAX));
+    cJSON_AddItemToObject(res, "damage_taken", sim_table(r->taken, SIM_DAMAGE_MAX));
+
+    return res;
+}
+
+static gboolean sim_options(int argc, char *argv[])
+{
+    const GOptionEntry entries[] =
+    {
+        { "monster",    'm', 0, G_OPTION_ARG_STRING, &opt_monster,    "The monster to fight, all if omitted", NULL },
+        { "level",      'l', 0, G_OPTION_ARG_INT,    &opt_level,      "The player's experience level", NULL },
+        { "weapon",     'w', 0, G_OPTION_ARG_STRING, &opt_weapon,     "The player's weapon or \"none\"", NULL },
+        { "armour",     'a', 0, G_OPTION_ARG_STRING, &opt_armour,     "The player's suit of armour or \"none\"", NULL },
+        { "difficulty", 'd', 0, G_OPTION_ARG_INT,    &opt_difficulty, "The difficulty of the game", NULL },
+        { "fights",     'f', 0, G_OPTION_ARG_INT,    &opt_fights,     "The fights against each monster", NULL },
+        { "threads",    't', 0, G_OPTION_ARG_INT,    &opt_threads,    "The worker threads, one per processor if omitted", NULL },
+        { "seed",       'r', 0, G_OPTION_ARG_INT64,  &opt_seed,       "The random seed", NULL },
+        { NULL, 0, 0, 0, NULL, NULL, NULL }
+    };
+
+    GError *error = NULL;
+    GOptionContext *context = g_option_context_new(NULL);
+    g_option_context_add_main_entries(context, entries, NULL);
+
+    if (!g_option_context_parse(context, &argc, &argv, &error))
+    {
+        g_printerr("%s\n", error->message);
+        g_error_free(error);
+        g_option_context_free(context);
+        return FALSE;
+    }
+
+    g_option_context_free(context);
+
+    if (opt_level < 1 || opt_fights < 1 || opt_threads < 0 || opt_seed < 1)
+    {
+        g_printerr("The level, the fights and the seed must be positive.\n");
+        return FALSE;
+    }
+
+    if (opt_weapon && (weapon_type = sim_lookup(opt_weapon,
+                    sim_weapon_name, WT_MAX)) == WT_MAX)
+    {
+        g_printerr("Unknown weapon \"%s\".\n", opt_weapon);
+        return FALSE;
+    }
+
+    if (opt_armour && (armour_type = sim_lookup(opt_armour,
+                    sim_armour_name, AT_MAX)) == AT_MAX)
+    {
+        g_printerr("Unknown armour \"%s\".\n", opt_armour);
+        return FALSE;
+    }
+
+    if (armour_type >= 0 && armours[armour_type].category != AC_SUIT)
+    {
+        g_printerr("The %s is not a suit of armour.\n", opt_armour);
+        return FALSE;
+    }
+
+    if (opt_monster)
+    {
+        gint type = sim_lookup(opt_monster, sim_monster_name, MT_MAX);
+
+        if (type < 0 || type == MT_MAX)
+        {
+            g_printerr("Unknown monster \"%s\".\n", opt_monster);
+            return FALSE;
+        }
+
+        monsters[monster_count++] = type;
+    }
+    else
+    {
+        /* the player does not fight the town's people */
+        for (monster_t type = 0; type < MT_MAX; type++)
+        {
+            if (type != MT_TOWN_PERSON)
+                monsters[monster_count++] = type;
+        }
+    }
+
+    return TRUE;
+}
+
+int main(int argc, char *argv[])
+{
+    if (!sim_options(argc, argv))
+        return EXIT_FAILURE;
+
+    const guint threads = opt_threads ? (guint)opt_threads
+                                      : g_get_num_processors();
+
+    /* the game's library is expected next to the directory of the program */
+    gchar *basedir = g_path_get_dirname(argv[0]);
+    nlarn_libdir = g_build_filename(basedir, "..", "lib", NULL);
+    nlarn_mazefile = g_build_filename(nlarn_libdir, "maze", NULL);
+    nlarn_fortunes = g_build_filename(nlarn_libdir, "fortune", NULL);
+    g_free(basedir);
+
+    char *problems = maze_library_load(nlarn_mazefile);
+    if (problems != NULL)
+    {
+        g_printerr("Cannot read the maze file \"%s\":\n%s", nlarn_mazefile, problems);
+        return EXIT_FAILURE;
+    }
+
+    config.name = "Sim";
+    config.no_autosave = TRUE;
+    config.difficulty = opt_difficulty;
+
+    sim_worker *workers = g_new0(sim_worker, threads);
+    GThread **thread = g_new0(GThread *, threads);
+
+    for (guint idx = 0; idx < threads; idx++)
+    {
+        workers[idx].seed = (guint32)opt_seed + idx;
+        workers[idx].fights = opt_fights / threads
+            + (idx < opt_fights % threads ? 1 : 0);
+        workers[idx].results = g_new0(sim_result, monster_count);
+    }
+
+    const gint64 start = g_get_monotonic_time();
+
+    for (guint idx = 0; idx < threads; idx++)
+        thread[idx] = g_thread_new("sim", sim_work, &workers[idx]);
+
+    for (guint idx = 0; idx < threads; idx++)
+        g_thread_join(thread[idx]);
+
+    const double seconds = (g_get_monotonic_time() - start) / 1000000.0;
+
+    /* add up the results of the workers */
+    cJSON *report = cJSON_CreateObject();
+    cJSON *results = cJSON_CreateArray();
+    guint64 fights = 0;
+
+    for (guint midx = 0; midx < monster_count; midx++)
+    {
+        sim_result *sum = &workers[0].results[midx];
+
+        for (guint idx = 1; idx < threads; idx++)
+        {
+            sim_result *r = &workers[idx].results[midx];
+
+            sum->won += r->won;
+            sum->lost += r->lost;
+            sum->undecided += r->undecided;
+
+            for (guint val = 0; val <= SIM_TURNS_MAX; val++)
+                sum->turns[val] += r->turns[val];
+
+            for (guint val = 0; val <= SIM_DAMAGE_MAX; val++)
+            {
+                sum->dealt[val] += r->dealt[val];
+                sum->taken[val] += r->taken[val];
+            }
+        }
+
+        fights += sum->won + sum->lost + sum->undecided;
+        cJSON_AddItemToArray(results, sim_report(sum, monsters[midx]));
+    }
+
+    cJSON_AddStringToObject(report, "version", nlarn_version);
+    cJSON_AddNumberToObject(report, "seed", opt_seed);
+    cJSON_AddNumberToObject(report, "threads", threads);
+    cJSON_AddNumberToObject(report, "level", opt_level);
+    cJSON_AddStringToObject(report, "weapon", weapon_type < 0 ? "none"
+                                              : weapons[weapon_type].name);
+    cJSON_AddStringToObject(report, "armour", armour_type < 0 ? "none"
+                                              : armours[armour_type].name);
+    cJSON_AddNumberToObject(report, "difficulty", opt_difficulty);
+    cJSON_AddNumberToObject(report, "seconds", seconds);
+    cJSON_AddNumberToObject(report, "fights_per_second", fights / seconds);
+    cJSON_AddItemToObject(report, "results", results);
+
+    char *out = cJSON_Print(report);
+    g_print("%s\n", out);
+    free(out);
+    cJSON_Delete(report);
+
+    /* tidy up */
+    for (guint idx = 0; idx < threads; idx++)
+        g_free(workers[idx].results);
+
+    g_free(workers);
+    g_free(thread);
+    maze_library_destroy();
+
+    return EXIT_SUCCESS;
+}
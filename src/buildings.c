@@ -51,8 +51,8 @@ void building_bank_calc_interest(game *g)
 {
     guint interest = 0;
 
-    /* pay interest every 1000 turns */
-    if (game_turn(g) % 1000 != 0 || g->p->bank_account <= 250)
+    /* called every 1000 turns */
+    if (g->p->bank_account <= 250)
         return;
 
     /* the bank pays an interest of 2.5% every ten mobuls */
@@ -1168,7 +1168,7 @@ int building_monastery(struct player *p)
                 int choice;
                 char *question;
                 effect *e = player_effect_get(p, curable_diseases[selection].et);
-                int price = e->turns * (game_difficulty(nlarn) + 1);
+                int price = effect_turns(e) * (game_difficulty(nlarn) + 1);
 
                 question = g_strdup_printf("For healing you from %s, we ask that you "
                                            "donate %d gold for our monastery. %s",
@@ -0,0 +1,245 @@
+/*
+ * codec.c
+ * Copyright (C) 2009-2020 Joachim de Groot <jdegroot@web.de>
+ *
+ * NLarn is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * NLarn is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <glib.h>
+#include <string.h>
+#include <lz4frame.h>
+#include <zlib.h>
+
+#include "codec.h"
+
+/* the codec used for compressing */
+static codec_t codec = CODEC_GZIP;
+static int gzip_level = 6;
+
+static const guchar gzip_magic[] = { 0x1f, 0x8b };
+
+/* LZ4 frames written by the LZ4 library, which the lz4 command line tool
+   reads. Frames state the size of their content and protect it with a
+   checksum. */
+static const guchar lz4_magic[] = { 0x04, 0x22, 0x4d, 0x18 };
+
+static GBytes *lz4_compress(const guchar *data, gsize len)
+{
+    LZ4F_preferences_t prefs = LZ4F_INIT_PREFERENCES;
+
+    prefs.frameInfo.blockSizeID = LZ4F_max4MB;
+    prefs.frameInfo.blockMode = LZ4F_blockIndependent;
+    prefs.frameInfo.contentSize = len;
+    prefs.frameInfo.contentChecksumFlag = LZ4F_contentChecksumEnabled;
+
+    const gsize bound = LZ4F_compressFrameBound(len, &prefs);
+    guchar *buf = g_malloc(bound);
+    const gsize size = LZ4F_compressFrame(buf, bound, data, len, &prefs);
+
+    /* the bound is always sufficient */
+    g_assert(!LZ4F_isError(size));
+
+    return g_bytes_new_take(g_realloc(buf, size), size);
+}
+
+/* decompress a frame; returns the number of bytes read, 0 on errors */
+static gsize lz4_decompress(const guchar *data, gsize len, GByteArray *out)
+{
+    LZ4F_dctx *dctx;
+    gsize read = 0;
+
+    if (LZ4F_isError(LZ4F_createDecompressionContext(&dctx, LZ4F_VERSION)))
+        return 0;
+
+    while (TRUE)
+    {
+        /* make room for the expected result */
+        const guint start = out->len;
+        const guint room = MAX(4 * (len - read), 65536);
+        gsize in_len = len - read, out_len = room;
+
+        g_byte_array_set_size(out, start + room);
+        const gsize hint = LZ4F_decompress(dctx, out->data + start, &out_len,
+                                           data + read, &in_len, NULL);
+        g_byte_array_set_size(out, start + out_len);
+        read += in_len;
+
+        /* the end of the frame has been reached */
+        if (hint == 0)
+            break;
+
+        /* errors and data ending within the frame */
+        if (LZ4F_isError(hint) || (in_len == 0 && out_len == 0))
+        {
+            read = 0;
+            break;
+        }
+    }
+
+    LZ4F_freeDecompressionContext(dctx);
+
+    return read;
+}
+
+static GBytes *gzip_compress(const guchar *data, gsize len)
+{
+    z_stream zs = { 0 };
+
+    deflateInit2(&zs, gzip_level, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY);
+
+    const gsize bound = deflateBound(&zs, len);
+    guchar *buf = g_malloc(bound);
+
+    zs.next_in = (Bytef *)data;
+    zs.avail_in = len;
+    zs.next_out = buf;
+    zs.avail_out = bound;
+
+    deflate(&zs, Z_FINISH);
+    const gsize size = zs.total_out;
+    deflateEnd(&zs);
+
+    return g_bytes_new_take(g_realloc(buf, size), size);
+}
+
+/* decompress a member; returns the number of bytes read, 0 on errors */
+static gsize gzip_decompress(const guchar *data, gsize len, GByteArray *out)
+{
+    z_stream zs = { 0 };
+    int ret;
+
+    if (inflateInit2(&zs, 15 + 16) != Z_OK)
+        return 0;
+
+    zs.next_in = (Bytef *)data;
+    zs.avail_in = len;
+
+    do
+    {
+        /* make room for the expected result */
+        const guint start = out->len;
+        const guint room = MAX(4 * zs.avail_in, 65536);
+
+        g_byte_array_set_size(out, start + room);
+        zs.next_out = out->data + start;
+        zs.avail_out = room;
+
+        ret = inflate(&zs, Z_NO_FLUSH);
+        g_byte_array_set_size(out, start + room - zs.avail_out);
+    } while (ret == Z_OK);
+
+    const gsize read = (ret == Z_STREAM_END) ? zs.total_in : 0;
+    inflateEnd(&zs);
+
+    return read;
+}
+
+gboolean codec_select(const char *name)
+{
+    g_assert(name != NULL);
+
+    if (g_strcmp0(name, "lz4") == 0)
+    {
+        codec = CODEC_LZ4;
+        return TRUE;
+    }
+
+    if (g_strcmp0(name, "gzip") == 0)
+    {
+        codec = CODEC_GZIP;
+        gzip_level = 6;
+        return TRUE;
+    }
+
+    if (g_str_has_prefix(name, "gzip-") && name[5] >= '1' && name[5] <= '9'
+            && name[6] == '\0')
+    {
+        codec = CODEC_GZIP;
+        gzip_level = name[5] - '0';
+        return TRUE;
+    }
+
+    return FALSE;
+}
+
+const char *codec_name()
+{
+    static char name[8];
+
+    if (codec == CODEC_LZ4)
+        return "lz4";
+
+    if (gzip_level == 6)
+        return "gzip";
+
+    g_snprintf(name, sizeof(name), "gzip-%d", gzip_level);
+
+    return name;
+}
+
+GBytes *codec_compress(gconstpointer data, gsize len)
+{
+    switch (codec)
+    {
+    case CODEC_LZ4:
+        return lz4_compress(data, len);
+
+    default:
+        return gzip_compress(data, len);
+    }
+}
+
+gchar *codec_decompress(gconstpointer data, gsize len, gsize *result_len)
+{
+    const guchar *ip = data;
+    GByteArray *out = g_byte_array_new();
+
+    while (len > 0)
+    {
+        gsize read;
+
+        if (len >= sizeof(gzip_magic)
+                && memcmp(ip, gzip_magic, sizeof(gzip_magic)) == 0)
+        {
+            read = gzip_decompress(ip, len, out);
+        }
+        else if (len >= sizeof(lz4_magic)
+                && memcmp(ip, lz4_magic, sizeof(lz4_magic)) == 0)
+        {
+            read = lz4_decompress(ip, len, out);
+        }
+        else
+        {
+            /* not compressed */
+            g_byte_array_append(out, ip, len);
+            read = len;
+        }
+
+        if (read == 0)
+        {
+            g_byte_array_free(out, TRUE);
+            return NULL;
+        }
+
+        ip += read;
+        len -= read;
+    }
+
+    if (result_len != NULL)
+        *result_len = out->len;
+
+    g_byte_array_append(out, (const guint8 *)"", 1);
+
+    return (gchar *)g_byte_array_free(out, FALSE);
+}
@@ -53,7 +53,13 @@ damage *damage_copy(damage *dam)
 
 char *damage_to_str(damage *dam)
 {
-    static char buf[121];
+    /* each thread has its own buffer: games played in threads
+       of their own log the damage at the same time */
+#ifdef _MSC_VER
+    static __declspec(thread) char buf[121];
+#else
+    static __thread char buf[121];
+#endif
     g_snprintf(buf, 120, "[%s - %s - %s: %d]",
             attack_t_string(dam->attack),
             damage_t_string(dam->type),
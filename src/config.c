@@ -65,9 +65,19 @@ static const char *default_config_file =
     "font-size=18\n"
     "\n"
 #endif
-    "# Disable automatic saving when switching a level. Saving the game is\n"
-    "# enabled by default, disable when it's too slow on your computer\n"
-    "no-autosave=false\n";
+    "# Disable automatic saving. The game is saved every 1000 keys and the\n"
+    "# keys pressed since are journalled, allowing to recover the game after\n"
+    "# a crash. Enabled by default, disable when it's too slow on your computer\n"
+    "no-autosave=false\n"
+    "\n"
+    "# Compression of saved games: gzip (level 6), gzip-1 (fastest) to\n"
+    "# gzip-9 (smallest) or lz4 (much faster, somewhat larger)\n"
+    "compression=gzip\n"
+    "\n"
+    "# Number of levels kept in memory. Levels away from the player are\n"
+    "# moved to a temporary file beyond that number. 0 keeps all levels\n"
+    "# in memory\n"
+    "resident-levels=0\n";
 
 /* shared config cleanup helper */
 void free_config(const struct game_config config)
@@ -76,6 +86,15 @@ void free_config(const struct game_config config)
     if (config.gender)      g_free(config.gender);
     if (config.stats)       g_free(config.stats);
     if (config.auto_pickup) g_free(config.auto_pickup);
+    if (config.trace)       g_free(config.trace);
+    if (config.record)      g_free(config.record);
+    if (config.replay)      g_free(config.replay);
+    if (config.compression) g_free(config.compression);
+    if (config.map_size)    g_free(config.map_size);
+#ifdef __unix
+    if (config.zygote)      g_free(config.zygote);
+    if (config.connect)     g_free(config.connect);
+#endif
 }
 
 /* parse the command line */
@@ -89,10 +108,21 @@ void parse_commandline(int argc, char *argv[], struct game_config *config)
         { "auto-pickup", 'a', 0, G_OPTION_ARG_STRING, &config->auto_pickup,  "Item types to pick up automatically, e.g. '$*+'", NULL },
         { "no-autosave", 'N', 0, G_OPTION_ARG_NONE,   &config->no_autosave,  "Disable autosave", NULL },
         { "wizard",      'w', 0, G_OPTION_ARG_NONE,   &config->wizard,       "Enable wizard mode", NULL },
+        { "seed",        'r', 0, G_OPTION_ARG_INT64,  &config->seed,         "Set the random seed for a new game", NULL },
+        { "map-size",    'm', 0, G_OPTION_ARG_STRING, &config->map_size,     "Set the size of the levels of a new game, e.g. '256x96'", "WxH" },
+        { "depth",       'd', 0, G_OPTION_ARG_INT,    &config->depth,        "Set the deepest level of the caverns of a new game (10-250)", "N" },
+        { "resident-levels", 'R', 0, G_OPTION_ARG_INT, &config->resident_levels, "Keep at most N levels in memory, paging out the others to a file", "N" },
 #ifdef SDLPDCURSES
         { "font-size",   'S', 0, G_OPTION_ARG_INT,    &config->font_size,   "Set font size", NULL },
 #endif
         { "userdir",     'D', 0, G_OPTION_ARG_FILENAME, &config->userdir,    "Alternate directory for config file and saved games", NULL },
+        { "trace",       't', 0, G_OPTION_ARG_FILENAME, &config->trace,      "Write a Chrome trace of the game's timing to a file", NULL },
+        { "record",      'j', 0, G_OPTION_ARG_FILENAME, &config->record,     "Record the keys pressed to a journal file", NULL },
+        { "replay",      'J', 0, G_OPTION_ARG_FILENAME, &config->replay,     "Replay a journal at full speed and compare the outcome", NULL },
+#ifdef __unix
+        { "zygote",      'Z', 0, G_OPTION_ARG_FILENAME, &config->zygote,     "Serve games to sessions connecting to a local socket", NULL },
+        { "connect",     'C', 0, G_OPTION_ARG_FILENAME, &config->connect,    "Play a game served by the zygote listening on a socket", NULL },
+#endif
         { "highscores",  'h', 0, G_OPTION_ARG_NONE,   &config->show_scores,  "Show highscores and exit", NULL },
         { "version",     'v', 0, G_OPTION_ARG_NONE,   &config->show_version, "Show version information and exit", NULL },
         { NULL, 0, 0, 0, NULL, NULL, NULL }
@@ -108,6 +138,59 @@ void parse_commandline(int argc, char *argv[], struct game_config *config)
 
         exit (EXIT_FAILURE);
     }
+
+    if (config->record && config->replay)
+    {
+        g_printerr("option parsing failed: a journal can either be recorded or replayed\n");
+
+        exit (EXIT_FAILURE);
+    }
+
+    if (config->seed < 0 || config->seed > G_MAXUINT32)
+    {
+        g_printerr("option parsing failed: seed must be between 0 and %u (0 = random)\n",
+                G_MAXUINT32);
+
+        exit (EXIT_FAILURE);
+    }
+
+    if (config->resident_levels < 0)
+    {
+        g_printerr("option parsing failed: the number of resident levels "
+                "must not be negative\n");
+
+        exit (EXIT_FAILURE);
+    }
+
+    if (config->depth != 0
+            && (config->depth < MAP_CMAX - 1 || config->depth > MAP_DEPTH_LIMIT))
+    {
+        g_printerr("option parsing failed: the deepest level of the caverns "
+                "must be between %d and %d\n", MAP_CMAX - 1, MAP_DEPTH_LIMIT);
+
+        exit (EXIT_FAILURE);
+    }
+
+    if (config->map_size)
+    {
+        char *end;
+
+        config->map_width = strtol(config->map_size, &end, 10);
+        config->map_height = (*end == 'x') ? strtol(end + 1, &end, 10) : 0;
+
+        if (*end || config->map_width < MAP_MAX_X
+                || config->map_width > MAP_LIMIT_X
+                || config->map_height < MAP_MAX_Y
+                || config->map_height > MAP_LIMIT_Y)
+        {
+            g_printerr("option parsing failed: the map size must be between "
+                    "%dx%d and %dx%d\n", MAP_MAX_X, MAP_MAX_Y,
+                    MAP_LIMIT_X, MAP_LIMIT_Y);
+
+            exit (EXIT_FAILURE);
+        }
+    }
+
     g_option_context_free(context);
 }
 
@@ -134,6 +217,15 @@ gboolean parse_ini_file(const char *filename, struct game_config *config)
         if (!config->no_autosave && !error) config->no_autosave = no_autosave;
         g_clear_error(&error);
 
+        char *compression = g_key_file_get_string(ini_file, "nlarn", "compression", &error);
+        if (!config->compression && !error) config->compression = compression;
+        g_clear_error(&error);
+
+        int resident_levels = g_key_file_get_integer(ini_file, "nlarn", "resident-levels", &error);
+        if (!config->resident_levels && !error && resident_levels > 0)
+            config->resident_levels = resident_levels;
+        g_clear_error(&error);
+
         char *name = g_key_file_get_string(ini_file, "nlarn", "name", &error);
         if (!config->name && !error) config->name = name;
         g_clear_error(&error);
@@ -189,6 +281,9 @@ void write_ini_file(const char *filename, struct game_config *config)
         g_key_file_set_value(kf,   "nlarn", "stats",       config->stats ? config->stats : "");
         g_key_file_set_value(kf,   "nlarn", "auto-pickup", config->auto_pickup ? config->auto_pickup : "");
         g_key_file_set_boolean(kf, "nlarn", "no-autosave", config->no_autosave);
+        if (config->compression)
+            g_key_file_set_value(kf, "nlarn", "compression", config->compression);
+        g_key_file_set_integer(kf, "nlarn", "resident-levels", config->resident_levels);
 #ifdef SDLPDCURSES
         g_key_file_set_integer(kf, "nlarn", "font-size", config->font_size);
 #endif
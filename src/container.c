@@ -237,9 +237,9 @@ void container_item_add(player *p, inventory **inv, item *element)
            to recalculated. Silence the log in the meantime to avoid
            pointless messages. */
 
-        log_disable(nlarn->log);
+        gboolean logged = log_disable(nlarn->log);
         player_inv_weight_recalc(p->inventory, NULL);
-        log_enable(nlarn->log);
+        if (logged) log_enable(nlarn->log);
     }
 }
 
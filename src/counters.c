@@ -0,0 +1,189 @@
+/*
+ * counters.c
+ * Copyright (C) 2009-2020 Joachim de Groot <jdegroot@web.de>
+ *
+ * NLarn is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * NLarn is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <glib.h>
+#include <string.h>
+
+#include "counters.h"
+
+#ifdef _MSC_VER
+__declspec(thread) guint64 counters[CNT_MAX] = { 0 };
+static __declspec(thread) counter_set *selected = NULL;
+#else
+__thread guint64 counters[CNT_MAX] = { 0 };
+static __thread counter_set *selected = NULL;
+#endif
+
+static const char *counter_descs[CNT_MAX] =
+{
+    "path_find calls",
+    "path_find nodes",
+    "fov_calculate calls",
+    "fov_calculate cells",
+    "map_pos_is_visible calls",
+    "effect_query calls",
+    "game_item_get lookups",
+    "game_monster_get lookups",
+    "paint time (us)",
+    "save bytes",
+    "save time (us)",
+    "load bytes",
+    "load time (us)",
+    "levels paged in",
+    "levels paged out",
+    "paging time (us)",
+    "travel commands",
+    "travel path searches",
+};
+
+static guint counter_bucket(guint64 count)
+{
+    guint bucket = 0;
+
+    while (count > 0 && bucket < COUNTER_BUCKETS - 1)
+    {
+        count >>= 1;
+        bucket++;
+    }
+
+    return bucket;
+}
+
+counter_set *counters_use(counter_set *set)
+{
+    counter_set *prev = selected;
+
+    /* the threads planning the monsters' moves hand in their counts
+       when they switch back after each monster */
+    for (counter_t c = 0; c < CNT_MAX; c++)
+    {
+        if (prev != NULL && counters[c] > 0)
+            g_atomic_int_add(&prev->pending[c], (gint)counters[c]);
+
+        counters[c] = 0;
+    }
+
+    selected = set;
+
+    return prev;
+}
+
+void counters_turn_end()
+{
+    counter_set *set = selected;
+
+    if (set == NULL)
+    {
+        memset(counters, 0, sizeof(counters));
+        return;
+    }
+
+    set->turns++;
+
+    for (counter_t c = 0; c < CNT_MAX; c++)
+    {
+        /* other threads may add to the pending counts meanwhile */
+        const gint pending = g_atomic_int_get(&set->pending[c]);
+        const guint64 count = counters[c] + (guint)pending;
+
+        g_atomic_int_add(&set->pending[c], -pending);
+
+        set->sum[c] += count;
+        set->buckets[c][counter_bucket(count)]++;
+
+        if (count > set->max[c])
+            set->max[c] = count;
+
+        set->last[c] = count;
+        counters[c] = 0;
+    }
+}
+
+guint64 counters_last(counter_t c)
+{
+    g_assert(c < CNT_MAX);
+    return (selected != NULL) ? selected->last[c] : 0;
+}
+
+const char *counter_desc(counter_t c)
+{
+    g_assert(c < CNT_MAX);
+    return counter_descs[c];
+}
+
+void counters_dump(message_log *log)
+{
+    counter_set *set = selected;
+
+    g_assert(log != NULL);
+
+#ifdef NO_COUNTERS
+    log_add_entry(log, "The counters have been disabled at compile time.");
+    return;
+#endif
+
+    if (set == NULL || set->turns == 0)
+    {
+        log_add_entry(log, "No turns have been counted yet.");
+        return;
+    }
+
+    log_add_entry(log, "Counts per turn over %u turns:", set->turns);
+
+    for (counter_t c = 0; c < CNT_MAX; c++)
+    {
+        /* omit things that did not happen at all */
+        if (set->max[c] == 0)
+            continue;
+
+        GString *desc = g_string_new(NULL);
+
+        g_string_append_printf(desc, "%s: mean %.1f, max %" G_GUINT64_FORMAT " (",
+                counter_descs[c], (double)set->sum[c] / set->turns, set->max[c]);
+
+        gboolean first = TRUE;
+        for (guint b = 0; b < COUNTER_BUCKETS; b++)
+        {
+            if (set->buckets[c][b] == 0)
+                continue;
+
+            if (!first)
+                g_string_append(desc, ", ");
+
+            if (b < 2)
+                g_string_append_printf(desc, "%u", b);
+            else if (b == COUNTER_BUCKETS - 1)
+                g_string_append_printf(desc, "%u+", 1U << (b - 1));
+            else
+                g_string_append_printf(desc, "%u-%u", 1U << (b - 1), (1U << b) - 1);
+
+            g_string_append_printf(desc, ": %u", set->buckets[c][b]);
+            first = FALSE;
+        }
+
+        g_string_append(desc, ").");
+        log_add_entry(log, "%s", desc->str);
+        g_string_free(desc, TRUE);
+    }
+
+    /* start over */
+    set->turns = 0;
+    memset(set->sum, 0, sizeof(set->sum));
+    memset(set->max, 0, sizeof(set->max));
+    memset(set->buckets, 0, sizeof(set->buckets));
+}
@@ -21,11 +21,14 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include "counters.h"
 #include "display.h"
 #include "fov.h"
+#include "journal.h"
 #include "map.h"
 #include "nlarn.h"
 #include "spheres.h"
+#include "trace.h"
 
 typedef struct _display_colset
 {
@@ -85,6 +88,25 @@ static gboolean display_initialised = FALSE;
 /* linked list of opened windows */
 static GList *windows = NULL;
 
+/* The part of the level shown on the screen: levels larger than the
+   classic size scroll to keep the player or the cursor in view. */
+#define VIEW_MARGIN_X 12
+#define VIEW_MARGIN_Y 4
+
+static int view_x = 0;
+static int view_y = 0;
+
+/* the position to keep in view instead of the player's while
+   display_get_position() is running */
+static position view_focus;
+static gboolean view_focused = FALSE;
+
+/* TRUE if painting the screen has been put off as keys were typed ahead */
+static gboolean paint_pending = FALSE;
+
+/* a window never shown, used to look for keys without refreshing */
+static WINDOW *typeahead_probe = NULL;
+
 static int mvwcprintw(WINDOW *win, int defattr, int currattr,
         const display_colset *colset, int y, int x, const char *fmt, ...);
 
@@ -105,6 +127,28 @@ static display_window *display_item_details(guint x1, guint y1, guint width,
                                             item *it, player *p, gboolean shop);
 
 static void display_spheres_paint(sphere *s, player *p);
+static void display_counters_paint();
+static void display_setup();
+
+/* draw to a file, or to nowhere if it is NULL, and read no keys */
+static void display_open_file(FILE *out)
+{
+#ifdef G_OS_WIN32
+    const char *nowhere = "NUL";
+#else
+    const char *nowhere = "/dev/null";
+#endif
+    FILE *in = fopen(nowhere, "r");
+
+    if (out == NULL)
+        out = fopen(nowhere, "w");
+
+    if (!out || !in || (!newterm(NULL, out, in) && !newterm("vt100", out, in)))
+    {
+        g_printerr("Could not initialise the display for replaying.\n");
+        exit(EXIT_FAILURE);
+    }
+}
 
 void display_init()
 {
@@ -133,9 +177,32 @@ void display_init()
     g_free(font_name);
 #endif
 
-    /* Start curses mode */
-    initscr();
+    if (journal_replaying())
+    {
+        /* replays are not shown */
+        display_open_file(NULL);
+    }
+    else
+    {
+        /* Start curses mode */
+        initscr();
+    }
+
+    display_setup();
+}
+
+void display_init_file(FILE *out)
+{
+#ifdef NCURSES_VERSION
+    set_escdelay(0);
+#endif
+
+    display_open_file(out);
+    display_setup();
+}
 
+static void display_setup()
+{
 #ifdef SDLPDCURSES
     /* These initialisations have to be done after initscr(), otherwise
        the window is not yet available. */
@@ -189,6 +256,11 @@ void display_init()
     /* make cursor invisible */
     curs_set(0);
 
+    /* pads are not refreshed when reading keys */
+    typeahead_probe = newpad(1, 1);
+    keypad(typeahead_probe, TRUE);
+    nodelay(typeahead_probe, TRUE);
+
     /* update display initialisation status */
     display_initialised = TRUE;
 }
@@ -237,12 +309,48 @@ static int attr_colour(int colour, int reverse)
     mvwhline(win, y, x, ch, n); \
     wattroff(win, attrs)
 
+/* scroll the view if a position comes too close to its edges */
+static void display_view_follow(map *vmap, position pos)
+{
+    if (X(pos) < view_x + VIEW_MARGIN_X)
+        view_x = X(pos) - VIEW_MARGIN_X;
+    else if (X(pos) >= view_x + MAP_MAX_X - VIEW_MARGIN_X)
+        view_x = X(pos) - MAP_MAX_X + VIEW_MARGIN_X + 1;
+
+    if (Y(pos) < view_y + VIEW_MARGIN_Y)
+        view_y = Y(pos) - VIEW_MARGIN_Y;
+    else if (Y(pos) >= view_y + MAP_MAX_Y - VIEW_MARGIN_Y)
+        view_y = Y(pos) - MAP_MAX_Y + VIEW_MARGIN_Y + 1;
+
+    /* never show anything beyond the level */
+    view_x = max(0, min(view_x, vmap->width - MAP_MAX_X));
+    view_y = max(0, min(view_y, vmap->height - MAP_MAX_Y));
+}
+
+gboolean display_map_move(position pos)
+{
+    const int x = X(pos) - view_x;
+    const int y = Y(pos) - view_y;
+
+    if (x < 0 || x >= MAP_MAX_X || y < 0 || y >= MAP_MAX_Y)
+        return FALSE;
+
+    move(y, x);
+
+    return TRUE;
+}
+
 void display_paint_screen(player *p)
 {
     position pos = pos_invalid;
     map *vmap;
     int attrs;              /* curses attributes */
 
+    counter_clock_start(started);
+    gint64 span = trace_begin();
+
+    paint_pending = FALSE;
+
     /* draw line around map */
     (void)mvhline(MAP_MAX_Y, 0, ACS_HLINE, MAP_MAX_X);
     (void)mvvline(0, MAP_MAX_X, ACS_VLINE, MAP_MAX_Y);
@@ -251,14 +359,17 @@ void display_paint_screen(player *p)
     /* make shortcut to the visible map */
     vmap = game_map(nlarn, Z(p->pos));
 
+    /* only the part of the map in view is drawn */
+    display_view_follow(vmap, view_focused ? view_focus : p->pos);
+
     /* draw map */
     Z(pos) = Z(p->pos);
-    for (Y(pos) = 0; Y(pos) < MAP_MAX_Y; Y(pos)++)
+    for (Y(pos) = view_y; Y(pos) < view_y + MAP_MAX_Y; Y(pos)++)
     {
         /* position cursor */
-        move(Y(pos), 0);
+        move(Y(pos) - view_y, 0);
 
-        for (X(pos) = 0; X(pos) < MAP_MAX_X; X(pos)++)
+        for (X(pos) = view_x; X(pos) < view_x + MAP_MAX_X; X(pos)++)
         {
             if (game_fullvis(nlarn) || fov_get(p->fv, pos))
             {
@@ -363,12 +474,12 @@ void display_paint_screen(player *p)
                 continue;
             }
 
-            if (game_fullvis(nlarn)
+            if ((game_fullvis(nlarn)
                     || player_effect(p, ET_DETECT_MONSTER)
                     || monster_in_sight(monst))
+                    && display_map_move(monster_pos(monst)))
             {
-                position mpos = monster_pos(monst);
-                mvaaddch(Y(mpos), X(mpos), monster_color(monst), monster_glyph(monst));
+                aaddch(monster_color(monst), monster_glyph(monst));
             }
         }
     }
@@ -389,8 +500,12 @@ void display_paint_screen(player *p)
         attrs = WHITE;
     }
 
-    mvaaddch(Y(p->pos), X(p->pos), attrs, pc);
+    if (display_map_move(p->pos))
+        aaddch(attrs, pc);
 
+    /* counters of the last turn in wizard mode */
+    if (game_wizardmode(nlarn) && game_profiler(nlarn))
+        display_counters_paint();
 
     /* *** first status line below map *** */
     move(MAP_MAX_Y + 1, 0);
@@ -589,7 +704,7 @@ void display_paint_screen(player *p)
             }
 
             if ((e->type == ET_WALL_WALK || e->type == ET_LEVITATION)
-                    && e->turns < 6)
+                    && effect_turns(e) < 6)
             {
                 /* fading effects */
                 gchar *cdesc = g_strdup_printf("`lightred`%s`end`", desc);
@@ -689,6 +804,52 @@ void display_paint_screen(player *p)
     text_destroy(text);
 
     display_draw();
+
+    counter_clock_stop(CNT_PAINT_TIME, started);
+    trace_end("display_paint_screen", span, -1);
+}
+
+/* TRUE if keys have been typed ahead, which are left to be read */
+static gboolean display_typeahead()
+{
+    /* the keys recovered or replayed are known in advance */
+    if (journal_key_pending())
+        return TRUE;
+
+    if (journal_replaying() || typeahead_probe == NULL)
+        return FALSE;
+
+    const int ch = wgetch(typeahead_probe);
+
+    if (ch == ERR)
+        return FALSE;
+
+    ungetch(ch);
+    return TRUE;
+}
+
+void display_repaint(player *p)
+{
+    if (display_typeahead())
+        paint_pending = TRUE;
+    else
+        display_paint_screen(p);
+}
+
+/* paint the screen if it has been put off, returns TRUE if painted */
+static gboolean display_paint_pending()
+{
+    if (!paint_pending)
+        return FALSE;
+
+    paint_pending = FALSE;
+
+    if (nlarn == NULL || nlarn->p == NULL)
+        return FALSE;
+
+    display_paint_screen(nlarn->p);
+
+    return TRUE;
 }
 
 void display_shutdown()
@@ -729,14 +890,14 @@ void display_draw()
     doupdate();
 }
 
-static int item_sort_normal(gconstpointer a, gconstpointer b, gpointer data)
+static gchar *item_sort_key_normal(item *it, gpointer data)
 {
-    return item_sort(a, b, data, FALSE);
+    return item_sort_key(it, (player *)data, FALSE);
 }
 
-static int item_sort_shop(gconstpointer a, gconstpointer b, gpointer data)
+static gchar *item_sort_key_shop(item *it, gpointer data)
 {
-    return item_sort(a, b, data, TRUE);
+    return item_sort_key(it, (player *)data, TRUE);
 }
 
 item *display_inventory(const char *title, player *p, inventory **inv,
@@ -780,9 +941,9 @@ item *display_inventory(const char *title, player *p, inventory **inv,
 
     /* sort inventory by item type */
     if (show_price)
-        inv_sort(*inv, (GCompareDataFunc)item_sort_shop, (gpointer)p);
+        inv_sort_by_key(*inv, item_sort_key_shop, (gpointer)p);
     else
-        inv_sort(*inv, (GCompareDataFunc)item_sort_normal, (gpointer)p);
+        inv_sort_by_key(*inv, item_sort_key_normal, (gpointer)p);
 
     /* store inventory length */
     len_orig = len_curr = inv_length_filtered(*inv, ifilter);
@@ -824,9 +985,9 @@ item *display_inventory(const char *title, player *p, inventory **inv,
             {
                 /* inventory has grown - sort inventory again */
                 if (show_price)
-                    inv_sort(*inv, (GCompareDataFunc)item_sort_shop, (gpointer)p);
+                    inv_sort_by_key(*inv, item_sort_key_shop, (gpointer)p);
                 else
-                    inv_sort(*inv, (GCompareDataFunc)item_sort_normal, (gpointer)p);
+                    inv_sort_by_key(*inv, item_sort_key_normal, (gpointer)p);
             }
         }
 
@@ -2343,8 +2504,12 @@ position display_get_new_position(player *p,
             }
         } /* visible */
 
-        /* redraw screen to erase previous modifications */
+        /* redraw screen to erase previous modifications, keeping the
+           cursor in view */
+        view_focus = pos;
+        view_focused = TRUE;
         display_paint_screen(p);
+        view_focused = FALSE;
 
         /* reset npos to an invalid position */
         position npos = pos_invalid;
@@ -2386,18 +2551,21 @@ position display_get_new_position(player *p,
                     && monster_in_sight(target))
                 {
                     /* ray is targeted at a visible monster */
-                    mvaaddch(Y(tpos), X(tpos), attrs, monster_glyph(target));
+                    if (display_map_move(tpos))
+                        aaddch(attrs, monster_glyph(target));
                 }
                 else if ((m = map_get_monster_at(vmap, tpos))
                          && monster_in_sight(m))
                 {
                     /* ray sweeps over a visible monster */
-                    mvaaddch(Y(tpos), X(tpos), attrs, monster_glyph(m));
+                    if (display_map_move(tpos))
+                        aaddch(attrs, monster_glyph(m));
                 }
                 else
                 {
                     /* a position with no or an invisible monster on it */
-                    mvaaddch(Y(tpos), X(tpos), attrs, '*');
+                    if (display_map_move(tpos))
+                        aaddch(attrs, '*');
                 }
             } while ((iter = iter->next));
 
@@ -2415,10 +2583,8 @@ position display_get_new_position(player *p,
             {
                 for (X(cursor) = b->start_x; X(cursor) < b->start_x + b->size_x; X(cursor)++)
                 {
-                    if (area_pos_get(b, cursor))
+                    if (area_pos_get(b, cursor) && display_map_move(cursor))
                     {
-                        move(Y(cursor), X(cursor));
-
                         if ((m = map_get_monster_at(vmap, cursor)) && monster_in_sight(m))
                         {
                             aaddch(monster_color(m) == RED ? LIGHTRED : RED, monster_glyph(m));
@@ -2439,7 +2605,8 @@ position display_get_new_position(player *p,
         else
         {
             /* show the position of the cursor by inverting the attributes */
-            (void)mvwchgat(stdscr, Y(pos), X(pos), 1, A_BOLD | A_STANDOUT, DCP_WHITE_BLACK, NULL);
+            (void)mvwchgat(stdscr, Y(pos) - view_y, X(pos) - view_x, 1,
+                           A_BOLD | A_STANDOUT, DCP_WHITE_BLACK, NULL);
         }
 
         /* wait for input */
@@ -2583,10 +2750,10 @@ position display_get_new_position(player *p,
                     position origin = pos;
                     while (TRUE)
                     {
-                        if (++X(pos) >= MAP_MAX_X)
+                        if (++X(pos) >= vmap->width)
                         {
                             X(pos) = 0;
-                            if (++Y(pos) >= MAP_MAX_Y)
+                            if (++Y(pos) >= vmap->height)
                                 Y(pos) = 0;
                         }
                         if (pos_identical(origin, pos))
@@ -2668,54 +2835,67 @@ position display_get_new_position(player *p,
     return pos;
 }
 
-void display_show_history(message_log *log, const char *title)
+/* Number of columns required for
+     a) the window border and the text padding
+     b) the margin around the window
+   of the windows showing a message */
+static const guint message_margin = 4;
+
+static int display_show_text(const char *title, GPtrArray *text);
+
+/* the number of characters of the current game time */
+static int display_history_twidth()
 {
-    GString *text = g_string_new(NULL);
     char intrep[11] = { 0 }; /* string representation of the game time */
-    int twidth; /* the number of characters of the current game time */
 
-    /* determine the width of the current game turn */
     g_snprintf(intrep, 10, "%d", nlarn->gtime);
-    twidth = strlen(intrep);
+
+    return strlen(intrep);
+}
+
+void display_show_history(message_log *log, const char *title)
+{
+    GPtrArray *text = g_ptr_array_new();
+
+    /* wrap the entries which have not been wrapped ahead */
+    log_wrap(log, COLS - 2 * message_margin, display_history_twidth(), 0);
 
     /* assemble reversed game log */
     for (guint idx = log_length(log); idx > 0; idx--)
     {
-        message_log_entry *le = log_get_entry(log, idx - 1);
-        g_string_append_printf(text, "%*d: %s\n", twidth, le->gtime, le->message);
+        GPtrArray *lines = log_get_entry(log, idx - 1)->wrapped;
+
+        for (guint line = 0; line < lines->len; line++)
+            g_ptr_array_add(text, g_strdup(g_ptr_array_index(lines, line)));
     }
 
     /* display the log */
-    display_show_message(title, text->str, twidth + 2);
-
-    /* free the assembled log */
-    g_string_free(text, TRUE);
+    display_show_text(title, text);
 }
 
 int display_show_message(const char *title, const char *message, int indent)
 {
-    int key;
+    /* wrap message according to the default width (minus border and padding) */
+    return display_show_text(title, text_wrap(message, COLS - 2 * message_margin, indent));
+}
 
-    /* Number of columns required for
-         a) the window border and the text padding
-         b) the margin around the window */
-    const guint wred = 4;
+/* show wrapped text in a window, which takes the text */
+static int display_show_text(const char *title, GPtrArray *text)
+{
+    int key;
 
     gboolean RUN = TRUE;
 
     /* default window width according to available screen space;
-       wred/2 chars margin on each side */
-    guint width = COLS - wred;
-
-    /* wrap message according to width (minus border and padding) */
-    GPtrArray *text = text_wrap(message, width - wred, indent);
+       message_margin/2 chars margin on each side */
+    guint width = COLS - message_margin;
 
     /* determine the length of longest text line */
     guint max_len = text_get_longest_line(text);
 
     /* shrink the window width if the default width is not required */
-    if (max_len + wred < width)
-        width = max_len + wred;
+    if (max_len + message_margin < width)
+        width = max_len + message_margin;
 
     /* set height according to message line count */
     guint height = min((LINES - 3), (text->len + 2));
@@ -2915,8 +3095,50 @@ void display_windows_show()
     }
 }
 
+/* Do a piece of the work that can be done ahead while waiting for a key.
+   Pieces take a millisecond or two at most, hence keys are not held up;
+   work which would take longer is not done ahead, see game_idle(). */
+static gboolean display_idle(guint step)
+{
+    if (nlarn == NULL || nlarn->p == NULL)
+        return FALSE;
+
+    /* the game's work first, as it is needed earlier */
+    if (game_idle(nlarn, step))
+        return TRUE;
+
+    return log_wrap(nlarn->log, COLS - 2 * message_margin,
+                    display_history_twidth(), 16);
+}
+
 int display_getch(WINDOW *win) {
-    int ch = wgetch(win ? win : stdscr);
+    int ch;
+    guint step = 0;
+
+    if (journal_key_next(&ch))
+        return ch;
+
+    if (win == NULL)
+        win = stdscr;
+
+    /* look for a key between the pieces of work and wait for one when
+       nothing is left to do; the keys typed ahead have been handled when
+       none is found, hence the screen put off is painted first */
+    wtimeout(win, 0);
+    while ((ch = wgetch(win)) == ERR)
+    {
+        if (display_paint_pending())
+            continue;
+
+        if (!display_idle(step))
+            break;
+
+        step++;
+    }
+    wtimeout(win, -1);
+
+    if (ch == ERR)
+        ch = wgetch(win);
 #ifdef SDLPDCURSES
         /* on SDL2 PDCurses, keys entered on the numeric keypad while num
            lock is enabled are returned twice. Hence we need to swallow
@@ -2924,12 +3146,20 @@ int display_getch(WINDOW *win) {
         if ((ch >= '1' && ch <= '9')
                 && (PDC_get_key_modifiers() & PDC_KEY_MODIFIER_NUMLOCK))
         {
-            ch = wgetch(win ? win : stdscr);
+            ch = wgetch(win);
         }
 #endif
+    journal_key_add(ch);
+
     return ch;
 }
 
+void display_sleep(int ms)
+{
+    if (!journal_replaying() && !journal_recovering())
+        napms(ms);
+}
+
 
 static int mvwcprintw(WINDOW *win, int defattr, int currattr,
         const display_colset *colset, int y, int x, const char *fmt, ...)
@@ -3304,8 +3534,42 @@ static void display_spheres_paint(sphere *s, player *p)
     if (!(Z(s->pos) == Z(p->pos)))
         return;
 
-    if (game_fullvis(nlarn) || fov_get(p->fv, s->pos))
+    if ((game_fullvis(nlarn) || fov_get(p->fv, s->pos))
+            && display_map_move(s->pos))
     {
-        mvaaddch(Y(s->pos), X(s->pos), MAGENTA, '0');
+        aaddch(MAGENTA, '0');
+    }
+}
+
+static void display_counters_paint()
+{
+    const char *labels[CNT_MAX] =
+    {
+        "path", "path nodes", "fov", "fov cells", "visible", "effects",
+        "items", "monsters", "paint", "save", "save time", "load", "load time",
+        "paged in", "paged out", "page time"
+    };
+
+    const int width = 22;
+
+    for (counter_t c = 0; c < CNT_MAX; c++)
+    {
+        const guint64 count = counters_last(c);
+        const gboolean is_time = (c == CNT_PAINT_TIME
+                || c == CNT_SAVE_TIME || c == CNT_LOAD_TIME
+                || c == CNT_PAGE_TIME);
+        gchar *value;
+
+        if (is_time && count >= 1000)
+            value = g_strdup_printf("%.1fms", count / 1000.0);
+        else if (is_time)
+            value = g_strdup_printf("%" G_GUINT64_FORMAT "us", count);
+        else
+            value = g_strdup_printf("%" G_GUINT64_FORMAT, count);
+
+        mvaprintw(c, MAP_MAX_X - width, (count > 0) ? LIGHTCYAN : DARKGRAY,
+                  " %-10s %9s ", labels[c], value);
+
+        g_free(value);
     }
 }
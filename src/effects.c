@@ -20,6 +20,7 @@
 #include <string.h>
 
 #include "cJSON.h"
+#include "counters.h"
 #include "effects.h"
 #include "game.h"
 #include "nlarn.h"
@@ -576,6 +577,11 @@ effect *effect_copy(effect *e)
     ne = g_malloc(sizeof(effect));
     memcpy(ne, e, sizeof(effect));
 
+    /* the copy is not attached to anyone yet */
+    ne->turns = effect_turns(e);
+    ne->expires = 0;
+    ne->owner = NULL;
+
     /* register copy with game */
     ne->oid = game_effect_register(nlarn, ne);
 
@@ -608,6 +614,16 @@ void effect_serialize(gpointer oid, effect *e, cJSON *root)
     {
         cJSON_AddNumberToObject(eval,"item", GPOINTER_TO_UINT(e->item));
     }
+
+    if (e->expires)
+    {
+        cJSON_AddNumberToObject(eval,"expires", e->expires);
+    }
+
+    if (e->owner)
+    {
+        cJSON_AddNumberToObject(eval,"owner", GPOINTER_TO_UINT(e->owner));
+    }
 }
 
 effect *effect_deserialize(cJSON *eser, game *g)
@@ -631,8 +647,19 @@ effect *effect_deserialize(cJSON *eser, game *g)
         e->item = GUINT_TO_POINTER(itm->valueint);
     }
 
+    if ((itm = cJSON_GetObjectItem(eser, "expires")))
+    {
+        e->expires = itm->valueint;
+    }
+
+    if ((itm = cJSON_GetObjectItem(eser, "owner")))
+    {
+        e->owner = GUINT_TO_POINTER(itm->valueint);
+    }
+
     /* add effect to game */
     g_hash_table_insert(g->effects, e->oid, e);
+    g->effect_types[e->type]++;
 
     /* increase max_id to match used ids */
     if (g->effect_max_id < oid)
@@ -750,7 +777,7 @@ effect *effect_add(GPtrArray *ea, effect *ne)
         /* if the effect's duration can be extended, reset it */
         if (effects[e->type].inc_duration)
         {
-            e->turns = max(e->turns, ne->turns);
+            effect_turns_set(e, max(effect_turns(e), ne->turns));
             modified_existing = TRUE;
         }
 
@@ -782,13 +809,27 @@ effect *effect_add(GPtrArray *ea, effect *ne)
 int effect_del(GPtrArray *ea, effect *e)
 {
     g_assert(ea != NULL && e != NULL);
-    return g_ptr_array_remove_fast(ea, e->oid);
+
+    if (!g_ptr_array_remove_fast(ea, e->oid))
+        return FALSE;
+
+    /* the effect's timers become void */
+    e->turns = effect_turns(e);
+    e->expires = 0;
+    e->owner = NULL;
+
+    return TRUE;
 }
 
 effect *effect_get(GPtrArray *ea, effect_t type)
 {
     g_assert(ea != NULL && type > ET_NONE && type < ET_MAX);
 
+    counter_inc(CNT_EFFECT_QUERY);
+
+    if (nlarn->effect_types[type] == 0)
+        return NULL;
+
     for (guint idx = 0; idx < ea->len; idx++)
     {
         gpointer effect_id = g_ptr_array_index(ea, idx);
@@ -810,6 +851,9 @@ int effect_query(GPtrArray *ea, effect_t type)
 
     g_assert(ea != NULL && type > ET_NONE && type < ET_MAX);
 
+    if (nlarn->effect_types[type] == 0)
+        return 0;
+
     for (guint idx = 0; idx < ea->len; idx++)
     {
         gpointer effect_id = g_ptr_array_index(ea, idx);
@@ -836,3 +880,78 @@ int effect_expire(effect *e)
 
     return e->turns;
 }
+
+/* effects which count the turns of the one affected */
+static gboolean effect_counts_turns(effect *e)
+{
+    return (e->type == ET_TIMESTOP || e->type == ET_TRAPPED);
+}
+
+static void effect_timers_add(effect *e)
+{
+    timewheel_add(nlarn->timers, e->expires, GT_EFFECT_END, e->oid);
+
+    /* the player is warned before critical effects end */
+    if (e->owner == NULL
+            && (e->type == ET_WALL_WALK || e->type == ET_LEVITATION)
+            && e->expires > game_turn(nlarn) + 5)
+    {
+        timewheel_add(nlarn->timers, e->expires - 5, GT_EFFECT_WARNING, e->oid);
+    }
+}
+
+void effect_schedule(effect *e, gpointer owner)
+{
+    g_assert(e != NULL);
+
+    if (e->expires || e->turns == 0 || effect_counts_turns(e))
+        return;
+
+    e->owner = owner;
+    e->expires = game_turn(nlarn) + e->turns;
+
+    effect_timers_add(e);
+}
+
+void effect_timers_restore(effect *e, gint32 turns)
+{
+    g_assert(e != NULL);
+
+    if (e->expires == 0)
+        return;
+
+    e->expires += turns;
+    effect_timers_add(e);
+}
+
+guint effect_turns(effect *e)
+{
+    g_assert(e != NULL);
+
+    if (e->expires == 0)
+        return e->turns;
+
+    /* an effect due this turn has not been removed yet */
+    return (e->expires > game_turn(nlarn)) ? e->expires - game_turn(nlarn) : 1;
+}
+
+void effect_turns_set(effect *e, guint turns)
+{
+    g_assert(e != NULL);
+
+    e->turns = turns;
+
+    if (e->expires == 0)
+        return;
+
+    /* timers registered before become void when the end changes */
+    if (turns == 0)
+    {
+        e->expires = 0;
+        e->owner = NULL;
+        return;
+    }
+
+    e->expires = game_turn(nlarn) + turns;
+    effect_timers_add(e);
+}
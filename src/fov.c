@@ -18,6 +18,7 @@
 
 #include <glib.h>
 #include <string.h>
+#include "counters.h"
 #include "fov.h"
 #include "game.h"
 #include "map.h"
@@ -33,8 +34,14 @@ static gint fov_visible_monster_sort(gconstpointer a, gconstpointer b, gpointer
 
 struct _fov
 {
-    /* the actual field of vision */
-    guchar data[MAP_MAX_Y][MAP_MAX_X];
+    /* the actual field of vision, as large as the map it has been
+       calculated for */
+    guchar *data;
+    int width, height;
+
+    /* the rectangle containing all visible positions, which is all
+       fov_reset() has to clear */
+    int x1, y1, x2, y2;
 
     /* the center of the fov */
     position center;
@@ -50,6 +57,8 @@ fov *fov_new()
     fov *nfov = g_malloc0(sizeof(fov));
     nfov->center = pos_invalid;
     nfov->mlist = g_hash_table_new(g_direct_hash, g_direct_equal);
+    nfov->x1 = nfov->y1 = G_MAXINT;
+    nfov->x2 = nfov->y2 = -1;
 
     return nfov;
 }
@@ -67,6 +76,8 @@ void fov_calculate(fov *fv, map *m, position pos, int radius, gboolean infravisi
         { 1,  0,  0,  1, -1,  0,  0, -1 }
     };
 
+    counter_inc(CNT_FOV_CALC);
+
     /* reset the entire fov to unseen */
     fov_reset(fv);
 
@@ -83,6 +94,7 @@ void fov_calculate(fov *fv, map *m, position pos, int radius, gboolean infravisi
     }
 
     fov_set(fv, pos, TRUE, infravision, TRUE);
+    counter_inc(CNT_FOV_CELLS);
 }
 
 gboolean fov_get(fov *fv, position pos)
@@ -90,7 +102,27 @@ gboolean fov_get(fov *fv, position pos)
     g_assert (fv != NULL);
     g_assert (pos_valid(pos));
 
-    return fv->data[Y(pos)][X(pos)];
+    if (X(pos) >= fv->width || Y(pos) >= fv->height)
+        return FALSE;
+
+    return fv->data[Y(pos) * fv->width + X(pos)];
+}
+
+rectangle fov_get_bounds(fov *fv)
+{
+    rectangle bounds = { 1, 1, 0, 0 };
+
+    g_assert (fv != NULL);
+
+    if (fv->x2 >= 0)
+    {
+        bounds.x1 = fv->x1;
+        bounds.y1 = fv->y1;
+        bounds.x2 = fv->x2;
+        bounds.y2 = fv->y2;
+    }
+
+    return bounds;
 }
 
 void fov_set(fov *fv, position pos, guchar visible,
@@ -99,12 +131,33 @@ void fov_set(fov *fv, position pos, guchar visible,
     g_assert (fv != NULL);
     g_assert (pos_valid(pos));
 
-    fv->data[Y(pos)][X(pos)] = visible;
+    map *m = game_map(nlarn, Z(pos));
+
+    /* the fov follows the dimensions of the map */
+    if (fv->width != m->width || fv->height != m->height)
+    {
+        g_free(fv->data);
+        fv->width = m->width;
+        fv->height = m->height;
+        fv->data = g_malloc0(fv->width * fv->height);
+        fv->x1 = fv->y1 = G_MAXINT;
+        fv->x2 = fv->y2 = -1;
+    }
+
+    fv->data[Y(pos) * fv->width + X(pos)] = visible;
     monster *mon;
 
+    if (visible)
+    {
+        fv->x1 = min(fv->x1, X(pos));
+        fv->y1 = min(fv->y1, Y(pos));
+        fv->x2 = max(fv->x2, X(pos));
+        fv->y2 = max(fv->y2, Y(pos));
+    }
+
     /* If advised to do so, check if there is a monster at that
        position. Must not be an unknown mimic or invisible. */
-    if (mchk && (mon = map_get_monster_at(game_map(nlarn, Z(pos)), pos))
+    if (mchk && (mon = map_get_monster_at(m, pos))
         && !monster_unknown(mon)
         && (!monster_flags(mon, INVISIBLE) || infravision))
     {
@@ -117,8 +170,12 @@ void fov_reset(fov *fv)
 {
     g_assert (fv != NULL);
 
-    /* set fov_data to FALSE */
-    memset(fv->data, 0, MAP_MAX_Y * MAP_MAX_X * sizeof(guchar));
+    /* set fov_data to FALSE where something has been visible */
+    for (int y = fv->y1; y <= fv->y2; y++)
+        memset(&fv->data[y * fv->width + fv->x1], 0, fv->x2 - fv->x1 + 1);
+
+    fv->x1 = fv->y1 = G_MAXINT;
+    fv->x2 = fv->y2 = -1;
 
     /* set the center to an invalid position */
     fv->center = pos_invalid;
@@ -174,6 +231,7 @@ void fov_free(fov *fv)
 
     /* free the allocated memory */
     g_hash_table_destroy(fv->mlist);
+    g_free(fv->data);
     g_free(fv);
 }
 
@@ -208,10 +266,10 @@ static void fov_calculate_octant(fov *fv, map *m, position center,
             Y = Y(center) + dx * yx + dy * yy;
 
             /* check if coordinated are within bounds */
-            if ((X < 0) || (X >= MAP_MAX_X))
+            if ((X < 0) || (X >= m->width))
                 continue;
 
-            if ((Y < 0) || (Y >= MAP_MAX_Y))
+            if ((Y < 0) || (Y >= m->height))
                 continue;
 
             /* l_slope and r_slope store the slopes of the left and right
@@ -235,6 +293,7 @@ static void fov_calculate_octant(fov *fv, map *m, position center,
                 if ((dx * dx + dy * dy) < radius_squared)
                 {
                     fov_set(fv, pos, TRUE, infravision, TRUE);
+                    counter_inc(CNT_FOV_CELLS);
                 }
 
                 if (blocked)
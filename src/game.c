@@ -26,11 +26,11 @@
 #include <glib.h>
 #include <stdlib.h>
 #include <string.h>
-#include <zlib.h>
 #include <glib/gstdio.h>
 
 #if (defined __unix) || (defined __unix__) || (defined __APPLE__)
 # include <sys/file.h>
+# include <unistd.h>
 #endif
 
 #ifdef WIN32
@@ -39,21 +39,74 @@
 #endif
 
 #include "cJSON.h"
+#include "codec.h"
 #include "config.h"
+#include "counters.h"
 #include "display.h"
 #include "game.h"
+#include "journal.h"
 #include "nlarn.h"
 #include "player.h"
 #include "spheres.h"
 #include "random.h"
+#include "trace.h"
 
-static void game_new();
+static void game_new(guint32 seed);
 static gboolean game_load();
 static void game_items_shuffle(game *g);
+static void game_maps_layout_start(game *g);
+static void game_maps_layout_stop(game *g);
+static void game_timers_periodic(game *g);
+static void game_timers_fire(game *g);
+static void game_save_chunks_free(game *g);
+static GPtrArray *game_monsters_plan(game *g);
+static void game_monsters_plan_end(game *g, GPtrArray *due);
+static void game_monsters_plan_stop(game *g);
+static void game_level_page_lost(guint nmap);
+static void game_level_page_in(game *g, guint nmap);
+static cJSON *game_level_page_part(game *g, guint nmap, guint part);
 
 /* file descriptor for locking the savegame file */
 static int sgfd = 0;
 
+/* the game selected for the current thread */
+#ifdef _MSC_VER
+__declspec(thread) game *nlarn = NULL;
+#else
+__thread game *nlarn = NULL;
+#endif
+
+/* a paged level consists of its chunks of the save file and the objects
+   on the level, see game_level_page_out() */
+#define PAGE_OBJECTS SAVE_CHUNKS
+#define PAGE_PARTS   (SAVE_CHUNKS + 1)
+
+/* levels laid out by worker threads while the game is running */
+typedef enum level_job_state
+{
+    LJ_QUEUED,
+    LJ_RUNNING,
+    LJ_DONE,
+    LJ_CANCELLED
+} level_job_state;
+
+typedef struct level_job
+{
+    guint nmap;
+    gint maze;
+    int width, height, levels;
+    rand_ctx ctx;
+    map *layout;                /* NULL if the maze keeps failing */
+    gboolean ran;               /* a worker has laid out the level */
+    level_job_state state;
+    GMutex mutex;
+    GCond done;
+} level_job;
+
+/* the number of levels below a level just generated which are laid out
+   ahead, see game_maps_layout_near() */
+#define LAYOUT_AHEAD 2
+
 static void print_welcome_message(gboolean newgame)
 {
     log_add_entry(nlarn->log, "Welcome %sto NLarn %s!",
@@ -64,7 +117,7 @@ static void print_welcome_message(gboolean newgame)
 static int try_locking_savegame_file(FILE *sg)
 {
     /*
-     * get a copy of the file descriptor for locking - gzclose would close
+     * get a copy of the file descriptor for locking - fclose would close
      * it and thus unlock the file.
      */
     int fd = dup(fileno(sg));
@@ -89,53 +142,97 @@ static int try_locking_savegame_file(FILE *sg)
     return fd;
 }
 
-void game_init(struct game_config *config)
+/* allocate what is kept for every level */
+static void game_levels_alloc(game *g)
 {
-    /* allocate space for game structure */
-    nlarn = g_malloc0(sizeof(game));
+    g->maps = g_new0(map *, g->levels);
+    g->level_jobs = g_new0(level_job *, g->levels);
+    g->level_warp = g_new0(gint32, g->levels);
 
-    /* set autosave setting (default: TRUE) */
-    game_autosave(nlarn) = !config->no_autosave;
+    for (int type = 0; type < SAVE_CHUNKS; type++)
+        g->save_chunks[type] = g_new0(GBytes *, g->levels);
+}
 
-    if (!game_load())
+static void game_levels_free(game *g)
+{
+    g_free(g->maps);
+    g_free(g->level_jobs);
+    g_free(g->level_warp);
+
+    for (int type = 0; type < SAVE_CHUNKS; type++)
+        g_free(g->save_chunks[type]);
+}
+
+/* set up a new game from the settings */
+static void game_start(struct game_config *config, guint32 seed)
+{
+    /* set game parameters */
+    game_difficulty(nlarn) = config->difficulty;
+    game_wizardmode(nlarn) = config->wizard;
+
+    /* the dimensions of the levels; 0 for the classic ones */
+    nlarn->map_width = config->map_width ? config->map_width : MAP_MAX_X;
+    nlarn->map_height = config->map_height ? config->map_height : MAP_MAX_Y;
+
+    /* the town, the caverns down to the deepest level and the volcano */
+    nlarn->levels = (config->depth ? config->depth + 1 : MAP_CMAX) + MAP_VMAX;
+    game_levels_alloc(nlarn);
+    game_use(nlarn);
+
+    game_new(seed);
+
+    /* put the player into the town */
+    player_map_enter(nlarn->p, game_map(nlarn, 0), FALSE);
+
+    /* give player knowledge of the town */
+    scroll_mapping(nlarn->p, NULL);
+
+    if (config->name && strlen(config->name) > 0)
     {
-        /* set game parameters */
-        game_difficulty(nlarn) = config->difficulty;
-        game_wizardmode(nlarn) = config->wizard;
+        nlarn->p->name = g_strdup(config->name);
+    }
 
-        /* restoring a save game failed - start a new game. */
-        game_new();
+    if (config->gender)
+    {
+        nlarn->p->sex = parse_gender(config->gender[0]);
+    }
 
-        /* put the player into the town */
-        player_map_enter(nlarn->p, game_map(nlarn, 0), FALSE);
+    if (config->stats && strlen(config->stats) > 0)
+    {
+        config->stats[0] = g_ascii_tolower(config->stats[0]);
+        nlarn->player_stats_set = player_assign_bonus_stats(
+                nlarn->p, config->stats[0]);
+    }
 
-        /* give player knowledge of the town */
-        scroll_mapping(nlarn->p, NULL);
 
-        if (config->name && strlen(config->name) > 0)
-        {
-            nlarn->p->name = g_strdup(config->name);
-        }
+    if (config->wizard)
+    {
+        log_add_entry(nlarn->log, "Wizard mode has been activated. "
+                      "The game's seed is %u.", nlarn->seed);
+    }
+}
 
-        if (config->gender)
-        {
-            nlarn->p->sex = parse_gender(config->gender[0]);
-        }
+/* settings applying to new and restored games */
+static void game_settings_apply(struct game_config *config)
+{
+    /* prepare the levels that have not been entered yet */
+    game_maps_layout_start(nlarn);
 
-        if (config->stats && strlen(config->stats) > 0)
-        {
-            config->stats[0] = g_ascii_tolower(config->stats[0]);
-            nlarn->player_stats_set = player_assign_bonus_stats(
-                    nlarn->p, config->stats[0]);
-        }
+    /* plan the monsters' moves on all processors */
+    nlarn->planners = g_get_num_processors();
 
+    /* page out the levels away from the player; all levels stay in memory
+       if there is no place for a temporary file */
+    if (config->resident_levels > 0 && nlarn->level_store == NULL)
+    {
+        nlarn->resident_levels = config->resident_levels;
+        nlarn->level_store = level_store_new(nlarn->levels);
 
-        if (config->wizard)
-        {
-            log_add_entry(nlarn->log, "Wizard mode has been activated.");
-        }
+        if (nlarn->level_store == NULL)
+            log_add_entry(nlarn->log, "Cannot create a file for the levels.");
 
-    } /* end new game only settings */
+        game_levels_page(nlarn);
+    }
 
     /* parse auto pick-up settings */
     if (config->auto_pickup)
@@ -145,22 +242,97 @@ void game_init(struct game_config *config)
     }
 }
 
+void game_init(struct game_config *config)
+{
+    /* allocate space for game structure */
+    game_use(g_malloc0(sizeof(game)));
+
+    /* set autosave setting (default: TRUE) */
+    game_autosave(nlarn) = !config->no_autosave;
+
+    /* the journal is kept for this game only */
+    nlarn->journaled = TRUE;
+
+    if (!game_load())
+    {
+        /* restoring a save game failed - start a new game. */
+        game_start(config, journal_seed(config->seed ? (guint32)config->seed
+                                                     : rand_seed_new()));
+    }
+
+    game_settings_apply(config);
+}
+
+game *game_create(struct game_config *config)
+{
+    game *g = g_malloc0(sizeof(game));
+
+    game_use(g);
+    game_autosave(g) = !config->no_autosave;
+    game_start(config, config->seed ? (guint32)config->seed : rand_seed_new());
+    game_settings_apply(config);
+
+    return g;
+}
+
+game *game_use(game *g)
+{
+    game *prev = nlarn;
+
+    nlarn = g;
+    rand_state_use((g != NULL) ? &g->rng : NULL);
+    counters_use((g != NULL) ? &g->counts : NULL);
+
+    /* games which are set up have the dimensions of their levels */
+    if (g != NULL && g->map_width > 0)
+        pos_bounds_use(g->map_width, g->map_height, g->levels);
+    else
+        pos_bounds_use(MAP_MAX_X, MAP_MAX_Y, MAP_MAX);
+
+    return prev;
+}
+
 game *game_destroy(game *g)
 {
     g_assert(g != NULL);
 
+    /* wait for the level generation workers */
+    game_maps_layout_stop(g);
+    game_monsters_plan_stop(g);
+
+    if (g->journaled)
+    {
+        /* the outcome of a recorded or replayed game */
+        if (journal_active() && g->p != NULL)
+            journal_game_end(g);
+
+        /* keep the keys pressed since the last save for a recovery */
+        journal_wal_close(FALSE);
+    }
+
+    /* the next game starts with a save file of its own */
+    game_save_chunks_free(g);
+
+    /* the paged levels are destroyed with the file */
+    if (g->level_store != NULL)
+        level_store_destroy(g->level_store);
+
     /* everything must go */
-    for (int i = 0; i < MAP_MAX; i++)
+    for (int i = 0; i < g->levels; i++)
     {
         if (g->maps[i] == NULL)
         {
             /* killed early during game initialisation */
+            if (nlarn == g) game_use(NULL);
+            game_levels_free(g);
             g_free(g);
             return NULL;
         }
         map_destroy(g->maps[i]);
     }
 
+    game_levels_free(g);
+
     player_destroy(g->p);
     log_destroy(g->log);
 
@@ -175,24 +347,23 @@ game *game_destroy(game *g)
     g_hash_table_destroy(g->monsters);
     g_ptr_array_free(g->dead_monsters, TRUE);
 
+    if (g->item_descs)
+        g_hash_table_destroy(g->item_descs);
+
     g_ptr_array_foreach(g->spheres, (GFunc)sphere_destroy, g);
     g_ptr_array_free(g->spheres, TRUE);
+    timewheel_destroy(g->timers);
+    scheduler_destroy(g->actors);
+
+    if (nlarn == g) game_use(NULL);
     g_free(g);
 
     return NULL;
 }
 
-int game_save(game *g)
+static cJSON *game_serialize(game *g, gboolean levels)
 {
-    int err;
     struct cJSON *save, *obj;
-    display_window *win = NULL;
-
-    g_assert(g != NULL);
-
-    /* if the display has been initialised, show a pop-up message */
-    if (display_available())
-        win = display_popup(2, 2, 0, NULL, "Saving....", 0);
 
     save = cJSON_CreateObject();
 
@@ -200,13 +371,38 @@ int game_save(game *g)
     cJSON_AddNumberToObject(save, "time_start", g->time_start);
     cJSON_AddNumberToObject(save, "gtime", g->gtime);
     cJSON_AddNumberToObject(save, "difficulty", g->difficulty);
-    cJSON_AddItemToObject(save, "rng_state", rand_serialize());
 
-    /* maps */
-    cJSON_AddItemToObject(save, "maps", obj = cJSON_CreateArray());
-    for (int idx = 0; idx < MAP_MAX; idx++)
+    if (g->map_width != MAP_MAX_X || g->map_height != MAP_MAX_Y)
+    {
+        cJSON_AddNumberToObject(save, "map_width", g->map_width);
+        cJSON_AddNumberToObject(save, "map_height", g->map_height);
+    }
+
+    if (g->levels != MAP_MAX)
+        cJSON_AddNumberToObject(save, "levels", g->levels);
+    cJSON_AddNumberToObject(save, "seed", g->seed);
+    cJSON_AddItemToObject(save, "rng_state", rand_serialize(&g->rng));
+    cJSON_AddItemToObject(save, "timers", timewheel_serialize(g->timers));
+    cJSON_AddItemToObject(save, "actors", scheduler_serialize(g->actors));
+
+    /* maps and the player's memory of them */
+    if (levels)
     {
-        cJSON_AddItemToArray(obj, map_serialize(g->maps[idx]));
+        cJSON_AddItemToObject(save, "maps", obj = cJSON_CreateArray());
+        for (int idx = 0; idx < g->levels; idx++)
+        {
+            cJSON_AddItemToArray(obj, g->maps[idx]->paged
+                                 ? game_level_page_part(g, idx, SAVE_MAP)
+                                 : map_serialize(g->maps[idx]));
+        }
+
+        cJSON_AddItemToObject(save, "memory", obj = cJSON_CreateArray());
+        for (int idx = 0; idx < g->levels; idx++)
+        {
+            cJSON_AddItemToArray(obj, g->maps[idx]->paged
+                                 ? game_level_page_part(g, idx, SAVE_MEMORY)
+                                 : player_level_memory_serialize(g->p, idx));
+        }
     }
 
     cJSON_AddItemToObject(save, "amulet_created",
@@ -235,124 +431,940 @@ int game_save(game *g)
     cJSON_AddItemToObject(save, "book_desc_mapping",
                           cJSON_CreateIntArray(g->book_desc_mapping, SP_MAX));
 
-    cJSON_AddItemToObject(save, "monster_genocided",
-                          cJSON_CreateIntArray(g->monster_genocided, MT_MAX));
+    cJSON_AddItemToObject(save, "monster_genocided",
+                          cJSON_CreateIntArray(g->monster_genocided, MT_MAX));
+
+    if (g->wizard) cJSON_AddTrueToObject(save, "wizard");
+    if (g->fullvis) cJSON_AddTrueToObject(save, "fullvis");
+
+    /* store stock */
+    if (inv_length(g->store_stock) > 0)
+    {
+        cJSON_AddItemToObject(save, "store_stock", inv_serialize(g->store_stock));
+    }
+
+    /* monastery stock */
+    if (inv_length(g->monastery_stock) > 0)
+    {
+        cJSON_AddItemToObject(save, "monastery_stock", inv_serialize(g->monastery_stock));
+    }
+
+    /* storage at player's home */
+    if (inv_length(g->player_home) > 0)
+    {
+        cJSON_AddItemToObject(save, "player_home", inv_serialize(g->player_home));
+    }
+
+    /* log */
+    cJSON_AddItemToObject(save, "log", log_serialize(g->log));
+
+    /* add player */
+    cJSON_AddItemToObject(save, "player",  player_serialize(g->p));
+
+    /* add items */
+    cJSON_AddItemToObject(save, "items", obj = cJSON_CreateArray());
+    g_hash_table_foreach(g->items, item_serialize, obj);
+
+    /* add effects */
+    cJSON_AddItemToObject(save, "effects", obj = cJSON_CreateArray());
+    g_hash_table_foreach(g->effects, (GHFunc)effect_serialize, obj);
+
+    /* add monsters */
+    cJSON_AddItemToObject(save, "monsters", obj = cJSON_CreateArray());
+    g_hash_table_foreach(g->monsters, (GHFunc)monster_serialize, obj);
+
+    /* add the objects on the paged levels, which are not registered */
+    for (guint nmap = 0; nmap < g->levels; nmap++)
+    {
+        if (!g->maps[nmap]->paged)
+            continue;
+
+        static const char *arrays[] = { "items", "effects", "monsters" };
+        cJSON *objs = game_level_page_part(g, nmap, PAGE_OBJECTS);
+
+        for (guint idx = 0; idx < G_N_ELEMENTS(arrays); idx++)
+        {
+            cJSON *from = cJSON_GetObjectItem(objs, arrays[idx]);
+            cJSON *to = cJSON_GetObjectItem(save, arrays[idx]);
+
+            while (from->child != NULL)
+                cJSON_AddItemToArray(to, cJSON_DetachItemFromArray(from, 0));
+        }
+
+        cJSON_Delete(objs);
+    }
+
+    /* add spheres */
+    if (g->spheres->len > 0)
+    {
+        cJSON_AddItemToObject(save, "spheres", obj = cJSON_CreateArray());
+        g_ptr_array_foreach(g->spheres, (GFunc)sphere_serialize, obj);
+    }
+
+    return save;
+}
+
+/* compress a chunk of the save game into a member of its own */
+static GBytes *game_save_compress(const char *text, gsize len)
+{
+    counter_add(CNT_SAVE_BYTES, len);
+
+    return codec_compress(text, len);
+}
+
+/* compress a chunk of a level; the separators of the arrays of levels
+   are part of the chunks */
+static GBytes *game_save_level_chunk(game *g, save_chunk_t type, guint nlevel)
+{
+    static const char *last[SAVE_CHUNKS] = { "],\n\t\"memory\":\t[", "]\n}\n" };
+
+    cJSON *ser = (type == SAVE_MAP) ? map_serialize(g->maps[nlevel])
+                                  : player_level_memory_serialize(g->p, nlevel);
+
+    char *text = cJSON_Print(ser);
+    gchar *chunk = g_strconcat(text, (nlevel + 1 < g->levels) ? "," : last[type], NULL);
+
+    GBytes *gz = game_save_compress(chunk, strlen(chunk));
+
+    g_free(chunk);
+    free(text);
+    cJSON_Delete(ser);
+
+    return gz;
+}
+
+/* rebuild the chunks of a level */
+static void game_save_level_chunks(game *g, guint nlevel)
+{
+    for (int type = 0; type < SAVE_CHUNKS; type++)
+    {
+        if (g->save_chunks[type][nlevel] != NULL)
+            g_bytes_unref(g->save_chunks[type][nlevel]);
+
+        g->save_chunks[type][nlevel] = game_save_level_chunk(g, type, nlevel);
+    }
+
+    g->maps[nlevel]->modified = FALSE;
+}
+
+static void game_save_chunks_free(game *g)
+{
+    for (int type = 0; type < SAVE_CHUNKS; type++)
+    {
+        for (int nlevel = 0; nlevel < g->levels; nlevel++)
+        {
+            if (g->save_chunks[type][nlevel] != NULL)
+                g_bytes_unref(g->save_chunks[type][nlevel]);
+
+            g->save_chunks[type][nlevel] = NULL;
+        }
+    }
+}
+
+int game_save(game *g)
+{
+    display_window *win = NULL;
+
+    g_assert(g != NULL);
+
+    counter_clock_start(started);
+    gint64 span = trace_begin();
+
+    /* if the display has been initialised, show a pop-up message */
+    if (display_available())
+        win = display_popup(2, 2, 0, NULL, "Saving....", 0);
+
+    /* everything but the levels, which are appended to the object */
+    cJSON *save = game_serialize(g, FALSE);
+    char *sg = cJSON_Print(save);
+    cJSON_Delete(save);
+
+    gsize len = strrchr(sg, '}') - sg;
+    while (len > 0 && g_ascii_isspace(sg[len - 1]))
+        len--;
+
+    gchar *head = g_strdup_printf("%.*s,\n\t\"maps\":\t[", (int)len, sg);
+    GBytes *head_gz = game_save_compress(head, strlen(head));
+
+    g_free(head);
+    free(sg);
+
+    /* rebuild the chunks of the levels that have changed; the level the
+       player is on always changes */
+    for (guint nlevel = 0; nlevel < g->levels; nlevel++)
+    {
+        /* paged levels are written as they have been stored */
+        if (g->maps[nlevel]->paged)
+        {
+            GPtrArray *parts = level_store_read(g->level_store, nlevel);
+
+            if (parts == NULL)
+                game_level_page_lost(nlevel);
+
+            for (int type = 0; type < SAVE_CHUNKS; type++)
+            {
+                if (g->save_chunks[type][nlevel] != NULL)
+                    g_bytes_unref(g->save_chunks[type][nlevel]);
+
+                g->save_chunks[type][nlevel] =
+                    g_bytes_ref(g_ptr_array_index(parts, type));
+            }
+
+            g_ptr_array_free(parts, TRUE);
+            continue;
+        }
+
+        if (!g->maps[nlevel]->modified && nlevel != Z(g->p->pos)
+                && g->save_chunks[SAVE_MAP][nlevel] != NULL)
+        {
+            continue;
+        }
+
+        game_save_level_chunks(g, nlevel);
+    }
+
+    /* open save file for writing */
+    FILE* fhandle;
+    if (sgfd)
+    {
+        /*
+         * File is already opened.
+         * We need to open a duplicate of the file descriptor as fclose
+         * would close the file descriptor we keep to ensure the lock
+         * on the file is kept.
+         */
+        fhandle = fdopen(dup(sgfd), "w");
+        /* Position at beginning of file, otherwise we would append */
+        rewind(fhandle);
+    }
+    else
+    {
+        /* File need to be opened for the first time */
+        fhandle = fopen(nlarn_savefile, "wb");
+    }
+
+    if (fhandle == NULL)
+    {
+        log_add_entry(g->log, "Error opening save file \"%s\".", nlarn_savefile);
+        g_bytes_unref(head_gz);
+        return FALSE;
+    }
+
+    if (!sgfd)
+    {
+        /* first time save, try locking the file */
+        sgfd = try_locking_savegame_file(fhandle);
+    }
+
+    /* write the chunks, hashing the file for the write-ahead journal */
+    GChecksum *hash = g_checksum_new(G_CHECKSUM_SHA256);
+    gsize written = 0;
+    gboolean ok = TRUE;
+
+    for (int idx = -1; ok && idx < SAVE_CHUNKS * g->levels; idx++)
+    {
+        GBytes *chunk = (idx < 0) ? head_gz
+                                  : g->save_chunks[idx / g->levels][idx % g->levels];
+        gsize size;
+        gconstpointer data = g_bytes_get_data(chunk, &size);
+
+        ok = (fwrite(data, 1, size, fhandle) == size);
+        g_checksum_update(hash, data, size);
+        written += size;
+    }
+
+    g_bytes_unref(head_gz);
+
+    /* the chunks of paged levels are kept in the level store */
+    for (guint nlevel = 0; nlevel < g->levels; nlevel++)
+    {
+        if (!g->maps[nlevel]->paged)
+            continue;
+
+        for (int type = 0; type < SAVE_CHUNKS; type++)
+        {
+            g_bytes_unref(g->save_chunks[type][nlevel]);
+            g->save_chunks[type][nlevel] = NULL;
+        }
+    }
+
+    /* a shorter save would otherwise be followed by the rest of the last */
+    ok = ok && (fflush(fhandle) == 0);
+#ifdef WIN32
+    ok = ok && (_chsize(fileno(fhandle), written) == 0);
+#else
+    ok = ok && (ftruncate(fileno(fhandle), written) == 0);
+#endif
+
+    if (!ok)
+    {
+        log_add_entry(g->log, "Error writing save file \"%s\": %s",
+                nlarn_savefile, strerror(errno));
+
+        fclose(fhandle);
+        g_checksum_free(hash);
+        return FALSE;
+    }
+
+    fclose(fhandle);
+
+    /* make sure the save game is on disk before the keys are dropped */
+#ifdef WIN32
+    _commit(sgfd);
+#else
+    fsync(sgfd);
+#endif
+
+    /* the keys pressed so far are not needed for a recovery any more */
+    if (g->journaled)
+        journal_wal_snapshot(g_checksum_get_string(hash));
+    g_checksum_free(hash);
+
+    /* if a pop-up message has been opened, destroy it here */
+    if (win != NULL)
+        display_window_destroy(win);
+
+    counter_clock_stop(CNT_SAVE_TIME, started);
+    trace_end("game_save", span, -1);
+
+    return TRUE;
+}
+
+static int game_state_oid_cmp(gconstpointer a, gconstpointer b)
+{
+    const int oid_a = cJSON_GetObjectItem(*(cJSON **)a, "oid")->valueint;
+    const int oid_b = cJSON_GetObjectItem(*(cJSON **)b, "oid")->valueint;
+
+    return (oid_a > oid_b) - (oid_a < oid_b);
+}
+
+/* order the objects of an array by their ids */
+static void game_state_sort(cJSON *objs)
+{
+    GPtrArray *sorted = g_ptr_array_new();
+
+    while (objs->child != NULL)
+        g_ptr_array_add(sorted, cJSON_DetachItemFromArray(objs, 0));
+
+    g_ptr_array_sort(sorted, game_state_oid_cmp);
+
+    for (guint idx = 0; idx < sorted->len; idx++)
+        cJSON_AddItemToArray(objs, g_ptr_array_index(sorted, idx));
+
+    g_ptr_array_free(sorted, TRUE);
+}
+
+gchar *game_state_hash(game *g)
+{
+    g_assert(g != NULL);
+
+    cJSON *state = game_serialize(g, TRUE);
+
+    /* the only thing that differs between two runs of the same game */
+    cJSON_DeleteItemFromObject(state, "time_start");
+
+    /* objects are serialized in the order they happen to be kept in,
+       which changes when levels are paged out and in again */
+    if (g->level_store != NULL)
+    {
+        game_state_sort(cJSON_GetObjectItem(state, "items"));
+        game_state_sort(cJSON_GetObjectItem(state, "effects"));
+        game_state_sort(cJSON_GetObjectItem(state, "monsters"));
+    }
+
+    char *str = cJSON_PrintUnformatted(state);
+    gchar *hash = g_compute_checksum_for_string(G_CHECKSUM_SHA256, str, -1);
+
+    free(str);
+    cJSON_Delete(state);
+
+    return hash;
+}
+
+gboolean game_idle(game *g, guint step)
+{
+    g_assert(g != NULL && g->p != NULL);
+
+    /* the descriptions shown in the inventory */
+    if (step == 0)
+    {
+        item_desc_compact();
+
+        for (guint idx = 0; idx < inv_length(g->p->inventory); idx++)
+        {
+            item *it = inv_get(g->p->inventory, idx);
+            g_free(item_describe(it, player_item_known(g->p, it), FALSE, FALSE));
+        }
+
+        return TRUE;
+    }
+
+    if (!game_autosave(g))
+        return FALSE;
+
+    /* one level at a time; the level the player is on changes anyway.
+       A level cannot be put aside halfway, and levels larger than the
+       classic ones would hold up a key pressed meanwhile for too long;
+       they are prepared when the game is saved. */
+    for (guint nlevel = 0; nlevel < g->levels; nlevel++)
+    {
+        map *m = g->maps[nlevel];
+
+        if (nlevel == Z(g->p->pos) || m->paged
+                || m->width * m->height > MAP_MAX_X * MAP_MAX_Y
+                || (!m->modified && g->save_chunks[SAVE_MAP][nlevel] != NULL))
+        {
+            continue;
+        }
+
+        game_save_level_chunks(g, nlevel);
+        return TRUE;
+    }
+
+    return FALSE;
+}
+
+/* the game cannot go on without the levels in the level store */
+static void game_level_page_lost(guint nmap)
+{
+    display_shutdown();
+    g_printerr("Failed to read level %u from the level store.\n", nmap);
+
+    exit(EXIT_FAILURE);
+}
+
+/* a part of a paged level, which stays in the level store */
+static cJSON *game_level_page_part(game *g, guint nmap, guint part)
+{
+    GPtrArray *parts = level_store_read(g->level_store, nmap);
+
+    if (parts == NULL)
+        game_level_page_lost(nmap);
+
+    gsize len;
+    gconstpointer data = g_bytes_get_data(g_ptr_array_index(parts, part), &len);
+    gchar *text = codec_decompress(data, len, NULL);
+
+    if (text == NULL)
+        game_level_page_lost(nmap);
+
+    /* the chunks of the save file end with the separators of the arrays */
+    cJSON *ser = cJSON_ParseWithOpts(text, NULL, FALSE);
+
+    g_free(text);
+    g_ptr_array_free(parts, TRUE);
+
+    return ser;
+}
+
+/* Move a level to the level store. Its objects are serialized and
+ * destroyed; the effects, items and monsters are registered again with
+ * their ids when the level is read back. */
+static gboolean game_level_page_out(game *g, guint nmap)
+{
+    map *m = g->maps[nmap];
+    GBytes *parts[PAGE_PARTS];
+
+    counter_clock_start(started);
+    gint64 span = trace_begin();
+
+    /* the chunks of the save file can be used as long as they are current */
+    for (int type = 0; type < SAVE_CHUNKS; type++)
+    {
+        if (!m->modified && g->save_chunks[type][nmap] != NULL)
+            parts[type] = g_bytes_ref(g->save_chunks[type][nmap]);
+        else
+            parts[type] = game_save_level_chunk(g, type, nmap);
+    }
+
+    cJSON *objs = map_objects_serialize(m);
+    char *text = cJSON_PrintUnformatted(objs);
+    parts[PAGE_OBJECTS] = codec_compress(text, strlen(text));
+
+    free(text);
+    cJSON_Delete(objs);
+
+    const gboolean stored = level_store_put(g->level_store, nmap, parts,
+                                            PAGE_PARTS);
+
+    for (int idx = 0; idx < PAGE_PARTS; idx++)
+        g_bytes_unref(parts[idx]);
+
+    /* the level stays in memory if the file is full */
+    if (!stored)
+        return FALSE;
+
+    for (int type = 0; type < SAVE_CHUNKS; type++)
+    {
+        if (g->save_chunks[type][nmap] != NULL)
+            g_bytes_unref(g->save_chunks[type][nmap]);
+
+        g->save_chunks[type][nmap] = NULL;
+    }
+
+    map_unload(m);
+    player_level_memory_forget(g->p, nmap);
+    g->level_warp[nmap] = 0;
+
+    counter_inc(CNT_PAGE_OUT);
+    counter_clock_stop(CNT_PAGE_TIME, started);
+    trace_end("level_page_out", span, nmap);
+
+    return TRUE;
+}
+
+static void game_level_page_in(game *g, guint nmap)
+{
+    counter_clock_start(started);
+    gint64 span = trace_begin();
+
+    gchar **texts = level_store_take(g->level_store, nmap);
+
+    if (texts == NULL)
+        game_level_page_lost(nmap);
+
+    cJSON *objs = cJSON_Parse(texts[PAGE_OBJECTS]);
+    cJSON *obj, *ser;
+
+    /* the effects first, as they are referred to by the items */
+    GPtrArray *effects = g_ptr_array_new();
+    cJSON_ArrayForEach(obj, cJSON_GetObjectItem(objs, "effects"))
+        g_ptr_array_add(effects, effect_deserialize(obj, g));
+
+    cJSON_ArrayForEach(obj, cJSON_GetObjectItem(objs, "items"))
+        item_deserialize(obj, g);
+
+    ser = cJSON_ParseWithOpts(texts[SAVE_MAP], NULL, FALSE);
+    map_reload(g->maps[nmap], ser);
+    cJSON_Delete(ser);
+
+    ser = cJSON_ParseWithOpts(texts[SAVE_MEMORY], NULL, FALSE);
+    player_level_memory_deserialize(g->p, nmap, ser);
+    cJSON_Delete(ser);
+
+    /* the monsters need the level to be in place */
+    cJSON_ArrayForEach(obj, cJSON_GetObjectItem(objs, "monsters"))
+    {
+        monster_deserialize(obj, g);
+
+        if (g->level_warp[nmap] != 0)
+        {
+            gpointer oid = GINT_TO_POINTER(cJSON_GetObjectItem(obj, "oid")->valueint);
+            monster_time_warp(game_monster_get(g, oid), g->level_warp[nmap]);
+        }
+    }
+
+    /* the timers of the monsters' effects have gone with the level */
+    for (guint idx = 0; idx < effects->len; idx++)
+        effect_timers_restore(g_ptr_array_index(effects, idx), g->level_warp[nmap]);
+
+    g->level_warp[nmap] = 0;
+
+    g_ptr_array_free(effects, TRUE);
+    cJSON_Delete(objs);
+    g_strfreev(texts);
+
+    counter_inc(CNT_PAGE_IN);
+    counter_clock_stop(CNT_PAGE_TIME, started);
+    trace_end("level_page_in", span, nmap);
+}
+
+/* the levels the monsters move on, see monster_map_active() */
+static gboolean game_level_near(guint nmap, guint pz)
+{
+    return (nmap == pz || nmap + 1 == pz || nmap == pz + 1
+            || (nmap == (guint)map_volcano() && pz == 0));
+}
+
+/* read the paged levels near a level ahead */
+static void game_levels_prefetch(game *g, guint nlevel)
+{
+    for (guint nmap = 0; nmap < g->levels; nmap++)
+    {
+        if (g->maps[nmap]->paged && game_level_near(nmap, nlevel))
+            level_store_prefetch(g->level_store, nmap);
+    }
+}
+
+/* the turns between two spawns of monsters on a level */
+static guint32 game_spawn_period(guint nmap)
+{
+    return 100 + nmap;
+}
+
+void game_levels_page(game *g)
+{
+    g_assert(g != NULL);
+
+    if (g->level_store == NULL || g->p == NULL || !pos_valid(g->p->pos))
+        return;
+
+    const guint pz = Z(g->p->pos);
+    gboolean *pageable = g_new0(gboolean, g->levels);
+    guint resident = 0;
+
+    for (guint nmap = 0; nmap < g->levels; nmap++)
+    {
+        map *m = g->maps[nmap];
+
+        if (!map_generated(m) || m->paged)
+            continue;
+
+        resident++;
+
+        /* the monsters near the player move, as do spheres and
+           the temporary tiles, see map_timer() */
+        pageable[nmap] = !game_level_near(nmap, pz);
+
+        for (guint idx = 0; pageable[nmap] && idx < g->spheres->len; idx++)
+        {
+            sphere *s = g_ptr_array_index(g->spheres, idx);
+            pageable[nmap] = (Z(s->pos) != nmap);
+        }
+
+        for (int y = 0; pageable[nmap] && y < m->height; y++)
+            for (int x = 0; pageable[nmap] && x < m->width; x++)
+                pageable[nmap] = (map_grid(m, x, y).timer == 0);
+    }
+
+    /* page out the levels visited longest ago */
+    while (resident > g->resident_levels)
+    {
+        gint coldest = -1;
+
+        for (guint nmap = 0; nmap < g->levels; nmap++)
+        {
+            if (pageable[nmap] && (coldest < 0
+                    || g->maps[nmap]->visited < g->maps[coldest]->visited))
+            {
+                coldest = nmap;
+            }
+        }
+
+        if (coldest < 0 || !game_level_page_out(g, coldest))
+            break;
+
+        pageable[coldest] = FALSE;
+        resident--;
+    }
+
+    /* monsters are spawned on all levels */
+    for (guint nmap = 0; nmap < g->levels; nmap++)
+    {
+        if (g->maps[nmap]->paged
+                && (g->gtime + 1) % game_spawn_period(nmap) == 0)
+        {
+            level_store_prefetch(g->level_store, nmap);
+        }
+    }
+
+    /* the levels the player is about to enter */
+    map *pmap = g->maps[pz];
+    position pos = pos_invalid;
+    Z(pos) = pz;
+
+    for (Y(pos) = MAX(Y(g->p->pos) - 5, 0);
+            Y(pos) <= MIN(Y(g->p->pos) + 5, pmap->height - 1); Y(pos)++)
+    {
+        for (X(pos) = MAX(X(g->p->pos) - 5, 0);
+                X(pos) <= MIN(X(g->p->pos) + 5, pmap->width - 1); X(pos)++)
+        {
+            switch (map_sobject_at(pmap, pos))
+            {
+            case LS_STAIRSDOWN:
+            case LS_CAVERNS_ENTRY:
+                game_levels_prefetch(g, pz + 1);
+                break;
+
+            case LS_STAIRSUP:
+            case LS_CAVERNS_EXIT:
+                game_levels_prefetch(g, pz - 1);
+                break;
+
+            case LS_ELEVATORDOWN:
+                game_levels_prefetch(g, map_volcano());
+                break;
+
+            case LS_ELEVATORUP:
+                game_levels_prefetch(g, 0);
+                break;
+
+            default:
+                break;
+            }
+        }
+    }
+
+    g_free(pageable);
+}
+
+map *game_map(game *g, guint nmap)
+{
+    g_assert (g != NULL && nmap < g->levels);
+
+    /* levels in the level store are read back when needed */
+    if (g->maps[nmap] != NULL && g->maps[nmap]->paged)
+        game_level_page_in(g, nmap);
+
+    return g->maps[nmap];
+}
+
+/* the streams of a level: one to choose the maze, one for the layout
+ * and one for populating it. Each stream can be used independently of
+ * the others, hence the order in which levels are generated and the
+ * threads which generate them do not matter. */
+static void game_map_streams(game *g, guint nmap, rand_ctx *plan,
+                             rand_ctx *layout, rand_ctx *populate)
+{
+    rand_ctx_level(populate, g->seed, nmap);
+    rand_ctx_split(populate, plan);
+    rand_ctx_split(populate, layout);
+}
+
+static map *game_map_layout(guint nmap, gint maze, int width, int height,
+                            int levels, rand_ctx *ctx)
+{
+    rand_ctx *prev = rand_use(ctx);
+
+    /* the workers lay out levels of any game */
+    pos_bounds_use(width, height, levels);
+
+    map *layout = map_layout_new(nmap, maze, width, height);
+    rand_use(prev);
+
+    return layout;
+}
+
+static void game_map_layout_worker(gpointer data,
+                                   gpointer user_data __attribute__((unused)))
+{
+    level_job *job = (level_job *)data;
+
+    g_mutex_lock(&job->mutex);
+    if (job->state != LJ_QUEUED)
+    {
+        /* the job has been claimed by the main thread or cancelled,
+           and can be freed from now on */
+        job->state = LJ_DONE;
+        g_mutex_unlock(&job->mutex);
+        return;
+    }
+    job->state = LJ_RUNNING;
+    g_mutex_unlock(&job->mutex);
+
+    map *layout = game_map_layout(job->nmap, job->maze, job->width,
+                                  job->height, job->levels, &job->ctx);
+
+    g_mutex_lock(&job->mutex);
+    job->layout = layout;
+    job->ran = TRUE;
+    job->state = LJ_DONE;
+    g_cond_signal(&job->done);
+    g_mutex_unlock(&job->mutex);
+}
+
+/* queue the layout of a level unless it has been generated or queued */
+static void game_map_layout_queue(game *g, guint nmap)
+{
+    rand_ctx plan, layout, populate;
+
+    if (map_generated(g->maps[nmap]) || g->level_jobs[nmap] != NULL)
+        return;
+
+    game_map_streams(g, nmap, &plan, &layout, &populate);
+
+    level_job *job = g_malloc0(sizeof(level_job));
+    job->nmap = nmap;
+    job->maze = g->maps[nmap]->maze;
+    job->width = g->map_width;
+    job->height = g->map_height;
+    job->levels = g->levels;
+    job->ctx = layout;
+    job->state = LJ_QUEUED;
+    g_mutex_init(&job->mutex);
+    g_cond_init(&job->done);
+
+    g->level_jobs[nmap] = job;
+    g_thread_pool_push(g->level_pool, job, NULL);
+}
+
+static void level_job_free(level_job *job)
+{
+    g_mutex_clear(&job->mutex);
+    g_cond_clear(&job->done);
+    g_free(job);
+}
+
+/* Lay out the levels which can be entered next from a level and throw
+ * away the layouts of the levels far from it, which are laid out again
+ * when they are entered after all. Thus the number of layouts kept does
+ * not grow with the depth of the dungeon. */
+static void game_maps_layout_near(game *g, guint nlevel)
+{
+    if (g->level_pool == NULL)
+        return;
+
+    for (guint nmap = 0; nmap < g->levels; nmap++)
+    {
+        if (game_level_near(nmap, nlevel)
+                || (nmap > nlevel && nmap <= nlevel + LAYOUT_AHEAD))
+        {
+            game_map_layout_queue(g, nmap);
+            continue;
+        }
+
+        level_job *job = g->level_jobs[nmap];
+        if (job == NULL) continue;
+
+        /* cancelled jobs are left to the workers until they are done */
+        g_mutex_lock(&job->mutex);
+        if (job->state == LJ_QUEUED) job->state = LJ_CANCELLED;
+        const gboolean done = (job->state == LJ_DONE);
+        g_mutex_unlock(&job->mutex);
+
+        if (done)
+        {
+            if (job->layout != NULL)
+                map_destroy(job->layout);
+
+            level_job_free(job);
+            g->level_jobs[nmap] = NULL;
+        }
+    }
+}
+
+static void game_maps_layout_start(game *g)
+{
+    g_assert(g->level_pool == NULL);
+
+    g->level_pool = g_thread_pool_new(game_map_layout_worker, NULL,
+                                   g_get_num_processors(), FALSE, NULL);
+
+    game_maps_layout_near(g, Z(g->p->pos));
+}
+
+/* take the layout of a level from the workers, laying it out here
+ * if no worker has picked it up yet; NULL if the maze keeps failing */
+static map *game_map_layout_claim(game *g, guint nmap, rand_ctx *layout)
+{
+    level_job *job = g->level_jobs[nmap];
+    map *m;
+
+    if (job == NULL)
+        return game_map_layout(nmap, g->maps[nmap]->maze, g->map_width,
+                               g->map_height, g->levels, layout);
+
+    g_mutex_lock(&job->mutex);
+    if (job->state == LJ_QUEUED)
+        job->state = LJ_CANCELLED;
 
-    if (g->wizard) cJSON_AddTrueToObject(save, "wizard");
-    if (g->fullvis) cJSON_AddTrueToObject(save, "fullvis");
+    while (job->state == LJ_RUNNING)
+        g_cond_wait(&job->done, &job->mutex);
 
-    /* store stock */
-    if (inv_length(g->store_stock) > 0)
-    {
-        cJSON_AddItemToObject(save, "store_stock", inv_serialize(g->store_stock));
-    }
+    /* the worker is finished with the job when it is done */
+    const gboolean done = (job->state == LJ_DONE);
+    const gboolean ran = job->ran;
+    m = job->layout;
+    job->layout = NULL;
+    g_mutex_unlock(&job->mutex);
 
-    /* monastery stock */
-    if (inv_length(g->monastery_stock) > 0)
+    /* the job has been cancelled before a worker ran it */
+    if (!ran)
     {
-        cJSON_AddItemToObject(save, "monastery_stock", inv_serialize(g->monastery_stock));
+        m = game_map_layout(nmap, job->maze, job->width, job->height,
+                            job->levels, &job->ctx);
     }
 
-    /* storage at player's home */
-    if (inv_length(g->player_home) > 0)
+    if (done)
     {
-        cJSON_AddItemToObject(save, "player_home", inv_serialize(g->player_home));
+        g->level_jobs[nmap] = NULL;
+        level_job_free(job);
     }
 
-    /* log */
-    cJSON_AddItemToObject(save, "log", log_serialize(g->log));
+    return m;
+}
 
-    /* add player */
-    cJSON_AddItemToObject(save, "player",  player_serialize(g->p));
+static void game_maps_layout_stop(game *g)
+{
+    if (g->level_pool == NULL)
+        return;
 
-    /* add items */
-    cJSON_AddItemToObject(save, "items", obj = cJSON_CreateArray());
-    g_hash_table_foreach(g->items, item_serialize, obj);
+    /* keep the workers from starting queued jobs */
+    for (guint nmap = 0; nmap < g->levels; nmap++)
+    {
+        level_job *job = g->level_jobs[nmap];
+        if (job == NULL) continue;
 
-    /* add effects */
-    cJSON_AddItemToObject(save, "effects", obj = cJSON_CreateArray());
-    g_hash_table_foreach(g->effects, (GHFunc)effect_serialize, obj);
+        g_mutex_lock(&job->mutex);
+        if (job->state == LJ_QUEUED) job->state = LJ_CANCELLED;
+        g_mutex_unlock(&job->mutex);
+    }
 
-    /* add monsters */
-    cJSON_AddItemToObject(save, "monsters", obj = cJSON_CreateArray());
-    g_hash_table_foreach(g->monsters, (GHFunc)monster_serialize, obj);
+    /* wait for the running jobs */
+    g_thread_pool_free(g->level_pool, FALSE, TRUE);
+    g->level_pool = NULL;
 
-    /* add spheres */
-    if (g->spheres->len > 0)
+    for (guint nmap = 0; nmap < g->levels; nmap++)
     {
-        cJSON_AddItemToObject(save, "spheres", obj = cJSON_CreateArray());
-        g_ptr_array_foreach(g->spheres, (GFunc)sphere_serialize, obj);
+        level_job *job = g->level_jobs[nmap];
+        if (job == NULL) continue;
+
+        if (job->layout != NULL)
+            map_destroy(job->layout);
+
+        level_job_free(job);
+        g->level_jobs[nmap] = NULL;
     }
+}
 
-    /* print save game into a string */
-    char *sg = cJSON_Print(save);
+map *game_map_generate(game *g, guint nmap)
+{
+    rand_ctx plan, layout, populate, *prev;
 
-    /* free memory claimed by JSON structures */
-    cJSON_Delete(save);
+    g_assert (g != NULL && nmap < g->levels);
 
-    /* open save file for writing */
-    FILE* fhandle;
-    if (sgfd)
-    {
-        /*
-         * File is already opened.
-         * We need to open a duplicate of the file descriptor as gzclose
-         * would close the file descriptor we keep to ensure the lock
-         * on the file is kept.
-         */
-        fhandle = fdopen(dup(sgfd), "w");
-        /* Position at beginning of file, otherwise zlib would append */
-        rewind(fhandle);
-    }
-    else
-    {
-        /* File need to be opened for the first time */
-        fhandle = fopen(nlarn_savefile, "wb");
-    }
+    if (g->maps[nmap] != NULL && map_generated(g->maps[nmap]))
+        return game_map(g, nmap);
 
-    if (fhandle == NULL)
-    {
-        log_add_entry(g->log, "Error opening save file \"%s\".", nlarn_savefile);
-        free(sg);
-        return FALSE;
-    }
+    /* generate the level from its own streams and keep the main sequence */
+    game_map_streams(g, nmap, &plan, &layout, &populate);
+    map *m = game_map_layout_claim(g, nmap, &layout);
 
-    if (!sgfd)
+    /* the maze chosen for the level keeps failing; another maze is
+       chosen here as the workers must not touch the mazes used */
+    while (m == NULL)
     {
-        /* first time save, try locking the file */
-        sgfd = try_locking_savegame_file(fhandle);
-    }
+        rand_ctx unused;
+        gint maze = g->maps[nmap]->maze;
 
-    gzFile file = gzdopen(fileno(fhandle), "wb");
-    if (gzputs(file, sg) != (int)strlen(sg))
-    {
-        log_add_entry(g->log, "Error writing save file \"%s\": %s",
-                nlarn_savefile, gzerror(file, &err));
+        prev = rand_use(&plan);
+        maze = g->maps[nmap]->maze = map_maze_replace(nmap, maze);
+        rand_use(prev);
 
-        free(sg);
-        return FALSE;
+        /* lay out the level from the start of its stream */
+        game_map_streams(g, nmap, &unused, &layout, &populate);
+        m = game_map_layout(nmap, maze, g->map_width, g->map_height,
+                            g->levels, &layout);
     }
 
-    free(sg);
-    gzclose(file);
-
-    /* if a pop-up message has been opened, destroy it here */
-    if (win != NULL)
-        display_window_destroy(win);
+    /* throw away the placeholder */
+    map_destroy(g->maps[nmap]);
+    g->maps[nmap] = m;
 
-    return TRUE;
-}
+    prev = rand_use(&populate);
+    map_populate(m);
+    rand_use(prev);
 
-map *game_map(game *g, guint nmap)
-{
-    g_assert (g != NULL && nmap < MAP_MAX);
+    /* the levels next to it may be entered soon */
+    game_maps_layout_near(g, nmap);
 
-    return g->maps[nmap];
+    return m;
 }
 
 void game_spin_the_wheel(game *g)
 {
     map *amap;
+    gint64 span, turn = trace_begin();
 
     g_assert(g != NULL);
 
@@ -360,18 +1372,19 @@ void game_spin_the_wheel(game *g)
     nlarn->p->movement += player_get_speed(nlarn->p);
 
     /* per-map actions */
-    for (int nmap = 0; nmap < MAP_MAX; nmap++)
+    for (int nmap = 0; nmap < g->levels; nmap++)
     {
-        amap = game_map(g, nmap);
+        amap = g->maps[nmap];
+
+        /* nothing happens on levels that do not exist yet; paged levels
+           have no temporary tiles, see game_levels_page() */
+        if (!map_generated(amap) || amap->paged)
+            continue;
 
         /* call map timers */
+        span = trace_begin();
         map_timer(amap);
-
-        /* spawn some monsters every now and then */
-        if (g->gtime % (100 + nmap) == 0)
-        {
-            map_fill_with_life(amap);
-        }
+        trace_end("map_timer", span, nmap);
     }
 
     amap = game_map(nlarn, Z(g->p->pos));
@@ -404,20 +1417,279 @@ void game_spin_the_wheel(game *g)
     if (dam != NULL)
         player_damage_take(g->p, dam, PD_MAP, map_tiletype_at(amap, g->p->pos));
 
-    /* move all monsters */
-    g_hash_table_foreach(g->monsters, (GHFunc)monster_move, g);
+    /* find the monsters' paths at once, then move the monsters one after
+       the other in the order they are due */
+    span = trace_begin();
+    GPtrArray *due = game_monsters_plan(g);
+    trace_end("monster_plan", span, (due != NULL) ? (gint64)due->len : 0);
+
+    /* move the monsters whose turn has come */
+    rand_ctx *prev = rand_use(rand_stream(RS_MONSTERS));
+    gpointer oid;
+
+    while ((oid = scheduler_pop(g->actors, g->gtime)))
+    {
+        monster *m = game_monster_get(g, oid);
+
+        if (m != NULL)
+        {
+            span = trace_begin();
+            monster_move(m, g);
+            trace_end("monster_move", span, GPOINTER_TO_UINT(oid));
+        }
+    }
+
+    rand_use(prev);
+    game_monsters_plan_end(g, due);
 
     /* destroy all monsters that have been killed during this turn */
     game_remove_dead_monsters(g);
 
     /* move all spheres */
+    span = trace_begin();
     g_ptr_array_foreach(g->spheres, (GFunc)sphere_move, g);
+    trace_end("sphere_move", span, -1);
+
+    game_timers_advance(g);
+
+    /* keep the number of levels in memory in bounds */
+    game_levels_page(g);
 
-    /* calculate bank interest */
-    building_bank_calc_interest(g);
+    counters_turn_end();
+    trace_end("game_spin_the_wheel", turn, g->gtime - 1);
+}
+
+void game_timers_advance(game *g)
+{
+    g_assert(g != NULL);
 
     g->gtime++; /* count up the time  */
     log_set_time(g->log, g->gtime); /* adjust time for log entries */
+
+    /* handle everything that is due in the new turn */
+    game_timers_fire(g);
+}
+
+guint32 game_fast_forward(game *g, guint32 turns)
+{
+    g_assert(g != NULL);
+
+    map *pmap = game_map(g, Z(g->p->pos));
+
+    /* spheres move every turn */
+    if (g->spheres->len > 0)
+        return 0;
+
+    /* burning or flooded tiles change every turn */
+    for (int nmap = 0; nmap < g->levels; nmap++)
+    {
+        map *amap = g->maps[nmap];
+
+        if (map_generated(amap) && !amap->paged && amap->timed)
+            return 0;
+    }
+
+    /* the tile the player is standing on is checked every turn */
+    switch (map_tiletype_at(pmap, g->p->pos))
+    {
+    case LT_WALL:
+    case LT_DEEPWATER:
+    case LT_LAVA:
+        return 0;
+
+    default:
+        if (map_tile_harmful(pmap, g->p->pos))
+            return 0;
+        break;
+    }
+
+    /* no monster may move and no timer may fire */
+    turns = scheduler_idle(g->actors, g->gtime, turns);
+    turns = timewheel_idle(g->timers, turns);
+
+    if (turns == 0)
+        return 0;
+
+    timewheel_skip(g->timers, turns);
+    g->gtime += turns;
+    log_set_time(g->log, g->gtime);
+
+    game_levels_page(g);
+    counters_turn_end();
+
+    return turns;
+}
+
+static void game_monster_plan_worker(gpointer oid, gpointer data)
+{
+    game *g = (game *)data;
+    game *prev = game_use(g);
+
+    monster *m = game_monster_get(g, oid);
+    if (m != NULL) monster_plan_step(m);
+
+    game_use(prev);
+
+    g_mutex_lock(&g->plan_mutex);
+    if (--g->plans_pending == 0)
+        g_cond_signal(&g->plan_done);
+    g_mutex_unlock(&g->plan_mutex);
+}
+
+/* Let the worker threads plan the steps of the monsters due in this turn.
+ * Nothing is changed while they are working; the changes made by the
+ * monsters moving afterwards are watched to tell which plans still hold.
+ * Returns the ids of the monsters planned or NULL. */
+static GPtrArray *game_monsters_plan(game *g)
+{
+    /* on a single processor, the planners would only take turns with the
+       monsters and each other, which makes a turn slower */
+    const guint planners = MIN(g->planners, g_get_num_processors());
+
+    if (planners < 2)
+        return NULL;
+
+    GPtrArray *due = scheduler_due(g->actors, g->gtime);
+
+    if (due->len < 2)
+    {
+        g_ptr_array_free(due, TRUE);
+        return NULL;
+    }
+
+    if (g->plan_pool == NULL)
+    {
+        g_mutex_init(&g->plan_mutex);
+        g_cond_init(&g->plan_done);
+        g->plan_pool = g_thread_pool_new(game_monster_plan_worker, g,
+                                         planners, FALSE, NULL);
+    }
+
+    for (guint nmap = 0; nmap < g->levels; nmap++)
+    {
+        if (map_generated(g->maps[nmap]) && !g->maps[nmap]->paged)
+            map_changes_watch(g->maps[nmap]);
+    }
+
+    g_mutex_lock(&g->plan_mutex);
+    g->plans_pending = due->len;
+
+    for (guint idx = 0; idx < due->len; idx++)
+        g_thread_pool_push(g->plan_pool, g_ptr_array_index(due, idx), NULL);
+
+    while (g->plans_pending > 0)
+        g_cond_wait(&g->plan_done, &g->plan_mutex);
+
+    g_mutex_unlock(&g->plan_mutex);
+
+    return due;
+}
+
+static void game_monsters_plan_end(game *g, GPtrArray *due)
+{
+    if (due == NULL)
+        return;
+
+    /* forget the plans of monsters which have not needed them */
+    for (guint idx = 0; idx < due->len; idx++)
+    {
+        monster *m = game_monster_get(g, g_ptr_array_index(due, idx));
+        if (m != NULL) monster_plan_drop(m);
+    }
+
+    for (guint nmap = 0; nmap < g->levels; nmap++)
+        map_changes_forget(g->maps[nmap]);
+
+    g_ptr_array_free(due, TRUE);
+}
+
+static void game_monsters_plan_stop(game *g)
+{
+    if (g->plan_pool == NULL)
+        return;
+
+    g_thread_pool_free(g->plan_pool, FALSE, TRUE);
+    g->plan_pool = NULL;
+
+    g_mutex_clear(&g->plan_mutex);
+    g_cond_clear(&g->plan_done);
+}
+
+static void game_monster_time_warp(gpointer oid __attribute__((unused)),
+                                   monster *m, gpointer turns)
+{
+    monster_time_warp(m, GPOINTER_TO_INT(turns));
+}
+
+void game_time_warp(game *g, gint32 turns)
+{
+    g_assert(g != NULL);
+
+    g->gtime += turns;
+    log_set_time(g->log, g->gtime);
+
+    GArray *timers = timewheel_drain(g->timers, g->gtime);
+
+    for (guint idx = 0; idx < timers->len; idx++)
+    {
+        wheel_timer *t = &g_array_index(timers, wheel_timer, idx);
+        effect *e;
+
+        /* periodic events are registered again below */
+        if (t->kind != GT_EFFECT_END && t->kind != GT_EFFECT_WARNING)
+            continue;
+
+        /* drop timers that have become void */
+        if (!(e = game_effect_get(g, t->id)) || e->expires == 0)
+            continue;
+
+        if (e->owner == NULL)
+        {
+            /* effects on the player end at the same turn as before */
+            timewheel_add(g->timers, t->due, t->kind, t->id);
+        }
+        else if (t->due == e->expires)
+        {
+            /* monsters are not affected by time warps */
+            e->expires += turns;
+            timewheel_add(g->timers, e->expires, t->kind, t->id);
+        }
+    }
+
+    g_array_free(timers, TRUE);
+
+    game_timers_periodic(g);
+
+    /* monsters keep their pace as well */
+    g_hash_table_foreach(g->monsters, (GHFunc)game_monster_time_warp,
+                         GINT_TO_POINTER(turns));
+
+    /* the monsters on paged levels when they are read back */
+    for (guint nmap = 0; nmap < g->levels; nmap++)
+    {
+        if (g->maps[nmap]->paged)
+            g->level_warp[nmap] += turns;
+    }
+}
+
+static void game_monster_wake(gpointer oid __attribute__((unused)),
+                              monster *m, gpointer data __attribute__((unused)))
+{
+    monster_schedule(m);
+}
+
+void game_actors_wake(game *g)
+{
+    g_assert(g != NULL);
+
+    /* the monsters near the player have to be in memory */
+    for (guint nmap = 0; nmap < g->levels; nmap++)
+    {
+        if (g->maps[nmap]->paged && game_level_near(nmap, Z(g->p->pos)))
+            game_map(g, nmap);
+    }
+
+    g_hash_table_foreach(g->monsters, (GHFunc)game_monster_wake, NULL);
 }
 
 void game_remove_dead_monsters(game *g)
@@ -451,6 +1723,8 @@ item *game_item_get(game *g, gpointer id)
 {
     g_assert(g != NULL && id != NULL);
 
+    counter_inc(CNT_ITEM_GET);
+
     return (item *)g_hash_table_lookup(g->items, id);
 }
 
@@ -460,6 +1734,7 @@ gpointer game_effect_register(game *g, effect *e)
 
     gpointer nkey = GUINT_TO_POINTER(++g->effect_max_id);
     g_hash_table_insert(g->effects, nkey, e);
+    g->effect_types[e->type]++;
 
     return nkey;
 }
@@ -468,7 +1743,13 @@ void game_effect_unregister(game *g, gpointer e)
 {
     g_assert (g != NULL && e != NULL);
 
-    g_hash_table_remove(g->effects, e);
+    effect *eff = g_hash_table_lookup(g->effects, e);
+
+    if (eff != NULL)
+    {
+        g->effect_types[eff->type]--;
+        g_hash_table_remove(g->effects, e);
+    }
 }
 
 effect *game_effect_get(game *g, gpointer id)
@@ -492,16 +1773,23 @@ void game_monster_unregister(game *g, gpointer m)
     g_assert (g != NULL && m != NULL);
 
     g_hash_table_remove(g->monsters, m);
+    scheduler_remove(g->actors, m);
 }
 
 monster *game_monster_get(game *g, gpointer id)
 {
     g_assert(g != NULL && id != NULL);
+    counter_inc(CNT_MONSTER_GET);
+
     return (monster *)g_hash_table_lookup(g->monsters, id);
 }
 
-static void game_new()
+static void game_new(guint32 seed)
 {
+    /* everything random in the game is derived from the seed */
+    nlarn->seed = seed;
+    rand_init(seed);
+
     /* initialize object hashes (here as they will be needed by player_new) */
     nlarn->items = g_hash_table_new(&g_direct_hash, &g_direct_equal);
     nlarn->effects = g_hash_table_new(&g_direct_hash, &g_direct_equal);
@@ -513,6 +1801,15 @@ static void game_new()
 
     nlarn->spheres = g_ptr_array_new();
 
+    /* game time handling */
+    nlarn->gtime = 1;
+    nlarn->time_start = time(NULL);
+    nlarn->version = SAVEFILE_VERSION;
+
+    nlarn->timers = timewheel_new(nlarn->gtime);
+    game_timers_periodic(nlarn);
+    nlarn->actors = scheduler_new();
+
     /* generate player */
     nlarn->p = player_new();
 
@@ -525,22 +1822,22 @@ static void game_new()
     /* initialize the monastery */
     building_monastery_init();
 
-    /* generate levels */
-    for (size_t idx = 0; idx < MAP_MAX; idx++)
+    /* levels are generated when entered for the first time; choose
+     * their mazes now as every maze may only be used once */
+    for (size_t idx = 0; idx < nlarn->levels; idx++)
     {
-        /* if map_new fails, it returns NULL.
-           loop while no map has been generated */
-        do
-        {
-            nlarn->maps[idx] = map_new(idx, nlarn_mazefile);
-        }
-        while (nlarn->maps[idx] == NULL);
+        rand_ctx plan, layout, populate, *prev;
+
+        game_map_streams(nlarn, idx, &plan, &layout, &populate);
+        prev = rand_use(&plan);
+        nlarn->maps[idx] = map_placeholder_new(idx, map_maze_choose(idx),
+                                               nlarn->map_width,
+                                               nlarn->map_height);
+        rand_use(prev);
     }
 
-    /* game time handling */
-    nlarn->gtime = 1;
-    nlarn->time_start = time(NULL);
-    nlarn->version = SAVEFILE_VERSION;
+    /* the town is needed right away */
+    game_map_generate(nlarn, 0);
 
     /* start a new diary */
     nlarn->log = log_new();
@@ -557,9 +1854,6 @@ static gboolean game_load()
     cJSON *save, *obj;
     display_window *win = NULL;
 
-    /* size of the buffer we allocate to store the uncompressed file content */
-    const int bufsize = 1024 * 1024 * 3;
-
     /* try to open save file */
     FILE* file = fopen(nlarn_savefile, "rb+");
 
@@ -576,17 +1870,29 @@ static gboolean game_load()
      */
     sgfd = try_locking_savegame_file(file);
 
-    /* open the file with zlib */
-    gzFile sg = gzdopen(fileno(file), "rb");
+    counter_clock_start(started);
+    gint64 span = trace_begin();
+
+    /* keys pressed after the game has been saved follow this file */
+    fseek(file, 0, SEEK_END);
+    const long rawlen = ftell(file);
+    guchar *raw = g_malloc(rawlen > 0 ? rawlen : 1);
+
+    rewind(file);
+    const gboolean complete = (rawlen > 0
+            && fread(raw, 1, rawlen, file) == (size_t)rawlen);
+
+    /* the lock is held by the duplicate of the file descriptor */
+    fclose(file);
 
     /* if the display has been initialised, show a pop-up message */
     if (display_available())
         win = display_popup(2, 2, 0, NULL, "Loading....", 0);
 
-    /* temporary buffer to store uncompressed save file content */
-    char *sgbuf = g_malloc0(bufsize);
+    gsize sglen = 0;
+    char *sgbuf = complete ? codec_decompress(raw, rawlen, &sglen) : NULL;
 
-    if (!gzread(sg, sgbuf, bufsize))
+    if (sgbuf == NULL)
     {
         /* Reading the file failed. Terminate the game with an error message */
         display_shutdown();
@@ -595,8 +1901,10 @@ static gboolean game_load()
         exit(EXIT_FAILURE);
     }
 
-    /* close save file */
-    gzclose(sg);
+    gchar *hash = g_compute_checksum_for_data(G_CHECKSUM_SHA256, raw, rawlen);
+    journal_wal_snapshot(hash);
+    g_free(hash);
+    g_free(raw);
 
     /* parse save file */
     save = cJSON_Parse(sgbuf);
@@ -647,7 +1955,22 @@ static gboolean game_load()
     nlarn->time_start = cJSON_GetObjectItem(save, "time_start")->valueint;
     nlarn->gtime = cJSON_GetObjectItem(save, "gtime")->valueint;
     nlarn->difficulty = cJSON_GetObjectItem(save, "difficulty")->valueint;
-    rand_deserialize(cJSON_GetObjectItem(save, "rng_state"));
+
+    /* games saved without the dimensions have the classic ones */
+    obj = cJSON_GetObjectItem(save, "map_width");
+    nlarn->map_width = (obj != NULL) ? obj->valueint : MAP_MAX_X;
+    obj = cJSON_GetObjectItem(save, "map_height");
+    nlarn->map_height = (obj != NULL) ? obj->valueint : MAP_MAX_Y;
+
+    /* as is the depth of the classic dungeon */
+    obj = cJSON_GetObjectItem(save, "levels");
+    nlarn->levels = (obj != NULL) ? obj->valueint : MAP_MAX;
+    game_levels_alloc(nlarn);
+    game_use(nlarn);
+    nlarn->seed = (guint32)cJSON_GetObjectItem(save, "seed")->valuedouble;
+    rand_deserialize(&nlarn->rng, cJSON_GetObjectItem(save, "rng_state"));
+    nlarn->timers = timewheel_deserialize(cJSON_GetObjectItem(save, "timers"),
+                                          nlarn->gtime);
 
     if (cJSON_GetObjectItem(save, "wizard"))
         nlarn->wizard = TRUE;
@@ -732,7 +2055,7 @@ static gboolean game_load()
     /* restore maps */
     obj = cJSON_GetObjectItem(save, "maps");
     size = cJSON_GetArraySize(obj);
-    g_assert(size == MAP_MAX);
+    g_assert(size == nlarn->levels);
     for (int idx = 0; idx < size; idx++)
         nlarn->maps[idx] = map_deserialize(cJSON_GetArrayItem(obj, idx));
 
@@ -756,14 +2079,31 @@ static gboolean game_load()
     /* restore player */
     nlarn->p = player_deserialize(cJSON_GetObjectItem(save, "player"));
 
+    if ((obj = cJSON_GetObjectItem(save, "memory")))
+    {
+        for (guint idx = 0; idx < nlarn->levels; idx++)
+        {
+            player_level_memory_deserialize(nlarn->p, idx,
+                    cJSON_GetArrayItem(obj, idx));
+        }
+    }
+
 
     /* restore monsters */
     nlarn->monsters = g_hash_table_new(&g_direct_hash, &g_direct_equal);
+    nlarn->actors = scheduler_new();
     obj = cJSON_GetObjectItem(save, "monsters");
 
     for (int idx = 0; idx < cJSON_GetArraySize(obj); idx++)
         monster_deserialize(cJSON_GetArrayItem(obj, idx), nlarn);
 
+    /* restore the order in which the monsters move */
+    if ((obj = cJSON_GetObjectItem(save, "actors")))
+    {
+        scheduler_destroy(nlarn->actors);
+        nlarn->actors = scheduler_deserialize(obj);
+    }
+
     /* initialize the array to store monsters that died during the turn */
     nlarn->dead_monsters = g_ptr_array_new_with_free_func(
             (GDestroyNotify)monster_destroy);
@@ -797,9 +2137,107 @@ static gboolean game_load()
     if (win != NULL)
         display_window_destroy(win);
 
+    counter_add(CNT_LOAD_BYTES, sglen);
+    counter_clock_stop(CNT_LOAD_TIME, started);
+    trace_end("game_load", span, -1);
+
     return TRUE;
 }
 
+/* register the events happening every now and then */
+static void game_timers_periodic(game *g)
+{
+    /* spawn some monsters every now and then */
+    for (guint nmap = 0; nmap < g->levels; nmap++)
+    {
+        guint32 period = game_spawn_period(nmap);
+        timewheel_add(g->timers, g->gtime - (g->gtime % period) + period,
+                      GT_SPAWN, GUINT_TO_POINTER(nmap));
+    }
+
+    /* pay interest every 1000 turns */
+    timewheel_add(g->timers, g->gtime - (g->gtime % 1000) + 1000,
+                  GT_BANK_INTEREST, NULL);
+}
+
+static void game_timers_fire(game *g)
+{
+    GArray *fired = g_array_new(FALSE, FALSE, sizeof(wheel_timer));
+
+    timewheel_advance(g->timers, fired);
+
+    for (guint idx = 0; idx < fired->len; idx++)
+    {
+        wheel_timer *t = &g_array_index(fired, wheel_timer, idx);
+        effect *e = NULL;
+
+        /* effect timers are void when the effect has been removed
+           or its duration has changed in the meantime */
+        if (t->kind == GT_EFFECT_END || t->kind == GT_EFFECT_WARNING)
+        {
+            e = game_effect_get(g, t->id);
+
+            if (e == NULL || e->expires == 0)
+                continue;
+
+            if (e->expires != t->due + (t->kind == GT_EFFECT_WARNING ? 5 : 0))
+                continue;
+        }
+
+        switch (t->kind)
+        {
+        case GT_EFFECT_END:
+            if (e->owner == NULL)
+            {
+                player_effect_del(g->p, e);
+            }
+            else
+            {
+                monster *m = game_monster_get(g, e->owner);
+
+                if (m != NULL)
+                    monster_effect_del(m, e);
+            }
+            break;
+
+        case GT_EFFECT_WARNING:
+            player_effect_fading(g->p, e);
+            break;
+
+        case GT_SPAWN:
+        {
+            guint nmap = GPOINTER_TO_UINT(t->id);
+            map *amap = game_map(g, nmap);
+
+            /* nothing happens on levels that do not exist yet */
+            if (map_generated(amap))
+            {
+                rand_ctx *prev = rand_use(rand_stream(RS_SPAWN));
+                gint64 span = trace_begin();
+                map_fill_with_life(amap);
+                trace_end("map_fill_with_life", span, nmap);
+                rand_use(prev);
+            }
+
+            timewheel_add(g->timers, t->due + game_spawn_period(nmap),
+                          GT_SPAWN, t->id);
+        }
+            break;
+
+        case GT_BANK_INTEREST:
+        {
+            gint64 span = trace_begin();
+            building_bank_calc_interest(g);
+            trace_end("bank_interest", span, -1);
+            timewheel_add(g->timers, t->due + 1000, GT_BANK_INTEREST, NULL);
+        }
+            break;
+        }
+    }
+
+    g_array_free(fired, TRUE);
+}
+
 static void game_items_shuffle(game *g)
 {
     shuffle(g->amulet_material_mapping, AM_MAX, 0);
@@ -811,6 +2249,9 @@ static void game_items_shuffle(game *g)
 
 void game_delete_savefile()
 {
+    /* the keys pressed since the last save are worthless without it */
+    journal_wal_close(TRUE);
+
     if (sgfd == 0)
     {
         /* no savegame present */
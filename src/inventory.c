@@ -17,6 +17,7 @@
  */
 
 #include <glib.h>
+#include <string.h>
 
 #include "amulets.h"
 #include "game.h"
@@ -78,6 +79,26 @@ cJSON *inv_serialize(inventory *inv)
     return sinv;
 }
 
+void inv_objects_serialize(inventory *inv, cJSON *effects, cJSON *items)
+{
+    for (guint idx = 0; idx < inv_length(inv); idx++)
+    {
+        item *it = inv_get(inv, idx);
+
+        item_serialize(it->oid, it, items);
+
+        for (guint eidx = 0; it->effects && eidx < it->effects->len; eidx++)
+        {
+            gpointer effect_id = g_ptr_array_index(it->effects, eidx);
+            effect *e = game_effect_get(nlarn, effect_id);
+
+            if (e != NULL) effect_serialize(effect_id, e, effects);
+        }
+
+        inv_objects_serialize(it->content, effects, items);
+    }
+}
+
 inventory *inv_deserialize(cJSON *iser)
 {
     inventory *inv = g_malloc0(sizeof(inventory));
@@ -136,6 +157,7 @@ int inv_add(inventory **inv, item *it)
             {
                 /* just increase item count and release the original */
                 i->count += it->count;
+                item_desc_invalidate();
                 item_destroy(it);
 
                 it = NULL;
@@ -281,6 +303,51 @@ void inv_sort(inventory *inv, GCompareDataFunc compare_func, gpointer user_data)
     g_ptr_array_sort_with_data(inv->content, compare_func, user_data);
 }
 
+/* element used by inv_sort_by_key() */
+typedef struct inv_sort_element
+{
+    gchar *key;
+    gpointer oid;
+} inv_sort_element;
+
+static gint inv_sort_element_compare(gconstpointer a, gconstpointer b)
+{
+    return strcmp(((inv_sort_element *)a)->key, ((inv_sort_element *)b)->key);
+}
+
+void inv_sort_by_key(inventory *inv,
+                     gchar *(*key_func)(item *it, gpointer data),
+                     gpointer user_data)
+{
+    g_assert(inv != NULL && inv->content != NULL && key_func != NULL);
+
+    guint len = inv_length(inv);
+    GArray *elements = g_array_sized_new(FALSE, FALSE,
+                                         sizeof(inv_sort_element), len);
+
+    /* decorate: build every key exactly once */
+    for (guint idx = 0; idx < len; idx++)
+    {
+        inv_sort_element el;
+        el.oid = g_ptr_array_index(inv->content, idx);
+        el.key = key_func(game_item_get(nlarn, el.oid), user_data);
+        g_array_append_val(elements, el);
+    }
+
+    /* sort, keeping the order of items with identical keys */
+    g_array_sort(elements, inv_sort_element_compare);
+
+    /* undecorate: write back the sorted item ids */
+    for (guint idx = 0; idx < len; idx++)
+    {
+        inv_sort_element *el = &g_array_index(elements, inv_sort_element, idx);
+        g_ptr_array_index(inv->content, idx) = el->oid;
+        g_free(el->key);
+    }
+
+    g_array_free(elements, TRUE);
+}
+
 int inv_weight(inventory *inv)
 {
     int sum = 0;
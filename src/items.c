@@ -285,7 +285,10 @@ item *item_new_by_level(item_t item_type, int num_level)
     item *nitem;
     float variance, id_base, divisor;
 
-    g_assert (item_type > IT_NONE && item_type < IT_MAX && num_level < MAP_MAX);
+    g_assert (item_type > IT_NONE && item_type < IT_MAX && num_level < pos_levels());
+
+    /* the items of the corresponding level of the classic dungeon */
+    num_level = map_level_classic(num_level);
 
     /* no amulets above caverns level 6 */
     if ((item_type == IT_AMULET) && (num_level < 6))
@@ -393,17 +396,19 @@ item *item_copy(item *original)
     nitem = g_malloc0(sizeof(item));
     memcpy(nitem, original, sizeof(item));
 
-    /* copy effects */
+    /* register copy with game */
+    nitem->oid = game_item_register(nlarn, nitem);
+
+    /* copy effects, linking them to the copy */
     nitem->effects = NULL;
 
     if (original->effects != NULL)
     {
         for (guint idx = 0; idx < original->effects->len; idx++)
         {
-            effect *e = g_ptr_array_index(original->effects, idx);
+            effect *e = game_effect_get(nlarn, g_ptr_array_index(original->effects, idx));
             effect *ne = effect_copy(e);
 
-            ne->item = nitem;
             item_effect_add(nitem, ne);
         }
     }
@@ -411,9 +416,6 @@ item *item_copy(item *original)
     /* reset inventory */
     nitem->content = NULL;
 
-    /* register copy with game */
-    nitem->oid = game_item_register(nlarn, nitem);
-
     return nitem;
 }
 
@@ -427,6 +429,7 @@ item *item_split(item *original, guint32 count)
 
     nitem->count = count;
     original->count -= count;
+    item_desc_invalidate();
 
     return nitem;
 }
@@ -460,6 +463,10 @@ void item_destroy(item *it)
         g_free(it->notes);
     }
 
+    /* drop cached descriptions */
+    if (nlarn->item_descs != NULL)
+        g_hash_table_remove(nlarn->item_descs, it->oid);
+
     /* unregister item */
     game_item_unregister(nlarn, it->oid);
 
@@ -609,48 +616,119 @@ int item_compare(item *a, item *b)
     return result;
 }
 
-int item_sort(gconstpointer a, gconstpointer b, gpointer data, gboolean force_id)
+gchar *item_sort_key(item *it, player *p, gboolean force_id)
 {
-    gint order;
-    item *item_a = game_item_get(nlarn, *((gpointer**)a));
-    item *item_b = game_item_get(nlarn, *((gpointer**)b));
-    player *p = (player *)data;
+    g_assert(it != NULL && p != NULL);
 
-    if (item_a->type == item_b->type)
-    {
-        /* Both items are of identical type. Compare their names. */
-        order = g_ascii_strcasecmp(item_desc_get(item_a, force_id || player_item_known(p, item_a)),
-                                   item_desc_get(item_b, force_id || player_item_known(p, item_b)));
-    }
-    else if (item_a->type < item_b->type)
-        order = -1;
-    else
-        order = 1;
+    gchar *name = g_ascii_strdown(item_desc_get(it,
+                force_id || player_item_known(p, it)), -1);
 
-    return order;
+    /* the type is zero-padded to make the keys sort by item type first */
+    gchar *key = g_strdup_printf("%02d %s", it->type, name);
+    g_free(name);
+
+    return key;
 }
 
-gchar *item_describe(item *it, gboolean known, gboolean singular, gboolean definite)
+/* cached descriptions of a single item */
+typedef struct item_desc_cache
 {
-    GString *desc = g_string_new(NULL);
+    item state;         /* copy of the item the descriptions belong to */
+    guint32 version;    /* description version at the time of caching */
+    gchar *desc[8];     /* indexed by known | singular << 1 | definite << 2 */
+} item_desc_cache;
+
+static void item_desc_cache_destroy(item_desc_cache *dc)
+{
+    for (guint idx = 0; idx < G_N_ELEMENTS(dc->desc); idx++)
+        g_free(dc->desc[idx]);
+
+    g_free(dc);
+}
+
+static gchar *item_describe_uncached(item *it, gboolean known,
+                                     gboolean singular, gboolean definite);
+
+void item_desc_invalidate()
+{
+    nlarn->item_desc_version++;
+}
+
+static gboolean item_desc_stale(gpointer oid, item_desc_cache *dc,
+                                gpointer version)
+{
+    item *it = game_item_get(nlarn, oid);
+
+    return (dc->version != GPOINTER_TO_UINT(version) || it == NULL
+            || memcmp(&dc->state, it, sizeof(item)) != 0);
+}
 
+void item_desc_compact()
+{
+    if (nlarn->item_descs == NULL)
+        return;
+
+    g_hash_table_foreach_remove(nlarn->item_descs, (GHRFunc)item_desc_stale,
+                                GUINT_TO_POINTER(nlarn->item_desc_version));
+}
+
+gchar *item_describe(item *it, gboolean known, gboolean singular, gboolean definite)
+{
     g_assert((it != NULL) && (it->type > IT_NONE) && (it->type < IT_MAX));
 
     /*
-     * Return a simplified description if the player is blinded.
+     * Blinded players get a simplified description which is not cached.
      * We need to ensure the player object exists as this function
      * is called very early in the game.
      */
     if (nlarn->p && player_effect_get(nlarn->p, ET_BLINDNESS))
     {
         struct item_type_data itd = item_data[it->type];
-        g_string_append_printf(desc, "%s %s",
+        return g_strdup_printf("%s %s",
             it->count == 1 ? a_an(itd.name_sg) : "some",
             it->count == 1 ? itd.name_sg : itd.name_pl);
+    }
 
-        return g_string_free(desc, FALSE);
+    if (nlarn->item_descs == NULL)
+    {
+        nlarn->item_descs = g_hash_table_new_full(&g_direct_hash,
+                &g_direct_equal, NULL, (GDestroyNotify)item_desc_cache_destroy);
     }
 
+    item_desc_cache *dc = g_hash_table_lookup(nlarn->item_descs, it->oid);
+
+    /*
+     * Discard the cached descriptions if the version has been increased or
+     * if the item has been modified directly, e.g. a count change.
+     */
+    if (dc != NULL && (dc->version != nlarn->item_desc_version
+                       || memcmp(&dc->state, it, sizeof(item)) != 0))
+    {
+        g_hash_table_remove(nlarn->item_descs, it->oid);
+        dc = NULL;
+    }
+
+    if (dc == NULL)
+    {
+        dc = g_malloc0(sizeof(item_desc_cache));
+        memcpy(&dc->state, it, sizeof(item));
+        dc->version = nlarn->item_desc_version;
+        g_hash_table_insert(nlarn->item_descs, it->oid, dc);
+    }
+
+    guint slot = (known ? 1 : 0) | (singular ? 2 : 0) | (definite ? 4 : 0);
+
+    if (dc->desc[slot] == NULL)
+        dc->desc[slot] = item_describe_uncached(it, known, singular, definite);
+
+    return g_strdup(dc->desc[slot]);
+}
+
+static gchar *item_describe_uncached(item *it, gboolean known,
+                                     gboolean singular, gboolean definite)
+{
+    GString *desc = g_string_new(NULL);
+
     /* collect additional information */
     char *add_info = NULL;
     char **add_infos = strv_new();
@@ -1169,6 +1247,7 @@ int item_bless(item *it)
         return FALSE;
 
     it->blessed = TRUE;
+    item_desc_invalidate();
 
     return TRUE;
 }
@@ -1181,6 +1260,7 @@ int item_curse(item *it)
         return FALSE;
 
     it->cursed = TRUE;
+    item_desc_invalidate();
 
     return TRUE;
 }
@@ -1194,6 +1274,7 @@ int item_remove_curse(item *it)
 
     it->cursed = FALSE;
     it->blessed_known = TRUE;
+    item_desc_invalidate();
 
     return TRUE;
 }
@@ -1203,6 +1284,7 @@ item *item_enchant(item *it)
     g_assert(it != NULL);
 
     it->bonus++;
+    item_desc_invalidate();
 
     /* warn against over-enchantment */
     if (it->bonus == 3)
@@ -1254,6 +1336,7 @@ item *item_disenchant(item *it)
     }
 
     it->bonus--;
+    item_desc_invalidate();
 
     if (it->bonus == -3)
     {
@@ -1377,6 +1460,9 @@ item *item_erode(inventory **inv, item *it, item_erosion_type iet, gboolean visi
         break;
     }
 
+    if (erosion_desc != NULL)
+        item_desc_invalidate();
+
     if (erosion_desc != NULL && visible)
     {
         /* items has been eroded, describe the event if it is visible */
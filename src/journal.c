@@ -0,0 +1,613 @@
+/*
+ * journal.c
+ * Copyright (C) 2009-2020 Joachim de Groot <jdegroot@web.de>
+ *
+ * NLarn is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * NLarn is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifdef __linux__
+# ifndef _GNU_SOURCE
+#  define _GNU_SOURCE
+# endif
+#endif
+
+#include <glib.h>
+#include <glib/gprintf.h>
+#include <glib/gstdio.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef G_OS_WIN32
+# include <io.h>
+#else
+# include <unistd.h>
+#endif
+
+#include "config.h"
+#include "journal.h"
+#include "nlarn.h"
+
+/*
+ * The journal starts with a header: the magic, the game version and the
+ * settings. Numbers are stored as unsigned LEB128, strings as their
+ * length plus one (zero for no string) followed by the characters.
+ *
+ * The header is followed by records, each starting with a number: one of
+ * the record types below or a key, hence most keys take a single byte. A
+ * seed is followed by its value, the final record by the length and the
+ * characters of the hash of the final state.
+ */
+static const char journal_magic[4] = { 'N', 'L', 'J', '1' };
+
+/*
+ * The write-ahead journal starts with its magic and the hash of the
+ * saved game it follows, stored as string. The keys follow, each stored
+ * as key + 1.
+ */
+static const char wal_magic[4] = { 'N', 'L', 'W', '1' };
+
+/* keys written to the write-ahead journal before it is forced to disk */
+#define WAL_BATCH 16
+
+typedef enum journal_record_type
+{
+    JR_SEED,    /* the seed of a new game */
+    JR_END,     /* the end of the journal */
+    JR_KEY,     /* stored as key + 1 + JR_MAX, as curses returns -1 for errors */
+    JR_MAX
+} journal_record_t;
+
+typedef enum journal_mode
+{
+    JM_OFF,
+    JM_RECORD,
+    JM_REPLAY
+} journal_mode;
+
+/* the content of a journal being read */
+typedef struct journal_buf
+{
+    gchar *data;
+    gsize len;
+    gsize pos;
+} journal_buf;
+
+static struct
+{
+    journal_mode mode;
+    FILE *file;         /* the journal being recorded */
+    journal_buf in;     /* the journal being replayed */
+    gchar *dir;         /* temporary directory of a replay */
+    gchar *hash;        /* hash of the state of the last game ended */
+    guint keys;
+    gint64 started;
+} journal = { 0 };
+
+static struct
+{
+    FILE *file;
+    gchar *snapshot;    /* hash of the saved game the keys follow */
+    journal_buf in;     /* keys left by a previous run, being recovered */
+    guint length;       /* keys since the snapshot */
+    guint unsynced;     /* keys not forced to disk yet */
+} wal = { 0 };
+
+static void journal_put(FILE *file, guint64 value)
+{
+    do
+    {
+        guchar byte = value & 0x7f;
+        value >>= 7;
+        fputc(value ? byte | 0x80 : byte, file);
+    }
+    while (value);
+}
+
+static void journal_put_string(FILE *file, const char *str)
+{
+    const gsize len = str ? strlen(str) : 0;
+
+    journal_put(file, str ? len + 1 : 0);
+    fwrite(str, 1, len, file);
+}
+
+static void journal_put_record(journal_record_t type, guint64 value)
+{
+    if (type == JR_KEY)
+    {
+        journal_put(journal.file, value + JR_MAX);
+    }
+    else
+    {
+        journal_put(journal.file, type);
+        journal_put(journal.file, value);
+    }
+
+    /* keep everything recorded up to a crash */
+    fflush(journal.file);
+}
+
+static gboolean journal_get(journal_buf *in, guint64 *value)
+{
+    *value = 0;
+
+    for (guint shift = 0; in->pos < in->len && shift < 64; shift += 7)
+    {
+        const guchar byte = in->data[in->pos++];
+        *value |= (guint64)(byte & 0x7f) << shift;
+
+        if (!(byte & 0x80))
+            return TRUE;
+    }
+
+    return FALSE;
+}
+
+static gboolean journal_get_string(journal_buf *in, char **str)
+{
+    guint64 len;
+
+    if (!journal_get(in, &len) || len > in->len - in->pos + 1)
+        return FALSE;
+
+    g_free(*str);
+    *str = len ? g_strndup(in->data + in->pos, len - 1) : NULL;
+    in->pos += len ? len - 1 : 0;
+
+    return TRUE;
+}
+
+/* read a file which starts with the given magic */
+static gboolean journal_read(const char *filename, const char magic[4],
+                             journal_buf *in)
+{
+    if (!g_file_get_contents(filename, &in->data, &in->len, NULL))
+        return FALSE;
+
+    in->pos = 4;
+
+    if (in->len < 4 || memcmp(in->data, magic, 4))
+    {
+        g_free(in->data);
+        memset(in, 0, sizeof(journal_buf));
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+/* get the next record, returns JR_MAX at the end of the journal */
+static journal_record_t journal_get_record(guint64 *value)
+{
+    guint64 rec;
+
+    if (!journal_get(&journal.in, &rec))
+        return JR_MAX;
+
+    if (rec >= JR_MAX)
+    {
+        *value = rec - JR_MAX;
+        return JR_KEY;
+    }
+
+    if (rec == JR_KEY || !journal_get(&journal.in, value))
+        return JR_MAX;
+
+    return rec;
+}
+
+static gchar *journal_final_hash()
+{
+    if (nlarn != NULL && nlarn->p != NULL)
+        journal_game_end(nlarn);
+
+    return journal.hash;
+}
+
+static void journal_atexit()
+{
+    journal_close();
+}
+
+gboolean journal_record(const char *filename, struct game_config *config)
+{
+    g_assert(filename != NULL && journal.mode == JM_OFF);
+
+    if ((journal.file = fopen(filename, "wb")) == NULL)
+        return FALSE;
+
+    fwrite(journal_magic, 1, sizeof(journal_magic), journal.file);
+    journal_put_string(journal.file, nlarn_version);
+    /* the depth of a deeper dungeon and the dimensions of larger levels
+       are kept above the difficulty, thus journals of classic games are
+       written as before */
+    journal_put(journal.file, config->difficulty
+                | ((guint64)config->depth << 16)
+                | ((guint64)config->map_width << 32)
+                | ((guint64)config->map_height << 48));
+    journal_put(journal.file, config->wizard);
+    journal_put(journal.file, config->no_autosave);
+    journal_put_string(journal.file, config->name);
+    journal_put_string(journal.file, config->gender);
+    journal_put_string(journal.file, config->stats);
+    journal_put_string(journal.file, config->auto_pickup);
+
+    journal.mode = JM_RECORD;
+    atexit(journal_atexit);
+
+    return TRUE;
+}
+
+gboolean journal_replay(const char *filename, struct game_config *config)
+{
+    guint64 difficulty, wizard, no_autosave;
+    char *version = NULL;
+    journal_buf *in = &journal.in;
+
+    g_assert(filename != NULL && journal.mode == JM_OFF);
+
+    if (!journal_read(filename, journal_magic, in))
+        return FALSE;
+
+    if (!journal_get_string(in, &version)
+            || !journal_get(in, &difficulty)
+            || !journal_get(in, &wizard)
+            || !journal_get(in, &no_autosave)
+            || !journal_get_string(in, &config->name)
+            || !journal_get_string(in, &config->gender)
+            || !journal_get_string(in, &config->stats)
+            || !journal_get_string(in, &config->auto_pickup))
+    {
+        g_free(in->data);
+        g_free(version);
+        return FALSE;
+    }
+
+    /* replays are meant to compare versions, hence differences are fine */
+    g_free(version);
+
+    config->difficulty = difficulty & G_MAXUINT16;
+    config->depth = (difficulty >> 16) & 0xffff;
+    config->map_width = (difficulty >> 32) & 0xffff;
+    config->map_height = difficulty >> 48;
+    config->wizard = wizard;
+    config->no_autosave = no_autosave;
+
+    /* keep the player's saved game, scores and settings out of the way */
+    if ((journal.dir = g_dir_make_tmp("nlarn-replay-XXXXXX", NULL)) == NULL)
+    {
+        g_free(in->data);
+        return FALSE;
+    }
+
+    journal.mode = JM_REPLAY;
+    journal.started = g_get_monotonic_time();
+    atexit(journal_atexit);
+
+    return TRUE;
+}
+
+gboolean journal_close()
+{
+    gboolean matches = TRUE;
+
+    if (journal.mode == JM_RECORD)
+    {
+        const gchar *hash = journal_final_hash();
+        const gsize len = hash ? strlen(hash) : 0;
+
+        journal_put_record(JR_END, len);
+        fwrite(hash, 1, len, journal.file);
+        fclose(journal.file);
+    }
+    else if (journal.mode == JM_REPLAY)
+    {
+        const gchar *hash = journal_final_hash();
+        journal_buf *in = &journal.in;
+        guint64 len;
+        journal_record_t type;
+
+        /* skip what is left, e.g. when the game has been quit early */
+        while ((type = journal_get_record(&len)) != JR_END && type != JR_MAX);
+
+        g_printf("Replayed %u keys in %.3f seconds.\n", journal.keys,
+                 (g_get_monotonic_time() - journal.started) / 1000000.0);
+        g_printf("Final state: %s\n", hash ? hash : "none");
+
+        if (type == JR_MAX || len > in->len - in->pos)
+        {
+            g_printf("The journal is incomplete, there is nothing to compare with.\n");
+        }
+        else
+        {
+            matches = (len == (hash ? strlen(hash) : 0))
+                && (len == 0 || !memcmp(in->data + in->pos, hash, len));
+
+            g_printf("The final state %s the recorded one.\n",
+                     matches ? "matches" : "DIFFERS from");
+        }
+
+        /* remove the files written while replaying */
+        GDir *dir = g_dir_open(journal.dir, 0, NULL);
+        const gchar *name;
+
+        while (dir && (name = g_dir_read_name(dir)))
+        {
+            gchar *path = g_build_filename(journal.dir, name, NULL);
+            g_unlink(path);
+            g_free(path);
+        }
+
+        if (dir) g_dir_close(dir);
+        g_rmdir(journal.dir);
+
+        g_free(journal.dir);
+        g_free(in->data);
+    }
+
+    g_free(journal.hash);
+    memset(&journal, 0, sizeof(journal));
+
+    return matches;
+}
+
+gboolean journal_active()
+{
+    return journal.mode != JM_OFF;
+}
+
+gboolean journal_replaying()
+{
+    return journal.mode == JM_REPLAY;
+}
+
+const char *journal_replay_dir()
+{
+    return journal.dir;
+}
+
+/* the game does not do what has been recorded */
+static void journal_out_of_step()
+{
+    g_printerr("The replay is out of step with the journal.\n");
+
+    exit(EXIT_FAILURE);
+}
+
+guint32 journal_seed(guint32 seed)
+{
+    guint64 value;
+
+    switch (journal.mode)
+    {
+    case JM_RECORD:
+        journal_put_record(JR_SEED, seed);
+        break;
+
+    case JM_REPLAY:
+        if (journal_get_record(&value) != JR_SEED)
+            journal_out_of_step();
+
+        seed = value;
+        break;
+
+    default:
+        break;
+    }
+
+    return seed;
+}
+
+/* force the write-ahead journal to disk */
+static void journal_wal_sync()
+{
+    fflush(wal.file);
+#ifdef G_OS_WIN32
+    _commit(_fileno(wal.file));
+#else
+    fsync(fileno(wal.file));
+#endif
+    wal.unsynced = 0;
+}
+
+static void journal_wal_add(int key)
+{
+    if (wal.file == NULL)
+        return;
+
+    journal_put(wal.file, key + 1);
+    wal.length++;
+
+    /* the key survives a crash of the game, but not of the system */
+    fflush(wal.file);
+
+    if (++wal.unsynced == WAL_BATCH)
+        journal_wal_sync();
+}
+
+void journal_key_add(int key)
+{
+    if (journal.mode == JM_RECORD)
+        journal_put_record(JR_KEY, key + 1);
+
+    journal_wal_add(key);
+}
+
+gboolean journal_key_next(int *key)
+{
+    guint64 value;
+
+    /* the keys pressed before the game has been interrupted come first */
+    if (journal_recovering())
+    {
+        if (journal_get(&wal.in, &value))
+        {
+            wal.length++;
+            *key = (int)value - 1;
+            return TRUE;
+        }
+
+        /* all keys have been recovered, the player takes over */
+        g_free(wal.in.data);
+        memset(&wal.in, 0, sizeof(journal_buf));
+    }
+
+    if (journal.mode != JM_REPLAY)
+        return FALSE;
+
+    const gsize pos = journal.in.pos;
+
+    switch (journal_get_record(&value))
+    {
+    case JR_KEY:
+        journal.keys++;
+        *key = (int)value - 1;
+
+        /* snapshots have to be taken when they were during the recording */
+        journal_wal_add(*key);
+        return TRUE;
+
+    case JR_SEED:
+        journal_out_of_step();
+        break;
+
+    default:
+        /* all keys have been replayed: the game would wait for the player */
+        journal.in.pos = pos;
+        exit(journal_close() ? EXIT_SUCCESS : EXIT_FAILURE);
+    }
+
+    return FALSE;
+}
+
+gboolean journal_key_pending()
+{
+    guint64 value;
+
+    if (journal_recovering() && wal.in.pos < wal.in.len)
+        return TRUE;
+
+    if (journal.mode != JM_REPLAY)
+        return FALSE;
+
+    /* look at the next record without taking it */
+    journal_buf in = journal.in;
+
+    return journal_get(&in, &value) && value >= JR_MAX;
+}
+
+void journal_game_end(game *g)
+{
+    g_assert(g != NULL);
+
+    g_free(journal.hash);
+    journal.hash = game_state_hash(g);
+}
+
+static gchar *journal_wal_filename()
+{
+    return g_strconcat(nlarn_savefile, ".wal", NULL);
+}
+
+/* start an empty write-ahead journal following the current snapshot */
+static void journal_wal_create()
+{
+    gchar *filename = journal_wal_filename();
+
+    if (wal.file != NULL)
+        fclose(wal.file);
+
+    if ((wal.file = fopen(filename, "wb")) != NULL)
+    {
+        fwrite(wal_magic, 1, sizeof(wal_magic), wal.file);
+        journal_put_string(wal.file, wal.snapshot);
+        journal_wal_sync();
+    }
+
+    wal.length = 0;
+    g_free(filename);
+}
+
+void journal_wal_open()
+{
+    gchar *filename, *snapshot = NULL;
+
+    g_assert(wal.file == NULL);
+
+    /* without a saved game, there is nothing the keys could follow */
+    if (wal.snapshot == NULL)
+        return;
+
+    filename = journal_wal_filename();
+
+    /* recover the keys pressed after the game has been saved */
+    if (journal_read(filename, wal_magic, &wal.in)
+            && journal_get_string(&wal.in, &snapshot)
+            && snapshot && !strcmp(snapshot, wal.snapshot)
+            && (wal.file = fopen(filename, "ab")))
+    {
+        wal.length = 0;
+    }
+    else
+    {
+        g_free(wal.in.data);
+        memset(&wal.in, 0, sizeof(journal_buf));
+
+        journal_wal_create();
+    }
+
+    g_free(snapshot);
+    g_free(filename);
+}
+
+void journal_wal_snapshot(const char *hash)
+{
+    g_free(wal.snapshot);
+    wal.snapshot = g_strdup(hash);
+
+    /* the keys pressed so far are part of the snapshot now */
+    if (wal.file != NULL)
+        journal_wal_create();
+}
+
+void journal_wal_close(gboolean remove)
+{
+    if (wal.file != NULL)
+    {
+        journal_wal_sync();
+        fclose(wal.file);
+    }
+
+    if (remove)
+    {
+        gchar *filename = journal_wal_filename();
+        g_unlink(filename);
+        g_free(filename);
+    }
+
+    g_free(wal.snapshot);
+    g_free(wal.in.data);
+    memset(&wal, 0, sizeof(wal));
+}
+
+guint journal_wal_length()
+{
+    return wal.length;
+}
+
+gboolean journal_recovering()
+{
+    return wal.in.data != NULL;
+}
@@ -0,0 +1,446 @@
+/*
+ * levelstore.c
+ * Copyright (C) 2009-2020 Joachim de Groot <jdegroot@web.de>
+ *
+ * NLarn is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * NLarn is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifdef __linux__
+# ifndef _GNU_SOURCE
+#  define _GNU_SOURCE
+# endif
+#endif
+
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <stdio.h>
+
+#if (defined __unix) || (defined __unix__) || (defined __APPLE__)
+# include <unistd.h>
+#endif
+
+#ifdef WIN32
+# include <io.h>
+#endif
+
+#include "codec.h"
+#include "levelstore.h"
+
+typedef enum page_state
+{
+    LP_EMPTY,       /* not in the store */
+    LP_STORED,      /* in the file */
+    LP_QUEUED,      /* waiting for the worker to read it */
+    LP_READING,     /* being read by the worker */
+    LP_READ         /* read ahead and decompressed */
+} page_state;
+
+typedef struct page
+{
+    page_state state;
+    guint64 offset;     /* where the page starts in the file */
+    GArray *lengths;    /* the sizes of the compressed parts, gsize */
+    gchar **texts;      /* the parts read ahead */
+} page;
+
+/* a part of the file not used by any page */
+typedef struct extent
+{
+    guint64 offset;
+    guint64 len;
+} extent;
+
+struct level_store
+{
+    FILE *file;
+    gchar *filename;
+    guint64 end;        /* the size of the file */
+    GArray *holes;      /* unused extents, sorted by offset */
+    guint npages;
+    page *pages;
+    GThreadPool *reader;
+    GMutex mutex;       /* guards the pages, the holes and the file */
+    GCond read;
+};
+
+static guint64 page_length(page *p)
+{
+    guint64 len = 0;
+
+    for (guint idx = 0; idx < p->lengths->len; idx++)
+        len += g_array_index(p->lengths, gsize, idx);
+
+    return len;
+}
+
+/* find room for a page, preferring the first hole large enough */
+static guint64 level_store_alloc(level_store *ls, guint64 len)
+{
+    for (guint idx = 0; idx < ls->holes->len; idx++)
+    {
+        extent *h = &g_array_index(ls->holes, extent, idx);
+
+        if (h->len < len)
+            continue;
+
+        const guint64 offset = h->offset;
+
+        h->offset += len;
+        h->len -= len;
+
+        if (h->len == 0)
+            g_array_remove_index(ls->holes, idx);
+
+        return offset;
+    }
+
+    const guint64 offset = ls->end;
+    ls->end += len;
+
+    return offset;
+}
+
+/* return the room of a page, merging it with adjacent holes */
+static void level_store_release(level_store *ls, guint64 offset, guint64 len)
+{
+    guint idx = 0;
+
+    if (len == 0)
+        return;
+
+    while (idx < ls->holes->len
+            && g_array_index(ls->holes, extent, idx).offset < offset)
+    {
+        idx++;
+    }
+
+    extent e = { offset, len };
+    g_array_insert_val(ls->holes, idx, e);
+
+    /* merge with the following hole */
+    if (idx + 1 < ls->holes->len)
+    {
+        extent *h = &g_array_index(ls->holes, extent, idx);
+        extent *next = &g_array_index(ls->holes, extent, idx + 1);
+
+        if (h->offset + h->len == next->offset)
+        {
+            h->len += next->len;
+            g_array_remove_index(ls->holes, idx + 1);
+        }
+    }
+
+    /* merge with the preceding hole */
+    if (idx > 0)
+    {
+        extent *prev = &g_array_index(ls->holes, extent, idx - 1);
+        extent *h = &g_array_index(ls->holes, extent, idx);
+
+        if (prev->offset + prev->len == h->offset)
+        {
+            prev->len += h->len;
+            g_array_remove_index(ls->holes, idx);
+            idx--;
+        }
+    }
+
+    /* the file does not have to keep a hole at its end */
+    extent *last = &g_array_index(ls->holes, extent, ls->holes->len - 1);
+    if (last->offset + last->len == ls->end)
+    {
+        ls->end = last->offset;
+        g_array_remove_index(ls->holes, ls->holes->len - 1);
+    }
+}
+
+/* read the parts of a page; the mutex has to be held */
+static GPtrArray *level_store_parts_read(level_store *ls, page *p)
+{
+    GPtrArray *parts = g_ptr_array_new_with_free_func(
+            (GDestroyNotify)g_bytes_unref);
+
+    if (fseek(ls->file, (long)p->offset, SEEK_SET) != 0)
+    {
+        g_ptr_array_free(parts, TRUE);
+        return NULL;
+    }
+
+    for (guint idx = 0; idx < p->lengths->len; idx++)
+    {
+        const gsize len = g_array_index(p->lengths, gsize, idx);
+        guchar *data = g_malloc(len > 0 ? len : 1);
+
+        if (fread(data, 1, len, ls->file) != len)
+        {
+            g_free(data);
+            g_ptr_array_free(parts, TRUE);
+            return NULL;
+        }
+
+        g_ptr_array_add(parts, g_bytes_new_take(data, len));
+    }
+
+    return parts;
+}
+
+static gchar **level_store_parts_decompress(GPtrArray *parts)
+{
+    gchar **texts = g_new0(gchar *, parts->len + 1);
+
+    for (guint idx = 0; idx < parts->len; idx++)
+    {
+        gsize len;
+        gconstpointer data = g_bytes_get_data(g_ptr_array_index(parts, idx), &len);
+
+        if ((texts[idx] = codec_decompress(data, len, NULL)) == NULL)
+        {
+            g_strfreev(texts);
+            return NULL;
+        }
+    }
+
+    return texts;
+}
+
+static void level_store_reader(gpointer data, gpointer user_data)
+{
+    level_store *ls = (level_store *)user_data;
+    page *p = &ls->pages[GPOINTER_TO_UINT(data) - 1];
+
+    g_mutex_lock(&ls->mutex);
+    if (p->state != LP_QUEUED)
+    {
+        /* the page has been taken in the meantime */
+        g_mutex_unlock(&ls->mutex);
+        return;
+    }
+
+    p->state = LP_READING;
+    GPtrArray *parts = level_store_parts_read(ls, p);
+    g_mutex_unlock(&ls->mutex);
+
+    /* pages which cannot be read here are read again when taken */
+    gchar **texts = NULL;
+
+    if (parts != NULL)
+    {
+        texts = level_store_parts_decompress(parts);
+        g_ptr_array_free(parts, TRUE);
+    }
+
+    g_mutex_lock(&ls->mutex);
+    p->texts = texts;
+    p->state = LP_READ;
+    g_cond_broadcast(&ls->read);
+    g_mutex_unlock(&ls->mutex);
+}
+
+level_store *level_store_new(guint npages)
+{
+    gchar *filename = NULL;
+    int fd = g_file_open_tmp("nlarn-levels-XXXXXX", &filename, NULL);
+
+    if (fd == -1)
+        return NULL;
+
+    FILE *file = fdopen(fd, "w+b");
+
+    if (file == NULL)
+    {
+        close(fd);
+        g_unlink(filename);
+        g_free(filename);
+        return NULL;
+    }
+
+#ifndef WIN32
+    /* the file vanishes with the process, even if the game crashes */
+    g_unlink(filename);
+#endif
+
+    level_store *ls = g_malloc0(sizeof(level_store));
+    ls->file = file;
+    ls->filename = filename;
+    ls->holes = g_array_new(FALSE, FALSE, sizeof(extent));
+    ls->npages = npages;
+    ls->pages = g_new0(page, npages);
+    ls->reader = g_thread_pool_new(level_store_reader, ls, 1, FALSE, NULL);
+    g_mutex_init(&ls->mutex);
+    g_cond_init(&ls->read);
+
+    return ls;
+}
+
+void level_store_destroy(level_store *ls)
+{
+    g_assert(ls != NULL);
+
+    /* wait for the worker; queued pages are read needlessly */
+    g_thread_pool_free(ls->reader, FALSE, TRUE);
+
+    for (guint idx = 0; idx < ls->npages; idx++)
+    {
+        if (ls->pages[idx].lengths != NULL)
+            g_array_free(ls->pages[idx].lengths, TRUE);
+
+        g_strfreev(ls->pages[idx].texts);
+    }
+
+    fclose(ls->file);
+#ifdef WIN32
+    g_unlink(ls->filename);
+#endif
+
+    g_mutex_clear(&ls->mutex);
+    g_cond_clear(&ls->read);
+    g_array_free(ls->holes, TRUE);
+    g_free(ls->pages);
+    g_free(ls->filename);
+    g_free(ls);
+}
+
+gboolean level_store_put(level_store *ls, guint page_nr, GBytes **parts,
+                         guint nparts)
+{
+    g_assert(ls != NULL && page_nr < ls->npages);
+
+    page *p = &ls->pages[page_nr];
+    gboolean ok = TRUE;
+
+    g_mutex_lock(&ls->mutex);
+    g_assert(p->state == LP_EMPTY);
+
+    p->lengths = g_array_sized_new(FALSE, FALSE, sizeof(gsize), nparts);
+
+    for (guint idx = 0; idx < nparts; idx++)
+    {
+        const gsize len = g_bytes_get_size(parts[idx]);
+        g_array_append_val(p->lengths, len);
+    }
+
+    p->offset = level_store_alloc(ls, page_length(p));
+    ok = (fseek(ls->file, (long)p->offset, SEEK_SET) == 0);
+
+    for (guint idx = 0; ok && idx < nparts; idx++)
+    {
+        gsize len;
+        gconstpointer data = g_bytes_get_data(parts[idx], &len);
+
+        ok = (fwrite(data, 1, len, ls->file) == len);
+    }
+
+    ok = ok && (fflush(ls->file) == 0);
+
+    if (ok)
+    {
+        p->state = LP_STORED;
+    }
+    else
+    {
+        level_store_release(ls, p->offset, page_length(p));
+        g_array_free(p->lengths, TRUE);
+        p->lengths = NULL;
+    }
+
+    g_mutex_unlock(&ls->mutex);
+
+    return ok;
+}
+
+gboolean level_store_contains(level_store *ls, guint page_nr)
+{
+    g_assert(ls != NULL && page_nr < ls->npages);
+
+    g_mutex_lock(&ls->mutex);
+    const gboolean stored = (ls->pages[page_nr].state != LP_EMPTY);
+    g_mutex_unlock(&ls->mutex);
+
+    return stored;
+}
+
+void level_store_prefetch(level_store *ls, guint page_nr)
+{
+    g_assert(ls != NULL && page_nr < ls->npages);
+
+    g_mutex_lock(&ls->mutex);
+    const gboolean queue = (ls->pages[page_nr].state == LP_STORED);
+    if (queue) ls->pages[page_nr].state = LP_QUEUED;
+    g_mutex_unlock(&ls->mutex);
+
+    /* the pool does not take NULL, hence the pages are counted from 1 */
+    if (queue)
+        g_thread_pool_push(ls->reader, GUINT_TO_POINTER(page_nr + 1), NULL);
+}
+
+GPtrArray *level_store_read(level_store *ls, guint page_nr)
+{
+    g_assert(ls != NULL && page_nr < ls->npages);
+
+    g_mutex_lock(&ls->mutex);
+    g_assert(ls->pages[page_nr].state != LP_EMPTY);
+    GPtrArray *parts = level_store_parts_read(ls, &ls->pages[page_nr]);
+    g_mutex_unlock(&ls->mutex);
+
+    return parts;
+}
+
+gchar **level_store_take(level_store *ls, guint page_nr)
+{
+    g_assert(ls != NULL && page_nr < ls->npages);
+
+    page *p = &ls->pages[page_nr];
+    GPtrArray *parts = NULL;
+
+    g_mutex_lock(&ls->mutex);
+    g_assert(p->state != LP_EMPTY);
+
+    while (p->state == LP_READING)
+        g_cond_wait(&ls->read, &ls->mutex);
+
+    gchar **texts = p->texts;
+
+    /* read the page here if it has not been read ahead */
+    if (texts == NULL)
+        parts = level_store_parts_read(ls, p);
+
+    level_store_release(ls, p->offset, page_length(p));
+    g_array_free(p->lengths, TRUE);
+    p->lengths = NULL;
+    p->texts = NULL;
+    p->state = LP_EMPTY;
+    g_mutex_unlock(&ls->mutex);
+
+    if (parts != NULL)
+    {
+        texts = level_store_parts_decompress(parts);
+        g_ptr_array_free(parts, TRUE);
+    }
+
+    return texts;
+}
+
+guint64 level_store_used(level_store *ls)
+{
+    g_assert(ls != NULL);
+
+    g_mutex_lock(&ls->mutex);
+    guint64 used = ls->end;
+
+    for (guint idx = 0; idx < ls->holes->len; idx++)
+        used -= g_array_index(ls->holes, extent, idx).len;
+
+    g_mutex_unlock(&ls->mutex);
+
+    return used;
+}
@@ -18,27 +18,52 @@
 
 #include <glib.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "container.h"
+#include "counters.h"
 #include "display.h"
 #include "items.h"
 #include "map.h"
+#include "maze.h"
 #include "nlarn.h"
 #include "random.h"
 #include "sobjects.h"
 #include "spheres.h"
 
+/* monsters and items placed while a level is laid out; they are created
+ * by map_populate() as creating them registers them with the game */
+typedef enum map_spawn_t
+{
+    MS_MONSTER,
+    MS_MONSTER_BY_LEVEL,
+    MS_ITEM,
+    MS_ITEM_BY_LEVEL,
+    MS_ITEM_RANDOM
+} map_spawn_t;
+
+typedef struct map_spawn
+{
+    map_spawn_t what;
+    position pos;
+    guint32 type;   /* monster or item type */
+    guint32 id;     /* item id for MS_ITEM */
+} map_spawn;
+
 static int map_fill_with_stationary_objects(map *maze);
 static void map_fill_with_objects(map *m);
 static void map_fill_with_traps(map *m);
 
-static gboolean map_load_from_file(map *m, const char *mazefile, guint which);
+static void map_layout_destroy(map *m);
+static void map_spawn_add(map *m, map_spawn_t what, position pos,
+                          guint32 type, guint32 id);
+static gboolean map_load_from_file(map *m, guint which);
+static void place_special_item(map *m, position npos);
 static void map_make_maze(map *m, int treasure_room);
 static void map_make_maze_eat(map *m, int x, int y);
 static void map_make_river(map *m, map_tile_t rivertype);
 static void map_make_lake(map *m, map_tile_t laketype);
 static void map_make_treasure_room(map *m, rectangle **rooms);
-static int map_validate(map *m);
 
 static inline void map_sphere_destroy(sphere *s, map *m __attribute__((unused)))
 {
@@ -62,26 +87,9 @@ const map_tile_data map_tiles[LT_MAX] =
     { LT_WALL,      '#', LIGHTGRAY,  "a wall",      0, 0 },
 };
 
-/* keep track which levels have been used before */
-static int map_used[MAP_MAZE_NUM + 1] = { 1, 0 };
-
-const char *map_names[MAP_MAX] =
-{
-    "Town",
-    "D1",
-    "D2",
-    "D3",
-    "D4",
-    "D5",
-    "D6",
-    "D7",
-    "D8",
-    "D9",
-    "D10",
-    "V1",
-    "V2",
-    "V3"
-};
+/* the names of the levels of the volcano; those of the caverns are
+   numbered, see map_level_name() */
+static const char *map_volcano_names[MAP_VMAX] = { "V1", "V2", "V3" };
 
 static gboolean is_town(int nlevel)
 {
@@ -90,34 +98,209 @@ static gboolean is_town(int nlevel)
 
 static gboolean is_caverns_bottom(int nlevel)
 {
-    return (nlevel == MAP_CMAX - 1);
+    return (nlevel == map_volcano() - 1);
 }
 
 static gboolean is_volcano_bottom(int nlevel)
 {
-    return (nlevel == MAP_MAX - 1);
+    return (nlevel == pos_levels() - 1);
 }
 
 static gboolean is_volcano_map(int nlevel)
 {
-    return (nlevel >= MAP_CMAX);
+    return (nlevel >= map_volcano());
+}
+
+static gboolean is_volcano_top(int nlevel)
+{
+    return (nlevel == map_volcano());
+}
+
+int map_volcano()
+{
+    return pos_levels() - MAP_VMAX;
+}
+
+int map_level_classic(int nlevel)
+{
+    const int volcano = map_volcano();
+
+    if (is_town(nlevel) || volcano == MAP_CMAX)
+        return nlevel;
+
+    if (is_volcano_map(nlevel))
+        return nlevel - volcano + MAP_CMAX;
+
+    /* the first and the deepest level of the caverns stay what they are */
+    return 1 + (nlevel - 1) * (MAP_CMAX - 2) / (volcano - 2);
+}
+
+const char *map_level_name(int nlevel, int levels)
+{
+    static gsize named = 0;
+    static char caverns[MAP_DEPTH_LIMIT + 1][8];
+
+    g_assert(nlevel >= 0 && nlevel < levels);
+
+    if (nlevel >= levels - MAP_VMAX)
+        return map_volcano_names[nlevel - (levels - MAP_VMAX)];
+
+    if (is_town(nlevel))
+        return "Town";
+
+    /* the names are written once for all threads */
+    if (g_once_init_enter(&named))
+    {
+        for (int n = 1; n <= MAP_DEPTH_LIMIT; n++)
+            g_snprintf(caverns[n], sizeof(caverns[n]), "D%d", n);
+
+        g_once_init_leave(&named, 1);
+    }
+
+    return caverns[nlevel];
+}
+
+/* how many times a level is as large as a classic one */
+static int map_area_factor(map *m)
+{
+    return max(1, (m->width * m->height) / (MAP_MAX_X * MAP_MAX_Y));
 }
 
-map *map_new(int num, const char *mazefile)
+map *map_new(int num)
+{
+    gint maze = map_maze_choose(num);
+    map *nmap;
+
+    while ((nmap = map_layout_new(num, maze, nlarn->map_width,
+                                  nlarn->map_height)) == NULL)
+    {
+        maze = map_maze_replace(num, maze);
+    }
+
+    nlarn->maps[num] = nmap;
+
+    /* add inhabitants to the map */
+    map_populate(nmap);
+
+    return nmap;
+}
+
+/* the number of dead ends map_fill_with_stationary_objects() needs */
+static guint map_dead_ends_needed(int nlevel)
+{
+    guint needed = 0;
+
+    /* volcano shaft up from the temple */
+    if (is_volcano_top(nlevel))
+        needed++;
+
+    /* stairs down */
+    if (!is_town(nlevel) && !is_caverns_bottom(nlevel)
+            && !is_volcano_bottom(nlevel))
+        needed++;
+
+    /* stairs up */
+    if ((nlevel > 1) && !is_volcano_top(nlevel))
+        needed++;
+
+    /* branch office of the bank */
+    if (nlevel == 5)
+        needed++;
+
+    return needed;
+}
+
+gint map_maze_choose(int num)
+{
+    int candidates[MAP_MAZE_NUM];
+    int count = 0;
+
+    /* the town is stored in the file as the first maze; it is
+       chosen first for a new game, so forget the mazes used before */
+    if (is_town(num))
+    {
+        memset(nlarn->maze_used, 0, sizeof(nlarn->maze_used));
+        nlarn->maze_used[0] = TRUE;
+
+        return 0;
+    }
+
+    /* larger levels are dug as the mazes are of the classic size,
+       except for the bottom levels which need their mazes */
+    gboolean classic = (nlarn->map_width == MAP_MAX_X
+                        && nlarn->map_height == MAP_MAX_Y);
+
+    if (!is_caverns_bottom(num) /* level 10 */
+            && !is_volcano_bottom(num) /* volcano level 3 */
+            && !(classic && num > 1 && chance(25)))
+    {
+        /* dig a random maze */
+        return -1;
+    }
+
+    /* mazes without enough dead ends can never take the staircases */
+    for (int pass = 0; pass < 2 && count == 0; pass++)
+    {
+        for (int mnum = 1; mnum <= MAP_MAX_MAZE_NUM; mnum++)
+        {
+            const maze *mz = maze_get(mnum);
+
+            /* prefer mazes which have not been used yet */
+            if (mz != NULL && mz->dead_ends >= map_dead_ends_needed(num)
+                    && (pass > 0 || !nlarn->maze_used[mnum]))
+            {
+                candidates[count++] = mnum;
+            }
+        }
+    }
+
+    /* no maze fits: dig one */
+    if (count == 0)
+        return -1;
+
+    /* roll the dice: which map? */
+    int map_num = candidates[rand_0n(count)];
+    nlarn->maze_used[map_num] = TRUE;
+
+    return map_num;
+}
+
+gint map_maze_replace(int num, gint failed)
+{
+    gboolean used[MAP_MAZE_NUM];
+
+    g_assert(!is_town(num) && failed > 0);
+    memcpy(used, nlarn->maze_used, sizeof(used));
+
+    const gint maze = map_maze_choose(num);
+
+    /* dig the level rather than using a maze twice */
+    return (maze > 0 && used[maze]) ? -1 : maze;
+}
+
+/* free a map which has been laid out but not populated */
+static void map_layout_destroy(map *m)
+{
+    if (m->spawns != NULL)
+        g_array_free(m->spawns, TRUE);
+
+    g_free(m->grid);
+    g_free(m);
+}
+
+static map *map_layout_try(int num, gint maze, int width, int height)
 {
     gboolean map_loaded = FALSE;
 
-    map *nmap = nlarn->maps[num] = g_malloc0(sizeof(map));
-    nmap->nlevel = num;
+    map *nmap = map_placeholder_new(num, maze, width, height);
+    nmap->grid = g_new0(map_tile, width * height);
+    nmap->spawns = g_array_new(FALSE, FALSE, sizeof(map_spawn));
 
     /* create map */
-    if ((num == 0) /* town is stored in file */
-            || is_caverns_bottom(num) /* level 10 */
-            || is_volcano_bottom(num) /* volcano level 3 */
-            || (num > 1 && chance(25)))
+    if (maze >= 0)
     {
         /* read maze from data file */
-        map_loaded = map_load_from_file(nmap, mazefile, (num == 0) ? 0 : -1);
+        map_loaded = map_load_from_file(nmap, maze);
 
         /* add stationary objects (not to the town) */
         if (num > 0)
@@ -125,7 +308,7 @@ map *map_new(int num, const char *mazefile)
             if (!map_fill_with_stationary_objects(nmap))
             {
                 /* adding stationary objects failed; generate a new map */
-                map_destroy(nmap);
+                map_layout_destroy(nmap);
                 return NULL;
             }
         }
@@ -147,77 +330,162 @@ map *map_new(int num, const char *mazefile)
             keep_maze = map_validate(nmap);
         }
         while (!keep_maze);
+
+        /* the bottom levels are dug if none of their mazes fits */
+        if (is_caverns_bottom(num) || is_volcano_bottom(num))
+            place_special_item(nmap, map_find_space(nmap, LE_ITEM, FALSE));
     }
 
+    /* home town is not trapped */
     if (num != 0)
+        map_fill_with_traps(nmap);
+
+    return nmap;
+}
+
+map *map_layout_new(int num, gint maze, int width, int height)
+{
+    map *nmap = NULL;
+
+    /* if map_layout_try fails, it returns NULL. Some mazes have hardly
+       room for the stationary objects; give up on a maze which keeps
+       failing, another one is chosen by the caller */
+    for (int tries = 0; nmap == NULL && tries < 10; tries++)
+        nmap = map_layout_try(num, maze, width, height);
+
+    return nmap;
+}
+
+void map_populate(map *m)
+{
+    g_assert(m != NULL && !m->generated && m->spawns != NULL);
+
+    /* create the monsters and items placed by the layout */
+    for (guint idx = 0; idx < m->spawns->len; idx++)
     {
-        /* home town is not filled with crap */
-        map_fill_with_objects(nmap);
+        map_spawn *sp = &g_array_index(m->spawns, map_spawn, idx);
 
-        /* and not trapped */
-        map_fill_with_traps(nmap);
+        switch (sp->what)
+        {
+        case MS_MONSTER:
+            monster_new(sp->type, sp->pos, NULL);
+            break;
+
+        case MS_MONSTER_BY_LEVEL:
+            monster_new_by_level(sp->pos);
+            break;
+
+        case MS_ITEM:
+            inv_add(map_ilist_at(m, sp->pos), item_new(sp->type, sp->id));
+            break;
+
+        case MS_ITEM_BY_LEVEL:
+            inv_add(map_ilist_at(m, sp->pos),
+                    item_new_by_level(sp->type, m->nlevel));
+            break;
+
+        case MS_ITEM_RANDOM:
+            inv_add(map_ilist_at(m, sp->pos), item_new_random(sp->type, FALSE));
+            break;
+        }
     }
 
+    g_array_free(m->spawns, TRUE);
+    m->spawns = NULL;
+
+    /* home town is not filled with crap */
+    if (m->nlevel != 0)
+        map_fill_with_objects(m);
+
+    m->generated = TRUE;
+
     /* add inhabitants to the map */
-    map_fill_with_life(nmap);
+    map_fill_with_life(m);
+}
+
+map *map_placeholder_new(int num, gint maze, int width, int height)
+{
+    g_assert(width >= MAP_MAX_X && width <= MAP_LIMIT_X
+             && height >= MAP_MAX_Y && height <= MAP_LIMIT_Y);
+
+    map *nmap = g_malloc0(sizeof(map));
+    nmap->nlevel = num;
+    nmap->maze = maze;
+    nmap->modified = TRUE;
+    nmap->width = width;
+    nmap->height = height;
 
     return nmap;
 }
 
 cJSON *map_serialize(map *m)
 {
-    cJSON *mser, *grid, *tile;
+    cJSON *mser, *grid, *tile = NULL;
 
     mser = cJSON_CreateObject();
 
     cJSON_AddNumberToObject(mser, "nlevel", m->nlevel);
     cJSON_AddNumberToObject(mser, "visited", m->visited);
 
+    /* levels of the classic size are saved as before */
+    if (m->width != MAP_MAX_X || m->height != MAP_MAX_Y)
+    {
+        cJSON_AddNumberToObject(mser, "width", m->width);
+        cJSON_AddNumberToObject(mser, "height", m->height);
+    }
+
+    /* levels that have not been generated yet have no content */
+    if (!map_generated(m))
+    {
+        cJSON_AddNumberToObject(mser, "maze", m->maze);
+        return mser;
+    }
+
     cJSON_AddItemToObject(mser, "grid", grid = cJSON_CreateArray());
 
-    for (int y = 0; y < MAP_MAX_Y; y++)
+    for (int y = 0; y < m->height; y++)
     {
-        for (int x = 0; x < MAP_MAX_X; x++)
+        for (int x = 0; x < m->width; x++)
         {
-            cJSON_AddItemToArray(grid, tile = cJSON_CreateObject());
+            tile = json_array_append(grid, tile, cJSON_CreateObject());
 
-            cJSON_AddNumberToObject(tile, "type", m->grid[y][x].type);
+            cJSON_AddNumberToObject(tile, "type", map_grid(m, x, y).type);
 
-            if (m->grid[y][x].base_type > 0
-                    && m->grid[y][x].base_type != m->grid[y][x].type)
+            if (map_grid(m, x, y).base_type > 0
+                    && map_grid(m, x, y).base_type != map_grid(m, x, y).type)
             {
                 cJSON_AddNumberToObject(tile, "base_type",
-                                        m->grid[y][x].base_type);
+                                        map_grid(m, x, y).base_type);
             }
 
-            if (m->grid[y][x].sobject)
+            if (map_grid(m, x, y).sobject)
             {
                 cJSON_AddNumberToObject(tile, "sobject",
-                                        m->grid[y][x].sobject);
+                                        map_grid(m, x, y).sobject);
             }
 
-            if (m->grid[y][x].trap)
+            if (map_grid(m, x, y).trap)
             {
                 cJSON_AddNumberToObject(tile, "trap",
-                                        m->grid[y][x].trap);
+                                        map_grid(m, x, y).trap);
             }
 
-            if (m->grid[y][x].timer)
+            if (map_grid(m, x, y).timer)
             {
                 cJSON_AddNumberToObject(tile, "timer",
-                                        m->grid[y][x].timer);
+                                        map_grid(m, x, y).timer);
             }
 
-            if (m->grid[y][x].m_oid)
+            if (map_grid(m, x, y).m_oid)
             {
                 cJSON_AddNumberToObject(tile, "monster",
-                                        GPOINTER_TO_UINT(m->grid[y][x].m_oid));
+                                        GPOINTER_TO_UINT(map_grid(m, x, y).m_oid));
             }
 
-            if (m->grid[y][x].ilist )
+            if (map_grid(m, x, y).ilist )
             {
                 cJSON_AddItemToObject(tile, "inventory",
-                                      inv_serialize(m->grid[y][x].ilist));
+                                      inv_serialize(map_grid(m, x, y).ilist));
             }
         }
     }
@@ -230,38 +498,61 @@ map *map_deserialize(cJSON *mser)
     cJSON *grid, *tile, *obj;
     map *m;
 
-    m = g_malloc0(sizeof(map));
+    obj = cJSON_GetObjectItem(mser, "width");
+    int width = (obj != NULL) ? obj->valueint : MAP_MAX_X;
+    obj = cJSON_GetObjectItem(mser, "height");
+    int height = (obj != NULL) ? obj->valueint : MAP_MAX_Y;
+
+    m = map_placeholder_new(cJSON_GetObjectItem(mser, "nlevel")->valueint,
+                            -1, width, height);
 
-    m->nlevel = cJSON_GetObjectItem(mser, "nlevel")->valueint;
     m->visited = cJSON_GetObjectItem(mser, "visited")->valueint;
 
     grid = cJSON_GetObjectItem(mser, "grid");
 
-    for (int y = 0; y < MAP_MAX_Y; y++)
+    /* placeholder for a level that has not been generated yet */
+    if (grid == NULL)
+    {
+        m->maze = cJSON_GetObjectItem(mser, "maze")->valueint;
+        return m;
+    }
+
+    m->generated = TRUE;
+    m->grid = g_new0(map_tile, width * height);
+
+    /* the tiles are stored row by row; walk the list instead of looking
+       up each tile from the start of the array */
+    tile = grid->child;
+
+    for (int y = 0; y < m->height; y++)
     {
-        for (int x = 0; x < MAP_MAX_X; x++)
+        for (int x = 0; x < m->width; x++, tile = tile->next)
         {
-            tile = cJSON_GetArrayItem(grid, x + (y * MAP_MAX_X));
+            g_assert(tile != NULL);
 
-            m->grid[y][x].type = cJSON_GetObjectItem(tile, "type")->valueint;
+            map_grid(m, x, y).type = cJSON_GetObjectItem(tile, "type")->valueint;
 
             obj = cJSON_GetObjectItem(tile, "base_type");
-            if (obj != NULL) m->grid[y][x].base_type = obj->valueint;
+            if (obj != NULL) map_grid(m, x, y).base_type = obj->valueint;
 
             obj = cJSON_GetObjectItem(tile, "sobject");
-            if (obj != NULL) m->grid[y][x].sobject = obj->valueint;
+            if (obj != NULL) map_grid(m, x, y).sobject = obj->valueint;
 
             obj = cJSON_GetObjectItem(tile, "trap");
-            if (obj != NULL) m->grid[y][x].trap = obj->valueint;
+            if (obj != NULL) map_grid(m, x, y).trap = obj->valueint;
 
             obj = cJSON_GetObjectItem(tile, "timer");
-            if (obj != NULL) m->grid[y][x].timer = obj->valueint;
+            if (obj != NULL)
+            {
+                map_grid(m, x, y).timer = obj->valueint;
+                m->timed = TRUE;
+            }
 
             obj = cJSON_GetObjectItem(tile, "monster");
-            if (obj != NULL) m->grid[y][x].m_oid = GUINT_TO_POINTER(obj->valueint);
+            if (obj != NULL) map_grid(m, x, y).m_oid = GUINT_TO_POINTER(obj->valueint);
 
             obj = cJSON_GetObjectItem(tile, "inventory");
-            if (obj != NULL) m->grid[y][x].ilist = inv_deserialize(obj);
+            if (obj != NULL) map_grid(m, x, y).ilist = inv_deserialize(obj);
         }
     }
 
@@ -274,13 +565,13 @@ char *map_dump(map *m, position ppos)
     GString *dump;
     monster *mon;
 
-    dump = g_string_new_len(NULL, MAP_SIZE);
+    dump = g_string_new_len(NULL, (m->width + 1) * m->height);
 
     Z(pos) = m->nlevel;
 
-    for (Y(pos) = 0; Y(pos) < MAP_MAX_Y; Y(pos)++)
+    for (Y(pos) = 0; Y(pos) < m->height; Y(pos)++)
     {
-        for (X(pos) = 0; X(pos) < MAP_MAX_X; X(pos)++)
+        for (X(pos) = 0; X(pos) < m->width; X(pos)++)
         {
             if (pos_identical(pos, ppos))
             {
@@ -313,15 +604,29 @@ void map_destroy(map *m)
 {
     g_assert(m != NULL);
 
+    /* placeholders and levels that have just been laid out have no content */
+    if (!map_generated(m))
+    {
+        map_layout_destroy(m);
+        return;
+    }
+
+    /* levels in the level store have no content in memory */
+    if (m->paged)
+    {
+        g_free(m);
+        return;
+    }
+
     /* destroy spheres on this level */
     g_ptr_array_foreach(nlarn->spheres, (GFunc)map_sphere_destroy, m);
 
     /* destroy items and monsters */
-    for (int y = 0; y < MAP_MAX_Y; y++)
-        for (int x = 0; x < MAP_MAX_X; x++)
+    for (int y = 0; y < m->height; y++)
+        for (int x = 0; x < m->width; x++)
         {
-            if (m->grid[y][x].m_oid != NULL) {
-                monster *mon = game_monster_get(nlarn, m->grid[y][x].m_oid);
+            if (map_grid(m, x, y).m_oid != NULL) {
+                monster *mon = game_monster_get(nlarn, map_grid(m, x, y).m_oid);
 
                 /* I wonder why it is possible that a monster ID is stored at
                  * a position while there is no matching monster registered.
@@ -329,17 +634,98 @@ void map_destroy(map *m)
                 if (mon != NULL) monster_destroy(mon);
             }
 
-            if (m->grid[y][x].ilist != NULL)
-                inv_destroy(m->grid[y][x].ilist, TRUE);
+            if (map_grid(m, x, y).ilist != NULL)
+                inv_destroy(map_grid(m, x, y).ilist, TRUE);
         }
 
+    g_free(m->grid);
     g_free(m);
 }
 
+cJSON *map_objects_serialize(map *m)
+{
+    cJSON *objs, *items, *effects, *monsters;
+
+    g_assert(m != NULL && map_generated(m) && !m->paged);
+
+    objs = cJSON_CreateObject();
+    cJSON_AddItemToObject(objs, "items", items = cJSON_CreateArray());
+    cJSON_AddItemToObject(objs, "effects", effects = cJSON_CreateArray());
+    cJSON_AddItemToObject(objs, "monsters", monsters = cJSON_CreateArray());
+
+    for (int y = 0; y < m->height; y++)
+        for (int x = 0; x < m->width; x++)
+        {
+            monster *mon = (map_grid(m, x, y).m_oid == NULL) ? NULL
+                : game_monster_get(nlarn, map_grid(m, x, y).m_oid);
+
+            if (mon != NULL)
+            {
+                monster_serialize(map_grid(m, x, y).m_oid, mon, monsters);
+                monster_objects_serialize(mon, effects, items);
+            }
+
+            inv_objects_serialize(map_grid(m, x, y).ilist, effects, items);
+        }
+
+    return objs;
+}
+
+void map_unload(map *m)
+{
+    g_assert(m != NULL && map_generated(m) && !m->paged);
+
+    for (int y = 0; y < m->height; y++)
+        for (int x = 0; x < m->width; x++)
+        {
+            monster *mon = (map_grid(m, x, y).m_oid == NULL) ? NULL
+                : game_monster_get(nlarn, map_grid(m, x, y).m_oid);
+
+            if (mon != NULL)
+            {
+                inventory **inv = monster_inv(mon);
+
+                /* the items of the monster are not lost */
+                if (*inv != NULL)
+                {
+                    inv_destroy(*inv, FALSE);
+                    *inv = NULL;
+                }
+
+                monster_destroy(mon);
+            }
+
+            if (map_grid(m, x, y).ilist != NULL)
+                inv_destroy(map_grid(m, x, y).ilist, FALSE);
+        }
+
+    g_free(m->grid);
+    m->grid = NULL;
+    m->paged = TRUE;
+}
+
+void map_reload(map *m, cJSON *mser)
+{
+    g_assert(m != NULL && m->paged);
+
+    map *restored = map_deserialize(mser);
+    g_assert(restored->nlevel == m->nlevel);
+
+    /* keep the map, which may be referred to */
+    m->visited = restored->visited;
+    m->width = restored->width;
+    m->height = restored->height;
+    m->grid = restored->grid;
+    m->modified = TRUE;
+    m->paged = FALSE;
+
+    g_free(restored);
+}
+
 /* return coordinates of a free space */
 position map_find_space(map *m, map_element_t element, gboolean dead_end)
 {
-    rectangle entire_map = rect_new(1, 1, MAP_MAX_X - 2, MAP_MAX_Y - 2);
+    rectangle entire_map = rect_new(1, 1, m->width - 2, m->height - 2);
     return map_find_space_in(m, entire_map, element, dead_end);
 }
 
@@ -413,8 +799,8 @@ position map_find_sobject(map *m, sobject_t sobject)
 
     Z(pos) = m->nlevel;
 
-    for (Y(pos) = 0; Y(pos) < MAP_MAX_Y; Y(pos)++)
-        for (X(pos) = 0; X(pos) < MAP_MAX_X; X(pos)++)
+    for (Y(pos) = 0; Y(pos) < m->height; Y(pos)++)
+        for (X(pos) = 0; X(pos) < m->width; X(pos)++)
             if (map_sobject_at(m, pos) == sobject)
                 return pos;
 
@@ -425,7 +811,7 @@ position map_find_sobject(map *m, sobject_t sobject)
 gboolean map_pos_validate(map *m, position pos, map_element_t element,
                           int dead_end)
 {
-    map_tile *tile;
+    const map_tile *tile;
 
     g_assert(m != NULL && element < LE_MAX);
 
@@ -438,7 +824,7 @@ gboolean map_pos_validate(map *m, position pos, map_element_t element,
         return FALSE;
 
     /* make shortcut */
-    tile = map_tile_at(m, pos);
+    tile = map_tile_get(m, pos);
 
     /* check for an dead end */
     if (dead_end)
@@ -522,6 +908,8 @@ int map_pos_is_visible(map *m, position s, position t)
     int x, y;
     signed int ix, iy;
 
+    counter_inc(CNT_POS_VISIBLE);
+
     /* positions on different levels? */
     if (Z(s) != Z(t))
         return FALSE;
@@ -555,8 +943,8 @@ int map_pos_is_visible(map *m, position s, position t)
             x += ix;
             error += delta_y;
 
-            if (!mt_is_transparent(m->grid[y][x].type)
-                    || !so_is_transparent(m->grid[y][x].sobject))
+            if (!mt_is_transparent(map_grid(m, x, y).type)
+                    || !so_is_transparent(map_grid(m, x, y).sobject))
             {
                 return FALSE;
             }
@@ -581,8 +969,8 @@ int map_pos_is_visible(map *m, position s, position t)
             y += iy;
             error += delta_x;
 
-            if (!mt_is_transparent(m->grid[y][x].type)
-                    || !so_is_transparent(m->grid[y][x].sobject))
+            if (!mt_is_transparent(map_grid(m, x, y).type)
+                    || !so_is_transparent(map_grid(m, x, y).sobject))
             {
                 return FALSE;
             }
@@ -732,12 +1120,13 @@ gboolean map_trajectory(position source, position target,
         /* show the position of the ray*/
         /* FIXME: move curses functions to display.c */
         attron(colour);
-        (void)mvaddch(Y(cursor), X(cursor), glyph);
+        if (display_map_move(cursor))
+            (void)addch(glyph);
         attroff(colour);
         display_draw();
 
         /* sleep a while to show the ray's position */
-        napms(100);
+        display_sleep(100);
         /* repaint the screen unless requested otherwise */
         if (!keep_ray) display_paint_screen(nlarn->p);
     }
@@ -828,12 +1217,36 @@ void map_set_tiletype(map *m, area *ar, map_tile_t type, guint8 duration)
                 tile->type = type;
                 /* if non-permanent, let the radius shrink with time */
                 if (duration != 0)
+                {
                     tile->timer = max(1, duration - 5 * pos_distance(pos, center));
+                    m->timed = TRUE;
+                }
+
+                /* wake up monsters standing on the tile */
+                monster *mon = map_get_monster_at(m, pos);
+                if (mon != NULL)
+                    monster_schedule(mon);
             }
         }
     }
 }
 
+gboolean map_tile_harmful(map *m, position pos)
+{
+    g_assert (m != NULL && pos_valid(pos));
+
+    switch (map_tiletype_at(m, pos))
+    {
+    case LT_CLOUD:
+    case LT_FIRE:
+    case LT_WATER:
+        return TRUE;
+
+    default:
+        return FALSE;
+    }
+}
+
 damage *map_tile_damage(map *m, position pos, gboolean flying)
 {
     g_assert (m != NULL && pos_valid(pos));
@@ -967,7 +1380,7 @@ monster *map_get_monster_at(map *m, position pos)
 {
     g_assert(m != NULL && m->nlevel == Z(pos) && pos_valid(pos));
 
-    gpointer mid = m->grid[Y(pos)][X(pos)].m_oid;
+    gpointer mid = map_grid(m, X(pos), Y(pos)).m_oid;
     return (mid != NULL) ? game_monster_get(nlarn, mid) : NULL;
 }
 
@@ -975,7 +1388,7 @@ void map_fill_with_life(map *m)
 {
     g_assert(m != NULL);
 
-    guint new_monster_count = rand_1n(14 + m->nlevel);
+    guint new_monster_count = rand_1n(14 + m->nlevel) * map_area_factor(m);
 
     if (m->nlevel == 0)
     {
@@ -999,7 +1412,7 @@ void map_fill_with_life(map *m)
                 return;
             }
         }
-        while (fov_get(nlarn->p->fv, pos));
+        while (Z(nlarn->p->pos) == m->nlevel && fov_get(nlarn->p->fv, pos));
 
         monster_new_by_level(pos);
     }
@@ -1033,17 +1446,25 @@ void map_timer(map *m)
 
     g_assert (m != NULL);
 
+    /* most of the time nothing burns or floods */
+    if (!m->timed)
+        return;
+
+    m->timed = FALSE;
     Z(pos) = m->nlevel;
 
-    for (Y(pos) = 0; Y(pos) < MAP_MAX_Y; Y(pos)++)
+    for (Y(pos) = 0; Y(pos) < m->height; Y(pos)++)
     {
-        for (X(pos) = 0; X(pos) < MAP_MAX_X; X(pos)++)
+        for (X(pos) = 0; X(pos) < m->width; X(pos)++)
         {
             if (map_timer_at(m, pos))
             {
                 map_tile *tile = map_tile_at(m, pos);
                 tile->timer--;
 
+                if (tile->timer > 0)
+                    m->timed = TRUE;
+
                 /* affect items every three turns */
                 if ((tile->ilist != NULL) && (tile->timer % 5 == 0))
                 {
@@ -1152,12 +1573,45 @@ char map_get_door_glyph(map *m, position pos)
     return so_get_glyph(map_sobject_at(m, pos));
 }
 
+void map_changes_watch(map *m)
+{
+    g_assert(m != NULL && m->changes == NULL);
+
+    m->changes = g_array_new(FALSE, FALSE, sizeof(position));
+}
+
+void map_changes_forget(map *m)
+{
+    g_assert(m != NULL);
+
+    if (m->changes == NULL)
+        return;
+
+    g_array_free(m->changes, TRUE);
+    m->changes = NULL;
+}
+
+gboolean map_changes_touch(map *m, area *a)
+{
+    g_assert(m != NULL && m->changes != NULL && a != NULL);
+
+    for (guint idx = 0; idx < m->changes->len; idx++)
+    {
+        position pos = g_array_index(m->changes, position, idx);
+
+        if (area_pos_get(a, pos))
+            return TRUE;
+    }
+
+    return FALSE;
+}
+
 static int map_fill_with_stationary_objects(map *m)
 {
     position pos = pos_invalid;
 
     /* volcano shaft up from the temple */
-    if (m->nlevel == MAP_CMAX)
+    if (is_volcano_top(m->nlevel))
     {
         pos = map_find_space(m, LE_SOBJECT, TRUE);
         if (!pos_valid(pos)) return FALSE;
@@ -1173,7 +1627,7 @@ static int map_fill_with_stationary_objects(map *m)
         map_sobject_set(m, pos, LS_STAIRSDOWN);
     }
 
-    if ((m->nlevel > 1) && (m->nlevel != MAP_CMAX))
+    if ((m->nlevel > 1) && !is_volcano_top(m->nlevel))
     {
         pos = map_find_space(m, LE_SOBJECT, TRUE);
         if (!pos_valid(pos)) return FALSE;
@@ -1337,7 +1791,9 @@ static void map_fill_with_traps(map *m)
     gboolean trapdoor = (!is_caverns_bottom(m->nlevel)
             && !is_volcano_bottom(m->nlevel));
 
-    for (guint count = 0; count < rand_0n((trapdoor ? 8 : 6)); count++)
+    for (guint count = 0;
+            count < rand_0n((trapdoor ? 8 : 6)) * map_area_factor(m);
+            count++)
     {
         position pos = map_find_space(m, LE_TRAP, FALSE);
         map_trap_set(m, pos, rand_1n(trapdoor ? TT_MAX : TT_TRAPDOOR));
@@ -1359,26 +1815,16 @@ static void map_make_maze(map *m, int treasure_room)
 
 generate:
     /* reset map by filling it with walls */
-    for (Y(pos) = 0; Y(pos) < MAP_MAX_Y; Y(pos)++)
-        for (X(pos) = 0; X(pos) < MAP_MAX_X; X(pos)++)
+    for (Y(pos) = 0; Y(pos) < m->height; Y(pos)++)
+        for (X(pos) = 0; X(pos) < m->width; X(pos)++)
         {
-            monster *mon;
-
             map_tiletype_set(m, pos, LT_WALL);
             map_sobject_set(m, pos, LS_NONE);
-
-            if ((mon = map_get_monster_at(m, pos)))
-            {
-                monster_destroy(mon);
-            }
-
-            if (map_tile_at(m, pos)->ilist != NULL)
-            {
-                inv_destroy(map_tile_at(m, pos)->ilist, TRUE);
-                map_tile_at(m, pos)->ilist = NULL;
-            }
         }
 
+    /* forget monsters and items placed by previous attempts */
+    g_array_set_size(m->spawns, 0);
+
     /* Maybe add a river or lake. */
     const map_tile_t rivertype = (is_volcano_map(m->nlevel) ? LT_LAVA : LT_DEEPWATER);
 
@@ -1390,7 +1836,7 @@ generate:
         else
             map_make_lake(m, rivertype);
 
-        if (m->grid[1][1].type == LT_WALL)
+        if (map_grid(m, 1, 1).type == LT_WALL)
             map_make_maze_eat(m, 1, 1);
     }
     else
@@ -1399,12 +1845,19 @@ generate:
     /* add exit to town on map 1 */
     if (m->nlevel == 1)
     {
-        m->grid[MAP_MAX_Y - 1][(MAP_MAX_X - 1) / 2].type = LT_FLOOR;
-        m->grid[MAP_MAX_Y - 1][(MAP_MAX_X - 1) / 2].sobject = LS_CAVERNS_EXIT;
+        /* the maze's ways lie on odd coordinates; on levels of an even
+           height, the exit has to be connected to the last of them */
+        const int ex = ((m->width - 1) / 2) | 1;
+
+        for (int ey = m->height - 2; map_grid(m, ex, ey).type == LT_WALL; ey--)
+            map_grid(m, ex, ey).type = LT_FLOOR;
+
+        map_grid(m, ex, m->height - 1).type = LT_FLOOR;
+        map_grid(m, ex, m->height - 1).sobject = LS_CAVERNS_EXIT;
     }
 
-    /* generate open spaces */
-    nrooms = rand_1n(3) + 3;
+    /* generate open spaces, more of them on larger levels */
+    nrooms = (rand_1n(3) + 3) * map_area_factor(m);
     if (treasure_room)
         nrooms++;
 
@@ -1414,13 +1867,13 @@ generate:
     {
         rooms[room] = g_malloc0(sizeof(rectangle));
 
-        my = rand_1n(11) + 2;
+        my = rand_1n(m->height - 6) + 2;
         rooms[room]->y1 = my - rand_1n(2);
         rooms[room]->y2 = my + rand_1n(2);
 
         if (is_volcano_map(m->nlevel))
         {
-            mx = rand_1n(60) + 3;
+            mx = rand_1n(m->width - 7) + 3;
             rooms[room]->x1 = mx - rand_1n(2);
             rooms[room]->x2 = mx + rand_1n(2);
 
@@ -1428,7 +1881,7 @@ generate:
         }
         else
         {
-            mx = rand_1n(44) + 5;
+            mx = rand_1n(m->width - 23) + 5;
             rooms[room]->x1 = mx - rand_1n(4);
             rooms[room]->x2 = mx + rand_1n(12) + 3;
         }
@@ -1445,7 +1898,7 @@ generate:
 
                 if (want_monster == TRUE)
                 {
-                    monster_new_by_level(pos);
+                    map_spawn_add(m, MS_MONSTER_BY_LEVEL, pos, 0, 0);
                     want_monster = FALSE;
                 }
             }
@@ -1473,65 +1926,102 @@ generate:
     g_free(rooms);
 }
 
-/* function to eat away a filled in maze */
-static void map_make_maze_eat(map *m, int x, int y)
+/* a place map_make_maze_eat() is eating away from */
+typedef struct maze_eater
 {
+    int x, y;
     int dir;
-    int try = 2;
+    int try;
+} maze_eater;
+
+/* function to eat away a filled in maze. The way is followed depth
+   first; a stack is used instead of recursion as the way can be very
+   long on large levels. */
+static void map_make_maze_eat(map *m, int x, int y)
+{
+    GArray *stack = g_array_new(FALSE, FALSE, sizeof(maze_eater));
+    maze_eater start = { x, y, rand_1n(4), 2 };
 
-    dir = rand_1n(4);
+    g_array_append_val(stack, start);
 
-    while (try)
+    while (stack->len > 0)
     {
-        switch (dir)
+        maze_eater *e = &g_array_index(stack, maze_eater, stack->len - 1);
+        maze_eater next = { e->x, e->y, 0, 2 };
+        gboolean eaten = FALSE;
+
+        if (!e->try)
+        {
+            g_array_set_size(stack, stack->len - 1);
+            continue;
+        }
+
+        x = e->x;
+        y = e->y;
+
+        switch (e->dir)
         {
         case 1: /* west */
             if ((x > 2) &&
-                    (m->grid[y][x - 1].type == LT_WALL) &&
-                    (m->grid[y][x - 2].type == LT_WALL))
+                    (map_grid(m, x - 1, y).type == LT_WALL) &&
+                    (map_grid(m, x - 2, y).type == LT_WALL))
             {
-                m->grid[y][x - 1].type = m->grid[y][x - 2].type = LT_FLOOR;
-                map_make_maze_eat(m, x - 2, y);
+                map_grid(m, x - 1, y).type = map_grid(m, x - 2, y).type = LT_FLOOR;
+                next.x = x - 2;
+                eaten = TRUE;
             }
             break;
 
         case 2: /* east */
-            if (x < (MAP_MAX_X - 3) &&
-                    (m->grid[y][x + 1].type == LT_WALL) &&
-                    (m->grid[y][x + 2].type == LT_WALL))
+            if (x < (m->width - 3) &&
+                    (map_grid(m, x + 1, y).type == LT_WALL) &&
+                    (map_grid(m, x + 2, y).type == LT_WALL))
             {
-                m->grid[y][x + 1].type = m->grid[y][x + 2].type = LT_FLOOR;
-                map_make_maze_eat(m, x + 2, y);
+                map_grid(m, x + 1, y).type = map_grid(m, x + 2, y).type = LT_FLOOR;
+                next.x = x + 2;
+                eaten = TRUE;
             }
             break;
 
         case 3: /* south */
             if ((y > 2) &&
-                    (m->grid[y - 1][x].type == LT_WALL) &&
-                    (m->grid[y - 2][x].type == LT_WALL))
+                    (map_grid(m, x, y - 1).type == LT_WALL) &&
+                    (map_grid(m, x, y - 2).type == LT_WALL))
             {
-                m->grid[y - 1][x].type = m->grid[y - 2][x].type = LT_FLOOR;
-                map_make_maze_eat(m, x, y - 2);
+                map_grid(m, x, y - 1).type = map_grid(m, x, y - 2).type = LT_FLOOR;
+                next.y = y - 2;
+                eaten = TRUE;
             }
             break;
 
         case 4: /* north */
-            if ((y < MAP_MAX_Y - 3) &&
-                    (m->grid[y + 1][x].type == LT_WALL) &&
-                    (m->grid[y + 2][x].type == LT_WALL))
+            if ((y < m->height - 3) &&
+                    (map_grid(m, x, y + 1).type == LT_WALL) &&
+                    (map_grid(m, x, y + 2).type == LT_WALL))
             {
-                m->grid[y + 1][x].type = m->grid[y + 2][x].type = LT_FLOOR;
-                map_make_maze_eat(m, x, y + 2);
+                map_grid(m, x, y + 1).type = map_grid(m, x, y + 2).type = LT_FLOOR;
+                next.y = y + 2;
+                eaten = TRUE;
             }
 
             break;
         };
-        if (++dir > 4)
+
+        /* this place continues with the next direction afterwards */
+        if (++e->dir > 4)
+        {
+            e->dir = 1;
+            e->try--;
+        }
+
+        if (eaten)
         {
-            dir = 1;
-            try--;
+            next.dir = rand_1n(4);
+            g_array_append_val(stack, next);
         }
     }
+
+    g_array_free(stack, TRUE);
 }
 
 /* The river/lake creation algorithm has been copied in entirety
@@ -1539,12 +2029,12 @@ static void map_make_maze_eat(map *m, int x, int y)
 static void map_make_vertical_river(map *m, map_tile_t rivertype)
 {
     gint width  = 3 + rand_0n(4);
-    gint startx = 6 - width + rand_0n(MAP_MAX_X - 8);
+    gint startx = 6 - width + rand_0n(m->width - 8);
 
     const gint starty = rand_1n(4);
-    const gint endy   = MAP_MAX_Y - (4 - starty);
+    const gint endy   = m->height - (4 - starty);
     const gint minx   = rand_1n(3);
-    const gint maxx   = MAP_MAX_X - rand_1n(3);
+    const gint maxx   = m->width - rand_1n(3);
 
     position pos = pos_invalid;
     Z(pos) = m->nlevel;
@@ -1575,12 +2065,12 @@ static void map_make_river(map *m, map_tile_t rivertype)
     }
 
     gint width  = 3 + rand_0n(4);
-    gint starty = 10 - width + rand_0n(MAP_MAX_Y - 12);
+    gint starty = 10 - width + rand_0n(m->height - 12);
 
     const gint startx = rand_1n(7);
-    const gint endx   = MAP_MAX_X - (7 - startx);
+    const gint endx   = m->width - (7 - startx);
     const gint miny   = rand_1n(3);
-    const gint maxy   = MAP_MAX_Y - rand_1n(3);
+    const gint maxy   = m->height - rand_1n(3);
 
     position pos = pos_invalid;
     Z(pos) = m->nlevel;
@@ -1607,8 +2097,8 @@ static void map_make_river(map *m, map_tile_t rivertype)
 
 static void map_make_lake(map *m, map_tile_t laketype)
 {
-    gint x1 = 5 + rand_0n(MAP_MAX_X - 30);
-    gint y1 = 3 + rand_0n(MAP_MAX_Y - 15);
+    gint x1 = 5 + rand_0n(m->width - 30);
+    gint y1 = 3 + rand_0n(m->height - 15);
     gint x2 = x1 + 4 + rand_0n(16);
     gint y2 = y1 + 4 + rand_0n(5);
 
@@ -1616,7 +2106,7 @@ static void map_make_lake(map *m, map_tile_t laketype)
     Z(pos) = m->nlevel;
     for (Y(pos) = y1; Y(pos) < y2; Y(pos)++)
     {
-        if (Y(pos) <= 1 || Y(pos) >= MAP_MAX_Y - 1)
+        if (Y(pos) <= 1 || Y(pos) >= m->height - 1)
             continue;
 
         if (chance(50))  x1 += rand_0n(3);
@@ -1637,7 +2127,7 @@ static void map_make_lake(map *m, map_tile_t laketype)
 
         for (X(pos) = x1; X(pos) < x2 ; X(pos)++)
         {
-            if (X(pos) <= 1 || X(pos) >= MAP_MAX_X - 1)
+            if (X(pos) <= 1 || X(pos) >= m->width - 1)
                 continue;
 
             if (chance(99))
@@ -1646,239 +2136,109 @@ static void map_make_lake(map *m, map_tile_t laketype)
     }
 }
 
-static void place_special_item(map *m, position npos)
+static void map_spawn_add(map *m, map_spawn_t what, position pos,
+                          guint32 type, guint32 id)
 {
-    map_tile *tile = map_tile_at(m, npos);
+    map_spawn sp = { what, pos, type, id };
 
-    switch (m->nlevel)
-    {
-    case MAP_CMAX - 1: /* the amulet of larn */
-        inv_add(&tile->ilist, item_new(IT_AMULET, AM_LARN));
-
-        monster_new(MT_DEMONLORD_I + rand_0n(7), npos, NULL);
-        break;
-
-    case MAP_MAX - 1: /* potion of cure dianthroritis */
-        inv_add(&tile->ilist, item_new(IT_POTION, PO_CURE_DIANTHR));
-        monster_new(MT_DEMON_PRINCE, npos, NULL);
+    g_array_append_val(m->spawns, sp);
+}
 
-    default:
-        /* plain level, add neither monster nor item */
-        break;
+static void place_special_item(map *m, position npos)
+{
+    if (is_caverns_bottom(m->nlevel))
+    {
+        /* the amulet of larn */
+        map_spawn_add(m, MS_ITEM, npos, IT_AMULET, AM_LARN);
+        map_spawn_add(m, MS_MONSTER, npos, MT_DEMONLORD_I + rand_0n(7), 0);
+    }
+    else if (is_volcano_bottom(m->nlevel))
+    {
+        /* potion of cure dianthroritis */
+        map_spawn_add(m, MS_ITEM, npos, IT_POTION, PO_CURE_DIANTHR);
+        map_spawn_add(m, MS_MONSTER, npos, MT_DEMON_PRINCE, 0);
     }
 }
 
 /*
- *  function to read in a maze from a data file
- *
- *  Format of maze data file:
- *  For each maze:  MAP_MAX_Y + 1 lines (MAP_MAX_Y used)
- *                  MAP_MAX_X characters per line
- *
- *  Special characters in maze data file:
- *
- *      #   wall
- *      +   door
- *      m   random monster
- *      !   potion of cure dianthroritis, or the amulet of larn, as appropriate
- *      o   random object
+ *  function to lay out a level from a maze of the maze library.
+ *  See lib/maze_doc.txt for the format of the maze file.
  */
-static gboolean map_load_from_file(map *m, const char *mazefile, guint which)
+static gboolean map_load_from_file(map *m, guint which)
 {
-    position pos;       /* current position on map */
-    int map_num = 0;    /* number of selected map */
+    const maze *mz = maze_get(which);
     item_t it;          /* item type for random objects */
 
-    FILE *levelfile;
-
-    if (!(levelfile = fopen(mazefile, "r")))
+    if (mz == NULL)
     {
-        /* maze file cannot be opened */
+        /* maze is not available */
         return FALSE;
     }
 
-    if (feof(levelfile))
-    {
-        /* FIXME: debug output */
-        fclose(levelfile);
-
-        return FALSE;
-    }
+    // Sometimes flip the maps. (Never the town)
+    gboolean flip_vertical   = (which > 0 && chance(50));
+    gboolean flip_horizontal = (which > 0 && chance(50));
 
-    /* FIXME: calculate how many levels are in the file  */
+    /* replace which of 3 '!' with a special item? (if appropriate) */
+    int spec_count = rand_0n(3);
 
-    /* roll the dice: which map? */
-    if (which <= MAP_MAX_MAZE_NUM)
+    /* copy the tiles; the maze takes the upper left part of larger
+       levels, the rest is filled like the maze's corner */
+    for (int y = 0; y < m->height; y++)
     {
-        map_num = which;
-    }
-    else
-    {
-        int tries = 0;
-        do
+        int my = flip_horizontal ? MAP_MAX_Y - y - 1 : y;
+
+        if (y >= MAP_MAX_Y)
         {
-            map_num = rand_1n(MAP_MAX_MAZE_NUM);
-        }
-        while (map_used[map_num] && ++tries < 100);
+            for (int x = 0; x < m->width; x++)
+                map_grid(m, x, y) = mz->grid[0][0];
 
-        map_used[map_num] = TRUE;
-    }
+            continue;
+        }
 
-    /* determine number of line separating character(s) */
-    guint lslen;
+        if (!flip_vertical)
+            memcpy(&map_grid(m, 0, my), mz->grid[y], sizeof(mz->grid[y]));
+        else
+            for (int x = 0; x < MAP_MAX_X; x++)
+                map_grid(m, MAP_MAX_X - x - 1, my) = mz->grid[y][x];
 
-    /* get first character at the end of the first line */
-    fseek(levelfile, MAP_MAX_X, SEEK_SET);
-    switch (fgetc(levelfile))
-    {
-        case 10: /* i.e. LF */
-            lslen = 1;
-            break;
-        case 13: /* i.e. CR/LF*/
-            lslen = 2;
-            break;
-        default:
-            /* maze file is corrupted - show error message and quit */
-            nlarn = game_destroy(nlarn);
-            display_show_message("Error", "Maze file is corrupted. Please reinstall the game.", 0);
-            exit(EXIT_FAILURE);
-            break;
+        for (int x = MAP_MAX_X; x < m->width; x++)
+            map_grid(m, x, my) = mz->grid[0][0];
     }
 
-    /* advance to desired maze */
-    fseek(levelfile, (map_num * ((MAP_MAX_X + lslen) * MAP_MAX_Y + lslen)), SEEK_SET);
-
-    if (feof(levelfile))
+    /* place the monsters and items */
+    for (guint idx = 0; idx < mz->objects->len; idx++)
     {
-        /* FIXME: debug output */
-        fclose(levelfile);
-
-        return FALSE;
-    }
+        maze_object *obj = &g_array_index(mz->objects, maze_object, idx);
+        position map_pos = pos_invalid;
 
-    // Sometimes flip the maps. (Never the town)
-    gboolean flip_vertical   = (map_num > 0 && chance(50));
-    gboolean flip_horizontal = (map_num > 0 && chance(50));
+        X(map_pos) = flip_vertical ? MAP_MAX_X - obj->x - 1 : obj->x;
+        Y(map_pos) = flip_horizontal ? MAP_MAX_Y - obj->y - 1 : obj->y;
+        Z(map_pos) = m->nlevel;
 
-    /* replace which of 3 '!' with a special item? (if appropriate) */
-    int spec_count = rand_0n(3);
-
-    Z(pos) = m->nlevel;
-    for (Y(pos) = 0; Y(pos) < MAP_MAX_Y; Y(pos)++)
-    {
-        for (X(pos) = 0; X(pos) < MAP_MAX_X; X(pos)++)
+        switch (obj->what)
         {
-            position map_pos = pos;
-            if (flip_vertical)
-                X(map_pos) = MAP_MAX_X - X(pos) - 1;
-            if (flip_horizontal)
-                Y(map_pos) = MAP_MAX_Y - Y(pos) - 1;
-
-            map_tile *tile = map_tile_at(m, map_pos);
+        case '!': /* potion of cure dianthroritis, eye of larn */
+            if (spec_count-- == 0)
+                place_special_item(m, map_pos);
+            break;
 
-            tile->type = LT_FLOOR;    /* floor is default */
+        case 'm': /* random monster */
+            map_spawn_add(m, MS_MONSTER_BY_LEVEL, map_pos, 0, 0);
+            break;
 
-            switch (fgetc(levelfile))
+        case 'o': /* random item */
+            do
             {
+                it = rand_1n(IT_MAX - 1);
+            }
+            while (it == IT_CONTAINER);
 
-            case '^': /* mountain */
-                tile->type = LT_MOUNTAIN;
-                break;
-
-            case '"': /* grass */
-                tile->type = LT_GRASS;
-                break;
-
-            case '.': /* dirt */
-                tile->type = LT_DIRT;
-                break;
-
-            case '&': /* tree */
-                tile->type = LT_TREE;
-                break;
-
-            case '~': /* deep water */
-                tile->type = LT_DEEPWATER;
-                break;
-
-            case '=': /* lava */
-                tile->type = LT_LAVA;
-                break;
-
-            case '#': /* wall */
-                tile->type =  LT_WALL;
-                break;
-
-            case '_': /* altar */
-                tile->sobject = LS_ALTAR;
-                break;
-
-            case '+': /* door */
-                tile->sobject = LS_CLOSEDDOOR;
-                break;
-
-            case 'O': /* caverns entrance */
-                tile->sobject = LS_CAVERNS_ENTRY;
-                break;
-
-            case 'I': /* elevator */
-                tile->sobject = LS_ELEVATORDOWN;
-                break;
-
-            case 'H': /* home */
-                tile->sobject = LS_HOME;
-                break;
-
-            case 'D': /* dnd store */
-                tile->sobject = LS_DNDSTORE;
-                break;
-
-            case 'T': /* trade post */
-                tile->sobject = LS_TRADEPOST;
-                break;
-
-            case 'L': /* LRS */
-                tile->sobject = LS_LRS;
-                break;
-
-            case 'S': /* school */
-                tile->sobject = LS_SCHOOL;
-                break;
-
-            case 'B': /* bank */
-                tile->sobject = LS_BANK;
-                break;
-
-            case 'M': /* monastery */
-                tile->sobject = LS_MONASTERY;
-                break;
-
-            case '!': /* potion of cure dianthroritis, eye of larn */
-                if (spec_count-- == 0)
-                    place_special_item(m, map_pos);
-                break;
-
-            case 'm': /* random monster */
-                monster_new_by_level(map_pos);
-                break;
-
-            case 'o': /* random item */
-                do
-                {
-                    it = rand_1n(IT_MAX - 1);
-                }
-                while (it == IT_CONTAINER);
-
-                inv_add(&tile->ilist, item_new_by_level(it, m->nlevel));
-                break;
-            };
-        }
-
-        (void)fgetc(levelfile); /* eat EOL */
+            map_spawn_add(m, MS_ITEM_BY_LEVEL, map_pos, it, 0);
+            break;
+        };
     }
 
-    fclose(levelfile);
-
     /* if the amulet of larn/pcd has not been placed yet, place it randomly */
     if (spec_count >= 0)
         place_special_item(m, map_find_space(m, LE_ITEM, FALSE));
@@ -1893,7 +2253,6 @@ static void map_make_treasure_room(map *m, rectangle **rooms)
 {
     position pos = pos_invalid, npos = pos_invalid;
     sobject_t mst;
-    item *itm;
     int success;
 
     int nrooms = 0; /* count of available rooms */
@@ -1931,11 +2290,10 @@ static void map_make_treasure_room(map *m, rectangle **rooms)
                 map_tiletype_set(m, pos, LT_FLOOR);
 
                 /* create loot */
-                itm = item_new_random(IT_GOLD, FALSE);
-                inv_add(map_ilist_at(m, pos), itm);
+                map_spawn_add(m, MS_ITEM_RANDOM, pos, IT_GOLD, 0);
 
                 /* create a monster */
-                monster_new_by_level(pos);
+                map_spawn_add(m, MS_MONSTER_BY_LEVEL, pos, 0, 0);
             }
 
             /* now clear out interior */
@@ -1978,18 +2336,18 @@ static void map_make_treasure_room(map *m, rectangle **rooms)
 }
 
 /* verify that every space on the map can be reached */
-static int map_validate(map *m)
+int map_validate(map *m)
 {
     position pos = pos_invalid;
     int connected = TRUE;
     area *floodmap = NULL;
-    area *obsmap = area_new(0, 0, MAP_MAX_X, MAP_MAX_Y);
+    area *obsmap = area_new(0, 0, m->width, m->height);
 
     Z(pos) = m->nlevel;
 
     /* generate an obstacle map */
-    for (Y(pos) = 0; Y(pos) < MAP_MAX_Y; Y(pos)++)
-        for (X(pos) = 0; X(pos) < MAP_MAX_X; X(pos)++)
+    for (Y(pos) = 0; Y(pos) < m->height; Y(pos)++)
+        for (X(pos) = 0; X(pos) < m->width; X(pos)++)
             if (!map_pos_passable(m, pos)
                     && (map_sobject_at(m, pos) != LS_CLOSEDDOOR))
             {
@@ -1997,30 +2355,25 @@ static int map_validate(map *m)
             }
 
     /* get position of entrance */
-    switch (m->nlevel)
-    {
+    if (m->nlevel == 1)
         /* caverns entrance */
-    case 1:
         pos = map_find_sobject(m, LS_CAVERNS_EXIT);
-        break;
-
+    else if (is_volcano_top(m->nlevel))
         /* volcano entrance */
-    case MAP_CMAX:
         pos = map_find_sobject(m, LS_ELEVATORUP);
-        break;
-
-    default:
+    else if (is_caverns_bottom(m->nlevel) || is_volcano_bottom(m->nlevel))
+        /* the bottom levels have no way down */
+        pos = map_find_sobject(m, LS_STAIRSUP);
+    else
         pos = map_find_sobject(m, LS_STAIRSDOWN);
-        break;
-    }
 
     /* flood fill the maze starting at the entrance */
     floodmap = area_flood(obsmap, X(pos), Y(pos));
 
     /* compare flooded area with obstacle map */
-    for (Y(pos) = 0; Y(pos) < MAP_MAX_Y; Y(pos)++)
+    for (Y(pos) = 0; Y(pos) < m->height; Y(pos)++)
     {
-        for (X(pos) = 0; X(pos) < MAP_MAX_X; X(pos)++)
+        for (X(pos) = 0; X(pos) < m->width; X(pos)++)
         {
             int pp = map_pos_passable(m, pos);
             int cd = (map_sobject_at(m, pos) == LS_CLOSEDDOOR);
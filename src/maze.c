@@ -0,0 +1,278 @@
+/*
+ * maze.c
+ * Copyright (C) 2009-2020 Joachim de Groot <jdegroot@web.de>
+ *
+ * NLarn is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * NLarn is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <glib.h>
+#include <string.h>
+
+#include "maze.h"
+
+/* the decoded mazes */
+static maze *mazes[MAP_MAZE_NUM] = { NULL };
+
+/* decode a symbol of the maze file; returns FALSE for unknown symbols */
+static gboolean maze_decode(map_tile *tile, char symbol)
+{
+    /* floor is default */
+    tile->type = LT_FLOOR;
+
+    switch (symbol)
+    {
+    case ' ': /* floor */
+    case '!': /* potion of cure dianthroritis, eye of larn */
+    case 'm': /* random monster */
+    case 'o': /* random item */
+        break;
+
+    case '^': /* mountain */
+        tile->type = LT_MOUNTAIN;
+        break;
+
+    case '"': /* grass */
+        tile->type = LT_GRASS;
+        break;
+
+    case '.': /* dirt */
+        tile->type = LT_DIRT;
+        break;
+
+    case '&': /* tree */
+        tile->type = LT_TREE;
+        break;
+
+    case '~': /* deep water */
+        tile->type = LT_DEEPWATER;
+        break;
+
+    case '=': /* lava */
+        tile->type = LT_LAVA;
+        break;
+
+    case '#': /* wall */
+        tile->type =  LT_WALL;
+        break;
+
+    case '_': /* altar */
+        tile->sobject = LS_ALTAR;
+        break;
+
+    case '+': /* door */
+        tile->sobject = LS_CLOSEDDOOR;
+        break;
+
+    case 'O': /* caverns entrance */
+        tile->sobject = LS_CAVERNS_ENTRY;
+        break;
+
+    case 'I': /* elevator */
+        tile->sobject = LS_ELEVATORDOWN;
+        break;
+
+    case 'H': /* home */
+        tile->sobject = LS_HOME;
+        break;
+
+    case 'D': /* dnd store */
+        tile->sobject = LS_DNDSTORE;
+        break;
+
+    case 'T': /* trade post */
+        tile->sobject = LS_TRADEPOST;
+        break;
+
+    case 'L': /* LRS */
+        tile->sobject = LS_LRS;
+        break;
+
+    case 'S': /* school */
+        tile->sobject = LS_SCHOOL;
+        break;
+
+    case 'B': /* bank */
+        tile->sobject = LS_BANK;
+        break;
+
+    case 'M': /* monastery */
+        tile->sobject = LS_MONASTERY;
+        break;
+
+    default:
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+/* count the positions where map_fill_with_stationary_objects() could
+ * place a staircase: free floor enclosed by at least seven walls */
+static guint maze_count_dead_ends(maze *mz)
+{
+    guint count = 0;
+
+    for (int y = 1; y < MAP_MAX_Y - 1; y++)
+    {
+        for (int x = 1; x < MAP_MAX_X - 1; x++)
+        {
+            int walls = 0;
+            gboolean open = mt_is_passable(mz->grid[y][x].type);
+
+            for (int ny = y - 1; open && ny <= y + 1; ny++)
+                for (int nx = x - 1; nx <= x + 1; nx++)
+                {
+                    if (mz->grid[ny][nx].sobject != LS_NONE)
+                        open = FALSE;
+
+                    if (mz->grid[ny][nx].type == LT_WALL)
+                        walls++;
+                }
+
+            if (open && walls >= 7)
+                count++;
+        }
+    }
+
+    return count;
+}
+
+static void maze_destroy(maze *mz)
+{
+    g_array_free(mz->objects, TRUE);
+    g_free(mz);
+}
+
+char *maze_library_load(const char *filename)
+{
+    gchar *content;
+    GError *error = NULL;
+    GString *problems = g_string_new(NULL);
+
+    if (!g_file_get_contents(filename, &content, NULL, &error))
+    {
+        g_string_append_printf(problems, "%s\n", error->message);
+        g_error_free(error);
+
+        return g_string_free(problems, FALSE);
+    }
+
+    /* line endings may be LF or CR/LF */
+    gchar **lines = g_strsplit(content, "\n", -1);
+    g_free(content);
+
+    guint nlines = g_strv_length(lines);
+    for (guint l = 0; l < nlines; l++)
+    {
+        size_t len = strlen(lines[l]);
+        if (len > 0 && lines[l][len - 1] == '\r')
+            lines[l][len - 1] = '\0';
+    }
+
+    /* each maze is followed by an empty line */
+    const guint maze_lines = MAP_MAX_Y + 1;
+
+    if (nlines < MAP_MAZE_NUM * maze_lines - 1)
+    {
+        g_string_append_printf(problems,
+                "expected %d mazes, found only %d lines\n",
+                MAP_MAZE_NUM, nlines);
+    }
+
+    for (guint num = 0; num < MAP_MAZE_NUM; num++)
+    {
+        maze *mz = g_malloc0(sizeof(maze));
+        mz->objects = g_array_new(FALSE, FALSE, sizeof(maze_object));
+
+        gboolean valid = TRUE;
+
+        for (guint y = 0; y < MAP_MAX_Y; y++)
+        {
+            guint l = num * maze_lines + y;
+            const char *line = (l < nlines) ? lines[l] : "";
+
+            if (strlen(line) != MAP_MAX_X)
+            {
+                g_string_append_printf(problems,
+                        "maze %d, line %d: expected %d characters, found %d\n",
+                        num, l + 1, MAP_MAX_X, (int)strlen(line));
+                valid = FALSE;
+                continue;
+            }
+
+            for (guint x = 0; x < MAP_MAX_X; x++)
+            {
+                if (!maze_decode(&mz->grid[y][x], line[x]))
+                {
+                    g_string_append_printf(problems,
+                            "maze %d, line %d, column %d: unknown symbol '%c'\n",
+                            num, l + 1, x + 1, line[x]);
+                    valid = FALSE;
+                }
+
+                if (line[x] == '!' || line[x] == 'm' || line[x] == 'o')
+                {
+                    maze_object obj = { x, y, line[x] };
+                    g_array_append_val(mz->objects, obj);
+                }
+            }
+        }
+
+        guint sep = num * maze_lines + MAP_MAX_Y;
+        if (sep < nlines && strlen(lines[sep]) > 0)
+        {
+            g_string_append_printf(problems,
+                    "maze %d, line %d: expected an empty line\n",
+                    num, sep + 1);
+            valid = FALSE;
+        }
+
+        if (!valid)
+        {
+            maze_destroy(mz);
+            continue;
+        }
+
+        mz->dead_ends = maze_count_dead_ends(mz);
+        mazes[num] = mz;
+    }
+
+    g_strfreev(lines);
+
+    if (problems->len > 0)
+    {
+        maze_library_destroy();
+        return g_string_free(problems, FALSE);
+    }
+
+    g_string_free(problems, TRUE);
+
+    return NULL;
+}
+
+void maze_library_destroy()
+{
+    for (guint num = 0; num < MAP_MAZE_NUM; num++)
+    {
+        if (mazes[num] != NULL)
+            maze_destroy(mazes[num]);
+
+        mazes[num] = NULL;
+    }
+}
+
+const maze *maze_get(guint num)
+{
+    return (num < MAP_MAZE_NUM) ? mazes[num] : NULL;
+}
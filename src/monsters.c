@@ -65,6 +65,7 @@ struct _monster
     position pos;
     fov *fv;
     int movement;
+    guint32 moved;           /* the last turn the monster has been moved at */
     monster_action_t action; /* current action */
     guint32 lastseen;        /* number of turns since when player was last seen; 0 = never */
     position player_pos;     /* last known position of player */
@@ -73,10 +74,22 @@ struct _monster
     GPtrArray *effects;
     guint number;        /* random value for some monsters */
     gpointer leader;    /* for pack monsters: ID of the leader */
+    struct monster_plan *plan; /* step planned before the turn, see monster_plan_step() */
     guint32
         unknown: 1;      /* monster is unknown (mimic) */
 };
 
+/* the first step of a path found before the monster's turn */
+typedef struct monster_plan
+{
+    position start;
+    position dest;
+    int element;
+    position ppos;      /* the player's position when the path was found */
+    position npos;      /* the step towards dest */
+    area *seen;         /* the positions the path depends on */
+} monster_plan;
+
 const char *monster_ai_desc[] =
 {
     NULL,               /* MA_NONE */
@@ -933,6 +946,9 @@ monster *monster_new(monster_t type, position pos, gpointer leader)
     nmonster->player_pos = pos_invalid;
     nmonster->leader = leader;
 
+    /* new monsters get their first move in the current turn */
+    nmonster->moved = game_turn(nlarn) - 1;
+
     /* register monster with game */
     nmonster->oid = game_monster_register(nlarn, nmonster);
 
@@ -962,6 +978,9 @@ monster *monster_new(monster_t type, position pos, gpointer leader)
     /* increment monster count */
     game_map(nlarn, Z(pos))->mcount++;
 
+    /* queue the monster for its first move */
+    monster_schedule(nmonster);
+
     return nmonster;
 }
 
@@ -985,7 +1004,8 @@ monster *monster_new_by_level(position pos)
         MT_DEMON_PRINCE      // V3
     };
 
-    const int nlevel = Z(pos);
+    /* the monsters of the corresponding level of the classic dungeon */
+    const int nlevel = map_level_classic(Z(pos));
     int monster_id;
 
     if (nlevel == 0)
@@ -1062,6 +1082,8 @@ void monster_destroy(monster *m)
     if (m->fv)
         fov_free(m->fv);
 
+    monster_plan_drop(m);
+
     g_free(m);
 }
 
@@ -1076,6 +1098,7 @@ void monster_serialize(gpointer oid, monster *m, cJSON *root)
     cJSON_AddNumberToObject(mval, "hp", m->hp);
     cJSON_AddNumberToObject(mval,"pos", pos_val(m->pos));
     cJSON_AddNumberToObject(mval, "movement", m->movement);
+    cJSON_AddNumberToObject(mval, "moved", m->moved);
     cJSON_AddNumberToObject(mval, "action", m->action);
 
     if (m->eq_weapon != NULL)
@@ -1092,10 +1115,11 @@ void monster_serialize(gpointer oid, monster *m, cJSON *root)
         cJSON_AddTrueToObject(mval, "unknown");
 
     if (m->lastseen != 0)
-    {
         cJSON_AddNumberToObject(mval,"lastseen", m->lastseen);
+
+    /* townspeople keep their destination here */
+    if (pos_valid(m->player_pos))
         cJSON_AddNumberToObject(mval,"player_pos", pos_val(m->player_pos));
-    }
 
     /* inventory */
     if (inv_length(m->inv) > 0)
@@ -1123,6 +1147,7 @@ void monster_deserialize(cJSON *mser, game *g)
     m->hp = cJSON_GetObjectItem(mser, "hp")->valueint;
     pos_val(m->pos) = cJSON_GetObjectItem(mser, "pos")->valueint;
     m->movement = cJSON_GetObjectItem(mser, "movement")->valueint;
+    m->moved = cJSON_GetObjectItem(mser, "moved")->valueint;
     m->action = cJSON_GetObjectItem(mser, "action")->valueint;
 
     if ((obj = cJSON_GetObjectItem(mser, "eq_weapon")))
@@ -1145,6 +1170,8 @@ void monster_deserialize(cJSON *mser, game *g)
 
     if ((obj = cJSON_GetObjectItem(mser, "player_pos")))
         pos_val(m->player_pos) = obj->valueint;
+    else
+        m->player_pos = pos_invalid;
 
     /* inventory */
     if ((obj = cJSON_GetObjectItem(mser, "inventory")))
@@ -1167,6 +1194,22 @@ void monster_deserialize(cJSON *mser, game *g)
 
     /* increment the count of monsters of the map the monster is on */
     game_map(g, Z(m->pos))->mcount++;
+
+    /* queue the monster for its next move */
+    monster_schedule(m);
+}
+
+void monster_objects_serialize(monster *m, cJSON *effects, cJSON *items)
+{
+    g_assert(m != NULL);
+
+    for (guint idx = 0; idx < m->effects->len; idx++)
+    {
+        gpointer effect_id = g_ptr_array_index(m->effects, idx);
+        effect_serialize(effect_id, game_effect_get(nlarn, effect_id), effects);
+    }
+
+    inv_objects_serialize(m->inv, effects, items);
 }
 
 int monster_hp_max(monster *m)
@@ -1252,6 +1295,10 @@ int monster_pos_set(monster *m, map *mp, position target)
         /* set reference to monster on tile */
         map_set_monster_at(mp, target, m);
 
+        /* the monster might have moved to another map or onto a
+           harmful tile */
+        monster_schedule(m);
+
         return TRUE;
     }
 
@@ -1358,8 +1405,13 @@ const char* monster_type_plural_name(monster_t mt, const int count)
     {
         if (monster_data[mt].plural_name == NULL)
         {
-            /* need a static buffer to return to calling functions */
-            static char buf[61] = { 0 };
+            /* need a buffer to return to calling functions, one per
+               thread as games may be played in threads of their own */
+#ifdef _MSC_VER
+            static __declspec(thread) char buf[61] = { 0 };
+#else
+            static __thread char buf[61] = { 0 };
+#endif
             g_snprintf(buf, 60, "%ss", monster_type_name(mt));
             return buf;
         }
@@ -1452,6 +1504,9 @@ void monster_die(monster *m, struct player *p)
     if (m->hp > 0)
         m->hp = 0;
 
+    /* dead monsters do not move any more */
+    scheduler_remove(nlarn->actors, m->oid);
+
     /* add the monster to the list of dead monsters */
     g_ptr_array_add(nlarn->dead_monsters, m);
 }
@@ -1460,6 +1515,10 @@ void monster_level_enter(monster *m, struct map *l)
 {
     g_assert (m != NULL && l != NULL);
 
+    /* levels that have not been generated have no tiles yet */
+    if (!map_generated(l))
+        return;
+
     sobject_t source = map_sobject_at(monster_map(m), m->pos);
     sobject_t target;
     position npos;
@@ -1548,10 +1607,133 @@ void monster_level_enter(monster *m, struct map *l)
     }
 }
 
-void monster_move(gpointer *oid __attribute__((unused)), monster *m, game *g)
+/* the number of turns between occasions of regeneration and poison;
+   the difficulty increases regeneration and decreases poison */
+static inline guint monster_regen_period(int difficulty)
 {
-    /* monster's new position */
-    position m_npos;
+    return 10 - difficulty;
+}
+
+static inline guint monster_poison_period(int difficulty)
+{
+    return 22 + (difficulty << 1);
+}
+
+static inline gint64 floor_div(gint64 a, gint64 b)
+{
+    return (a >= 0) ? a / b : -((b - 1 - a) / b);
+}
+
+/* the number of turns in (from, from + turns] at which an event
+   happening every period turns, starting at offset, occurs */
+static guint monster_occasions(guint32 from, guint32 turns,
+                               guint32 offset, guint period)
+{
+    const gint64 base = (gint64)from - offset;
+    return floor_div(base + turns, period) - floor_div(base, period);
+}
+
+/* the first turn after the given one at which such an event occurs */
+static guint32 monster_occasion_next(guint32 after, guint32 offset, guint period)
+{
+    const gint64 base = (gint64)after - offset;
+    return offset + (floor_div(base, period) + 1) * period;
+}
+
+/* monsters only move on the player's map and the maps next to it */
+static gboolean monster_map_active(monster *m)
+{
+    /* during game initialisation the player has no position yet */
+    if (nlarn->p == NULL || !pos_valid(nlarn->p->pos))
+        return TRUE;
+
+    const int mz = Z(m->pos);
+    const int pz = Z(nlarn->p->pos);
+
+    return (mz == pz || mz == pz - 1 || mz == pz + 1
+            || (mz == map_volcano() && pz == 0));
+}
+
+/* Let the turns pass the monster has not been moved at. The scheduler
+   visits monsters at every turn something happens to them, thus only
+   monsters on maps far from the player have missed anything noteworthy. */
+static gboolean monster_catch_up(monster *m, guint32 from, guint32 turns, game *g)
+{
+    effect *e;
+
+    if (turns == 0)
+        return TRUE;
+
+    /* count the turns since the player has been seen */
+    if (m->lastseen)
+        m->lastseen += turns;
+
+    /* idle turns have used up the monster's movement points */
+    const int speed = monster_speed(m);
+    if (speed > 0)
+        m->movement = ((gint64)m->movement + (gint64)speed * turns) % NORMAL;
+
+    /* expire summoned monsters */
+    if (monster_action(m) == MA_SERVE
+            && !monster_effect(m, ET_CHARM_MONSTER))
+    {
+        if (m->number <= turns)
+        {
+            m->number = 0;
+            monster_die(m, g->p);
+            return FALSE;
+        }
+
+        m->number -= turns;
+    }
+
+    /* trapped monsters work themselves free */
+    if ((e = monster_effect_get(m, ET_TRAPPED))
+            && !monster_effect(m, ET_HOLD_MONSTER)
+            && !monster_effect(m, ET_SLEEP))
+    {
+        if (e->turns > turns)
+            e->turns -= turns;
+        else
+            monster_effect_del(m, e);
+    }
+
+    /* regeneration and poison */
+    if (monster_flags(m, REGENERATE) && (m->hp < monster_hp_max(m)))
+    {
+        guint ticks = monster_occasions(from, turns, 0,
+                                        monster_regen_period(g->difficulty));
+        m->hp = min(m->hp + (gint32)ticks, m->hp_max);
+    }
+
+    if ((e = monster_effect_get(m, ET_POISON)))
+    {
+        guint ticks = monster_occasions(from, turns, e->start,
+                                        monster_poison_period(g->difficulty));
+        m->hp -= (gint32)ticks * e->amount;
+
+        if (m->hp < 1)
+        {
+            /* monster died from poison */
+            monster_die(m, NULL);
+            return FALSE;
+        }
+    }
+
+    return TRUE;
+}
+
+/* everything that happens to a monster once per turn; returns FALSE if
+   the monster has died or is on a map where monsters do not move */
+static gboolean monster_turn_begin(monster *m, game *g)
+{
+    const guint32 from = m->moved;
+    const guint32 quiet = (from < g->gtime) ? g->gtime - 1 - from : 0;
+
+    m->moved = g->gtime;
+
+    if (!monster_catch_up(m, from, quiet, g))
+        return FALSE;
 
     /* expire summoned monsters */
     if (monster_action(m) == MA_SERVE
@@ -1563,23 +1745,17 @@ void monster_move(gpointer *oid __attribute__((unused)), monster *m, game *g)
         {
             /* expired */
             monster_die(m, g->p);
-            return;
+            return FALSE;
         }
     }
 
-    if (monster_hp(m) < 1)
-        /* Monster is already dead. */
-        return;
-
-    position mpos = monster_pos(m);
-
     /* modify effects */
     monster_effects_expire(m);
 
     /* regenerate / inflict poison upon monster. */
     if (!monster_regenerate(m, g->gtime, g->difficulty))
         /* the monster died */
-        return;
+        return FALSE;
 
     /* damage caused by map effects */
     damage *dam = map_tile_damage(monster_map(m), monster_pos(m),
@@ -1589,17 +1765,15 @@ void monster_move(gpointer *oid __attribute__((unused)), monster *m, game *g)
     /* deal damage caused by floor effects */
     if ((dam != NULL) && !(m = monster_damage_take(m, dam)))
         /* the monster died */
-        return;
+        return FALSE;
 
     /* move the monster only if it is on the same map as the player or
        an adjacent map */
-    gboolean map_adjacent = (Z(mpos) == Z(g->p->pos)
-                             || (Z(mpos) == Z(g->p->pos) - 1)
-                             || (Z(mpos) == Z(g->p->pos) + 1)
-                             || (Z(mpos) == MAP_CMAX && Z(g->p->pos) == 0)
-                            );
-    if (!map_adjacent)
-        return;
+    if (!monster_map_active(m))
+        return FALSE;
+
+    /* increment count of turns since when player was last seen */
+    if (m->lastseen) m->lastseen++;
 
     /* Update the monster's knowledge of player's position.
        Not for civilians or servants: the first don't care,
@@ -1618,185 +1792,286 @@ void monster_move(gpointer *oid __attribute__((unused)), monster *m, game *g)
     /* add the monster's speed to the monster's movement points */
     m->movement += monster_speed(m);
 
-    /* let the monster make a move as long it has movement points left */
-    while (m->movement >= NORMAL)
+    return TRUE;
+}
+
+/* a single move of a monster; returns FALSE if the monster's turn is over */
+static gboolean monster_act(monster *m, game *g)
+{
+    /* monster's new position */
+    position m_npos;
+
+    /* update monsters action */
+    if (monster_update_action(m, MA_NONE) && monster_in_sight(m))
     {
-        /* reduce the monster's movement points */
-        m->movement -= NORMAL;
+        /* the monster has chosen a new action and the player
+           can see the new action, so let's describe it */
 
-        /* update monsters action */
-        if (monster_update_action(m, MA_NONE) && monster_in_sight(m))
+        if (m->action == MA_ATTACK && monster_sound(m))
         {
-            /* the monster has chosen a new action and the player
-               can see the new action, so let's describe it */
-
-            if (m->action == MA_ATTACK && monster_sound(m))
-            {
-                const char *sound = monster_sound(m);
-                log_add_entry(g->log, "The %s %s%ss!",
-                              monster_name(m), sound,
-                              sound[strlen(sound) - 1] == 's' ? "e": "");
-            }
-            else if (m->action == MA_FLEE)
-            {
-                log_add_entry(g->log, "The %s turns to flee!",
-                        monster_get_name(m));
-            }
+            const char *sound = monster_sound(m);
+            log_add_entry(g->log, "The %s %s%ss!",
+                          monster_name(m), sound,
+                          sound[strlen(sound) - 1] == 's' ? "e": "");
+        }
+        else if (m->action == MA_FLEE)
+        {
+            log_add_entry(g->log, "The %s turns to flee!",
+                    monster_get_name(m));
         }
+    }
 
-        /* let the monster have a look at the items at it's current position
-           if it chose to pick up something, the turn is over */
-        if (monster_items_pickup(m))
-            return;
+    /* let the monster have a look at the items at it's current position
+       if it chose to pick up something, the turn is over */
+    if (monster_items_pickup(m))
+        return FALSE;
 
-        /* determine monster's next move */
-        m_npos = monster_pos(m);
+    /* determine monster's next move */
+    m_npos = monster_pos(m);
 
-        switch (m->action)
-        {
-        case MA_FLEE:
-            m_npos = monster_move_flee(m, g->p);
-            break;
+    switch (m->action)
+    {
+    case MA_FLEE:
+        m_npos = monster_move_flee(m, g->p);
+        break;
 
-        case MA_REMAIN:
-            /* Sgt. Stan Still - do nothing */
-            break;
+    case MA_REMAIN:
+        /* Sgt. Stan Still - do nothing */
+        break;
 
-        case MA_WANDER:
-            m_npos = monster_move_wander(m, g->p);
-            break;
+    case MA_WANDER:
+        m_npos = monster_move_wander(m, g->p);
+        break;
 
-        case MA_ATTACK:
-            /* monster tries a ranged attack */
-            if (monster_player_visible(m)
-                    && monster_player_ranged_attack(m, g->p))
-                return;
+    case MA_ATTACK:
+        /* monster tries a ranged attack */
+        if (monster_player_visible(m)
+                && monster_player_ranged_attack(m, g->p))
+            return FALSE;
 
-            m_npos = monster_move_attack(m, g->p);
-            break;
+        m_npos = monster_move_attack(m, g->p);
+        break;
 
-        case MA_CONFUSION:
-            m_npos = monster_move_confused(m, g->p);
-            break;
+    case MA_CONFUSION:
+        m_npos = monster_move_confused(m, g->p);
+        break;
 
-        case MA_SERVE:
-            m_npos = monster_move_serve(m, g->p);
-            break;
+    case MA_SERVE:
+        m_npos = monster_move_serve(m, g->p);
+        break;
 
-        case MA_CIVILIAN:
-            m_npos = monster_move_civilian(m, g->p);
-            break;
+    case MA_CIVILIAN:
+        m_npos = monster_move_civilian(m, g->p);
+        break;
 
-        case MA_NONE:
-            /* possibly a bug */
-            break;
-        }
+    case MA_NONE:
+        /* possibly a bug */
+        break;
+    }
 
-        /* ******** if new position has been found - move the monster ********* */
-        if (!pos_identical(m_npos, monster_pos(m)))
-        {
-            /* get the monster's current map */
-            map *mmap = monster_map(m);
+    /* ******** if new position has been found - move the monster ********* */
+    if (!pos_identical(m_npos, monster_pos(m)))
+    {
+        /* get the monster's current map */
+        map *mmap = monster_map(m);
 
-            /* get stationary object at the monster's target position */
-            sobject_t target_st = map_sobject_at(mmap, m_npos);
+        /* get stationary object at the monster's target position */
+        sobject_t target_st = map_sobject_at(mmap, m_npos);
 
-            /* vampires won't step onto mirrors */
-            if ((m->type == MT_VAMPIRE) && (target_st == LS_MIRROR))
-            {
-                /* No movement - FIXME: should try to move around it */
-            }
+        /* vampires won't step onto mirrors */
+        if ((m->type == MT_VAMPIRE) && (target_st == LS_MIRROR))
+        {
+            /* No movement - FIXME: should try to move around it */
+        }
 
-            else if (pos_identical(g->p->pos, m_npos))
-            {
-                /* The monster bumps into the player who is invisible to the
-                   monster. Thus the monster gains knowledge over the player's
-                   current position. */
-                monster_update_player_pos(m, g->p->pos);
+        else if (pos_identical(g->p->pos, m_npos))
+        {
+            /* The monster bumps into the player who is invisible to the
+               monster. Thus the monster gains knowledge over the player's
+               current position. */
+            monster_update_player_pos(m, g->p->pos);
 
-                log_add_entry(g->log, "The %s bumps into you.", monster_get_name(m));
-            }
+            log_add_entry(g->log, "The %s bumps into you.", monster_get_name(m));
+        }
 
-            /* check for door */
-            else if ((target_st == LS_CLOSEDDOOR) && monster_flags(m, HANDS))
+        /* check for door */
+        else if ((target_st == LS_CLOSEDDOOR) && monster_flags(m, HANDS))
+        {
+            /* dim-witted or confused monster are unable to open doors */
+            if (monster_int(m) < 4 || monster_effect_get(m, ET_CONFUSION))
             {
-                /* dim-witted or confused monster are unable to open doors */
-                if (monster_int(m) < 4 || monster_effect_get(m, ET_CONFUSION))
+                /* notify the player if the door is visible */
+                if (monster_in_sight(m))
                 {
-                    /* notify the player if the door is visible */
-                    if (monster_in_sight(m))
-                    {
-                        log_add_entry(g->log, "The %s bumps into the door.",
-                                      monster_get_name(m));
-                    }
+                    log_add_entry(g->log, "The %s bumps into the door.",
+                                  monster_get_name(m));
                 }
-                else
-                {
-                    /* the monster is capable of opening the door */
-                    map_sobject_set(mmap, m_npos, LS_OPENDOOR);
+            }
+            else
+            {
+                /* the monster is capable of opening the door */
+                map_sobject_set(mmap, m_npos, LS_OPENDOOR);
 
-                    /* notify the player if the door is visible */
-                    if (monster_in_sight(m))
-                    {
-                        log_add_entry(g->log, "The %s opens the door.",
-                                      monster_get_name(m));
-                    }
+                /* notify the player if the door is visible */
+                if (monster_in_sight(m))
+                {
+                    log_add_entry(g->log, "The %s opens the door.",
+                                  monster_get_name(m));
                 }
             }
+        }
 
-            /* set the monsters new position */
+        /* set the monsters new position */
+        else
+        {
+            /* check if the new position is valid for this monster */
+            if (map_pos_validate(mmap, m_npos, monster_map_element(m), FALSE))
+            {
+                /* the new position is valid -> reposition the monster */
+                monster_pos_set(m, mmap, m_npos);
+            }
             else
             {
-                /* check if the new position is valid for this monster */
-                if (map_pos_validate(mmap, m_npos, monster_map_element(m), FALSE))
+                /* the new position is invalid */
+                map_tile_t nle = map_tiletype_at(mmap, m_npos);
+
+                switch (nle)
                 {
-                    /* the new position is valid -> reposition the monster */
-                    monster_pos_set(m, mmap, m_npos);
+                    case LT_TREE:
+                    case LT_WALL:
+                        if (monster_in_sight(m))
+                        {
+                            log_add_entry(g->log, "The %s bumps into %s.",
+                                    monster_get_name(m), mt_get_desc(nle));
+                        }
+                        break;
+
+                    case LT_LAVA:
+                    case LT_DEEPWATER:
+                        if (monster_in_sight(m)) {
+                            log_add_entry(g->log, "The %s sinks into %s.",
+                                    monster_get_name(m), mt_get_desc(nle));
+                        }
+                        monster_die(m, g->p);
+                        return FALSE;
+
+                    default:
+                        /* just do not move.. */
+                        break;
                 }
-                else
-                {
-                    /* the new position is invalid */
-                    map_tile_t nle = map_tiletype_at(mmap, m_npos);
+            }
 
-                    switch (nle)
-                    {
-                        case LT_TREE:
-                        case LT_WALL:
-                            if (monster_in_sight(m))
-                            {
-                                log_add_entry(g->log, "The %s bumps into %s.",
-                                        monster_get_name(m), mt_get_desc(nle));
-                            }
-                            break;
-
-                        case LT_LAVA:
-                        case LT_DEEPWATER:
-                            if (monster_in_sight(m)) {
-                                log_add_entry(g->log, "The %s sinks into %s.",
-                                        monster_get_name(m), mt_get_desc(nle));
-                            }
-                            monster_die(m, g->p);
-                            break;
-
-                        default:
-                            /* just do not move.. */
-                            break;
-                    }
-                }
+            /* check for traps */
+            if (map_trap_at(mmap, monster_pos(m)))
+            {
+                if (!monster_trap_trigger(m))
+                    return FALSE; /* trap killed the monster */
+            }
 
-                /* check for traps */
-                if (map_trap_at(mmap, monster_pos(m)))
-                {
-                    if (!monster_trap_trigger(m))
-                        return; /* trap killed the monster */
-                }
+        } /* end new position */
+    } /* end monster repositioning */
 
-            } /* end new position */
-        } /* end monster repositioning */
-    } /* while movement >= NORMAL */
+    return TRUE;
+}
 
-    /* increment count of turns since when player was last seen */
-    if (m->lastseen) m->lastseen++;
+void monster_move(monster *m, game *g)
+{
+    g_assert(m != NULL && g != NULL);
+
+    if (monster_hp(m) < 1)
+        /* Monster is already dead. */
+        return;
+
+    /* the monster's first move in this turn */
+    if (m->moved != g->gtime && !monster_turn_begin(m, g))
+        return;
+
+    /* let the monster make a move if it has enough movement points */
+    if (m->movement >= NORMAL)
+    {
+        /* reduce the monster's movement points */
+        m->movement -= NORMAL;
+
+        if (monster_act(m, g) && m->movement >= NORMAL)
+        {
+            /* fast monsters get their next move in this turn
+               after all others have had theirs */
+            scheduler_add(g->actors, m->oid, g->gtime);
+            return;
+        }
+    }
+
+    monster_schedule(m);
+}
+
+void monster_schedule(monster *m)
+{
+    g_assert(m != NULL);
+
+    const guint32 last = m->moved;
+    guint32 due = G_MAXUINT32;
+    effect *e;
+
+    /* dead monsters and those far from the player are left alone
+       until something wakes them up */
+    if (m->hp < 1 || !monster_map_active(m))
+    {
+        scheduler_remove(nlarn->actors, m->oid);
+        return;
+    }
+
+    /* things that have to be handled every turn */
+    if (m->action == MA_SERVE || monster_effect(m, ET_TRAPPED)
+            || map_tile_harmful(monster_map(m), m->pos))
+    {
+        due = last + 1;
+    }
+
+    /* regeneration and poison */
+    if (monster_flags(m, REGENERATE) && (m->hp < monster_hp_max(m)))
+    {
+        guint32 next = monster_occasion_next(last, 0,
+                monster_regen_period(game_difficulty(nlarn)));
+
+        if (next < due) due = next;
+    }
+
+    if ((e = monster_effect_get(m, ET_POISON)))
+    {
+        guint32 next = monster_occasion_next(last, e->start,
+                monster_poison_period(game_difficulty(nlarn)));
+
+        if (next < due) due = next;
+    }
+
+    /* the turn the monster has gathered enough movement points to move;
+       idling monsters do not need to be moved at all */
+    const int speed = monster_speed(m);
+
+    if (m->action != MA_REMAIN && speed > 0)
+    {
+        const int missing = NORMAL - m->movement;
+        guint32 next = last + 1;
+
+        if (missing > speed)
+            next = last + (missing + speed - 1) / speed;
+
+        if (next < due) due = next;
+    }
+
+    if (due == G_MAXUINT32)
+        scheduler_remove(nlarn->actors, m->oid);
+    else
+        scheduler_add(nlarn->actors, m->oid, due);
+}
+
+void monster_time_warp(monster *m, gint32 turns)
+{
+    g_assert(m != NULL);
+
+    /* monsters are not affected by time warps */
+    m->moved += turns;
+    monster_schedule(m);
 }
 
 void monster_polymorph(monster *m)
@@ -1836,7 +2111,7 @@ void monster_polymorph(monster *m)
         {
             /* briefly display the new monster before it dies */
             display_paint_screen(nlarn->p);
-            g_usleep(250000);
+            display_sleep(250);
 
             switch (old_elem)
             {
@@ -2382,6 +2657,11 @@ monster *monster_damage_take(monster *m, damage *dam)
         monster_die(m, p);
         m = NULL;
     }
+    else
+    {
+        /* wounded monsters may have to regenerate */
+        monster_schedule(m);
+    }
 
     g_free(dam);
 
@@ -2405,6 +2685,10 @@ gboolean monster_update_action(monster *m, monster_action_t override)
             /* FIXME: it would be nice to have a variable amount of turns */
             m->number = 100;
         }
+
+        /* idling monsters wake up and vice versa */
+        monster_schedule(m);
+
         return TRUE;
     }
 
@@ -2469,29 +2753,23 @@ void monster_update_player_pos(monster *m, position ppos)
 
 gboolean monster_regenerate(monster *m, time_t gtime, int difficulty)
 {
-    /* number of turns between occasions */
-    int frequency;
-
     /* temporary var for effect */
     effect *e;
 
     g_assert(m != NULL);
 
-    /* modify frequency by difficulty: more regeneration, less poison */
-    frequency = difficulty << 1;
-
     /* handle regeneration */
     if (monster_flags(m, REGENERATE) && (m->hp < monster_hp_max(m)))
     {
         /* regenerate every (10 - difficulty) turns */
-        if (gtime % (10 - difficulty) == 0)
+        if (gtime % monster_regen_period(difficulty) == 0)
             m->hp++;
     }
 
     /* handle poison */
     if ((e = monster_effect_get(m, ET_POISON)))
     {
-        if ((gtime - e->start) % (22 + frequency) == 0)
+        if ((gtime - e->start) % monster_poison_period(difficulty) == 0)
         {
             m->hp -= e->amount;
         }
@@ -2697,7 +2975,9 @@ effect *monster_effect_add(monster *m, effect *e)
     }
 
     /* one time effects */
-    if (e && e->turns == 1)
+    gboolean one_time = (e && e->turns == 1);
+
+    if (one_time)
     {
         switch (e->type)
         {
@@ -2730,6 +3010,9 @@ effect *monster_effect_add(monster *m, effect *e)
         /* multi-turn effects */
         e = effect_add(m->effects, e);
 
+        if (e)
+            effect_schedule(e, monster_oid(m));
+
         /* if it's confusion, set the monster's "AI" accordingly */
         if (e && e->type == ET_CONFUSION) {
             monster_update_action(m, MA_CONFUSION);
@@ -2745,19 +3028,23 @@ effect *monster_effect_add(monster *m, effect *e)
         {
             monster_update_action(m, MA_REMAIN);
         }
+
+        /* the effect may change when the monster moves next */
+        if (e)
+            monster_schedule(m);
     }
 
     /* show message if monster is visible */
     if (e && monster_in_sight(m)
         && effect_get_msg_m_start(e)
-        && (e->turns > 0 || vis_effect))
+        && (effect_turns(e) > 0 || vis_effect))
     {
         log_add_entry(nlarn->log, effect_get_msg_m_start(e),
                       monster_get_name(m));
     }
 
     /* clean up one-time effects */
-    if (e && e->turns == 1)
+    if (e && one_time)
     {
         effect_destroy(e);
         e = NULL;
@@ -2798,6 +3085,7 @@ int monster_effect_del(monster *m, effect *e)
         }
 
         effect_destroy(e);
+        monster_schedule(m);
     }
 
     return result;
@@ -2817,35 +3105,23 @@ int monster_effect(monster *m, effect_t type)
 
 void monster_effects_expire(monster *m)
 {
-    guint idx = 0;
-
     g_assert(m != NULL);
 
-    while (idx < m->effects->len)
-    {
-        gpointer effect_id = g_ptr_array_index(m->effects, idx);;
-        effect *e = game_effect_get(nlarn, effect_id);
+    /* all other temporary effects end by the game's timers */
+    effect *e = monster_effect_get(m, ET_TRAPPED);
 
-        if (e->type == ET_TRAPPED)
-        {
-            /* if the monster is incapable of movement don't decrease
-               trapped counter */
-            if (monster_effect(m, ET_HOLD_MONSTER)
-                    || monster_effect(m, ET_SLEEP))
-            {
-                idx++;
-            }
-        }
+    /* if the monster is incapable of movement don't decrease
+       trapped counter */
+    if (e == NULL || monster_effect(m, ET_HOLD_MONSTER)
+            || monster_effect(m, ET_SLEEP))
+    {
+        return;
+    }
 
-        if (effect_expire(e) == -1)
-        {
-            /* effect has expired */
-            monster_effect_del(m, e);
-        }
-        else
-        {
-            idx++;
-        }
+    if (effect_expire(e) == -1)
+    {
+        /* effect has expired */
+        monster_effect_del(m, e);
     }
 }
 
@@ -3138,44 +3414,152 @@ static gboolean monster_player_rob(monster *m, struct player *p, item_t item_typ
     }
 }
 
+/* array of pointers to fortunes, shared by all games */
+static GPtrArray *fortunes = NULL;
+static GMutex fortunes_mutex;
+
+void monster_fortunes_load(const char *fortune_file)
+{
+    g_mutex_lock(&fortunes_mutex);
+
+    if (fortunes)
+    {
+        g_mutex_unlock(&fortunes_mutex);
+        return;
+    }
+
+    /* read in the fortunes */
+    char buffer[80];
+    FILE *fortune_fd;
+
+    /* open the file */
+    fortune_fd = fopen(fortune_file, "r");
+    if (fortune_fd == NULL)
+    {
+        /* can't find file */
+        g_mutex_unlock(&fortunes_mutex);
+        return;
+    }
+
+    GPtrArray *lines = g_ptr_array_new();
+
+    /* read in the entire fortune file */
+    while((fgets(buffer, 79, fortune_fd)))
+    {
+        /* replace EOL with \0 */
+        size_t len = (size_t)(strchr(buffer, '\n') - (char *)&buffer);
+        buffer[len] = '\0';
+
+        /* keep the line */
+        char *tmp = g_malloc((len + 1) * sizeof(char));
+        memcpy(tmp, &buffer, (len + 1));
+        g_ptr_array_add(lines, tmp);
+    }
+
+    fclose(fortune_fd);
+
+    fortunes = lines;
+    g_mutex_unlock(&fortunes_mutex);
+}
+
 static char *monster_get_fortune(const char *fortune_file)
 {
-    /* array of pointers to fortunes */
-    static GPtrArray *fortunes = NULL;
+    monster_fortunes_load(fortune_file);
 
     if (!fortunes)
     {
-        /* read in the fortunes */
-        char buffer[80];
-        FILE *fortune_fd;
+        /* can't find file */
+        return "Help me! I can't find the fortune file!";
+    }
 
-        /* open the file */
-        fortune_fd = fopen(fortune_file, "r");
-        if (fortune_fd == NULL)
-        {
-            /* can't find file */
-            return "Help me! I can't find the fortune file!";
-        }
+    return g_ptr_array_index(fortunes, rand_0n(fortunes->len));
+}
 
-        fortunes = g_ptr_array_new();
+/* the destination a monster will most likely head for in its turn */
+static gboolean monster_plan_dest(monster *m, position *dest)
+{
+    struct player *p = nlarn->p;
+    monster *leader;
 
-        /* read in the entire fortune file */
-        while((fgets(buffer, 79, fortune_fd)))
-        {
-            /* replace EOL with \0 */
-            size_t len = (size_t)(strchr(buffer, '\n') - (char *)&buffer);
-            buffer[len] = '\0';
-
-            /* keep the line */
-            char *tmp = g_malloc((len + 1) * sizeof(char));
-            memcpy(tmp, &buffer, (len + 1));
-            g_ptr_array_add(fortunes, tmp);
-        }
+    switch (m->action)
+    {
+    case MA_ATTACK:
+        if (!pos_valid(m->player_pos))
+            return FALSE;
+
+        /* monsters chasing the player usually see where the player is */
+        *dest = (Z(p->pos) == Z(m->pos)) ? p->pos : m->player_pos;
+
+        /* monsters next to the player attack */
+        return !pos_adjacent(m->pos, *dest);
+
+    case MA_WANDER:
+        if (m->leader == NULL
+                || !(leader = game_monster_get(nlarn, m->leader)))
+            return FALSE;
 
-        fclose(fortune_fd);
+        *dest = monster_pos(leader);
+        return (pos_distance(m->pos, *dest) > 4);
+
+    case MA_SERVE:
+        *dest = p->pos;
+        return (pos_distance(m->pos, *dest) > 5);
+
+    case MA_CIVILIAN:
+        *dest = m->player_pos;
+        return pos_valid(*dest) && !pos_identical(m->pos, *dest);
+
+    default:
+        return FALSE;
     }
+}
 
-    return g_ptr_array_index(fortunes, rand_0n(fortunes->len));
+void monster_plan_step(monster *m)
+{
+    position dest;
+
+    g_assert(m != NULL && m->plan == NULL);
+
+    if (monster_hp(m) < 1 || !monster_map_active(m)
+            || pos_identical(m->pos, nlarn->p->pos)
+            || !monster_plan_dest(m, &dest)
+            || Z(dest) != Z(m->pos))
+        return;
+
+    monster_plan *plan = g_malloc0(sizeof(monster_plan));
+
+    plan->start = m->pos;
+    plan->dest = dest;
+    plan->element = monster_map_element(m);
+    plan->ppos = nlarn->p->pos;
+    plan->npos = m->pos;
+    plan->seen = area_new(0, 0, monster_map(m)->width,
+                          monster_map(m)->height);
+
+    path *path = path_find_watched(monster_map(m), plan->start, dest,
+                                   plan->element, plan->seen);
+
+    if (path && !g_queue_is_empty(path->path))
+    {
+        path_element *el = g_queue_peek_head(path->path);
+        plan->npos = el->pos;
+    }
+
+    if (path) path_destroy(path);
+
+    m->plan = plan;
+}
+
+void monster_plan_drop(monster *m)
+{
+    g_assert(m != NULL);
+
+    if (m->plan == NULL)
+        return;
+
+    area_destroy(m->plan->seen);
+    g_free(m->plan);
+    m->plan = NULL;
 }
 
 static position monster_find_next_pos_to(monster *m, position dest)
@@ -3186,6 +3570,27 @@ static position monster_find_next_pos_to(monster *m, position dest)
     /* next position */
     position npos = monster_pos(m);
 
+    /* take the planned step if nothing the path depends on has changed */
+    monster_plan *plan = m->plan;
+
+    if (plan != NULL)
+    {
+        gboolean valid = pos_identical(plan->start, monster_pos(m))
+            && pos_identical(plan->dest, dest)
+            && plan->element == monster_map_element(m)
+            && pos_identical(plan->ppos, nlarn->p->pos)
+            && !map_changes_touch(monster_map(m), plan->seen);
+
+        if (valid)
+            npos = plan->npos;
+
+        /* a plan is good for one step */
+        monster_plan_drop(m);
+
+        if (valid)
+            return npos;
+    }
+
     /* find the next step in the direction of dest */
     path *path = path_find(monster_map(m), monster_pos(m), dest,
                            monster_map_element(m));
@@ -3275,7 +3680,7 @@ static position monster_move_attack(monster *m, struct player *p)
 
         case LS_ELEVATORDOWN:
             /* move into the volcano from the town */
-            newmap = MAP_CMAX + 1;
+            newmap = map_volcano() + 1;
             break;
 
         case LS_ELEVATORUP:
@@ -3288,6 +3693,10 @@ static position monster_move_attack(monster *m, struct player *p)
             break;
         }
 
+        /* monsters cannot migrate to levels that have not been generated */
+        if (!map_generated(game_map(nlarn, newmap)))
+            return monster_pos(m);
+
         /* change the map */
         monster_level_enter(m, game_map(nlarn, newmap));
 
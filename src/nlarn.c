@@ -36,16 +36,22 @@
 # include <sys/stat.h>
 #endif
 
+#include "codec.h"
 #include "config.h"
 #include "container.h"
+#include "counters.h"
 #include "display.h"
 #include "game.h"
+#include "journal.h"
+#include "maze.h"
 #include "nlarn.h"
 #include "pathfinding.h"
 #include "player.h"
 #include "scoreboard.h"
 #include "sobjects.h"
+#include "trace.h"
 #include "traps.h"
+#include "zygote.h"
 
 /* see https://stackoverflow.com/q/36764885/1519878 */
 #define STR_HELPER(x) #x
@@ -78,8 +84,9 @@ static const char *highscores = "highscores";
 static const char *config_file = "nlarn.ini";
 static const char *save_file = "nlarn.sav";
 
-/* global game object */
-game *nlarn = NULL;
+/* the texts shown by the game, read once */
+static gchar *message_text = NULL;
+static gchar *help_text = NULL;
 
 /* the game settings */
 static struct game_config config = {0};
@@ -128,6 +135,52 @@ static const gchar *nlarn_userdir()
     return userdir;
 }
 
+/* read the predefined mazes unless they have been read */
+static void nlarn_mazes_load()
+{
+    static gboolean loaded = FALSE;
+
+    if (loaded)
+        return;
+
+    char *maze_problems = maze_library_load(nlarn_mazefile);
+    if (maze_problems != NULL)
+    {
+        g_printerr("The maze file \"%s\" is corrupted:\n%s\n"
+                   "Please reinstall the game.\n",
+                   nlarn_mazefile, maze_problems);
+
+        exit(EXIT_FAILURE);
+    }
+
+    loaded = TRUE;
+}
+
+#ifdef __unix
+/* Read everything shared by the games and serve sessions. Returns in the
+   process playing the game for a session, with its settings. */
+static void nlarn_zygote()
+{
+    nlarn_mazes_load();
+    monster_fortunes_load(nlarn_fortunes);
+    g_file_get_contents(nlarn_mesgfile, &message_text, NULL, NULL);
+    g_file_get_contents(nlarn_helpfile, &help_text, NULL, NULL);
+
+    gchar **args = zygote_serve(config.zygote);
+
+    /* use the settings of the session */
+    free_config(config);
+    memset(&config, 0, sizeof(config));
+    parse_commandline(g_strv_length(args), args, &config);
+    g_strfreev(args);
+
+    /* a game must not serve further games */
+    g_free(config.zygote);
+    g_free(config.connect);
+    config.zygote = config.connect = NULL;
+}
+#endif
+
 /* initialize runtime environment */
 static void nlarn_init(int argc, char *argv[])
 {
@@ -222,14 +275,39 @@ static void nlarn_init(int argc, char *argv[])
         exit(EXIT_FAILURE);
     }
 
-#else
+#endif
+
+    /* parse the command line options; the parser modifies the arguments */
+    gchar **args = g_strdupv(argv);
+    parse_commandline(argc, argv, &config);
+
+#ifdef __unix
+    /* play a game served by a zygote */
+    if (config.connect)
+        exit(zygote_connect(config.connect, args));
+
+    /* serve games to sessions; the zygote must not read anything specific
+       to a user */
+    if (config.zygote)
+        nlarn_zygote();
+#endif
+
+    g_strfreev(args);
+
+#if !((defined (__unix) || defined (__unix__)) && defined (SETGID))
     /* highscore file handling for non-SETGID builds -
        store high scores in the same directory as the configuation */
     nlarn_highscores = g_build_filename(nlarn_userdir(), highscores, NULL);
 #endif
 
-    /* parse the command line options */
-    parse_commandline(argc, argv, &config);
+    /* write a trace file if requested */
+    const char *trace_file = config.trace ? config.trace : g_getenv("NLARN_TRACE");
+
+    if (trace_file && *trace_file && !trace_open(trace_file))
+    {
+        g_printerr("Could not open the trace file \"%s\".\n", trace_file);
+        exit(EXIT_FAILURE);
+    }
 
     /* show version information */
     if (config.show_version) {
@@ -252,6 +330,9 @@ static void nlarn_init(int argc, char *argv[])
         exit(EXIT_SUCCESS);
     }
 
+    /* read the predefined mazes */
+    nlarn_mazes_load();
+
     /* verify that user directory exists */
     if (!g_file_test(nlarn_userdir(), G_FILE_TEST_IS_DIR))
     {
@@ -279,6 +360,13 @@ static void nlarn_init(int argc, char *argv[])
     /* try to load settings from the configuration file */
     parse_ini_file(nlarn_inifile, &config);
 
+    /* choose how saved games are compressed */
+    if (config.compression && !codec_select(config.compression))
+    {
+        g_printerr("Unknown compression \"%s\" in \"%s\", using %s.\n",
+                config.compression, nlarn_inifile, codec_name());
+    }
+
 #ifdef SDLPDCURSES
     /* If a font size was defined, export it to the environment
      * before initialising PDCurses. */
@@ -289,6 +377,39 @@ static void nlarn_init(int argc, char *argv[])
         g_setenv("PDC_FONT_SIZE", size, TRUE);
     }
 #endif
+    /* assemble the save file name */
+    nlarn_savefile = g_build_path(G_DIR_SEPARATOR_S, nlarn_userdir(),
+            save_file, NULL);
+
+    if (config.replay)
+    {
+        if (!journal_replay(config.replay, &config))
+        {
+            g_printerr("Could not read the journal \"%s\".\n", config.replay);
+            exit(EXIT_FAILURE);
+        }
+
+        /* the replay must neither see nor change the player's files */
+        nlarn_inifile = g_build_filename(journal_replay_dir(), config_file, NULL);
+        nlarn_savefile = g_build_filename(journal_replay_dir(), save_file, NULL);
+        nlarn_highscores = g_build_filename(journal_replay_dir(), highscores, NULL);
+    }
+    else if (config.record)
+    {
+        /* a recording has to start from the beginning of a game */
+        if (g_file_test(nlarn_savefile, G_FILE_TEST_EXISTS))
+        {
+            g_printerr("Cannot record a journal while a saved game exists.\n");
+            exit(EXIT_FAILURE);
+        }
+
+        if (!journal_record(config.record, &config))
+        {
+            g_printerr("Could not open the journal \"%s\".\n", config.record);
+            exit(EXIT_FAILURE);
+        }
+    }
+
     /* initialise the display - must not happen before this point
        otherwise displaying the command line help fails */
     display_init();
@@ -296,10 +417,6 @@ static void nlarn_init(int argc, char *argv[])
     /* call display_shutdown when terminating the game */
     atexit(display_shutdown);
 
-    /* assemble the save file name */
-    nlarn_savefile = g_build_path(G_DIR_SEPARATOR_S, nlarn_userdir(),
-            save_file, NULL);
-
     /* set the console shutdown handler */
 #ifdef __unix
     signal(SIGTERM, nlarn_signal_handler);
@@ -321,17 +438,29 @@ static void mainloop()
     /* position chosen for auto travel, allowing to continue travel */
     position cpos = pos_invalid;
 
+    /* the path followed while travelling */
+    path *route = NULL;
+
     char run_cmd = 0;
     int ch = 0;
     gboolean adj_corr = FALSE;
     guint end_resting = 0;
+    gint64 iteration = 0;
+
+    /* keys pressed from now on can be recovered after a crash */
+    if (game_autosave(nlarn))
+        journal_wal_open();
 
     /* main event loop
        keep running until the game object was destroyed */
     while (nlarn)
     {
-        /* repaint screen */
-        display_paint_screen(nlarn->p);
+        /* one iteration ends where the next begins */
+        trace_end("mainloop", iteration, -1);
+        iteration = trace_begin();
+
+        /* repaint screen, unless more keys are waiting to be handled */
+        display_repaint(nlarn->p);
 
         if (pos_valid(pos))
         {
@@ -353,31 +482,22 @@ static void mainloop()
             }
             else
             {
-                /* find a path to the destination */
-                path *path = path_find(game_map(nlarn, Z(nlarn->p->pos)),
-                                       nlarn->p->pos, pos, LE_GROUND);
+                /* move along the path to the destination */
+                moves_count = player_travel_step(nlarn->p, pos, &route);
 
-                if (path && !g_queue_is_empty(path->path))
+                if (moves_count == 0)
                 {
-                    /* Path found. Move the player. */
-                    path_element *el = g_queue_pop_head(path->path);
-                    moves_count = player_move(nlarn->p, pos_dir(nlarn->p->pos, el->pos), TRUE);
-
-                    if (moves_count == 0)
-                    {
-                        /* for some reason movement is impossible, therefore
-                           stop auto travel. */
-                        pos = pos_invalid;
-                    }
-                }
-                else
-                {
-                    /* No path found. Stop traveling */
+                    /* no path found or for some reason movement is
+                       impossible, therefore stop auto travel. */
                     pos = pos_invalid;
                 }
+            }
 
-                /* clean up */
-                if (path) path_destroy(path);
+            /* the path is kept for the following steps */
+            if (!pos_valid(pos) && route != NULL)
+            {
+                path_destroy(route);
+                route = NULL;
             }
         }
         else if (run_cmd != 0)
@@ -389,6 +509,16 @@ static void mainloop()
         }
         else
         {
+            /* save the game when recovering the keys pressed since the
+               last save would take too long */
+            if (game_autosave(nlarn) && !journal_recovering()
+                    && journal_wal_length() >= JOURNAL_SNAPSHOT_KEYS)
+            {
+                /* the travel destination is not saved */
+                cpos = pos_invalid;
+                game_save(nlarn);
+            }
+
             /* not running or travelling, get a key and handle it */
             ch = display_getch(NULL);
 
@@ -592,10 +722,9 @@ static void mainloop()
             /* help */
         case KEY_F(1):
         case '?':
-            if (g_file_get_contents(nlarn_helpfile, &strbuf, NULL, NULL))
+            if (help_text || g_file_get_contents(nlarn_helpfile, &help_text, NULL, NULL))
             {
-                display_show_message("Help for the game of NLarn", strbuf, 1);
-                g_free(strbuf);
+                display_show_message("Help for the game of NLarn", help_text, 1);
             }
             else
             {
@@ -651,6 +780,7 @@ static void mainloop()
             {
                 /* restore last known auto travel position */
                 pos = cpos;
+                counter_inc(CNT_TRAVEL);
                 /* reset keyboard input */
                 ch = 0;
             }
@@ -789,6 +919,7 @@ static void mainloop()
                 ch = 0;
                 /* store position for resuming travel */
                 cpos = pos;
+                counter_inc(CNT_TRAVEL);
             }
             else
             {
@@ -910,15 +1041,15 @@ static void mainloop()
             if (game_wizardmode(nlarn) && (Z(nlarn->p->pos) > 0))
             {
                 moves_count = player_map_enter(nlarn->p, game_map(nlarn, Z(nlarn->p->pos) - 1),
-                                               Z(nlarn->p->pos) == MAP_CMAX);
+                                               Z(nlarn->p->pos) == map_volcano());
             }
             break;
 
         case '-': /* map down */
-            if (game_wizardmode(nlarn) && (Z(nlarn->p->pos) < (MAP_MAX - 1)))
+            if (game_wizardmode(nlarn) && (Z(nlarn->p->pos) < (pos_levels() - 1)))
             {
                 moves_count = player_map_enter(nlarn->p, game_map(nlarn, Z(nlarn->p->pos) + 1),
-                                               Z(nlarn->p->pos) == MAP_CMAX - 1);
+                                               Z(nlarn->p->pos) == map_volcano() - 1);
             }
             break;
 
@@ -975,13 +1106,33 @@ static void mainloop()
             if (game_wizardmode(nlarn))
                 calc_fighting_stats(nlarn->p);
             break;
+
+            /* toggle the counters of the last turn */
+        case 15: /* ^O */
+            if (game_wizardmode(nlarn))
+                game_profiler(nlarn) = (!game_profiler(nlarn));
+            break;
+
+            /* describe the counts per turn in the message log */
+        case 11: /* ^K */
+            if (game_wizardmode(nlarn))
+                counters_dump(nlarn->log);
+            break;
         }
 
         gboolean no_move = (moves_count == 0);
         gboolean was_attacked = FALSE;
 
         /* manipulate game time */
-        if (moves_count)
+        if (moves_count && run_cmd == '.')
+        {
+            /* resting: skip ahead over uneventful turns */
+            player_rest(nlarn->p, end_resting);
+            was_attacked = nlarn->p->attacked;
+            nlarn->p->attacked = FALSE;
+            moves_count = 0;
+        }
+        else if (moves_count)
         {
             player_make_move(nlarn->p, moves_count, FALSE, NULL);
             was_attacked = nlarn->p->attacked;
@@ -1032,6 +1183,9 @@ static void mainloop()
             }
         }
     }
+
+    if (route != NULL)
+        path_destroy(route);
 }
 
 gboolean main_menu()
@@ -1094,8 +1248,7 @@ int main(int argc, char *argv[])
     nlarn_init(argc, argv);
 
     /* check if the message file exists */
-    gchar *message_file = NULL;
-    if (!g_file_get_contents(nlarn_mesgfile, &message_file, NULL, NULL))
+    if (!message_text && !g_file_get_contents(nlarn_mesgfile, &message_text, NULL, NULL))
     {
         nlarn = game_destroy(nlarn);
         display_shutdown();
@@ -1105,8 +1258,7 @@ int main(int argc, char *argv[])
     }
 
     /* show message file */
-    display_show_message("Welcome to the game of NLarn!", message_file, 0);
-    g_free(message_file);
+    display_show_message("Welcome to the game of NLarn!", message_text, 0);
 
     /* Create the jump target for player death. Death will destroy the game
        object, thus control will be returned to the line after this one, i.e
@@ -1153,8 +1305,10 @@ int main(int argc, char *argv[])
             nlarn->player_stats_set = player_assign_bonus_stats(nlarn->p, selection);
         }
 
-        /* automatic save point (not when restoring a save) */
-        if ((game_turn(nlarn) == 1) && game_autosave(nlarn))
+        /* automatic save point (not when restoring a save, as the keys
+           pressed after it has been saved would be lost) */
+        if ((game_turn(nlarn) == 1) && game_autosave(nlarn)
+                && !g_file_test(nlarn_savefile, G_FILE_TEST_EXISTS))
         {
             game_save(nlarn);
         }
@@ -1163,9 +1317,13 @@ int main(int argc, char *argv[])
         mainloop();
     }
 
+    /* a replay fails if the outcome differs from the recording */
+    const gboolean journal_ok = journal_close();
+
     free_config(config);
+    maze_library_destroy();
 
-    return EXIT_SUCCESS;
+    return journal_ok ? EXIT_SUCCESS : EXIT_FAILURE;
 }
 
 static gboolean adjacent_corridor(position pos, char mv)
@@ -1215,12 +1373,12 @@ static gboolean adjacent_corridor(position pos, char mv)
         break;
     }
 
-    if (X(p1) < MAP_MAX_X && Y(p1) < MAP_MAX_Y
+    if (pos_valid(p1)
             && mt_is_passable(map_tiletype_at(game_map(nlarn, Z(nlarn->p->pos)), p1)))
     {
         return TRUE;
     }
-    if (X(p2) < MAP_MAX_X && Y(p2) < MAP_MAX_Y
+    if (pos_valid(p2)
             && mt_is_passable(map_tiletype_at(game_map(nlarn, Z(nlarn->p->pos)), p2)))
     {
         return TRUE;
@@ -16,6 +16,7 @@
  * with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include "counters.h"
 #include "nlarn.h"
 #include "pathfinding.h"
 #include "player.h"
@@ -25,19 +26,43 @@ static path_element *path_element_new(position pos);
 static int path_step_cost(map *m, path_element* element,
                          map_element_t map_elem, gboolean ppath);
 static int path_cost(path_element* element, position target);
-static path_element *path_element_in_list(path_element* el, GPtrArray *list);
-static path_element *path_find_best(path *pt);
+static path_element *path_element_known(path *pt, path_element *el,
+                                        gboolean closed);
+static void path_open_add(path *pt, path_element *el);
+static path_element *path_open_take_best(path *pt);
+static gboolean path_passable(map *m, position pos, map_element_t element,
+                              gboolean ppath);
 static GPtrArray *path_get_neighbours(map *m, position pos,
                                       map_element_t element,
                                       gboolean ppath);
+static void path_note_neighbourhood(area *seen, position pos);
+
+static path *path_search(map *m, position start, position goal,
+                         map_element_t element, area *seen);
 
 path *path_find(map *m, position start, position goal, map_element_t element)
+{
+    return path_search(m, start, goal, element, NULL);
+}
+
+path *path_find_watched(map *m, position start, position goal,
+                        map_element_t element, area *seen)
+{
+    g_assert(seen != NULL);
+
+    return path_search(m, start, goal, element, seen);
+}
+
+static path *path_search(map *m, position start, position goal,
+                         map_element_t element, area *seen)
 {
     g_assert(m != NULL);
     g_assert(pos_valid(start));
     g_assert(pos_valid(goal));
     g_assert(element < LE_MAX);
 
+    counter_inc(CNT_PATH_FIND);
+
     /* if the starting position is on another map, fail for now */
     /* TODO: could be changed to support 3D path finding */
     if (Z(start) != Z(goal))
@@ -47,17 +72,18 @@ path *path_find(map *m, position start, position goal, map_element_t element)
 
     /* add start to open list */
     path_element *curr = path_element_new(start);
-    g_ptr_array_add(pt->open, curr);
+    path_open_add(pt, curr);
 
     /* check if the path is being determined for the player */
     gboolean ppath = pos_identical(start, nlarn->p->pos);
 
     while (pt->open->len)
     {
-        curr = path_find_best(pt);
+        curr = path_open_take_best(pt);
 
-        g_ptr_array_remove_fast(pt->open, curr);
+        curr->closed = TRUE;
         g_ptr_array_add(pt->closed, curr);
+        counter_inc(CNT_PATH_NODES);
 
         if (pos_identical(curr->pos, pt->goal))
         {
@@ -75,6 +101,10 @@ path *path_find(map *m, position start, position goal, map_element_t element)
             return pt;
         }
 
+        /* note the node and its neighbours examined below */
+        if (seen != NULL)
+            path_note_neighbourhood(seen, curr->pos);
+
         GPtrArray *neighbours = path_get_neighbours(m, curr->pos, element, ppath);
 
         while (neighbours->len)
@@ -84,7 +114,7 @@ path *path_find(map *m, position start, position goal, map_element_t element)
 
             gboolean next_is_better = FALSE;
 
-            if (path_element_in_list(next, pt->closed))
+            if (path_element_known(pt, next, TRUE))
             {
                 g_free(next);
                 continue;
@@ -93,9 +123,8 @@ path *path_find(map *m, position start, position goal, map_element_t element)
             const guint32 next_g_score = curr->g_score
                 + path_step_cost(m, next, element, ppath);
 
-            if (!path_element_in_list(next, pt->open))
+            if (!path_element_known(pt, next, FALSE))
             {
-                g_ptr_array_add(pt->open, next);
                 next_is_better = TRUE;
             }
             else if (next->g_score > next_g_score)
@@ -111,6 +140,7 @@ path *path_find(map *m, position start, position goal, map_element_t element)
             {
                 next->parent  = curr;
                 next->g_score = next_g_score;
+                path_open_add(pt, next);
             }
         }
 
@@ -123,6 +153,37 @@ path *path_find(map *m, position start, position goal, map_element_t element)
     return NULL;
 }
 
+gboolean path_valid(map *m, path *pt, position start,
+                    map_element_t element)
+{
+    g_assert(m != NULL && pt != NULL);
+
+    if (g_queue_is_empty(pt->path))
+        return FALSE;
+
+    /* the path has to continue next to the start */
+    path_element *first = g_queue_peek_head(pt->path);
+
+    if (!pos_adjacent(start, first->pos) || pos_identical(start, first->pos))
+        return FALSE;
+
+    gboolean ppath = pos_identical(start, nlarn->p->pos);
+
+    for (GList *iter = pt->path->head; iter != NULL; iter = iter->next)
+    {
+        path_element *el = (path_element *)iter->data;
+        const guint32 cost = el->g_score
+            - (el->parent != NULL ? el->parent->g_score : 0);
+
+        /* a step that has become more costly might be avoided now */
+        if (!path_passable(m, el->pos, element, ppath)
+                || (guint32)path_step_cost(m, el, element, ppath) > cost)
+            return FALSE;
+    }
+
+    return TRUE;
+}
+
 void path_destroy(path *pt)
 {
     g_assert(pt != NULL);
@@ -140,6 +201,8 @@ void path_destroy(path *pt)
     }
     g_ptr_array_free(pt->closed, TRUE);
 
+    g_ptr_array_free(pt->heap, TRUE);
+    g_hash_table_destroy(pt->known);
     g_queue_free(pt->path);
     g_free(pt);
 }
@@ -153,6 +216,8 @@ static path *path_new(position start, position goal)
 
     pt->open   = g_ptr_array_new();
     pt->closed = g_ptr_array_new();
+    pt->heap   = g_ptr_array_new();
+    pt->known  = g_hash_table_new(g_direct_hash, g_direct_equal);
     pt->path   = g_queue_new();
 
     pt->start = start;
@@ -235,39 +300,127 @@ static int path_cost(path_element* element, position target)
     return element->g_score + element->h_score;
 }
 
-static path_element *path_element_in_list(path_element* el, GPtrArray *list)
+static path_element *path_element_known(path *pt, path_element *el,
+                                        gboolean closed)
+{
+    g_assert(pt != NULL && el != NULL);
+
+    path_element *li = g_hash_table_lookup(pt->known,
+                                           GUINT_TO_POINTER(pos_val(el->pos)));
+
+    return (li != NULL && li->closed == closed) ? li : NULL;
+}
+
+/* The best element of the open list is the one with the lowest estimated
+   cost, the earlier one in the open list if several have the same cost.
+   The heap keeps this order, thus the best element needs not to be
+   searched for in the whole list. */
+static gboolean path_heap_before(path_element *a, path_element *b)
+{
+    const guint32 cost_a = a->g_score + a->h_score;
+    const guint32 cost_b = b->g_score + b->h_score;
+
+    return cost_a < cost_b || (cost_a == cost_b && a->open_idx < b->open_idx);
+}
+
+static void path_heap_set(path *pt, guint idx, path_element *el)
+{
+    g_ptr_array_index(pt->heap, idx) = el;
+    el->heap_idx = idx;
+}
+
+static void path_heap_up(path *pt, path_element *el)
 {
-    g_assert(el != NULL && list != NULL);
+    guint idx = el->heap_idx;
 
-    for (guint idx = 0; idx < list->len; idx++)
+    while (idx > 0)
     {
-        path_element *li = g_ptr_array_index(list, idx);
+        path_element *parent = g_ptr_array_index(pt->heap, (idx - 1) / 2);
+
+        if (!path_heap_before(el, parent))
+            break;
 
-        if (pos_identical(li->pos, el->pos))
-            return li;
+        path_heap_set(pt, idx, parent);
+        idx = (idx - 1) / 2;
     }
 
-    return NULL;
+    path_heap_set(pt, idx, el);
 }
 
-static path_element *path_find_best(path *pt)
+static void path_heap_down(path *pt, path_element *el)
 {
-    path_element *best = NULL;
+    guint idx = el->heap_idx;
 
-    for (guint idx = 0; idx < pt->open->len; idx++)
+    while (2 * idx + 1 < pt->heap->len)
     {
-        path_element *el = g_ptr_array_index(pt->open, idx);
+        guint child = 2 * idx + 1;
+        path_element *cel = g_ptr_array_index(pt->heap, child);
 
-        if (best == NULL || path_cost(el, pt->goal)
-                < path_cost(best, pt->goal))
+        if (child + 1 < pt->heap->len
+                && path_heap_before(g_ptr_array_index(pt->heap, child + 1), cel))
         {
-            best = el;
+            cel = g_ptr_array_index(pt->heap, ++child);
         }
+
+        if (!path_heap_before(cel, el))
+            break;
+
+        path_heap_set(pt, idx, cel);
+        idx = child;
+    }
+
+    path_heap_set(pt, idx, el);
+}
+
+static void path_open_add(path *pt, path_element *el)
+{
+    /* the estimated distance to the goal does not change */
+    path_cost(el, pt->goal);
+
+    el->open_idx = pt->open->len;
+    g_ptr_array_add(pt->open, el);
+    g_hash_table_insert(pt->known, GUINT_TO_POINTER(pos_val(el->pos)), el);
+
+    el->heap_idx = pt->heap->len;
+    g_ptr_array_add(pt->heap, el);
+    path_heap_up(pt, el);
+}
+
+static path_element *path_open_take_best(path *pt)
+{
+    path_element *best = g_ptr_array_index(pt->heap, 0);
+    path_element *last = g_ptr_array_remove_index(pt->heap, pt->heap->len - 1);
+
+    if (last != best)
+    {
+        last->heap_idx = 0;
+        path_heap_down(pt, last);
+    }
+
+    /* the last element of the open list takes the place of the best one */
+    g_ptr_array_remove_index_fast(pt->open, best->open_idx);
+
+    if (best->open_idx < pt->open->len)
+    {
+        path_element *moved = g_ptr_array_index(pt->open, best->open_idx);
+
+        moved->open_idx = best->open_idx;
+        path_heap_up(pt, moved);
     }
 
     return best;
 }
 
+/* the player avoids the positions not known to be passable */
+static gboolean path_passable(map *m, position pos, map_element_t element,
+                              gboolean ppath)
+{
+    if (ppath)
+        return mt_is_passable(player_memory_of(nlarn->p, pos).type);
+
+    return monster_valid_dest(m, pos, element);
+}
+
 static GPtrArray *path_get_neighbours(map *m, position pos,
                                       map_element_t element,
                                       gboolean ppath)
@@ -284,8 +437,7 @@ static GPtrArray *path_get_neighbours(map *m, position pos,
         if (!pos_valid(npos))
             continue;
 
-        if ((ppath && mt_is_passable(player_memory_of(nlarn->p, npos).type))
-                || (!ppath && monster_valid_dest(m, npos, element)))
+        if (path_passable(m, npos, element, ppath))
         {
             path_element *pe = path_element_new(npos);
             g_ptr_array_add(neighbours, pe);
@@ -294,3 +446,11 @@ static GPtrArray *path_get_neighbours(map *m, position pos,
 
     return neighbours;
 }
+
+/* mark a position and the positions surrounding it */
+static void path_note_neighbourhood(area *seen, position pos)
+{
+    for (int y = max(Y(pos) - 1, 0); y <= min(Y(pos) + 1, seen->size_y - 1); y++)
+        for (int x = max(X(pos) - 1, 0); x <= min(X(pos) + 1, seen->size_x - 1); x++)
+            area_point_set(seen, x, y);
+}
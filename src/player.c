@@ -24,14 +24,18 @@
 #include "cJSON.h"
 #include "config.h"
 #include "container.h"
+#include "counters.h"
 #include "display.h"
 #include "fov.h"
 #include "game.h"
+#include "journal.h"
 #include "nlarn.h"
+#include "pathfinding.h"
 #include "player.h"
 #include "random.h"
 #include "scoreboard.h"
 #include "sobjects.h"
+#include "trace.h"
 
 const char *player_sex_str[] = {"not defined", "male", "female"};
 
@@ -133,6 +137,10 @@ player *player_new()
 
     /* initialize player */
     p = g_malloc0(sizeof(player));
+    p->memory_width = nlarn->map_width;
+    p->memory_height = nlarn->map_height;
+    p->memory_levels = nlarn->levels;
+    p->memory = g_new0(player_tile_memory *, p->memory_levels);
 
     p->strength     = 12;
     p->constitution = 12;
@@ -334,6 +342,11 @@ void player_destroy(player *p)
     /* clean the FOV */
     fov_free(p->fv);
 
+    /* forget the levels */
+    for (guint nlevel = 0; nlevel < p->memory_levels; nlevel++)
+        g_free(p->memory[nlevel]);
+
+    g_free(p->memory);
     g_free(p);
 }
 
@@ -464,21 +477,7 @@ cJSON *player_serialize(player *p)
         cJSON_AddNumberToObject(pser, "ptarget", GPOINTER_TO_UINT(p->ptarget));
     }
 
-    position pos = pos_invalid;
-
-    /* store players' memory of the map */
-    cJSON_AddItemToObject(pser, "memory", obj = cJSON_CreateArray());
-
-    for (Z(pos) = 0; Z(pos) < MAP_MAX; Z(pos)++)
-    {
-        cJSON *mm = cJSON_CreateArray();
-
-        for (Y(pos) = 0; Y(pos) < MAP_MAX_Y; Y(pos)++)
-            for (X(pos) = 0; X(pos) < MAP_MAX_X; X(pos)++)
-                cJSON_AddItemToArray(mm, player_memory_serialize(p, pos));
-
-        cJSON_AddItemToArray(obj, mm);
-    }
+    /* the memory of the levels is stored by game_save() */
 
     /* store remembered stationary objects */
     if (p->sobjmem != NULL)
@@ -544,6 +543,10 @@ player *player_deserialize(cJSON *pser)
     cJSON *obj, *elem;
 
     p = g_malloc0(sizeof(player));
+    p->memory_width = nlarn->map_width;
+    p->memory_height = nlarn->map_height;
+    p->memory_levels = nlarn->levels;
+    p->memory = g_new0(player_tile_memory *, p->memory_levels);
 
     p->name = g_strdup(cJSON_GetObjectItem(pser, "name")->valuestring);
     p->sex = cJSON_GetObjectItem(pser, "sex")->valueint;
@@ -672,21 +675,14 @@ player *player_deserialize(cJSON *pser)
         p->ptarget = GUINT_TO_POINTER(obj->valueint);
     }
 
-    /* restore players' memory of the map */
-    position pos = pos_invalid;
-    obj = cJSON_GetObjectItem(pser, "memory");
-
-    for (Z(pos) = 0; Z(pos) < MAP_MAX; Z(pos)++)
+    /* restore players' memory of the map, stored with the player
+       by earlier versions */
+    if ((obj = cJSON_GetObjectItem(pser, "memory")))
     {
-        elem = cJSON_GetArrayItem(obj, Z(pos));
-
-        for (Y(pos) = 0; Y(pos) < MAP_MAX_Y; Y(pos)++)
+        for (guint nlevel = 0; nlevel < p->memory_levels; nlevel++)
         {
-            for (X(pos) = 0; X(pos) < MAP_MAX_X; X(pos)++)
-            {
-                cJSON *tile = cJSON_GetArrayItem(elem, X(pos) + (MAP_MAX_X * Y(pos)));
-                player_memory_deserialize(p, pos, tile);
-            }
+            player_level_memory_deserialize(p, nlevel,
+                    cJSON_GetArrayItem(obj, nlevel));
         }
     }
 
@@ -754,44 +750,170 @@ player *player_deserialize(cJSON *pser)
     return p;
 }
 
-gboolean player_make_move(player *p, int turns, gboolean interruptible, const char *desc, ...)
+/* the distance up to which a monster can disturb the player:
+   the player's sight or the range monsters can see the player */
+static int player_quiet_range(player *p)
 {
-    int frequency; /* number of turns between occasions */
-    int regen = 0; /* amount of regeneration */
-    effect *e; /* temporary var for effect */
-    guint idx = 0;
-    g_autofree char *description = NULL, *popup_desc = NULL;
+    int range = (Z(p->pos) == 0 ? 15 : 6) + player_effect(p, ET_AWARENESS);
 
-    g_assert(p != NULL);
+    return max(range, 7);
+}
 
-    /* do do nothing if there is nothing to */
-    if (turns == 0) return FALSE;
+/* check if a monster is within player_quiet_range() of the player */
+static gboolean player_quiet_disturbed(player *p)
+{
+    const int range = player_quiet_range(p);
+    map *pmap = game_map(nlarn, Z(p->pos));
+    position pos = p->pos;
 
-    /* return if the game has not been entirely set up */
-    if (nlarn->p == NULL) return TRUE;
+    for (Y(pos) = max(0, Y(p->pos) - range);
+         Y(pos) <= min(pmap->height - 1, Y(p->pos) + range); Y(pos)++)
+    {
+        for (X(pos) = max(0, X(p->pos) - range);
+             X(pos) <= min(pmap->width - 1, X(p->pos) + range); X(pos)++)
+        {
+            if (map_is_monster_at(pmap, pos))
+                return TRUE;
+        }
+    }
 
-    // Initialize attacked marker.
-    p->attacked = FALSE;
+    return p->attacked;
+}
 
-    /* assemble message and append it to the buffer */
-    if (desc != NULL)
+/* Determine how many of the next turns are certain to pass without
+ * anything happening to the player, up to limit. The player's regeneration
+ * during such a quiet stretch is calculated in one step by
+ * player_fast_forward(); the world moves every turn unless nothing happens
+ * there either, see game_fast_forward(). */
+static int player_quiet_turns(player *p, int limit)
+{
+    const int frequency = game_difficulty(nlarn) << 3;
+    const int range = player_quiet_range(p);
+    map *pmap = game_map(nlarn, Z(p->pos));
+    int quiet = limit;
+
+    /* effects which have to be handled every turn */
+    if (player_effect(p, ET_TIMESTOP) || player_effect(p, ET_POISON)
+        || player_effect(p, ET_CLUMSINESS) || player_effect(p, ET_ITCHING)
+        || player_effect(p, ET_ENLIGHTENMENT))
     {
-        va_list argp;
+        return 0;
+    }
 
-        va_start(argp, desc);
-        description = g_strdup_vprintf(desc, argp);
-        va_end(argp);
+    /* spheres roam freely */
+    for (guint idx = 0; idx < nlarn->spheres->len; idx++)
+    {
+        sphere *s = g_ptr_array_index(nlarn->spheres, idx);
+        if (Z(s->pos) == Z(p->pos))
+            return 0;
     }
 
-    display_window *pop = NULL;
-    if (turns > 10 && description)
+    /* the tile the player is standing on might hurt */
+    damage *dam = map_tile_damage(pmap, p->pos, player_effect(p, ET_LEVITATION));
+    if (dam != NULL)
     {
-        /* shop popup window */
-        popup_desc = g_strdup_printf("You are %s.",
-                description);
-        pop = display_popup(2, 2, 40, NULL, popup_desc, 0);
+        damage_free(dam);
+        return 0;
     }
 
+    /* temporary effects: stop before the turn an effect ends */
+    for (guint idx = 0; idx < p->effects->len; idx++)
+    {
+        effect *e = game_effect_get(nlarn, g_ptr_array_index(p->effects, idx));
+
+        if (e->type == ET_TRAPPED || effect_turns(e) == 0)
+            continue;
+
+        quiet = min(quiet, effect_turns(e) - 1);
+    }
+
+    /* regeneration: stop at the turn hit points and mana are restored */
+    int hp_ticks = 0, mp_ticks = 0;
+    int hp_regen = 1 + player_effect(p, ET_INC_HP_REGEN);
+    int mp_regen = 1 + player_effect(p, ET_INC_MP_REGEN);
+
+    if (p->hp < player_get_hp_max(p))
+        hp_ticks = (player_get_hp_max(p) - p->hp + hp_regen - 1) / hp_regen;
+
+    if (p->mp < player_get_mp_max(p))
+        mp_ticks = (player_get_mp_max(p) - p->mp + mp_regen - 1) / mp_regen;
+
+    if (hp_ticks > 0 || mp_ticks > 0)
+    {
+        int ticks = max(hp_ticks, mp_ticks);
+        quiet = min(quiet, (int)p->regen_counter + 1 + (ticks - 1) * (23 + frequency));
+    }
+
+    /* stop before new monsters are spawned on the player's map */
+    int spawn = 100 + Z(p->pos);
+    quiet = min(quiet, (spawn - game_turn(nlarn) % spawn) % spawn);
+
+    /* monsters on the player's map: assume each one comes straight
+       towards the player at full speed */
+    GHashTableIter iter;
+    gpointer m;
+
+    g_hash_table_iter_init(&iter, nlarn->monsters);
+    while (quiet > 0 && g_hash_table_iter_next(&iter, NULL, &m))
+    {
+        position mpos = monster_pos(m);
+
+        if (Z(mpos) != Z(p->pos))
+            continue;
+
+        int dist = max(abs(X(mpos) - X(p->pos)), abs(Y(mpos) - Y(p->pos)));
+        int steps = max(monster_speed(m), 0) / NORMAL + 1;
+
+        if (dist <= range)
+            return 0;
+
+        quiet = min(quiet, (dist - range - 1) / steps);
+    }
+
+    return max(quiet, 0);
+}
+
+/* apply the regeneration of a quiet stretch of turns */
+static void player_fast_forward(player *p, int turns)
+{
+    const int frequency = game_difficulty(nlarn) << 3;
+
+    if (turns == 0)
+        return;
+
+    /* regeneration happens at the turn the counter has reached 0,
+       afterwards the counter is reset to 22 + frequency */
+    const int counter = p->regen_counter;
+    int ticks = 0;
+
+    if (turns > counter)
+    {
+        ticks = 1 + (turns - counter - 1) / (23 + frequency);
+        p->regen_counter = 22 + frequency - (turns - counter - 1) % (23 + frequency);
+    }
+    else
+    {
+        p->regen_counter = counter - turns;
+    }
+
+    if (ticks > 0 && p->hp < player_get_hp_max(p))
+        player_hp_gain(p, ticks * (1 + player_effect(p, ET_INC_HP_REGEN)));
+
+    if (ticks > 0 && p->mp < player_get_mp_max(p))
+        player_mp_gain(p, ticks * (1 + player_effect(p, ET_INC_MP_REGEN)));
+}
+
+/* Let time pass. If rest is positive, it is the length of a quiet stretch
+   determined by the caller; the function returns when it has ended. */
+static gboolean player_turns_pass(player *p, int turns, gboolean interruptible,
+                                  const char *description, int rest)
+{
+    int frequency; /* number of turns between occasions */
+    int regen = 0; /* amount of regeneration */
+    effect *e; /* temporary var for effect */
+    int quiet = rest; /* remaining turns of the current quiet stretch */
+    int skipped = 0;  /* quiet turns not yet accounted for */
+
     /* modifier for frequency */
     frequency = game_difficulty(nlarn) << 3;
 
@@ -828,40 +950,53 @@ gboolean player_make_move(player *p, int turns, gboolean interruptible, const ch
                 }
             }
 
+            /* look ahead for a stretch of uneventful turns */
+            if (rest == 0 && quiet == 0 && turns > 1)
+                quiet = player_quiet_turns(p, turns);
+
             /* move the rest of the world */
             game_spin_the_wheel(nlarn);
 
-            /* expire temporary effects */
-            idx = 0; // reset idx for proper expiration during multiturn events
-            while (idx < p->effects->len)
+            if (quiet > 0)
             {
-                gpointer effect_id = g_ptr_array_index(p->effects, idx);
-                e = game_effect_get(nlarn, effect_id);
-
-                /* trapped counter only reduces on movement */
-                if (e->type != ET_TRAPPED && effect_expire(e) == -1)
+                if (!player_quiet_disturbed(p))
                 {
-                    /* effect has expired */
-                    player_effect_del(p, e);
-                }
-                else
-                {
-                    /* give a warning if critical effects are about to time out */
-                    if (e->turns == 5)
+                    /* nothing happened - skip the player's bookkeeping,
+                       repainting and pausing for this turn */
+                    skipped++;
+                    quiet--;
+                    turns--;
+
+                    /* when nothing happens in the rest of the world either,
+                       the remaining quiet turns pass at once */
+                    if (quiet > 0 && player_get_speed(p) == NORMAL)
                     {
-                        gboolean interrupt_actions = TRUE;
-                        if (e->type == ET_WALL_WALK)
-                            log_add_entry(nlarn->log, "`lightred`Your attunement to the walls is fading!`end`");
-                        else if (e->type == ET_LEVITATION)
-                            log_add_entry(nlarn->log, "`lightred`You are starting to drift towards the ground!`end`");
-                        else
-                            interrupt_actions = FALSE;
-
-                        if (interrupt_actions)
-                            p->attacked = TRUE;
+                        const int idle = game_fast_forward(nlarn, quiet);
+
+                        skipped += idle;
+                        quiet -= idle;
+                        turns -= idle;
                     }
-                    idx++;
+
+                    if (quiet == 0)
+                    {
+                        player_fast_forward(p, skipped);
+                        skipped = 0;
+
+                        if (rest > 0)
+                            break;
+                    }
+
+                    continue;
                 }
+
+                /* a monster showed up unexpectedly: catch up with the
+                   quiet turns and handle this turn as usual */
+                player_fast_forward(p, skipped);
+                skipped = quiet = 0;
+
+                if (rest > 0)
+                    turns = 1;
             }
 
             /* handle regeneration */
@@ -940,7 +1075,7 @@ gboolean player_make_move(player *p, int turns, gboolean interruptible, const ch
                 if (!interruptible || p->attacked)
                 {
                     display_paint_screen(p);
-                    napms((turns > 10) ? 1 : 50);
+                    display_sleep((turns > 10) ? 1 : 50);
                 }
 
                 /* offer to abort the action if the player is under attack */
@@ -962,12 +1097,6 @@ gboolean player_make_move(player *p, int turns, gboolean interruptible, const ch
                         /* clean up */
                         p->attacked = FALSE;
 
-                        if (pop)
-                        {
-                            /* remove the popup window */
-                            display_window_destroy(pop);
-                        }
-
                         return FALSE;
                     }
                 }
@@ -986,14 +1115,77 @@ gboolean player_make_move(player *p, int turns, gboolean interruptible, const ch
     }
     while (turns > 0);
 
+    /* account for the remainder of a quiet stretch */
+    player_fast_forward(p, skipped);
+
+    return TRUE;
+}
+
+gboolean player_make_move(player *p, int turns, gboolean interruptible, const char *desc, ...)
+{
+    g_autofree char *description = NULL, *popup_desc = NULL;
+
+    g_assert(p != NULL);
+
+    /* do do nothing if there is nothing to */
+    if (turns == 0) return FALSE;
+
+    /* return if the game has not been entirely set up */
+    if (nlarn->p == NULL) return TRUE;
+
+    // Initialize attacked marker.
+    p->attacked = FALSE;
+
+    /* assemble message and append it to the buffer */
+    if (desc != NULL)
+    {
+        va_list argp;
+
+        va_start(argp, desc);
+        description = g_strdup_vprintf(desc, argp);
+        va_end(argp);
+    }
+
+    display_window *pop = NULL;
+    if (turns > 10 && description)
+    {
+        /* shop popup window */
+        popup_desc = g_strdup_printf("You are %s.",
+                description);
+        pop = display_popup(2, 2, 40, NULL, popup_desc, 0);
+    }
+
+    gboolean completed = player_turns_pass(p, turns, interruptible,
+                                           description, 0);
+
     if (pop)
     {
         /* remove the popup window */
         display_window_destroy(pop);
     }
 
-    /* successfully completed the action */
-    return TRUE;
+    return completed;
+}
+
+int player_rest(player *p, guint until)
+{
+    g_assert(p != NULL);
+
+    guint start = game_turn(nlarn);
+    int quiet = (until > start) ? player_quiet_turns(p, until - start) : 0;
+
+    if (quiet < 2)
+    {
+        /* something might happen: rest for a single turn */
+        player_make_move(p, 1, FALSE, NULL);
+    }
+    else
+    {
+        p->attacked = FALSE;
+        player_turns_pass(p, G_MAXINT, FALSE, NULL, quiet);
+    }
+
+    return game_turn(nlarn) - start;
 }
 
 void player_die(player *p, player_cod cause_type, int cause)
@@ -1145,7 +1337,7 @@ void player_die(player *p, player_cod cause_type, int cause)
         display_paint_screen(p);
 
         /* sleep a second */
-        g_usleep(1000000);
+        display_sleep(1000);
 
         /* flush keyboard input buffer */
         flushinp();
@@ -1366,6 +1558,39 @@ int player_move(player *p, direction dir, gboolean open_door)
     return times;
 }
 
+int player_travel_step(player *p, position dest, path **route)
+{
+    map *pmap = game_map(nlarn, Z(p->pos));
+
+    g_assert(p != NULL && route != NULL);
+
+    /* a new path is only needed when the one found before is no good */
+    if (*route != NULL && !(pos_identical((*route)->goal, dest)
+                            && path_valid(pmap, *route, p->pos, LE_GROUND)))
+    {
+        path_destroy(*route);
+        *route = NULL;
+    }
+
+    if (*route == NULL)
+    {
+        counter_inc(CNT_TRAVEL_PATHS);
+        *route = path_find(pmap, p->pos, dest, LE_GROUND);
+    }
+
+    if (*route == NULL || g_queue_is_empty((*route)->path))
+        return 0;
+
+    path_element *el = g_queue_peek_head((*route)->path);
+    const int moves = player_move(p, pos_dir(p->pos, el->pos), TRUE);
+
+    /* the player stays in place when opening a door on the way */
+    if (pos_identical(p->pos, el->pos))
+        g_queue_pop_head((*route)->path);
+
+    return moves;
+}
+
 typedef struct min_max_damage
 {
     int min_damage;
@@ -1589,8 +1814,15 @@ int player_map_enter(player *p, map *l, gboolean teleported)
 {
     g_assert(p != NULL && l != NULL);
 
-    /* store the last turn player has been on this map */
-    game_map(nlarn, Z(p->pos))->visited = game_turn(nlarn);
+    /* levels are generated on first entry */
+    if (!map_generated(l))
+        l = game_map_generate(nlarn, l->nlevel);
+
+    /* store the last turn player has been on this map; the player's memory
+       of the map has to be saved again, too */
+    map *left = game_map(nlarn, Z(p->pos));
+    left->visited = game_turn(nlarn);
+    left->modified = TRUE;
 
     if (p->stats.deepest_level < l->nlevel)
     {
@@ -1612,11 +1844,11 @@ int player_map_enter(player *p, map *l, gboolean teleported)
         p->pos = map_find_sobject(l, LS_HOME);
 
     /* took the elevator down */
-    else if ((Z(p->pos) == 0) && (l->nlevel == (MAP_CMAX)))
+    else if ((Z(p->pos) == 0) && ((int)l->nlevel == map_volcano()))
         p->pos = map_find_sobject(l, LS_ELEVATORUP);
 
     /* took the elevator up */
-    else if ((Z(p->pos) == (MAP_CMAX)) && (l->nlevel == 0))
+    else if ((Z(p->pos) == map_volcano()) && (l->nlevel == 0))
         p->pos = map_find_sobject(l, LS_ELEVATORDOWN);
 
     /* climbing up */
@@ -1658,18 +1890,15 @@ int player_map_enter(player *p, map *l, gboolean teleported)
                         game_map(nlarn, Z(p->pos)), mnpos);
     }
 
+    /* the monsters around the new map start moving again */
+    game_actors_wake(nlarn);
+
     /* recalculate FOV to make ensure correct display after entering a level */
     player_update_fov(p);
 
     /* call autopickup */
     player_autopickup(p);
 
-    /* automatic save point */
-    if (game_autosave(nlarn) && (game_turn(nlarn) > 1))
-    {
-        game_save(nlarn);
-    }
-
     return TRUE;
 }
 
@@ -1823,7 +2052,8 @@ void player_level_gain(player *p, int count)
     if (p->level == 100)
         return;
 
-    desc_orig = player_get_level_desc(p);
+    /* the player may have lost the last level */
+    desc_orig = p->level ? player_get_level_desc(p) : NULL;
 
     p->level += count;
 
@@ -2520,6 +2750,8 @@ effect *player_effect_add(player *p, effect *e)
            actually has a value */
         if (e)
         {
+            effect_schedule(e, NULL);
+
             if (effect_get_amount(e) > 0 && effect_get_msg_start(e))
                 log_add_entry(nlarn->log, "%s", effect_get_msg_start(e));
             else if (effect_get_amount(e) < 0 && effect_get_msg_stop(e))
@@ -2590,6 +2822,21 @@ int player_effect_del(player *p, effect *e)
     return result;
 }
 
+void player_effect_fading(player *p, effect *e)
+{
+    g_assert(p != NULL && e != NULL);
+
+    if (e->type == ET_WALL_WALK)
+        log_add_entry(nlarn->log, "`lightred`Your attunement to the walls is fading!`end`");
+    else if (e->type == ET_LEVITATION)
+        log_add_entry(nlarn->log, "`lightred`You are starting to drift towards the ground!`end`");
+    else
+        return;
+
+    /* interrupt multi-turn actions */
+    p->attacked = TRUE;
+}
+
 void player_effects_del(player *p, GPtrArray *effects)
 {
     g_assert (p != NULL);
@@ -2720,7 +2967,11 @@ int player_inv_display(player *p)
 
 static char *player_print_weight(float weight)
 {
-    static char buf[21] = "";
+#ifdef _MSC_VER
+    static __declspec(thread) char buf[21] = "";
+#else
+    static __thread char buf[21] = "";
+#endif
 
     const char *unit = "g";
     if (weight > 1000)
@@ -2736,7 +2987,11 @@ static char *player_print_weight(float weight)
 
 char *player_can_carry(player *p)
 {
-    static char buf[21] = "";
+#ifdef _MSC_VER
+    static __declspec(thread) char buf[21] = "";
+#else
+    static __thread char buf[21] = "";
+#endif
     g_snprintf(buf, 20, "%s",
                player_print_weight(2000 * 1.3 * (float)player_get_str(p)));
     return buf;
@@ -2744,7 +2999,11 @@ char *player_can_carry(player *p)
 
 char *player_inv_weight(player *p)
 {
-    static char buf[21] = "";
+#ifdef _MSC_VER
+    static __declspec(thread) char buf[21] = "";
+#else
+    static __thread char buf[21] = "";
+#endif
     g_snprintf(buf, 20, "%s",
                player_print_weight((float)inv_weight(p->inventory)));
     return buf;
@@ -2810,9 +3069,9 @@ void player_inv_weight_recalc(inventory *inv, item *it __attribute__((unused)))
         if ((e = player_effect_get(p, ET_BURDENED)))
         {
             /* get rid of burden effect (mute log to avoid pointless message) */
-            log_disable(nlarn->log);
+            gboolean logged = log_disable(nlarn->log);
             player_effect_del(p, e);
-            log_enable(nlarn->log);
+            if (logged) log_enable(nlarn->log);
         }
 
         /* make overstrained */
@@ -2827,9 +3086,9 @@ void player_inv_weight_recalc(inventory *inv, item *it __attribute__((unused)))
         if ((e = player_effect_get(p, ET_OVERSTRAINED)))
         {
             /* get rid of overstrained effect */
-            log_disable(nlarn->log);
+            gboolean logged = log_disable(nlarn->log);
             player_effect_del(p, e);
-            log_enable(nlarn->log);
+            if (logged) log_enable(nlarn->log);
         }
 
         if (!player_effect(p, ET_BURDENED))
@@ -3068,8 +3327,9 @@ void player_item_unequip(player *p,
 {
     g_assert(p != NULL && it != NULL);
 
-    /* Check if the player is able to move. */
-    if (!player_movement_possible(p))
+    /* Check if the player is able to move. Items taken away by force
+       must be removed in any case. */
+    if (!forced && !player_movement_possible(p))
         return;
 
    /* the idea behind the time values: one turn to take one item off,
@@ -3715,6 +3975,9 @@ void player_item_identify(player *p, inventory **inv __attribute__((unused)), it
 
     it->blessed_known = TRUE;
     it->bonus_known = TRUE;
+
+    /* the player's knowledge has changed */
+    item_desc_invalidate();
 }
 
 void player_item_use(player *p, inventory **inv __attribute__((unused)), item *it)
@@ -3935,6 +4198,7 @@ void player_item_notes(player *p, inventory **inv __attribute__((unused)), item
     /* free the old note before adding the new note to the item */
     g_free(it->notes);
     it->notes = temp;
+    item_desc_invalidate();
 
     g_free(caption);
 }
@@ -4251,10 +4515,10 @@ void player_search(player *p)
         if (player_effect(p, ET_BLINDNESS))
         {
             /* examine tile types */
-            player_memory_of(p, pos).type = map_tile_at(m, pos)->type;
+            player_memory_of(p, pos).type = map_tile_get(m, pos)->type;
 
             /* examine stationary objects */
-            player_memory_of(p, pos).sobject = map_tile_at(m, pos)->sobject;
+            player_memory_of(p, pos).sobject = map_tile_get(m, pos)->sobject;
         }
 
         /* search for traps */
@@ -4324,7 +4588,7 @@ void player_list_sobjmem(player *p)
             som = &g_array_index(p->sobjmem, player_sobject_memory, idx);
 
             g_string_append_printf(sobjlist, "%-4s %s (%d, %d)\n",
-                                   (Z(som->pos) > prevmap) ? map_names[Z(som->pos)] : "",
+                                   (Z(som->pos) > prevmap) ? map_level_name(Z(som->pos), pos_levels()) : "",
                                    so_get_desc(som->sobject),
                                    Y(som->pos), X(som->pos));
 
@@ -4341,6 +4605,7 @@ void player_update_fov(player *p)
     int radius;
     position pos = p->pos;
     map *pmap;
+    gint64 span = trace_begin();
 
     int range = (Z(p->pos) == 0 ? 15 : 6);
 
@@ -4401,9 +4666,11 @@ void player_update_fov(player *p)
     }
 
     /* update visible fields in player's memory */
-    for (Y(pos) = 0; Y(pos) < MAP_MAX_Y; Y(pos)++)
+    const rectangle seen = fov_get_bounds(p->fv);
+
+    for (Y(pos) = seen.y1; Y(pos) <= (int)seen.y2; Y(pos)++)
     {
-        for (X(pos) = 0; X(pos) < MAP_MAX_X; X(pos)++)
+        for (X(pos) = seen.x1; X(pos) <= (int)seen.x2; X(pos)++)
         {
             if (fov_get(p->fv, pos))
             {
@@ -4474,6 +4741,8 @@ void player_update_fov(player *p)
             }
         }
     }
+
+    trace_end("player_update_fov", span, -1);
 }
 
 static guint player_item_pickup(player *p, inventory **inv, item *it, gboolean ask)
@@ -4686,6 +4955,56 @@ static int player_sobjects_sort(gconstpointer a, gconstpointer b)
         return 1;
 }
 
+cJSON *player_level_memory_serialize(player *p, guint nlevel)
+{
+    cJSON *mser = cJSON_CreateArray(), *tile = NULL;
+    position pos = pos_invalid;
+
+    g_assert(p != NULL && nlevel < p->memory_levels);
+
+    Z(pos) = nlevel;
+
+    for (Y(pos) = 0; Y(pos) < p->memory_height; Y(pos)++)
+        for (X(pos) = 0; X(pos) < p->memory_width; X(pos)++)
+        {
+            /* levels never seen are not allocated to be saved */
+            tile = json_array_append(mser, tile, p->memory[nlevel] == NULL
+                                     ? cJSON_CreateObject()
+                                     : player_memory_serialize(p, pos));
+        }
+
+    return mser;
+}
+
+void player_level_memory_deserialize(player *p, guint nlevel, cJSON *mser)
+{
+    position pos = pos_invalid;
+
+    g_assert(p != NULL && nlevel < p->memory_levels);
+
+    Z(pos) = nlevel;
+
+    /* the tiles are stored row by row */
+    cJSON *tile = mser->child;
+
+    for (Y(pos) = 0; Y(pos) < p->memory_height; Y(pos)++)
+    {
+        for (X(pos) = 0; X(pos) < p->memory_width; X(pos)++, tile = tile->next)
+        {
+            g_assert(tile != NULL);
+            player_memory_deserialize(p, pos, tile);
+        }
+    }
+}
+
+void player_level_memory_forget(player *p, guint nlevel)
+{
+    g_assert(p != NULL && nlevel < p->memory_levels);
+
+    g_free(p->memory[nlevel]);
+    p->memory[nlevel] = NULL;
+}
+
 static cJSON *player_memory_serialize(player *p, position pos)
 {
     cJSON *mser;
@@ -5218,13 +5537,16 @@ static void player_memorial_file_save(player *p, const char *text)
             done = TRUE;
         } else {
             /* file name has been provided, try to save file */
-            char *fullname = g_build_path(G_DIR_SEPARATOR_S,
 #ifdef G_OS_WIN32
-                    g_get_user_special_dir(G_USER_DIRECTORY_DOCUMENTS),
+            const char *dir = g_get_user_special_dir(G_USER_DIRECTORY_DOCUMENTS);
 #else
-                    g_get_home_dir(),
+            const char *dir = g_get_home_dir();
 #endif
-                    filename, NULL);
+            /* do not overwrite the player's file when replaying a journal */
+            if (journal_replaying())
+                dir = journal_replay_dir();
+
+            char *fullname = g_build_path(G_DIR_SEPARATOR_S, dir, filename, NULL);
 
             if (g_file_test(fullname, G_FILE_TEST_IS_SYMLINK))
             {
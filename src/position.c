@@ -26,12 +26,30 @@
 #include "position.h"
 
 #define POS_MAX_XY (1<<10)
-#define POS_MAX_Z  (1<<6)
-
-static void area_flood_worker(area *flood, area *obstacles, int x, int y);
+#define POS_MAX_Z  ((1<<8) - 1)
 
 const position pos_invalid = { { POS_MAX_XY, POS_MAX_XY, POS_MAX_Z } };
 
+/* the dimensions of the levels of the game played by this thread */
+static __thread int pos_max_x = MAP_MAX_X;
+static __thread int pos_max_y = MAP_MAX_Y;
+static __thread int pos_max_z = MAP_MAX;
+
+void pos_bounds_use(int width, int height, int levels)
+{
+    g_assert(width > 0 && width < POS_MAX_XY && height > 0 && height < POS_MAX_XY);
+    g_assert(levels > 0 && levels < POS_MAX_Z);
+
+    pos_max_x = width;
+    pos_max_y = height;
+    pos_max_z = levels;
+}
+
+int pos_levels()
+{
+    return pos_max_z;
+}
+
 position pos_move(position pos, direction dir)
 {
     /* return given position if direction is not implemented */
@@ -69,7 +87,7 @@ position pos_move(position pos, direction dir)
         break;
 
     case GD_NE:
-        if ((X(pos) < MAP_MAX_X - 1) && (Y(pos) > 0))
+        if ((X(pos) < pos_max_x - 1) && (Y(pos) > 0))
         {
             X(npos) += 1;
             Y(npos) -= 1;
@@ -80,7 +98,7 @@ position pos_move(position pos, direction dir)
         break;
 
     case GD_EAST:
-        if (X(pos) < MAP_MAX_X - 1)
+        if (X(pos) < pos_max_x - 1)
             X(npos) += 1;
         else
             npos = pos_invalid;
@@ -88,7 +106,7 @@ position pos_move(position pos, direction dir)
         break;
 
     case GD_SE:
-        if ((X(pos) < MAP_MAX_X - 1) && (Y(pos) < MAP_MAX_Y - 1))
+        if ((X(pos) < pos_max_x - 1) && (Y(pos) < pos_max_y - 1))
         {
             X(npos) += 1;
             Y(npos) += 1;
@@ -99,7 +117,7 @@ position pos_move(position pos, direction dir)
         break;
 
     case GD_SOUTH:
-        if (Y(pos) < MAP_MAX_Y - 1)
+        if (Y(pos) < pos_max_y - 1)
             Y(npos) += 1;
         else
             npos = pos_invalid;
@@ -107,7 +125,7 @@ position pos_move(position pos, direction dir)
         break;
 
     case GD_SW:
-        if ((X(pos) > 0) && (Y(pos) < MAP_MAX_Y - 1))
+        if ((X(pos) > 0) && (Y(pos) < pos_max_y - 1))
         {
             X(npos) -= 1;
             Y(npos) += 1;
@@ -153,9 +171,9 @@ int pos_adjacent(position first, position second)
 
 int pos_valid(position pos)
 {
-    return (X(pos) < MAP_MAX_X)
-            && (Y(pos) < MAP_MAX_Y)
-            && (Z(pos) < MAP_MAX);
+    return (X(pos) >= 0) && (X(pos) < pos_max_x)
+            && (Y(pos) >= 0) && (Y(pos) < pos_max_y)
+            && (Z(pos) < pos_max_z);
 }
 
 direction pos_dir(position origin, position target)
@@ -182,8 +200,8 @@ rectangle rect_new(int x1, int y1, int x2, int y2)
 
     rect.x1 = (x1 < 0) ? 0 : x1;
     rect.y1 = (y1 < 0) ? 0 : y1;
-    rect.x2 = (x2 > MAP_MAX_X) ? MAP_MAX_X : x2;
-    rect.y2 = (y2 > MAP_MAX_Y) ? MAP_MAX_Y : y2;
+    rect.x2 = (x2 > pos_max_x) ? pos_max_x : x2;
+    rect.y2 = (y2 > pos_max_y) ? pos_max_y : y2;
 
     return(rect);
 }
@@ -218,10 +236,14 @@ area *area_new(int start_x, int start_y, int size_x, int size_y)
     a->size_x = size_x;
     a->size_y = size_y;
 
+    /* the rows share one block, as an area may be as large as a level */
     a->area = g_malloc0(size_y * sizeof(int *));
 
-    for (int y = 0; y < size_y; y++)
-        a->area[y] = g_malloc0(size_x * sizeof(int));
+    if (size_y > 0)
+        a->area[0] = g_malloc0(size_x * size_y * sizeof(int));
+
+    for (int y = 1; y < size_y; y++)
+        a->area[y] = a->area[0] + y * size_x;
 
     return a;
 }
@@ -363,33 +385,29 @@ gboolean area_blast(position center, guint radius,
             if (!area_pos_get(ball, cursor))
                 continue;
 
-            /* move the cursor to the position */
-            move(Y(cursor), X(cursor));
+            char ch = glyph;
 
             if (map_sobject_at(cmap, cursor))
             {
                 /* The blast hit a stationary object. */
-                addch(so_get_glyph(map_sobject_at(cmap, cursor)));
+                ch = so_get_glyph(map_sobject_at(cmap, cursor));
             }
             else if ((m = map_get_monster_at(cmap, cursor)))
             {
                 /* The blast hit a monster */
                 if (monster_in_sight(m))
-                    addch(monster_glyph(m));
-                else
-                    addch(glyph);
+                    ch = monster_glyph(m);
             }
             else if (pos_identical(nlarn->p->pos, cursor))
             {
                 /* The blast hit the player */
-                addch('@');
-            }
-            else
-            {
-                /* The blast hit nothing */
-                addch(glyph);
+                ch = '@';
             }
 
+            /* positions outside the part of the map shown are not drawn */
+            if (display_map_move(cursor))
+                addch(ch);
+
             /* keep track if the blast hit something */
             if (pos_hitfun(cursor, damo, data1, data2))
                 retval = TRUE;
@@ -403,7 +421,7 @@ gboolean area_blast(position center, guint radius,
     display_draw();
 
     /* sleep a 3/4 second */
-    napms(750);
+    display_sleep(750);
 
     return retval;
 }
@@ -412,8 +430,8 @@ void area_destroy(area *a)
 {
     g_assert(a != NULL);
 
-    for (int y = 0; y < a->size_y; y++)
-        g_free(a->area[y]);
+    if (a->size_y > 0)
+        g_free(a->area[0]);
 
     g_free(a->area);
 
@@ -448,8 +466,41 @@ area *area_flood(area *obstacles, int start_x, int start_y)
     area *flood = area_new(obstacles->start_x, obstacles->start_y,
                            obstacles->size_x, obstacles->size_y);
 
-    area_flood_worker(flood, obstacles, start_x, start_y);
+    /* The points still to be examined. The area may be as large as a
+       level, thus the flood is not filled recursively. */
+    GArray *todo = g_array_new(FALSE, FALSE, sizeof(position));
+    position pt = pos_invalid;
+
+    X(pt) = start_x;
+    Y(pt) = start_y;
+    g_array_append_val(todo, pt);
+
+    while (todo->len > 0)
+    {
+        pt = g_array_index(todo, position, todo->len - 1);
+        g_array_set_size(todo, todo->len - 1);
+
+        int x = X(pt), y = Y(pt);
+
+        /* stepped out of area, can't flood this or been here before */
+        if (!area_point_valid(flood, x, y)
+                || area_point_get(obstacles, x, y)
+                || area_point_get(flood, x, y))
+            continue;
+
+        area_point_set(flood, x, y);
+
+        const int next[4][2] = { { 1, 0 }, { -1, 0 }, { 0, 1 }, { 0, -1 } };
+
+        for (int idx = 0; idx < 4; idx++)
+        {
+            X(pt) = x + next[idx][0];
+            Y(pt) = y + next[idx][1];
+            g_array_append_val(todo, pt);
+        }
+    }
 
+    g_array_free(todo, TRUE);
     area_destroy(obstacles);
 
     return flood;
@@ -489,25 +540,3 @@ int area_pos_get(area *a, position pos)
 
     return area_point_get(a, x, y);
 }
-
-static void area_flood_worker(area *flood, area *obstacles, int x, int y)
-{
-    /* stepped out of area */
-    if (!area_point_valid(flood, x, y))
-        return;
-
-    /* can't flood this */
-    if (area_point_get(obstacles, x, y))
-        return;
-
-    /* been here before */
-    if (area_point_get(flood, x, y))
-        return;
-
-    area_point_set(flood, x, y);
-
-    area_flood_worker(flood, obstacles, x + 1, y);
-    area_flood_worker(flood, obstacles, x - 1, y);
-    area_flood_worker(flood, obstacles, x, y + 1);
-    area_flood_worker(flood, obstacles, x, y - 1);
-}
@@ -360,9 +360,9 @@ static int potion_amnesia(player *p, item *potion __attribute__((unused)))
     /* set position's level to player's position */
     Z(pos) = Z(p->pos);
 
-    for (Y(pos) = 0; Y(pos) < MAP_MAX_Y; Y(pos)++)
+    for (Y(pos) = 0; Y(pos) < p->memory_height; Y(pos)++)
     {
-        for (X(pos) = 0; X(pos) < MAP_MAX_X; X(pos)++)
+        for (X(pos) = 0; X(pos) < p->memory_width; X(pos)++)
         {
             player_memory_of(p, pos).type = LT_NONE;
             player_memory_of(p, pos).sobject = LS_NONE;
@@ -387,9 +387,9 @@ static int potion_detect_item(player *p, item *potion)
     Z(pos) = Z(p->pos);
     map *pmap = game_map(nlarn, Z(pos));
 
-    for (Y(pos) = 0; Y(pos) < MAP_MAX_Y; Y(pos)++)
+    for (Y(pos) = 0; Y(pos) < pmap->height; Y(pos)++)
     {
-        for (X(pos) = 0; X(pos) < MAP_MAX_X; X(pos)++)
+        for (X(pos) = 0; X(pos) < pmap->width; X(pos)++)
         {
             gboolean found_item = FALSE;
             if ((inv = *map_ilist_at(pmap, pos)))
@@ -55,9 +55,7 @@ static inline uint32_t rotl(const uint32_t x, int k) {
 }
 
 
-static uint32_t s[4];
-
-uint32_t next(void) {
+static inline uint32_t next(uint32_t s[4]) {
 	const uint32_t result_starstar = rotl(s[0] * 5, 7) * 9;
 
 	const uint32_t t = s[1] << 9;
@@ -74,40 +72,189 @@ uint32_t next(void) {
 	return result_starstar;
 }
 
+
+/* This is the jump function for the generator. It is equivalent
+   to 2^64 calls to next(); it can be used to generate 2^64
+   non-overlapping subsequences for parallel computations. */
+
+static void jump(uint32_t s[4], const uint32_t JUMP[4]) {
+	uint32_t s0 = 0;
+	uint32_t s1 = 0;
+	uint32_t s2 = 0;
+	uint32_t s3 = 0;
+	for(int i = 0; i < 4; i++)
+		for(int b = 0; b < 32; b++) {
+			if (JUMP[i] & UINT32_C(1) << b) {
+				s0 ^= s[0];
+				s1 ^= s[1];
+				s2 ^= s[2];
+				s3 ^= s[3];
+			}
+			next(s);
+		}
+
+	s[0] = s0;
+	s[1] = s1;
+	s[2] = s2;
+	s[3] = s3;
+}
+
+static const uint32_t JUMP[] = { 0x8764000b, 0xf542d2d3, 0x6fa035c3, 0x77f2db5b };
+
+/* The long-jump polynomial is equivalent to 2^96 calls to next(); it can
+   be used to generate 2^32 starting points, from each of which jump()
+   will generate 2^32 non-overlapping subsequences for parallel
+   distributed computations. */
+
+static const uint32_t LONG_JUMP[] = { 0xb523952e, 0x0b6f099f, 0xccf5a0ef, 0x1c580662 };
+
 /* end xoshiro128starstar.c excerpt */
 
-static gboolean seeded = FALSE;
+/* the streams used by threads which have not selected a game's */
+static rand_state shared = { 0 };
+
+/* the streams and the context used by rand_0n() et al., set per thread */
+#ifdef _MSC_VER
+static __declspec(thread) rand_state *state = NULL;
+static __declspec(thread) rand_ctx *current = NULL;
+#else
+static __thread rand_state *state = NULL;
+static __thread rand_ctx *current = NULL;
+#endif
 
-/* initialize RNG */
-static void rand_seed()
+static inline rand_state *rand_state_current()
 {
-    g_assert(seeded == FALSE);
+    return (state != NULL) ? state : &shared;
+}
 
-    /* On Windows, use rand_s to seed out RNG; otherwise use random() */
-#ifndef G_OS_WIN32
-    srandom(g_get_monotonic_time());
-#endif
+/* splitmix64, used to expand a seed into a generator state */
+static guint64 splitmix64(guint64 *x)
+{
+    guint64 z = (*x += 0x9e3779b97f4a7c15ULL);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
 
-    for (int i = 0; i < 4; i++)
-    {
+guint32 rand_seed_new()
+{
+    guint32 nseed;
+
+    /* On Windows, use rand_s to seed out RNG; otherwise use random() */
 #ifdef G_OS_WIN32
-        rand_s(&s[i]);
+    rand_s(&nseed);
 #else
-        s[i] = random();
+    srandom(g_get_monotonic_time() ^ g_get_real_time());
+    nseed = random();
 #endif
+
+    /* zero is reserved for "no seed given" */
+    return nseed ? nseed : 1;
+}
+
+rand_state *rand_state_use(rand_state *nstate)
+{
+    rand_state *prev = state;
+
+    state = nstate;
+    current = NULL;
+
+    return prev;
+}
+
+void rand_init(guint32 nseed)
+{
+    rand_state *rs = rand_state_current();
+
+    rs->seed = nseed;
+
+    /* stream n starts n jumps behind the seeded state */
+    rand_ctx_seed(&rs->streams[0], nseed);
+    for (int st = 1; st < RS_MAX; st++)
+    {
+        rs->streams[st] = rs->streams[st - 1];
+        rand_ctx_jump(&rs->streams[st]);
+    }
+
+    current = &rs->streams[RS_MAIN];
+    rs->seeded = TRUE;
+}
+
+guint32 rand_seed()
+{
+    return rand_state_current()->seed;
+}
+
+rand_ctx *rand_stream(rand_stream_t st)
+{
+    rand_state *rs = rand_state_current();
+
+    g_assert(st < RS_MAX);
+
+    if (!rs->seeded)
+    {
+        rand_init(rand_seed_new());
+    }
+
+    return &rs->streams[st];
+}
+
+rand_ctx *rand_use(rand_ctx *ctx)
+{
+    rand_ctx *prev = current;
+    current = ctx;
+
+    return prev;
+}
+
+void rand_ctx_seed(rand_ctx *ctx, guint32 nseed)
+{
+    guint64 x = nseed;
+
+    g_assert(ctx != NULL);
+
+    for (int i = 0; i < 4; i += 2)
+    {
+        guint64 v = splitmix64(&x);
+        ctx->s[i] = (guint32)v;
+        ctx->s[i + 1] = (guint32)(v >> 32);
     }
+}
 
-    seeded = TRUE;
+void rand_ctx_jump(rand_ctx *ctx)
+{
+    jump(ctx->s, JUMP);
 }
 
-cJSON* rand_serialize()
+void rand_ctx_long_jump(rand_ctx *ctx)
 {
-    g_assert(seeded == TRUE);
+    jump(ctx->s, LONG_JUMP);
+}
+
+void rand_ctx_split(rand_ctx *ctx, rand_ctx *child)
+{
+    g_assert(ctx != NULL && child != NULL);
 
-    return cJSON_CreateIntArray((int*)&s, 4);
+    *child = *ctx;
+    rand_ctx_jump(ctx);
 }
 
-void rand_deserialize(cJSON *r)
+void rand_ctx_level(rand_ctx *ctx, guint32 nseed, guint nlevel)
+{
+    g_assert(ctx != NULL);
+
+    /* level n starts n + 1 long jumps behind the seeded state */
+    rand_ctx_seed(ctx, nseed);
+    for (guint n = 0; n <= nlevel; n++)
+        rand_ctx_long_jump(ctx);
+}
+
+static cJSON *rand_ctx_serialize(rand_ctx *ctx)
+{
+    return cJSON_CreateIntArray((int*)ctx->s, 4);
+}
+
+static void rand_ctx_deserialize(rand_ctx *ctx, cJSON *r)
 {
     g_assert(r != NULL);
     g_assert(cJSON_GetArraySize(r) == 4);
@@ -116,19 +263,46 @@ void rand_deserialize(cJSON *r)
     {
         cJSON* it = cJSON_GetArrayItem(r, i);
         g_assert(cJSON_IsNumber(it));
-        s[i] = (guint64)it->valuedouble;
+        ctx->s[i] = (guint32)(gint32)it->valueint;
     }
+}
 
-    seeded = TRUE;
+cJSON* rand_serialize(rand_state *rs)
+{
+    g_assert(rs != NULL && rs->seeded == TRUE);
+
+    cJSON *r = cJSON_CreateObject();
+    cJSON_AddNumberToObject(r, "seed", rs->seed);
+
+    cJSON *obj = cJSON_CreateArray();
+    cJSON_AddItemToObject(r, "streams", obj);
+
+    for (int st = 0; st < RS_MAX; st++)
+        cJSON_AddItemToArray(obj, rand_ctx_serialize(&rs->streams[st]));
+
+    return r;
 }
 
-guint32 rand_0n(guint32 n)
+void rand_deserialize(rand_state *rs, cJSON *r)
 {
-    if (!seeded)
-    {
-        rand_seed();
-    }
+    g_assert(rs != NULL && r != NULL);
+
+    rs->seed = (guint32)cJSON_GetObjectItem(r, "seed")->valuedouble;
+
+    cJSON *obj = cJSON_GetObjectItem(r, "streams");
+    g_assert(cJSON_GetArraySize(obj) == RS_MAX);
+
+    for (int st = 0; st < RS_MAX; st++)
+        rand_ctx_deserialize(&rs->streams[st], cJSON_GetArrayItem(obj, st));
 
+    if (rs == rand_state_current())
+        current = &rs->streams[RS_MAIN];
+
+    rs->seeded = TRUE;
+}
+
+guint32 rand_ctx_0n(rand_ctx *ctx, guint32 n)
+{
     guint32 min = -n % n;
     guint32 result;
 
@@ -139,16 +313,26 @@ guint32 rand_0n(guint32 n)
             return 0;
             break;
         case UINT32_MAX:
-            return next();
+            return next(ctx->s);
             break;
         default:
-            while ((result = next()) < min);
+            while ((result = next(ctx->s)) < min);
 
             return result % n;
             break;
     }
 }
 
+guint32 rand_0n(guint32 n)
+{
+    if (current == NULL)
+    {
+        current = rand_stream(RS_MAIN);
+    }
+
+    return rand_ctx_0n(current, n);
+}
+
 int divert(int value, int percent)
 {
     int lower, upper;
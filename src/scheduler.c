@@ -0,0 +1,283 @@
+/*
+ * scheduler.c
+ * Copyright (C) 2009-2020 Joachim de Groot <jdegroot@web.de>
+ *
+ * NLarn is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * NLarn is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <glib.h>
+
+#include "scheduler.h"
+
+typedef struct actor_slot
+{
+    guint32 due;    /* game turn the actor acts next */
+    guint32 seq;    /* order of queueing among actors due at the same turn */
+    gpointer id;
+} actor_slot;
+
+/* a binary min-heap; the index allows to find queued actors again */
+struct scheduler
+{
+    GArray *heap;       /* actor_slot */
+    GHashTable *index;  /* actor id -> position in the heap + 1 */
+    guint32 seq;
+};
+
+#define slot_at(S, I) g_array_index((S)->heap, actor_slot, (I))
+
+static inline gboolean slot_before(actor_slot *a, actor_slot *b)
+{
+    if (a->due != b->due)
+        return a->due < b->due;
+
+    return (gint32)(a->seq - b->seq) < 0;
+}
+
+static void scheduler_place(scheduler *s, guint pos, actor_slot *as)
+{
+    slot_at(s, pos) = *as;
+    g_hash_table_insert(s->index, as->id, GUINT_TO_POINTER(pos + 1));
+}
+
+static void scheduler_sift_up(scheduler *s, guint pos)
+{
+    actor_slot as = slot_at(s, pos);
+
+    while (pos > 0)
+    {
+        guint parent = (pos - 1) / 2;
+
+        if (!slot_before(&as, &slot_at(s, parent)))
+            break;
+
+        scheduler_place(s, pos, &slot_at(s, parent));
+        pos = parent;
+    }
+
+    scheduler_place(s, pos, &as);
+}
+
+static void scheduler_sift_down(scheduler *s, guint pos)
+{
+    actor_slot as = slot_at(s, pos);
+    const guint len = s->heap->len;
+
+    while (2 * pos + 1 < len)
+    {
+        guint child = 2 * pos + 1;
+
+        if (child + 1 < len && slot_before(&slot_at(s, child + 1), &slot_at(s, child)))
+            child++;
+
+        if (!slot_before(&slot_at(s, child), &as))
+            break;
+
+        scheduler_place(s, pos, &slot_at(s, child));
+        pos = child;
+    }
+
+    scheduler_place(s, pos, &as);
+}
+
+/* remove the slot at the given position from the heap */
+static void scheduler_take(scheduler *s, guint pos)
+{
+    const guint last = s->heap->len - 1;
+
+    g_hash_table_remove(s->index, slot_at(s, pos).id);
+
+    if (pos != last)
+    {
+        actor_slot moved = slot_at(s, last);
+        g_array_set_size(s->heap, last);
+        scheduler_place(s, pos, &moved);
+
+        if (pos > 0 && slot_before(&moved, &slot_at(s, (pos - 1) / 2)))
+            scheduler_sift_up(s, pos);
+        else
+            scheduler_sift_down(s, pos);
+    }
+    else
+    {
+        g_array_set_size(s->heap, last);
+    }
+}
+
+scheduler *scheduler_new()
+{
+    scheduler *s = g_malloc0(sizeof(scheduler));
+
+    s->heap = g_array_new(FALSE, FALSE, sizeof(actor_slot));
+    s->index = g_hash_table_new(g_direct_hash, g_direct_equal);
+
+    return s;
+}
+
+void scheduler_destroy(scheduler *s)
+{
+    g_assert(s != NULL);
+
+    g_array_free(s->heap, TRUE);
+    g_hash_table_destroy(s->index);
+    g_free(s);
+}
+
+void scheduler_add(scheduler *s, gpointer id, guint32 due)
+{
+    g_assert(s != NULL && id != NULL);
+
+    actor_slot as = { due, s->seq++, id };
+    guint pos = GPOINTER_TO_UINT(g_hash_table_lookup(s->index, id));
+
+    if (pos > 0)
+    {
+        /* the actor is queued already */
+        pos--;
+        gboolean earlier = slot_before(&as, &slot_at(s, pos));
+
+        slot_at(s, pos) = as;
+
+        if (earlier)
+            scheduler_sift_up(s, pos);
+        else
+            scheduler_sift_down(s, pos);
+    }
+    else
+    {
+        g_array_append_val(s->heap, as);
+        scheduler_sift_up(s, s->heap->len - 1);
+    }
+}
+
+void scheduler_remove(scheduler *s, gpointer id)
+{
+    g_assert(s != NULL);
+
+    guint pos = GPOINTER_TO_UINT(g_hash_table_lookup(s->index, id));
+
+    if (pos > 0)
+        scheduler_take(s, pos - 1);
+}
+
+gpointer scheduler_pop(scheduler *s, guint32 now)
+{
+    g_assert(s != NULL);
+
+    if (s->heap->len == 0 || slot_at(s, 0).due > now)
+        return NULL;
+
+    gpointer id = slot_at(s, 0).id;
+    scheduler_take(s, 0);
+
+    return id;
+}
+
+GPtrArray *scheduler_due(scheduler *s, guint32 now)
+{
+    g_assert(s != NULL);
+
+    GPtrArray *due = g_ptr_array_new();
+    GArray *stack = g_array_new(FALSE, FALSE, sizeof(guint));
+    guint pos = 0;
+
+    /* the children of an actor which is not due are not due either */
+    if (s->heap->len > 0)
+        g_array_append_val(stack, pos);
+
+    while (stack->len > 0)
+    {
+        pos = g_array_index(stack, guint, stack->len - 1);
+        g_array_remove_index_fast(stack, stack->len - 1);
+
+        if (slot_at(s, pos).due > now)
+            continue;
+
+        g_ptr_array_add(due, slot_at(s, pos).id);
+
+        for (guint child = 2 * pos + 1; child <= 2 * pos + 2; child++)
+        {
+            if (child < s->heap->len)
+                g_array_append_val(stack, child);
+        }
+    }
+
+    g_array_free(stack, TRUE);
+
+    return due;
+}
+
+guint32 scheduler_idle(scheduler *s, guint32 now, guint32 limit)
+{
+    g_assert(s != NULL);
+
+    if (s->heap->len == 0)
+        return limit;
+
+    if (slot_at(s, 0).due <= now)
+        return 0;
+
+    return MIN(slot_at(s, 0).due - now, limit);
+}
+
+static gint slot_compare(gconstpointer a, gconstpointer b)
+{
+    return slot_before((actor_slot *)a, (actor_slot *)b) ? -1 : 1;
+}
+
+cJSON *scheduler_serialize(scheduler *s)
+{
+    cJSON *sser = cJSON_CreateArray();
+
+    g_assert(s != NULL);
+
+    /* store the actors in the order they are due */
+    GArray *slots = g_array_sized_new(FALSE, FALSE, sizeof(actor_slot),
+                                      s->heap->len);
+    g_array_append_vals(slots, s->heap->data, s->heap->len);
+    g_array_sort(slots, slot_compare);
+
+    for (guint idx = 0; idx < slots->len; idx++)
+    {
+        actor_slot *as = &g_array_index(slots, actor_slot, idx);
+        int val[2] = { as->due, GPOINTER_TO_UINT(as->id) };
+
+        cJSON_AddItemToArray(sser, cJSON_CreateIntArray(val, 2));
+    }
+
+    g_array_free(slots, TRUE);
+
+    return sser;
+}
+
+scheduler *scheduler_deserialize(cJSON *sser)
+{
+    scheduler *s = scheduler_new();
+
+    for (int idx = 0; idx < cJSON_GetArraySize(sser); idx++)
+    {
+        cJSON *as = cJSON_GetArrayItem(sser, idx);
+
+        scheduler_add(s, GUINT_TO_POINTER(cJSON_GetArrayItem(as, 1)->valueint),
+                      cJSON_GetArrayItem(as, 0)->valueint);
+    }
+
+    return s;
+}
+
+guint scheduler_length(scheduler *s)
+{
+    g_assert(s != NULL);
+    return s->heap->len;
+}
@@ -16,80 +16,365 @@
  * with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#ifdef __linux__
+# ifndef _GNU_SOURCE
+#  define _GNU_SOURCE
+# endif
+#endif
+
+#include <errno.h>
+#include <fcntl.h>
+#include <glib/gstdio.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <zlib.h>
 
 #if (defined __unix) || (defined __unix__) || (defined __APPLE__)
 # include <sys/file.h>
+# include <unistd.h>
+#endif
+
+#ifdef WIN32
+# include <io.h>
 #endif
 
 #include "nlarn.h"
 #include "scoreboard.h"
 #include "cJSON.h"
+#include "codec.h"
 
 #if ((defined (__unix) || defined (__unix__)) && defined (SETGID))
 /* file descriptor for the scoreboard file when running setgid */
 int scoreboard_fd = -1;
 #endif
 
+#ifndef O_BINARY
+# define O_BINARY 0
+#endif
+
+#ifdef WIN32
+# define LOCK_SH 1
+# define LOCK_EX 2
+# define LOCK_UN 8
+# define ftruncate _chsize
+#endif
+
+/*
+ * The scoreboard file starts with a header and the index of the best
+ * scores for each difficulty, followed by all scores in the order they
+ * have been added. Scores do not change once they have been written:
+ * a new score is appended and inserted into the index of its difficulty.
+ * Thus adding a score and showing the best scores do not depend on the
+ * number of scores on the scoreboard.
+ *
+ * Earlier versions stored all scores as compressed JSON text, which is
+ * converted when the next score is added.
+ */
+
 /* scoreboard version */
-static const gint sb_ver = 1;
+static const gint sb_ver = 2;
+static const char sb_magic[4] = { 'N', 'L', 'H', 'S' };
+
+#define SB_DIFFICULTIES 16  /* the last one indexes all higher difficulties */
+#define SB_TOP          100 /* number of scores indexed per difficulty */
+#define SB_HEADER       16  /* magic, version, number of scores, unused */
+#define SB_ENTRY        12  /* index entry: score, number of the score + 1 */
+#define SB_INDEX        (SB_DIFFICULTIES * SB_TOP * SB_ENTRY)
+#define SB_RECORD       128 /* a score */
+#define SB_NAME         64  /* room for the player's name in a score */
+
+/* an entry of the index; unused entries have record 0 */
+typedef struct sb_entry
+{
+    guint64 score;
+    guint32 record;
+} sb_entry;
 
-GList *scores_load()
+static void sb_put32(guchar *p, guint32 val)
 {
-    /* linked list of all scores */
-    GList *gs = NULL;
+    for (int idx = 0; idx < 4; idx++)
+        p[idx] = val >> (8 * idx);
+}
 
-    /* read the scoreboard file into memory */
-#if ((defined (__unix) || defined (__unix__)) && defined (SETGID))
-    /* we'll need the file desciptor for saving, too, so duplicate it */
-    int fd = dup(scoreboard_fd);
-
-    /*
-     * Lock the scoreboard file while updating the scoreboard.
-     * Wait until another process that holds the lock releases it again.
-     */
-    if (flock(fd, LOCK_EX) == -1)
+static void sb_put64(guchar *p, guint64 val)
+{
+    sb_put32(p, val & 0xffffffffU);
+    sb_put32(p + 4, val >> 32);
+}
+
+static guint32 sb_get32(const guchar *p)
+{
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((guint32)p[3] << 24);
+}
+
+static guint64 sb_get64(const guchar *p)
+{
+    return sb_get32(p) | ((guint64)sb_get32(p + 4) << 32);
+}
+
+/* The descriptor opened before the privileges have been dropped is shared
+ * by all games a zygote has started, as is its file offset. Hence the file
+ * is read and written at explicit offsets and locked with record locks,
+ * which belong to the process rather than to the shared descriptor. */
+
+static gboolean sb_read(int fd, off_t offset, void *buf, size_t len)
+{
+#ifdef WIN32
+    if (lseek(fd, offset, SEEK_SET) != offset)
+        return FALSE;
+
+    return (read(fd, buf, len) == (ssize_t)len);
+#else
+    return (pread(fd, buf, len, offset) == (ssize_t)len);
+#endif
+}
+
+static gboolean sb_write(int fd, off_t offset, const void *buf, size_t len)
+{
+#ifdef WIN32
+    if (lseek(fd, offset, SEEK_SET) != offset)
+        return FALSE;
+
+    return (write(fd, buf, len) == (ssize_t)len);
+#else
+    return (pwrite(fd, buf, len, offset) == (ssize_t)len);
+#endif
+}
+
+static void sb_lock(int fd, int operation)
+{
+#if (defined __unix) || (defined __unix__) || (defined __APPLE__)
+    struct flock lock = { 0 };
+
+    /* the whole file */
+    lock.l_whence = SEEK_SET;
+
+    switch (operation)
     {
-        perror("Could not lock the scoreboard file");
+    case LOCK_SH:
+        lock.l_type = F_RDLCK;
+        break;
+
+    case LOCK_EX:
+        lock.l_type = F_WRLCK;
+        break;
+
+    default:
+        lock.l_type = F_UNLCK;
+        break;
     }
 
-    gzFile file = gzdopen(fd, "rb");
+    /* wait until another process that holds the lock releases it again */
+    while (fcntl(fd, F_SETLKW, &lock) == -1)
+    {
+        if (errno != EINTR)
+        {
+            perror("Could not lock the scoreboard file");
+            break;
+        }
+    }
 #else
-    gzFile file = gzopen(nlarn_highscores, "rb");
+    (void)fd;
+    (void)operation;
 #endif
+}
 
-    if (file == NULL)
+static int sb_open(gboolean write)
+{
+#if ((defined (__unix) || defined (__unix__)) && defined (SETGID))
+    /* the file has been opened before the privileges have been dropped */
+    (void)write;
+    return dup(scoreboard_fd);
+#else
+    return g_open(nlarn_highscores, write ? (O_RDWR | O_CREAT | O_BINARY)
+                                          : (O_RDONLY | O_BINARY), 0644);
+#endif
+}
+
+static void sb_close(int fd)
+{
+    /* closing any descriptor of the file would release the lock anyway */
+    sb_lock(fd, LOCK_UN);
+    close(fd);
+}
+
+/* the number of scores, or -1 if the file does not have this format */
+static gint64 sb_count(int fd)
+{
+    guchar header[SB_HEADER];
+
+    if (!sb_read(fd, 0, header, SB_HEADER)
+            || memcmp(header, sb_magic, sizeof(sb_magic)) != 0
+            || (gint)sb_get32(header + 4) != sb_ver)
     {
-        return gs;
+        return -1;
     }
 
-    /* size of buffer to store uncompressed scoreboard content */
-    const gint bufsize = 8192;
+    return sb_get32(header + 8);
+}
+
+static guint sb_slot(gint32 difficulty)
+{
+    return CLAMP(difficulty, 0, SB_DIFFICULTIES - 1);
+}
 
-    /* allocate buffer space */
-    gchar *scores = g_malloc(bufsize);
+static gboolean sb_index_read(int fd, guint slot, sb_entry *top)
+{
+    guchar buf[SB_TOP * SB_ENTRY];
 
-    /* count of buffer allocations */
-    gint bufcount = 1;
+    if (!sb_read(fd, SB_HEADER + slot * sizeof(buf), buf, sizeof(buf)))
+        return FALSE;
 
-    /* read the scoreboard file
-     * append subsequent blocks at the end of the previously read block */
-    while(gzread(file, scores + ((bufcount - 1) * bufsize), bufsize) == bufsize)
+    for (guint idx = 0; idx < SB_TOP; idx++)
     {
-        /* it seems the buffer space was insufficient -> increase it */
-        bufcount += 1;
-        scores = g_realloc(scores, (bufsize * bufcount));
+        top[idx].score = sb_get64(buf + idx * SB_ENTRY);
+        top[idx].record = sb_get32(buf + idx * SB_ENTRY + 8);
     }
 
-#if ((defined (__unix) || defined (__unix__)) && defined (SETGID))
-    /* reposition to the start otherwise writing would append */
-    gzrewind(file);
+    return TRUE;
+}
+
+static gboolean sb_index_write(int fd, guint slot, const sb_entry *top)
+{
+    guchar buf[SB_TOP * SB_ENTRY];
+
+    for (guint idx = 0; idx < SB_TOP; idx++)
+    {
+        sb_put64(buf + idx * SB_ENTRY, top[idx].score);
+        sb_put32(buf + idx * SB_ENTRY + 8, top[idx].record);
+    }
+
+    return sb_write(fd, SB_HEADER + slot * sizeof(buf), buf, sizeof(buf));
+}
+
+/* insert a score behind all scores which are at least as high */
+static void sb_index_insert(sb_entry *top, guint64 score, guint32 record)
+{
+    guint lo = 0, hi = SB_TOP;
+
+    while (lo < hi)
+    {
+        const guint mid = (lo + hi) / 2;
+
+        if (top[mid].record != 0 && top[mid].score >= score)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    if (lo == SB_TOP)
+    {
+        /* not among the best */
+        return;
+    }
+
+    memmove(top + lo + 1, top + lo, (SB_TOP - lo - 1) * sizeof(sb_entry));
+    top[lo].score = score;
+    top[lo].record = record + 1;
+}
+
+static void sb_record_encode(const score_t *score, guchar *rec)
+{
+    memset(rec, 0, SB_RECORD);
+
+    sb_put64(rec, score->score);
+    sb_put64(rec + 8, score->time_start);
+    sb_put64(rec + 16, score->time_end);
+    sb_put32(rec + 24, score->moves);
+    sb_put32(rec + 28, score->cause);
+    sb_put32(rec + 32, score->hp);
+    sb_put32(rec + 36, score->hp_max);
+    sb_put32(rec + 40, score->level);
+    sb_put32(rec + 44, score->level_max);
+    sb_put32(rec + 48, score->dlevel);
+    sb_put32(rec + 52, score->dlevel_max);
+    sb_put32(rec + 56, score->difficulty);
+    rec[60] = score->sex;
+    rec[61] = score->cod;
+    /* 0 for the classic dungeon, as in scores written before */
+    rec[62] = (score->levels != MAP_MAX) ? score->levels : 0;
+
+    /* the name is cut off if it is too long, keeping the last byte 0 */
+    g_strlcpy((char *)rec + SB_RECORD - SB_NAME, score->player_name, SB_NAME);
+}
+
+static score_t *sb_record_decode(const guchar *rec)
+{
+    score_t *score = g_malloc0(sizeof(score_t));
+
+    score->score      = sb_get64(rec);
+    score->time_start = sb_get64(rec + 8);
+    score->time_end   = sb_get64(rec + 16);
+    score->moves      = sb_get32(rec + 24);
+    score->cause      = sb_get32(rec + 28);
+    score->hp         = sb_get32(rec + 32);
+    score->hp_max     = sb_get32(rec + 36);
+    score->level      = sb_get32(rec + 40);
+    score->level_max  = sb_get32(rec + 44);
+    score->dlevel     = sb_get32(rec + 48);
+    score->dlevel_max = sb_get32(rec + 52);
+    score->difficulty = sb_get32(rec + 56);
+    score->sex        = rec[60];
+    score->cod        = rec[61];
+    score->levels     = (rec[62] > 0) ? rec[62] : MAP_MAX;
+    score->player_name = g_strndup((const char *)rec + SB_RECORD - SB_NAME,
+                                   SB_NAME);
+
+    return score;
+}
+
+/* append a score; the caller holds the exclusive lock */
+static gboolean sb_append(int fd, guint32 count, score_t *score)
+{
+    guchar rec[SB_RECORD];
+    guchar num[4];
+    sb_entry top[SB_TOP];
+    const guint slot = sb_slot(score->difficulty);
+
+    sb_record_encode(score, rec);
+    sb_put32(num, count + 1);
+
+    /* the score is counted once written, and indexed once counted */
+    if (!sb_write(fd, SB_HEADER + SB_INDEX + (off_t)count * SB_RECORD, rec, SB_RECORD)
+            || !sb_write(fd, 8, num, sizeof(num))
+            || !sb_index_read(fd, slot, top))
+    {
+        return FALSE;
+    }
+
+    sb_index_insert(top, score->score, count);
+
+    return sb_index_write(fd, slot, top);
+}
+
+/* read the scores stored by earlier versions */
+static GList *scores_legacy_load(int fd)
+{
+    /* linked list of all scores */
+    GList *gs = NULL;
+
+    /* read the scoreboard file into memory */
+    GByteArray *raw = g_byte_array_new();
+    guint8 buf[8192];
+    ssize_t count;
+
+#ifdef WIN32
+    lseek(fd, 0, SEEK_SET);
+    while ((count = read(fd, buf, sizeof(buf))) > 0)
+        g_byte_array_append(raw, buf, count);
+#else
+    while ((count = pread(fd, buf, sizeof(buf), raw->len)) > 0)
+        g_byte_array_append(raw, buf, count);
 #endif
-    /* close save file */
-    gzclose(file);
+
+    /* uncompressed scoreboard content */
+    gchar *scores = codec_decompress(raw->data, raw->len, NULL);
+    g_byte_array_free(raw, TRUE);
+
+    if (scores == NULL)
+    {
+        return gs;
+    }
 
     /* parsed scoreboard; scoreboard entry */
     cJSON *pscores, *s_entry;
@@ -98,27 +383,20 @@ GList *scores_load()
     if ((pscores = cJSON_Parse(scores)) == NULL)
     {
         /* empty file, no entries */
+        g_free(scores);
         return gs;
     }
 
-    /* version of scoreboard file */
-    gint version = cJSON_GetObjectItem(pscores, "version")->valueint;
-
-    if (version < sb_ver)
-    {
-        /* TODO: when there are multiple versions, handle old versions here */
-    }
-
     /* point to the first entry of the scores array */
     s_entry = cJSON_GetObjectItem(pscores, "scores")->child;
 
     while (s_entry != NULL)
     {
         /* create new score record */
-        score_t *nscore = g_malloc(sizeof(score_t));
+        score_t *nscore = g_malloc0(sizeof(score_t));
 
         /* add record to array */
-        gs = g_list_append(gs, nscore);
+        gs = g_list_prepend(gs, nscore);
 
         /* fill score record fields with data */
         nscore->player_name = g_strdup(cJSON_GetObjectItem(s_entry, "player_name")->valuestring);
@@ -133,6 +411,7 @@ GList *scores_load()
         nscore->level_max  = cJSON_GetObjectItem(s_entry, "level_max")->valueint;
         nscore->dlevel     = cJSON_GetObjectItem(s_entry, "dlevel")->valueint;
         nscore->dlevel_max = cJSON_GetObjectItem(s_entry, "dlevel_max")->valueint;
+        nscore->levels     = MAP_MAX;
         nscore->difficulty = cJSON_GetObjectItem(s_entry, "difficulty")->valueint;
         nscore->time_start = cJSON_GetObjectItem(s_entry, "time_start")->valueint;
         nscore->time_end   = cJSON_GetObjectItem(s_entry, "time_end")->valueint;
@@ -143,101 +422,149 @@ GList *scores_load()
     /* free memory  */
     cJSON_Delete(pscores);
 
-    /* free the memory allocated for gzread */
+    /* free the memory allocated for the content */
     g_free(scores);
 
-    return gs;
+    /* the entries are sorted by score */
+    return g_list_reverse(gs);
 }
 
-static void scores_save(game *g, GList *gs)
+/* start a scoreboard file of this format, converting the scores of an
+   earlier version; the caller holds the exclusive lock. Returns the
+   number of scores converted, -1 on errors */
+static gint64 sb_create(int fd)
 {
-    /* serialize the scores */
-    cJSON *sf = cJSON_CreateObject();
-    cJSON_AddNumberToObject(sf, "version", sb_ver);
-    cJSON *scores = cJSON_CreateArray();
-    cJSON_AddItemToObject(sf, "scores", scores);
-
-    for (GList *iterator = gs; iterator; iterator = iterator->next)
+    GList *legacy = scores_legacy_load(fd);
+    const guint32 count = g_list_length(legacy);
+    guchar header[SB_HEADER] = { 0 };
+    guchar *records = g_malloc0((gsize)count * SB_RECORD + 1);
+    sb_entry top[SB_DIFFICULTIES][SB_TOP];
+    guint32 record = 0;
+
+    memcpy(header, sb_magic, sizeof(sb_magic));
+    sb_put32(header + 4, sb_ver);
+    sb_put32(header + 8, count);
+    memset(top, 0, sizeof(top));
+
+    for (GList *iter = legacy; iter != NULL; iter = iter->next, record++)
     {
-        score_t *score = iterator->data;
+        score_t *score = iter->data;
 
-        /* create new object to store a single scoreboard entry */
-        cJSON *sc = cJSON_CreateObject();
-        cJSON_AddItemToArray(scores, sc);
-
-        /* add all scoreboard entry values */
-        cJSON_AddStringToObject(sc, "player_name", score->player_name);
-        cJSON_AddNumberToObject(sc, "sex", score->sex);
-        cJSON_AddNumberToObject(sc, "score", score->score);
-        cJSON_AddNumberToObject(sc, "moves", score->moves);
-        cJSON_AddNumberToObject(sc, "cod", score->cod);
-        cJSON_AddNumberToObject(sc, "cause", score->cause);
-        cJSON_AddNumberToObject(sc, "hp", score->hp);
-        cJSON_AddNumberToObject(sc, "hp_max", score->hp_max);
-        cJSON_AddNumberToObject(sc, "level", score->level);
-        cJSON_AddNumberToObject(sc, "level_max", score->level_max);
-        cJSON_AddNumberToObject(sc, "dlevel", score->dlevel);
-        cJSON_AddNumberToObject(sc, "dlevel_max", score->dlevel_max);
-        cJSON_AddNumberToObject(sc, "difficulty", score->difficulty);
-        cJSON_AddNumberToObject(sc, "time_start", score->time_start);
-        cJSON_AddNumberToObject(sc, "time_end", score->time_end);
+        sb_record_encode(score, records + (gsize)record * SB_RECORD);
+        sb_index_insert(top[sb_slot(score->difficulty)], score->score, record);
     }
 
-    /* export the cJSON structure to a string */
-    char *uscores = cJSON_PrintUnformatted(sf);
-    cJSON_Delete(sf);
+    gboolean ok = ftruncate(fd, 0) == 0
+                  && sb_write(fd, 0, header, SB_HEADER)
+                  && sb_write(fd, SB_HEADER + SB_INDEX, records,
+                              (gsize)count * SB_RECORD);
 
-    /* open the file for writing */
-#if ((defined (__unix) || defined (__unix__)) && defined (SETGID))
-    gzFile sb = gzdopen(scoreboard_fd, "wb");
-#else
-    gzFile sb = gzopen(nlarn_highscores, "wb");
-#endif
+    for (guint slot = 0; ok && slot < SB_DIFFICULTIES; slot++)
+        ok = sb_index_write(fd, slot, top[slot]);
+
+    g_free(records);
+    scores_destroy(legacy);
 
-    if (sb == NULL)
+    return ok ? (gint64)count : -1;
+}
+
+static int sb_entry_compare(const void *a, const void *b)
+{
+    const sb_entry *ea = a, *eb = b;
+
+    if (ea->score != eb->score)
+        return (ea->score > eb->score) ? -1 : 1;
+
+    /* the earlier score ranks first */
+    return (ea->record > eb->record) - (ea->record < eb->record);
+}
+
+/* the best scores of all difficulties; the score with the given number
+   is replaced by the score supplied */
+static GList *sb_best(int fd, guint32 record, score_t *score)
+{
+    sb_entry best[SB_DIFFICULTIES * SB_TOP];
+    guint count = 0;
+
+    /* the indexed scores of each difficulty are followed by unused entries */
+    for (guint slot = 0; slot < SB_DIFFICULTIES; slot++)
     {
-        /* opening the file failed */
-        log_add_entry(g->log, "Error opening scoreboard file.");
-        free(uscores);
-        return;
+        if (!sb_index_read(fd, slot, best + count))
+            return NULL;
+
+        for (guint idx = 0; idx < SB_TOP && best[count].record != 0; idx++)
+            count++;
     }
 
-    /* write to file */
-    if (gzputs(sb, uscores) != (int)strlen(uscores))
+    qsort(best, count, sizeof(sb_entry), sb_entry_compare);
+
+    GList *gs = NULL;
+
+    for (guint idx = 0; idx < MIN(count, SB_TOP); idx++)
     {
-        /* handle error */
-        int err;
+        guchar rec[SB_RECORD];
+        score_t *entry;
 
-        log_add_entry(g->log, "Error writing scoreboard file: %s",
-                      gzerror(sb, &err));
+        if (best[idx].record == record + 1 && score != NULL)
+        {
+            entry = score;
+        }
+        else if (sb_read(fd, SB_HEADER + SB_INDEX
+                         + (off_t)(best[idx].record - 1) * SB_RECORD,
+                         rec, SB_RECORD))
+        {
+            entry = sb_record_decode(rec);
+        }
+        else
+        {
+            continue;
+        }
 
-        free(uscores);
-        return;
+        entry->rank = idx + 1;
+        gs = g_list_prepend(gs, entry);
     }
 
-    /*
-     * Close file.
-     * As this was the last reference to that file, this action
-     * unlocks the scoreboard file again.
-     */
-    gzclose(sb);
-
-    /* return memory */
-    g_free(uscores);
+    return g_list_reverse(gs);
 }
 
-static int score_compare(const void *scr_a, const void *scr_b)
+GList *scores_load()
 {
-    score_t *a = (score_t *)scr_a;
-    score_t *b = (score_t *)scr_b;
+    /* linked list of the best scores */
+    GList *gs = NULL;
+    int fd = sb_open(FALSE);
 
-    if (a->score > b->score)
-        return -1;
+    if (fd == -1)
+    {
+        return gs;
+    }
+
+    sb_lock(fd, LOCK_SH);
+
+    if (sb_count(fd) >= 0)
+    {
+        gs = sb_best(fd, G_MAXUINT32, NULL);
+    }
+    else
+    {
+        /* not converted yet */
+        gs = scores_legacy_load(fd);
+
+        GList *rest = g_list_nth(gs, SB_TOP);
+        if (rest != NULL)
+        {
+            rest->prev->next = NULL;
+            rest->prev = NULL;
+            scores_destroy(rest);
+        }
+
+        guint rank = 0;
+        for (GList *iter = gs; iter != NULL; iter = iter->next)
+            ((score_t *)iter->data)->rank = ++rank;
+    }
 
-    if (b->score > a->score)
-        return 1;
+    sb_close(fd);
 
-    return 0;
+    return gs;
 }
 
 score_t *score_new(game *g, player_cod cod, int cause)
@@ -256,6 +583,7 @@ score_t *score_new(game *g, player_cod cod, int cause)
     score->level_max = g->p->stats.max_level;
     score->dlevel = Z(g->p->pos);
     score->dlevel_max = g->p->stats.deepest_level;
+    score->levels = g->levels;
     score->difficulty = game_difficulty(g);
     score->time_start = g->time_start;
     score->time_end = time(0);
@@ -267,16 +595,38 @@ GList *score_add(game *g, score_t *score)
 {
     g_assert (g != NULL && score != NULL);
 
-    GList *gs = scores_load();
+    GList *gs = NULL;
+    int fd = sb_open(TRUE);
 
-    /* add new score */
-    gs = g_list_append(gs, score);
+    if (fd == -1)
+    {
+        /* opening the file failed */
+        log_add_entry(g->log, "Error opening scoreboard file.");
+        return g_list_append(gs, score);
+    }
 
-    /* sort scoreboard entries */
-    gs = g_list_sort(gs, (GCompareFunc)score_compare);
+    sb_lock(fd, LOCK_EX);
 
-    /* save new scoreboard */
-    scores_save(g, gs);
+    gint64 count = sb_count(fd);
+
+    if (count < 0)
+        count = sb_create(fd);
+
+    if (count >= 0 && sb_append(fd, count, score))
+    {
+        gs = sb_best(fd, count, score);
+    }
+    else
+    {
+        log_add_entry(g->log, "Error writing scoreboard file: %s",
+                      strerror(errno));
+    }
+
+    sb_close(fd);
+
+    /* a score which is not among the best is shown after them */
+    if (score->rank == 0)
+        gs = g_list_append(gs, score);
 
     return gs;
 }
@@ -343,11 +693,12 @@ char *score_death_description(score_t *score, int verbose)
 
     if (verbose)
     {
-        g_string_append_printf(text, " on level %s", map_names[score->dlevel]);
+        g_string_append_printf(text, " on level %s", map_level_name(score->dlevel, score->levels));
 
         if (score->dlevel_max > score->dlevel)
         {
-            g_string_append_printf(text, " (max. %s)", map_names[score->dlevel_max]);
+            g_string_append_printf(text, " (max. %s)",
+                                   map_level_name(score->dlevel_max, score->levels));
         }
 
         if (score->cod < PD_TOO_LATE)
@@ -476,12 +827,24 @@ char *scores_to_string(GList *scores, score_t *score)
         score_t *cscore = (score_t *)iterator->data;
 
         desc = score_death_description(cscore, FALSE);
-        g_string_append_printf(text, "  %c%2d) %7" G_GINT64_FORMAT " %s\n",
-                               (cscore == score) ? '*' : ' ',
-                               nrec + 1, cscore->score, desc);
+
+        if (cscore->rank > 0)
+        {
+            g_string_append_printf(text, "  %c%2u) %7" G_GINT64_FORMAT " %s\n",
+                                   (cscore == score) ? '*' : ' ',
+                                   cscore->rank, cscore->score, desc);
+        }
+        else
+        {
+            /* not among the best scores */
+            g_string_append_printf(text, "  %c--) %7" G_GINT64_FORMAT " %s\n",
+                                   (cscore == score) ? '*' : ' ',
+                                   cscore->score, desc);
+        }
 
         g_string_append_printf(text, "               [exp. level %d, caverns lvl. %s, %d/%d hp, difficulty %d]\n",
-                               cscore->level, map_names[cscore->dlevel],
+                               cscore->level,
+                               map_level_name(cscore->dlevel, cscore->levels),
                                cscore->hp, cscore->hp_max, cscore->difficulty);
         g_free(desc);
     }
@@ -354,9 +354,9 @@ static int scroll_create_artefact(player *p, item *r_scroll)
     if (r_scroll->blessed)
     {
         if (type == IT_AMULET)
-            level = max(10, Z(p->pos));
+            level = max(map_volcano() - 1, Z(p->pos));
         else
-            level = rand_m_n(Z(p->pos), MAP_MAX);
+            level = rand_m_n(Z(p->pos), pos_levels());
     }
 
     item *it = item_new_by_level(type, level);
@@ -392,7 +392,8 @@ static int scroll_create_artefact(player *p, item *r_scroll)
         {
             // Roll again for an unknown, reasonably high-level book.
             while ((spell_known(p, it->id) && chance(80))
-                    || (it->id < (item_max_id(IT_BOOK) * level) / (MAP_MAX - 1)
+                    || (it->id < (item_max_id(IT_BOOK) * map_level_classic(level))
+                        / (MAP_MAX - 1)
                         && chance(50)))
             {
                 it->id = rand_1n(item_max_id(it->type));
@@ -786,9 +787,9 @@ int scroll_mapping(player *p, item *r_scroll)
 
     const gboolean map_traps = (r_scroll != NULL && r_scroll->blessed);
 
-    for (Y(pos) = 0; Y(pos) < MAP_MAX_Y; Y(pos)++)
+    for (Y(pos) = 0; Y(pos) < m->height; Y(pos)++)
     {
-        for (X(pos) = 0; X(pos) < MAP_MAX_X; X(pos)++)
+        for (X(pos) = 0; X(pos) < m->width; X(pos)++)
         {
             map_tile_t tile = map_tiletype_at(m, pos);
             if (r_scroll == NULL || tile != LT_FLOOR)
@@ -919,12 +920,12 @@ static int scroll_teleport(player *p, item *r_scroll)
         if (Z(p->pos) == 0)
             /* teleporting in town does not work */
             nlevel = 0;
-        else if (Z(p->pos) < MAP_CMAX)
+        else if (Z(p->pos) < map_volcano())
             /* choose a cavern level if the player is in the caverns*/
-            nlevel = rand_1n(MAP_CMAX);
+            nlevel = rand_1n(map_volcano());
         else
             /* choose a volcano level if the player is in the volcano */
-            nlevel = rand_m_n(MAP_CMAX, MAP_MAX);
+            nlevel = rand_m_n(map_volcano(), pos_levels());
     }
 
     if (nlevel != Z(p->pos))
@@ -969,7 +970,7 @@ static int scroll_timewarp(player *p, item *r_scroll)
         return FALSE;
     }
 
-    game_turn(nlarn) += turns;
+    game_time_warp(nlarn, turns);
     log_add_entry(nlarn->log,
                   "You go %sward in time by %d mobul%s.",
                   (mobuls < 0) ? "back" : "for",
@@ -981,7 +982,7 @@ static int scroll_timewarp(player *p, item *r_scroll)
         /* loop over all effects which affect the player */
         effect *e = game_effect_get(nlarn, g_ptr_array_index(p->effects, idx));
 
-        if (e->turns == 0)
+        if (effect_turns(e) == 0)
         {
             /* leave permanent effects alone */
             idx++;
@@ -990,8 +991,10 @@ static int scroll_timewarp(player *p, item *r_scroll)
 
         if (turns > 0)
         {
-            /* gone forward in time */
-            if ((gint)e->turns < turns)
+            /* gone forward in time: scheduled effects keep the turn
+               they end at, others count down the turns warped */
+            if (e->expires ? (e->expires <= game_turn(nlarn))
+                           : ((gint)e->turns <= turns))
             {
                 /* the effect's remaining turns are smaller
                    than the number of turns the player moved into the future,
@@ -1001,7 +1004,8 @@ static int scroll_timewarp(player *p, item *r_scroll)
             else
             {
                 /* reduce the number of remaining turns for this effect */
-                e->turns -= turns;
+                if (!e->expires)
+                    e->turns -= turns;
 
                 /* proceed to next effect */
                 idx++;
@@ -1019,7 +1023,8 @@ static int scroll_timewarp(player *p, item *r_scroll)
             else
             {
                 /* increase the number of remaining turns */
-                e->turns += abs(turns);
+                if (!e->expires)
+                    e->turns += abs(turns);
 
                 /* proceed to next effect */
                 idx++;
@@ -771,7 +771,7 @@ int player_stairs_down(player *p)
     case LS_ELEVATORDOWN:
         /* first volcano map */
         show_msg = TRUE;
-        nlevel = game_map(nlarn, MAP_CMAX);
+        nlevel = game_map(nlarn, map_volcano());
         break;
 
     case LS_CAVERNS_ENTRY:
@@ -655,10 +655,10 @@ static gboolean spell_type_player(spell *s, struct player *p)
             /* The duration of this effect can be incremented.
              * Increase the duration of the effect up to the base
              * effect duration * spell knowledge value. */
-            if (e->turns + effect_type_duration(e->type)
+            if (effect_turns(e) + effect_type_duration(e->type)
                 < (effect_type_duration(e->type) * s->knowledge))
             {
-                e->turns += effect_type_duration(e->type);
+                effect_turns_set(e, effect_turns(e) + effect_type_duration(e->type));
                 log_add_entry(nlarn->log, "You have extended the duration "
                         "of %s.", spell_name(s));
             }
@@ -1047,7 +1047,6 @@ static gboolean spell_type_blast(spell *s, struct player *p)
 static gboolean spell_alter_reality(spell *s, player *p)
 {
     map *nlevel;
-    position pos = { { 0, 0, Z(p->pos) } };
 
     if (Z(p->pos) == 0)
     {
@@ -1056,13 +1055,12 @@ static gboolean spell_alter_reality(spell *s, player *p)
     }
 
     /* reset the player's memory of the current map */
-    memset(&player_memory_of(p, pos), 0,
-           MAP_MAX_Y * MAP_MAX_X * sizeof(player_tile_memory));
+    player_level_memory_forget(p, Z(p->pos));
 
     map_destroy(game_map(nlarn, Z(p->pos)));
 
     /* create new map */
-    nlevel = nlarn->maps[Z(p->pos)] = map_new(Z(p->pos), nlarn_mazefile);
+    nlevel = nlarn->maps[Z(p->pos)] = map_new(Z(p->pos));
 
     /* reposition player (if needed) */
     if (!map_pos_passable(nlevel, p->pos))
@@ -1314,7 +1312,7 @@ static gboolean spell_make_wall(spell *s __attribute__((unused)), player *p)
                 {
                     /* briefly display the new monster before it dies */
                     display_paint_screen(nlarn->p);
-                    g_usleep(250000);
+                    display_sleep(250);
 
                     log_add_entry(nlarn->log, "The %s is trapped in the wall!",
                                   monster_get_name(m));
@@ -1583,7 +1581,7 @@ static int count_adjacent_water_squares(position pos)
             if (pos_identical(p, pos))
                 continue;
 
-            const map_tile *tile = map_tile_at(game_map(nlarn, Z(pos)), p);
+            const map_tile *tile = map_tile_get(game_map(nlarn, Z(pos)), p);
             if (tile->type == LT_WATER || tile->type == LT_DEEPWATER)
                 count++;
         }
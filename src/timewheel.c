@@ -0,0 +1,237 @@
+/*
+ * timewheel.c
+ * Copyright (C) 2009-2020 Joachim de Groot <jdegroot@web.de>
+ *
+ * NLarn is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * NLarn is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <glib.h>
+
+#include "timewheel.h"
+
+/* Each level has 64 slots; a slot on level n covers 64^n turns. Timers
+ * further in the future than the top level can hold are put into the
+ * top level anyway and sorted in again each time their slot comes up. */
+#define TW_BITS   6
+#define TW_SLOTS  (1 << TW_BITS)
+#define TW_MASK   (TW_SLOTS - 1)
+#define TW_LEVELS 4
+
+struct timewheel
+{
+    guint32 now;
+    GArray *slots[TW_LEVELS][TW_SLOTS];
+};
+
+/* the timer fires at its due turn, but not before the turn earliest */
+static void timewheel_insert(timewheel *tw, wheel_timer *t, guint32 earliest)
+{
+    guint32 due = t->due;
+    int level = 0;
+
+    /* timers in the past are handled as soon as possible */
+    if ((gint32)(due - earliest) < 0)
+        due = earliest;
+
+    guint32 delta = due - tw->now;
+
+    while (level < TW_LEVELS - 1 && delta >= (1u << (TW_BITS * (level + 1))))
+        level++;
+
+    guint slot = (due >> (TW_BITS * level)) & TW_MASK;
+    g_array_append_val(tw->slots[level][slot], *t);
+}
+
+/* sort the timers of a slot into the lower levels */
+static void timewheel_cascade(timewheel *tw, int level, guint slot)
+{
+    GArray *timers = tw->slots[level][slot];
+
+    if (timers->len == 0)
+        return;
+
+    tw->slots[level][slot] = g_array_new(FALSE, FALSE, sizeof(wheel_timer));
+
+    /* cascading happens before the slot of the current turn is taken,
+       hence timers due now still fire in time */
+    for (guint idx = 0; idx < timers->len; idx++)
+        timewheel_insert(tw, &g_array_index(timers, wheel_timer, idx), tw->now);
+
+    g_array_free(timers, TRUE);
+}
+
+timewheel *timewheel_new(guint32 now)
+{
+    timewheel *tw = g_malloc0(sizeof(timewheel));
+
+    tw->now = now;
+
+    for (int level = 0; level < TW_LEVELS; level++)
+        for (int slot = 0; slot < TW_SLOTS; slot++)
+            tw->slots[level][slot] = g_array_new(FALSE, FALSE, sizeof(wheel_timer));
+
+    return tw;
+}
+
+void timewheel_destroy(timewheel *tw)
+{
+    g_assert(tw != NULL);
+
+    for (int level = 0; level < TW_LEVELS; level++)
+        for (int slot = 0; slot < TW_SLOTS; slot++)
+            g_array_free(tw->slots[level][slot], TRUE);
+
+    g_free(tw);
+}
+
+void timewheel_add(timewheel *tw, guint32 due, guint32 kind, gpointer id)
+{
+    g_assert(tw != NULL);
+
+    wheel_timer t = { due, kind, id };
+
+    /* the slot of the current turn has been taken already */
+    timewheel_insert(tw, &t, tw->now + 1);
+}
+
+void timewheel_advance(timewheel *tw, GArray *fired)
+{
+    g_assert(tw != NULL && fired != NULL);
+
+    tw->now++;
+
+    /* when the slots of a level wrap around, the next slot of the level
+       above is due to be distributed, starting with the highest level */
+    int top = 0;
+    while (top < TW_LEVELS - 1 && ((tw->now >> (TW_BITS * top)) & TW_MASK) == 0)
+        top++;
+
+    for (int level = top; level > 0; level--)
+        timewheel_cascade(tw, level, (tw->now >> (TW_BITS * level)) & TW_MASK);
+
+    GArray *due = tw->slots[0][tw->now & TW_MASK];
+
+    if (due->len > 0)
+    {
+        g_array_append_vals(fired, due->data, due->len);
+        g_array_set_size(due, 0);
+    }
+}
+
+guint32 timewheel_idle(timewheel *tw, guint32 limit)
+{
+    g_assert(tw != NULL);
+
+    for (int level = 0; level < TW_LEVELS; level++)
+    {
+        for (int slot = 0; slot < TW_SLOTS; slot++)
+        {
+            GArray *s = tw->slots[level][slot];
+
+            for (guint idx = 0; idx < s->len; idx++)
+            {
+                guint32 due = g_array_index(s, wheel_timer, idx).due;
+
+                /* overdue timers fire next turn, see timewheel_insert() */
+                if ((gint32)(due - tw->now) <= 0)
+                    return 0;
+
+                limit = MIN(limit, due - tw->now - 1);
+            }
+        }
+    }
+
+    return limit;
+}
+
+void timewheel_skip(timewheel *tw, guint32 turns)
+{
+    g_assert(tw != NULL);
+
+    GArray *fired = g_array_new(FALSE, FALSE, sizeof(wheel_timer));
+
+    /* stepping keeps the cascades intact; it is cheap as the slots
+       passed are empty */
+    while (turns-- > 0)
+        timewheel_advance(tw, fired);
+
+    g_assert(fired->len == 0);
+    g_array_free(fired, TRUE);
+}
+
+GArray *timewheel_drain(timewheel *tw, guint32 now)
+{
+    g_assert(tw != NULL);
+
+    GArray *timers = g_array_new(FALSE, FALSE, sizeof(wheel_timer));
+
+    for (int level = 0; level < TW_LEVELS; level++)
+    {
+        for (int slot = 0; slot < TW_SLOTS; slot++)
+        {
+            GArray *s = tw->slots[level][slot];
+
+            if (s->len > 0)
+            {
+                g_array_append_vals(timers, s->data, s->len);
+                g_array_set_size(s, 0);
+            }
+        }
+    }
+
+    tw->now = now;
+
+    return timers;
+}
+
+cJSON *timewheel_serialize(timewheel *tw)
+{
+    cJSON *tser = cJSON_CreateArray();
+
+    g_assert(tw != NULL);
+
+    for (int level = 0; level < TW_LEVELS; level++)
+    {
+        for (int slot = 0; slot < TW_SLOTS; slot++)
+        {
+            GArray *s = tw->slots[level][slot];
+
+            for (guint idx = 0; idx < s->len; idx++)
+            {
+                wheel_timer *t = &g_array_index(s, wheel_timer, idx);
+                int val[3] = { t->due, t->kind, GPOINTER_TO_UINT(t->id) };
+
+                cJSON_AddItemToArray(tser, cJSON_CreateIntArray(val, 3));
+            }
+        }
+    }
+
+    return tser;
+}
+
+timewheel *timewheel_deserialize(cJSON *tser, guint32 now)
+{
+    timewheel *tw = timewheel_new(now);
+
+    for (int idx = 0; idx < cJSON_GetArraySize(tser); idx++)
+    {
+        cJSON *t = cJSON_GetArrayItem(tser, idx);
+
+        timewheel_add(tw, cJSON_GetArrayItem(t, 0)->valueint,
+                      cJSON_GetArrayItem(t, 1)->valueint,
+                      GUINT_TO_POINTER(cJSON_GetArrayItem(t, 2)->valueint));
+    }
+
+    return tw;
+}
@@ -0,0 +1,255 @@
+/*
+ * trace.c
+ * Copyright (C) 2009-2020 Joachim de Groot <jdegroot@web.de>
+ *
+ * NLarn is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * NLarn is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <glib.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "trace.h"
+
+
+/* number of events the ring of a thread can hold, must be a power of two */
+#define TRACE_RING 16384
+
+typedef struct trace_event
+{
+    const char *name;
+    gint64 ts;      /* start, relative to the opening of the trace */
+    gint64 dur;
+    gint64 arg;
+} trace_event;
+
+/* the events recorded by one thread; the thread is the only one adding
+   events, the writer the only one taking them */
+typedef struct trace_ring
+{
+    trace_event *events;
+    volatile gint head;     /* events recorded, only changed by the thread */
+    volatile gint tail;     /* events written, only changed by the writer */
+    guint tid;              /* the thread's number in the trace */
+    gboolean named;         /* the name of the thread has been written */
+    guint dropped;
+} trace_ring;
+
+gboolean trace_active = FALSE;
+
+static struct
+{
+    FILE *file;
+    gint64 epoch;
+    GPtrArray *rings;       /* the rings of all threads, by number */
+    gboolean stop;
+    GThread *writer;
+    GMutex mutex;           /* protects rings and stop */
+    GCond wakeup;
+} trace = { 0 };
+
+/* the ring of the current thread */
+#ifdef _MSC_VER
+static __declspec(thread) trace_ring *ring = NULL;
+#else
+static __thread trace_ring *ring = NULL;
+#endif
+
+static trace_ring *trace_ring_new()
+{
+    trace_ring *r = g_malloc0(sizeof(trace_ring));
+
+    r->events = g_malloc(TRACE_RING * sizeof(trace_event));
+
+    g_mutex_lock(&trace.mutex);
+    g_ptr_array_add(trace.rings, r);
+    r->tid = trace.rings->len;
+    g_mutex_unlock(&trace.mutex);
+
+    return r;
+}
+
+static void trace_write(trace_event *ev, guint tid)
+{
+    fprintf(trace.file, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,"
+            "\"ts\":%" G_GINT64_FORMAT ",\"dur\":%" G_GINT64_FORMAT,
+            ev->name, tid, ev->ts, ev->dur);
+
+    if (ev->arg >= 0)
+        fprintf(trace.file, ",\"args\":{\"id\":%" G_GINT64_FORMAT "}", ev->arg);
+
+    fputc('}', trace.file);
+}
+
+/* write all events recorded so far */
+static void trace_drain()
+{
+    for (guint idx = 0; ; idx++)
+    {
+        trace_ring *r = NULL;
+
+        /* threads may add their rings meanwhile */
+        g_mutex_lock(&trace.mutex);
+        if (idx < trace.rings->len)
+            r = g_ptr_array_index(trace.rings, idx);
+        g_mutex_unlock(&trace.mutex);
+
+        if (r == NULL)
+            break;
+
+        guint tail = g_atomic_int_get(&r->tail);
+        const guint head = g_atomic_int_get(&r->head);
+
+        if (!r->named)
+        {
+            fprintf(trace.file, ",\n{\"name\":\"thread_name\",\"ph\":\"M\","
+                    "\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"%s %u\"}}",
+                    r->tid, (r->tid == 1) ? "game" : "thread", r->tid);
+            r->named = TRUE;
+        }
+
+        for (; tail != head; tail++)
+            trace_write(&r->events[tail & (TRACE_RING - 1)], r->tid);
+
+        g_atomic_int_set(&r->tail, tail);
+    }
+}
+
+static gpointer trace_writer(gpointer data __attribute__((unused)))
+{
+    gboolean stop = FALSE;
+
+    while (!stop)
+    {
+        g_mutex_lock(&trace.mutex);
+
+        /* wake up when a quarter of a ring is used or after 100ms */
+        if (!trace.stop)
+        {
+            g_cond_wait_until(&trace.wakeup, &trace.mutex,
+                              g_get_monotonic_time() + 100000);
+        }
+
+        stop = trace.stop;
+        g_mutex_unlock(&trace.mutex);
+
+        trace_drain();
+    }
+
+    return NULL;
+}
+
+gboolean trace_open(const char *filename)
+{
+    g_assert(filename != NULL && trace.file == NULL);
+
+    if ((trace.file = fopen(filename, "w")) == NULL)
+        return FALSE;
+
+    trace.epoch = g_get_monotonic_time();
+    trace.rings = g_ptr_array_new();
+
+    g_mutex_init(&trace.mutex);
+    g_cond_init(&trace.wakeup);
+
+    /* the thread opening the trace plays the game */
+    ring = trace_ring_new();
+
+    /* the array format tolerates a missing end, e.g. after a crash */
+    fputs("[{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,"
+          "\"args\":{\"name\":\"nlarn\"}}", trace.file);
+
+    trace.writer = g_thread_new("trace", trace_writer, NULL);
+
+    trace_active = TRUE;
+    atexit(trace_close);
+
+    return TRUE;
+}
+
+void trace_close()
+{
+    if (!trace_active)
+        return;
+
+    trace_active = FALSE;
+
+    g_mutex_lock(&trace.mutex);
+    trace.stop = TRUE;
+    g_cond_signal(&trace.wakeup);
+    g_mutex_unlock(&trace.mutex);
+
+    g_thread_join(trace.writer);
+
+    for (guint idx = 0; idx < trace.rings->len; idx++)
+    {
+        trace_ring *r = g_ptr_array_index(trace.rings, idx);
+
+        if (r->dropped > 0)
+        {
+            fprintf(trace.file, ",\n{\"name\":\"dropped events\",\"ph\":\"i\","
+                    "\"s\":\"t\",\"pid\":1,\"tid\":%u,\"ts\":%" G_GINT64_FORMAT
+                    ",\"args\":{\"count\":%u}}", r->tid,
+                    g_get_monotonic_time() - trace.epoch, r->dropped);
+        }
+
+        g_free(r->events);
+        g_free(r);
+    }
+
+    fputs("\n]\n", trace.file);
+    fclose(trace.file);
+    trace.file = NULL;
+
+    g_ptr_array_free(trace.rings, TRUE);
+    trace.rings = NULL;
+    ring = NULL;
+    g_mutex_clear(&trace.mutex);
+    g_cond_clear(&trace.wakeup);
+}
+
+void trace_span(const char *name, gint64 start, gint64 arg)
+{
+    if (!trace_active)
+        return;
+
+    if (ring == NULL)
+        ring = trace_ring_new();
+
+    const gint64 now = g_get_monotonic_time();
+    const guint head = ring->head;
+    const guint used = head - (guint)g_atomic_int_get(&ring->tail);
+
+    if (used == TRACE_RING)
+    {
+        /* the writer can not keep up */
+        ring->dropped++;
+        return;
+    }
+
+    trace_event *ev = &ring->events[head & (TRACE_RING - 1)];
+    ev->name = name;
+    ev->ts = start - trace.epoch;
+    ev->dur = now - start;
+    ev->arg = arg;
+
+    g_atomic_int_set(&ring->head, head + 1);
+
+    if (used + 1 == TRACE_RING / 4)
+    {
+        g_mutex_lock(&trace.mutex);
+        g_cond_signal(&trace.wakeup);
+        g_mutex_unlock(&trace.mutex);
+    }
+}
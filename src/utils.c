@@ -128,7 +128,7 @@ void log_set_time(message_log *log, int gtime)
     /* flush pending entry */
     if ((log->buffer)->len)
     {
-        message_log_entry *entry = g_malloc(sizeof(message_log_entry));
+        message_log_entry *entry = g_malloc0(sizeof(message_log_entry));
         entry->gtime = log->gtime;
         entry->message = (log->buffer)->str;
 
@@ -163,6 +163,69 @@ message_log_entry *log_get_entry(message_log *log, guint id)
     return g_ptr_array_index(log->entries, id);
 }
 
+cJSON *json_array_append(cJSON *array, cJSON *last, cJSON *item)
+{
+    g_assert(array != NULL && item != NULL);
+
+    if (last == NULL)
+    {
+        array->child = item;
+    }
+    else
+    {
+        last->next = item;
+        item->prev = last;
+    }
+
+    return item;
+}
+
+gboolean log_wrap(message_log *log, int width, int twidth, guint count)
+{
+    g_assert(log != NULL);
+
+    /* the lines of another width are useless */
+    if (width != log->wrap_width || twidth != log->wrap_twidth)
+    {
+        for (guint idx = 0; idx < log_length(log); idx++)
+        {
+            message_log_entry *le = log_get_entry(log, idx);
+
+            if (le->wrapped != NULL)
+            {
+                text_destroy(le->wrapped);
+                le->wrapped = NULL;
+            }
+        }
+
+        log->wrap_width = width;
+        log->wrap_twidth = twidth;
+    }
+
+    guint wrapped = 0;
+
+    /* the latest entries are shown first */
+    for (guint idx = log_length(log); idx > 0; idx--)
+    {
+        message_log_entry *le = log_get_entry(log, idx - 1);
+
+        if (le->wrapped != NULL)
+            continue;
+
+        /* leave the remaining entries for later */
+        if (count > 0 && wrapped == count)
+            return TRUE;
+
+        gchar *text = g_strdup_printf("%*d: %s\n", twidth, le->gtime, le->message);
+        le->wrapped = text_wrap(text, width, twidth + 2);
+        g_free(text);
+
+        wrapped++;
+    }
+
+    return FALSE;
+}
+
 cJSON *log_serialize(message_log *log)
 {
     cJSON *log_ser = cJSON_CreateObject();
@@ -233,7 +296,7 @@ message_log *log_deserialize(cJSON *lser)
         for (int idx = 0; idx < cJSON_GetArraySize(obj); idx++)
         {
             cJSON *le = cJSON_GetArrayItem(obj, idx);
-            message_log_entry *entry = g_malloc(sizeof(message_log_entry));
+            message_log_entry *entry = g_malloc0(sizeof(message_log_entry));
 
             entry->gtime = cJSON_GetObjectItem(le, "gtime")->valueint;
             entry->message = g_strdup(cJSON_GetObjectItem(le, "message")->valuestring);
@@ -483,7 +546,11 @@ int str_starts_with_vowel(const char *str)
 
 const char *int2str(int val)
 {
-    static char buf[21];
+#ifdef _MSC_VER
+    static __declspec(thread) char buf[21];
+#else
+    static __thread char buf[21];
+#endif
     const char *count_desc[] = { "no", "one", "two", "three", "four", "five",
                                  "six", "seven", "eight", "nine", "ten",
                                  "eleven", "twelve", "thirteen", "fourteen",
@@ -512,7 +579,11 @@ const char *int2time_str(int val)
     }
     else
     {
-        static char buf[21];
+#ifdef _MSC_VER
+        static __declspec(thread) char buf[21];
+#else
+        static __thread char buf[21];
+#endif
         g_snprintf(buf, 20, "%d times", val);
         return buf;
     }
@@ -522,5 +593,9 @@ static void log_entry_destroy(message_log_entry *entry)
 {
     g_assert(entry != NULL);
     g_free(entry->message);
+
+    if (entry->wrapped != NULL)
+        text_destroy(entry->wrapped);
+
     g_free(entry);
 }
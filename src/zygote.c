@@ -0,0 +1,420 @@
+/*
+ * zygote.c
+ * Copyright (C) 2009-2020 Joachim de Groot <jdegroot@web.de>
+ *
+ * NLarn is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * NLarn is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifdef __unix
+
+#ifdef __linux__
+# ifndef _GNU_SOURCE
+#  define _GNU_SOURCE
+# endif
+#endif
+
+#include <errno.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+#include "zygote.h"
+
+extern char **environ;
+
+/* A session sends the header, together with its standard input, output
+   and error, followed by its command line and its environment: each string
+   terminated by a NUL character, the command line followed by an empty
+   string. The process playing the game answers with its process id once
+   it has taken over, and keeps the connection open until it terminates. */
+#define ZYGOTE_MAGIC "NLZ1"
+#define ZYGOTE_FDS 3
+
+/* the longest command line and environment accepted */
+#define ZYGOTE_MAX_LEN (1 << 20)
+
+typedef struct zygote_header
+{
+    char magic[4];
+    guint32 len;
+} zygote_header;
+
+/* the process playing the game for the session */
+static pid_t session_pid = 0;
+
+static gboolean zygote_write(int fd, gconstpointer data, gsize len)
+{
+    const char *pos = data;
+
+    while (len > 0)
+    {
+        ssize_t written = write(fd, pos, len);
+
+        if (written == -1 && errno == EINTR) continue;
+        if (written <= 0) return FALSE;
+
+        pos += written;
+        len -= written;
+    }
+
+    return TRUE;
+}
+
+static gboolean zygote_read(int fd, gpointer data, gsize len)
+{
+    char *pos = data;
+
+    while (len > 0)
+    {
+        ssize_t got = read(fd, pos, len);
+
+        if (got == -1 && errno == EINTR) continue;
+        if (got <= 0) return FALSE;
+
+        pos += got;
+        len -= got;
+    }
+
+    return TRUE;
+}
+
+static int zygote_socket(const char *socket_name, struct sockaddr_un *addr)
+{
+    if (strlen(socket_name) >= sizeof(addr->sun_path))
+    {
+        g_printerr("The socket name \"%s\" is too long.\n", socket_name);
+        return -1;
+    }
+
+    memset(addr, 0, sizeof(struct sockaddr_un));
+    addr->sun_family = AF_UNIX;
+    strcpy(addr->sun_path, socket_name);
+
+    int sock = socket(AF_UNIX, SOCK_STREAM, 0);
+
+    if (sock == -1)
+        perror("Could not create the socket");
+
+    return sock;
+}
+
+/* only sessions of the user running the zygote are served: the game
+   started for them runs with the zygote's privileges */
+static gboolean zygote_peer_trusted(int conn)
+{
+#ifdef SO_PEERCRED
+    struct ucred cred;
+    socklen_t len = sizeof(cred);
+
+    if (getsockopt(conn, SOL_SOCKET, SO_PEERCRED, &cred, &len) == -1)
+        return FALSE;
+
+    return (cred.uid == getuid());
+#else
+    uid_t uid;
+    gid_t gid;
+
+    if (getpeereid(conn, &uid, &gid) == -1)
+        return FALSE;
+
+    return (uid == getuid());
+#endif
+}
+
+/* take over the session on the connection; exits on failure */
+static gchar **zygote_session_start(int conn)
+{
+    zygote_header header;
+    int fds[ZYGOTE_FDS];
+    char control[CMSG_SPACE(sizeof(fds))];
+    struct iovec iov = { &header, sizeof(header) };
+    struct msghdr msg;
+    ssize_t got;
+
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+
+    /* the file descriptors arrive with the first byte of the header */
+    do got = recvmsg(conn, &msg, 0);
+    while (got == -1 && errno == EINTR);
+
+    struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+
+    if (got <= 0 || cmsg == NULL || cmsg->cmsg_level != SOL_SOCKET
+            || cmsg->cmsg_type != SCM_RIGHTS
+            || cmsg->cmsg_len != CMSG_LEN(sizeof(fds)))
+        _exit(EXIT_FAILURE);
+
+    memcpy(fds, CMSG_DATA(cmsg), sizeof(fds));
+
+    if (!zygote_read(conn, (char *)&header + got, sizeof(header) - got)
+            || memcmp(header.magic, ZYGOTE_MAGIC, sizeof(header.magic))
+            || header.len == 0 || header.len > ZYGOTE_MAX_LEN)
+        _exit(EXIT_FAILURE);
+
+    g_autofree char *strings = g_malloc(header.len + 1);
+
+    if (!zygote_read(conn, strings, header.len))
+        _exit(EXIT_FAILURE);
+
+    /* terminate the last string in any case */
+    strings[header.len] = '\0';
+
+    /* take over the terminal */
+    for (int fd = 0; fd < ZYGOTE_FDS; fd++)
+    {
+        if (dup2(fds[fd], fd) == -1)
+            _exit(EXIT_FAILURE);
+    }
+
+    for (int fd = 0; fd < ZYGOTE_FDS; fd++)
+    {
+        if (fds[fd] >= ZYGOTE_FDS)
+            close(fds[fd]);
+    }
+
+    /* Leave the zygote's session. The terminal usually remains the
+       controlling terminal of the connecting process, which then forwards
+       the signals the terminal sends to this process. */
+    setsid();
+    (void)ioctl(STDIN_FILENO, TIOCSCTTY, 0);
+
+    /* split the command line from the environment */
+    GPtrArray *args = g_ptr_array_new();
+    char *pos = strings;
+    char *end = strings + header.len;
+
+    while (pos < end && *pos)
+    {
+        g_ptr_array_add(args, g_strdup(pos));
+        pos += strlen(pos) + 1;
+    }
+
+    g_ptr_array_add(args, NULL);
+
+    /* replace the environment */
+    gchar **names = g_listenv();
+    for (guint idx = 0; names[idx]; idx++)
+        g_unsetenv(names[idx]);
+
+    g_strfreev(names);
+
+    for (pos++; pos < end; pos += strlen(pos) + 1)
+    {
+        char *value = strchr(pos, '=');
+
+        if (value == NULL || value == pos)
+            continue;
+
+        *value = '\0';
+        g_setenv(pos, value + 1, TRUE);
+        *value = '=';
+    }
+
+    /* tell the session that the game is running */
+    gint32 pid = getpid();
+
+    if (!zygote_write(conn, &pid, sizeof(pid)))
+        _exit(EXIT_FAILURE);
+
+    /* the connection remains open while the game is played */
+    return (gchar **)g_ptr_array_free(args, FALSE);
+}
+
+gchar **zygote_serve(const char *socket_name)
+{
+    struct sockaddr_un addr;
+    int sock = zygote_socket(socket_name, &addr);
+
+    if (sock == -1)
+        exit(EXIT_FAILURE);
+
+    /* remove the socket left by a previous zygote, but nothing else */
+    struct stat st;
+
+    if (lstat(socket_name, &st) == 0)
+    {
+        if (!S_ISSOCK(st.st_mode))
+        {
+            g_printerr("\"%s\" exists and is not a socket.\n", socket_name);
+            exit(EXIT_FAILURE);
+        }
+
+        unlink(socket_name);
+    }
+
+    /* the socket is accessible for the user running the zygote only,
+       from the moment it is created */
+    mode_t mask = umask(0177);
+    int bound = bind(sock, (struct sockaddr *)&addr, sizeof(addr));
+    umask(mask);
+
+    if (bound == -1 || listen(sock, SOMAXCONN) == -1)
+    {
+        perror("Could not listen on the socket");
+        exit(EXIT_FAILURE);
+    }
+
+    /* the games are not waited for */
+    signal(SIGCHLD, SIG_IGN);
+
+    while (TRUE)
+    {
+        int conn = accept(sock, NULL, NULL);
+
+        if (conn == -1)
+        {
+            if (errno == EINTR || errno == ECONNABORTED)
+                continue;
+
+            perror("Could not accept a session");
+            exit(EXIT_FAILURE);
+        }
+
+        if (!zygote_peer_trusted(conn))
+        {
+            g_printerr("Refused a session of another user.\n");
+            close(conn);
+            continue;
+        }
+
+        /* the zygote must not wait for a session, thus the new process
+           handles the connection */
+        pid_t pid = fork();
+
+        if (pid == 0)
+        {
+            close(sock);
+            signal(SIGCHLD, SIG_DFL);
+
+            return zygote_session_start(conn);
+        }
+
+        if (pid == -1)
+            perror("Could not start a game");
+
+        close(conn);
+    }
+}
+
+static void zygote_signal_forward(int signo)
+{
+    if (session_pid > 0)
+        kill(session_pid, signo);
+}
+
+int zygote_connect(const char *socket_name, char **args)
+{
+    struct sockaddr_un addr;
+    int sock = zygote_socket(socket_name, &addr);
+
+    if (sock == -1)
+        return EXIT_FAILURE;
+
+    if (connect(sock, (struct sockaddr *)&addr, sizeof(addr)) == -1)
+    {
+        perror("Could not connect to the zygote");
+        return EXIT_FAILURE;
+    }
+
+    GString *strings = g_string_new(NULL);
+
+    for (guint idx = 0; args[idx]; idx++)
+        g_string_append_len(strings, args[idx], strlen(args[idx]) + 1);
+
+    g_string_append_c(strings, '\0');
+
+    for (guint idx = 0; environ[idx]; idx++)
+        g_string_append_len(strings, environ[idx], strlen(environ[idx]) + 1);
+
+    if (strings->len > ZYGOTE_MAX_LEN)
+    {
+        g_printerr("The command line and the environment are too long.\n");
+        g_string_free(strings, TRUE);
+        return EXIT_FAILURE;
+    }
+
+    zygote_header header;
+    int fds[ZYGOTE_FDS] = { STDIN_FILENO, STDOUT_FILENO, STDERR_FILENO };
+    char control[CMSG_SPACE(sizeof(fds))];
+    struct iovec iov = { &header, sizeof(header) };
+    struct msghdr msg;
+    ssize_t sent;
+
+    memcpy(header.magic, ZYGOTE_MAGIC, sizeof(header.magic));
+    header.len = strings->len;
+
+    memset(control, 0, sizeof(control));
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+
+    struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(fds));
+    memcpy(CMSG_DATA(cmsg), fds, sizeof(fds));
+
+    /* a zygote refusing the session closes the connection */
+    signal(SIGPIPE, SIG_IGN);
+
+    do sent = sendmsg(sock, &msg, 0);
+    while (sent == -1 && errno == EINTR);
+
+    gboolean ok = (sent > 0)
+        && zygote_write(sock, (char *)&header + sent, sizeof(header) - sent)
+        && zygote_write(sock, strings->str, strings->len);
+
+    g_string_free(strings, TRUE);
+
+    /* wait for the game to start */
+    gint32 pid;
+
+    if (!ok || !zygote_read(sock, &pid, sizeof(pid)))
+    {
+        g_printerr("The zygote could not start a game.\n");
+        return EXIT_FAILURE;
+    }
+
+    session_pid = pid;
+
+    /* pass on the signals sent by the terminal */
+    signal(SIGHUP, zygote_signal_forward);
+    signal(SIGTERM, zygote_signal_forward);
+    signal(SIGWINCH, zygote_signal_forward);
+
+    /* wait for the game to end */
+    char buf[64];
+    ssize_t got;
+
+    do got = read(sock, buf, sizeof(buf));
+    while (got > 0 || (got == -1 && errno == EINTR));
+
+    close(sock);
+
+    return EXIT_SUCCESS;
+}
+
+#endif